@@ -116,11 +116,6 @@ glusterfs_ctx_defaults_init (glusterfs_ctx_t *ctx)
 	if (!ctx->dict_pool)
 		goto err;
 
-	ctx->dict_pair_pool = mem_pool_new (data_pair_t,
-					    GF_MEMPOOL_COUNT_OF_DATA_PAIR_T);
-	if (!ctx->dict_pair_pool)
-		goto err;
-
 	ctx->dict_data_pool = mem_pool_new (data_t, GF_MEMPOOL_COUNT_OF_DATA_T);
 	if (!ctx->dict_data_pool)
 		goto err;
@@ -149,8 +144,6 @@ err:
 			mem_pool_destroy (ctx->dict_pool);
 		if (ctx->dict_data_pool)
 			mem_pool_destroy (ctx->dict_data_pool);
-		if (ctx->dict_pair_pool)
-			mem_pool_destroy (ctx->dict_pair_pool);
 	}
 
 	return ret;
@@ -5874,6 +5874,68 @@ out:
         return;
 }
 
+void
+cmd_heal_volume_statistics_out (dict_t *dict, int brick)
+{
+        int             ret = 0;
+        char            key[256] = {0};
+        char           *hostname = NULL;
+        char           *path = NULL;
+        char           *status = NULL;
+        uint32_t        threads = 0;
+        uint32_t        queued = 0;
+        uint64_t        done = 0;
+        uint64_t        failed = 0;
+        uint64_t        skipped = 0;
+        uint64_t        remaining = 0;
+        uint64_t        eta = 0;
+        double          rate = 0;
+
+        snprintf (key, sizeof key, "%d-hostname", brick);
+        ret = dict_get_str (dict, key, &hostname);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof key, "%d-path", brick);
+        ret = dict_get_str (dict, key, &path);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof key, "%d-status", brick);
+        ret = dict_get_str (dict, key, &status);
+        if (ret)
+                goto out;
+        cli_out ("\nBrick %s:%s", hostname, path);
+        cli_out ("Status: %s", status);
+
+        snprintf (key, sizeof key, "%d-heal-threads", brick);
+        ret = dict_get_uint32 (dict, key, &threads);
+        snprintf (key, sizeof key, "%d-heal-queued", brick);
+        ret = dict_get_uint32 (dict, key, &queued);
+        snprintf (key, sizeof key, "%d-heal-done", brick);
+        ret = dict_get_uint64 (dict, key, &done);
+        snprintf (key, sizeof key, "%d-heal-failed", brick);
+        ret = dict_get_uint64 (dict, key, &failed);
+        snprintf (key, sizeof key, "%d-heal-skipped", brick);
+        ret = dict_get_uint64 (dict, key, &skipped);
+        snprintf (key, sizeof key, "%d-heal-remaining", brick);
+        ret = dict_get_uint64 (dict, key, &remaining);
+        snprintf (key, sizeof key, "%d-heal-rate", brick);
+        ret = dict_get_double (dict, key, &rate);
+        snprintf (key, sizeof key, "%d-heal-eta", brick);
+        ret = dict_get_uint64 (dict, key, &eta);
+
+        cli_out ("Heal threads: %"PRIu32, threads);
+        cli_out ("Queued entries: %"PRIu32, queued);
+        cli_out ("Entries healed: %"PRIu64" (failed: %"PRIu64", already "
+                 "being healed: %"PRIu64")", done - failed, failed, skipped);
+        cli_out ("Entries remaining: %"PRIu64, remaining);
+        cli_out ("Heal rate: %.2f entries/sec", rate);
+        if (eta)
+                cli_out ("Estimated time left: %"PRIu64":%02"PRIu64":%02"
+                         PRIu64, eta / 3600, (eta / 60) % 60, eta % 60);
+out:
+        return;
+}
+
 int
 gf_cli_heal_volume_cbk (struct rpc_req *req, struct iovec *iov,
                              int count, void *myframe)
@@ -5988,8 +6050,12 @@ gf_cli_heal_volume_cbk (struct rpc_req *req, struct iovec *iov,
                 goto out;
         }
 
-        for (i = 0; i < brick_count; i++)
-                cmd_heal_volume_brick_out (dict, i);
+        for (i = 0; i < brick_count; i++) {
+                if (heal_op == GF_AFR_OP_STATISTICS)
+                        cmd_heal_volume_statistics_out (dict, i);
+                else
+                        cmd_heal_volume_brick_out (dict, i);
+        }
         ret = rsp.op_ret;
 
 out:
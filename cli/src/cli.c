@@ -136,10 +136,6 @@ glusterfs_ctx_defaults_init (glusterfs_ctx_t *ctx)
         if (!ctx->dict_pool)
                 return -1;
 
-        ctx->dict_pair_pool = mem_pool_new (data_pair_t, 512);
-        if (!ctx->dict_pair_pool)
-                return -1;
-
         ctx->dict_data_pool = mem_pool_new (data_t, 512);
         if (!ctx->dict_data_pool)
                 return -1;
@@ -988,6 +988,8 @@ cleanup_and_exit (int signum)
 
         glusterfs_pidfile_cleanup (ctx);
 
+        gf_log_fini ();
+
         exit (0);
 #if 0
         /* TODO: Properly do cleanup_and_exit(), with synchronization */
@@ -1194,11 +1196,6 @@ glusterfs_ctx_defaults_init (glusterfs_ctx_t *ctx)
         if (!ctx->dict_pool)
                 return -1;
 
-        ctx->dict_pair_pool = mem_pool_new (data_pair_t,
-                                            GF_MEMPOOL_COUNT_OF_DATA_PAIR_T);
-        if (!ctx->dict_pair_pool)
-                return -1;
-
         ctx->dict_data_pool = mem_pool_new (data_t, GF_MEMPOOL_COUNT_OF_DATA_T);
         if (!ctx->dict_data_pool)
                 return -1;
@@ -1255,9 +1252,6 @@ out:
 
                 if (ctx->dict_data_pool)
                         mem_pool_destroy (ctx->dict_data_pool);
-
-                if (ctx->dict_pair_pool)
-                        mem_pool_destroy (ctx->dict_pair_pool);
         }
 
         return ret;
@@ -39,7 +39,6 @@
 #define GF_MEMPOOL_COUNT_OF_DICT_T        4096
 /* Considering 4 key/value pairs in a dictionary on an average */
 #define GF_MEMPOOL_COUNT_OF_DATA_T        (GF_MEMPOOL_COUNT_OF_DICT_T * 4)
-#define GF_MEMPOOL_COUNT_OF_DATA_PAIR_T   (GF_MEMPOOL_COUNT_OF_DICT_T * 4)
 
 enum argp_option_keys {
         ARGP_VOLFILE_SERVER_KEY           = 's',
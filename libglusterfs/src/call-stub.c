@@ -2129,7 +2129,8 @@ call_stub_t *
 fop_xattrop_cbk_stub (call_frame_t *frame,
                       fop_xattrop_cbk_t fn,
                       int32_t op_ret,
-                      int32_t op_errno, dict_t *xdata)
+                      int32_t op_errno,
+                      dict_t *xattr, dict_t *xdata)
 {
         call_stub_t *stub = NULL;
 
@@ -2141,6 +2142,8 @@ fop_xattrop_cbk_stub (call_frame_t *frame,
         stub->args.xattrop_cbk.fn       = fn;
         stub->args.xattrop_cbk.op_ret   = op_ret;
         stub->args.xattrop_cbk.op_errno = op_errno;
+        if (xattr)
+                stub->args.xattrop_cbk.xattr = dict_ref (xattr);
 
         if (xdata)
                 stub->xdata = dict_ref (xdata);
@@ -1081,10 +1081,11 @@ fop_xattrop_stub (call_frame_t *frame,
 		  dict_t *xattr, dict_t *xdata);
 
 call_stub_t *
-fop_xattrop_stub_cbk_stub (call_frame_t *frame,
-			   fop_xattrop_cbk_t fn,
-			   int32_t op_ret,
-			   int32_t op_errno, dict_t *xdata);
+fop_xattrop_cbk_stub (call_frame_t *frame,
+		      fop_xattrop_cbk_t fn,
+		      int32_t op_ret,
+		      int32_t op_errno,
+		      dict_t *xattr, dict_t *xdata);
 
 call_stub_t *
 fop_fxattrop_stub (call_frame_t *frame,
@@ -1094,10 +1095,11 @@ fop_fxattrop_stub (call_frame_t *frame,
 		   dict_t *xattr, dict_t *xdata);
 
 call_stub_t *
-fop_fxattrop_stub_cbk_stub (call_frame_t *frame,
-			    fop_xattrop_cbk_t fn,
-			    int32_t op_ret,
-			    int32_t op_errno, dict_t *xdata);
+fop_fxattrop_cbk_stub (call_frame_t *frame,
+		       fop_fxattrop_cbk_t fn,
+		       int32_t op_ret,
+		       int32_t op_errno,
+		       dict_t *xattr, dict_t *xdata);
 
 call_stub_t *
 fop_setattr_stub (call_frame_t *frame,
@@ -63,3 +63,112 @@ gf_rsync_strong_checksum (unsigned char *data, size_t len, unsigned char *md5)
 {
         MD5(data, len, md5);
 }
+
+
+/*
+ * A non-cryptographic 128 bit "strong" checksum (MurmurHash3, x64_128
+ * variant, seed 0). It fills the same MD5_DIGEST_LENGTH bytes as
+ * gf_rsync_strong_checksum() at a fraction of its cost, and is used
+ * for rchecksum when both ends of a heal ask for it.
+ */
+
+static inline uint64_t
+gf_rotl64 (uint64_t x, int8_t r)
+{
+        return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+gf_get_le64 (const unsigned char *p)
+{
+        return ((uint64_t) p[0])       | ((uint64_t) p[1] << 8)  |
+               ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+               ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+               ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline void
+gf_put_le64 (unsigned char *p, uint64_t v)
+{
+        int i = 0;
+
+        for (i = 0; i < 8; i++)
+                p[i] = (unsigned char) (v >> (i * 8));
+}
+
+static inline uint64_t
+gf_fmix64 (uint64_t k)
+{
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+
+        return k;
+}
+
+void
+gf_rsync_fast_checksum (unsigned char *data, size_t len, unsigned char *sum)
+{
+        const uint64_t  c1      = 0x87c37b91114253d5ULL;
+        const uint64_t  c2      = 0x4cf5ad432745937fULL;
+        size_t          nblocks = len / 16;
+        const unsigned char *tail = NULL;
+        uint64_t        h1      = 0;
+        uint64_t        h2      = 0;
+        uint64_t        k1      = 0;
+        uint64_t        k2      = 0;
+        size_t          i       = 0;
+
+        for (i = 0; i < nblocks; i++) {
+                k1 = gf_get_le64 (data + (i * 16));
+                k2 = gf_get_le64 (data + (i * 16) + 8);
+
+                k1 *= c1; k1 = gf_rotl64 (k1, 31); k1 *= c2; h1 ^= k1;
+                h1 = gf_rotl64 (h1, 27); h1 += h2;
+                h1 = h1 * 5 + 0x52dce729;
+
+                k2 *= c2; k2 = gf_rotl64 (k2, 33); k2 *= c1; h2 ^= k2;
+                h2 = gf_rotl64 (h2, 31); h2 += h1;
+                h2 = h2 * 5 + 0x38495ab5;
+        }
+
+        tail = data + (nblocks * 16);
+        k1 = k2 = 0;
+
+        switch (len & 15) {
+        case 15: k2 ^= ((uint64_t) tail[14]) << 48;
+        case 14: k2 ^= ((uint64_t) tail[13]) << 40;
+        case 13: k2 ^= ((uint64_t) tail[12]) << 32;
+        case 12: k2 ^= ((uint64_t) tail[11]) << 24;
+        case 11: k2 ^= ((uint64_t) tail[10]) << 16;
+        case 10: k2 ^= ((uint64_t) tail[9]) << 8;
+        case 9:  k2 ^= ((uint64_t) tail[8]);
+                 k2 *= c2; k2 = gf_rotl64 (k2, 33); k2 *= c1; h2 ^= k2;
+        case 8:  k1 ^= ((uint64_t) tail[7]) << 56;
+        case 7:  k1 ^= ((uint64_t) tail[6]) << 48;
+        case 6:  k1 ^= ((uint64_t) tail[5]) << 40;
+        case 5:  k1 ^= ((uint64_t) tail[4]) << 32;
+        case 4:  k1 ^= ((uint64_t) tail[3]) << 24;
+        case 3:  k1 ^= ((uint64_t) tail[2]) << 16;
+        case 2:  k1 ^= ((uint64_t) tail[1]) << 8;
+        case 1:  k1 ^= ((uint64_t) tail[0]);
+                 k1 *= c1; k1 = gf_rotl64 (k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= (uint64_t) len;
+        h2 ^= (uint64_t) len;
+
+        h1 += h2;
+        h2 += h1;
+
+        h1 = gf_fmix64 (h1);
+        h2 = gf_fmix64 (h2);
+
+        h1 += h2;
+        h2 += h1;
+
+        gf_put_le64 (sum, h1);
+        gf_put_le64 (sum + 8, h2);
+}
@@ -17,4 +17,7 @@ gf_rsync_weak_checksum (unsigned char *buf, size_t len);
 void
 gf_rsync_strong_checksum (unsigned char *buf, size_t len, unsigned char *sum);
 
+void
+gf_rsync_fast_checksum (unsigned char *buf, size_t len, unsigned char *sum);
+
 #endif /* __CHECKSUM_H__ */
@@ -403,6 +403,9 @@ gf_print_trace (int32_t signum, glusterfs_ctx_t *ctx)
         int          ret = 0;
         int          fd = 0;
 
+        /* get the queued messages out before the trace goes behind them */
+        gf_log_flush_on_crash ();
+
         fd = fileno (ctx->log.gf_log_logfile);
 
         /* Pending frames, (if any), list them in order */
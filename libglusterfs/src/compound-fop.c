@@ -0,0 +1,492 @@
+/*
+  Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "compound-fop.h"
+#include "mem-types.h"
+
+gf_boolean_t
+compound_fop_supported (glusterfs_fop_t fop)
+{
+        switch (fop) {
+        case GF_FOP_STAT:
+        case GF_FOP_FSTAT:
+        case GF_FOP_INODELK:
+        case GF_FOP_FINODELK:
+        case GF_FOP_XATTROP:
+        case GF_FOP_FXATTROP:
+        case GF_FOP_WRITE:
+        case GF_FOP_SETXATTR:
+        case GF_FOP_FSETXATTR:
+        case GF_FOP_FLUSH:
+        case GF_FOP_FSYNC:
+        case GF_FOP_CREATE:
+        case GF_FOP_FTRUNCATE:
+        case GF_FOP_FSETATTR:
+                return _gf_true;
+        default:
+                return _gf_false;
+        }
+}
+
+/* returns the number of fops in @stubs, or -1 if they cannot be sent
+   as one compound */
+int
+compound_stubs_validate (struct list_head *stubs)
+{
+        call_stub_t *stub  = NULL;
+        int          count = 0;
+
+        if (!stubs)
+                return -1;
+
+        list_for_each_entry (stub, stubs, list) {
+                if (!stub->wind || !compound_fop_supported (stub->fop))
+                        return -1;
+                if (++count > GF_COMPOUND_MAX_OPS)
+                        return -1;
+        }
+
+        return (count > 0) ? count : -1;
+}
+
+void
+compound_replies_destroy (struct list_head *replies)
+{
+        call_stub_t *stub = NULL;
+        call_stub_t *tmp  = NULL;
+
+        list_for_each_entry_safe (stub, tmp, replies, list) {
+                list_del_init (&stub->list);
+                call_stub_destroy (stub);
+        }
+}
+
+static int
+compound_collect (call_frame_t *frame, void *cookie, call_stub_t *reply,
+                  int32_t op_ret, int32_t op_errno)
+{
+        compound_op_t *op = cookie;
+
+        return op->collect (frame, op, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                   dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_stat_cbk_stub (frame, NULL, op_ret, op_errno, buf, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                    dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_fstat_cbk_stub (frame, NULL, op_ret, op_errno, buf, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_inodelk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_inodelk_cbk_stub (frame, NULL, op_ret, op_errno, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_finodelk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_finodelk_cbk_stub (frame, NULL, op_ret, op_errno, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_xattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, dict_t *xattr,
+                      dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_xattrop_cbk_stub (frame, NULL, op_ret, op_errno, xattr,
+                                      xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_fxattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, dict_t *xattr,
+                       dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_fxattrop_cbk_stub (frame, NULL, op_ret, op_errno, xattr,
+                                       xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                     struct iatt *postbuf, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_writev_cbk_stub (frame, NULL, op_ret, op_errno, prebuf,
+                                     postbuf, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_setxattr_cbk_stub (frame, NULL, op_ret, op_errno, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_fsetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_fsetxattr_cbk_stub (frame, NULL, op_ret, op_errno, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_flush_cbk_stub (frame, NULL, op_ret, op_errno, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                    struct iatt *postbuf, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_fsync_cbk_stub (frame, NULL, op_ret, op_errno, prebuf,
+                                    postbuf, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, fd_t *fd,
+                     inode_t *inode, struct iatt *buf, struct iatt *preparent,
+                     struct iatt *postparent, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_create_cbk_stub (frame, NULL, op_ret, op_errno, fd, inode,
+                                     buf, preparent, postparent, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                        struct iatt *postbuf, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_ftruncate_cbk_stub (frame, NULL, op_ret, op_errno, prebuf,
+                                        postbuf, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+static int32_t
+compound_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, struct iatt *statpre,
+                       struct iatt *statpost, dict_t *xdata)
+{
+        call_stub_t *reply = NULL;
+
+        reply = fop_fsetattr_cbk_stub (frame, NULL, op_ret, op_errno, statpre,
+                                       statpost, xdata);
+        return compound_collect (frame, cookie, reply, op_ret, op_errno);
+}
+
+/* the xdata a fop is wound with: whatever was given to the compound as a
+   whole, with the fop's own keys on top */
+static int
+compound_stub_xdata (call_stub_t *stub, dict_t *xdata, dict_t **merged)
+{
+        if (!xdata) {
+                *merged = stub->xdata ? dict_ref (stub->xdata) : NULL;
+                return 0;
+        }
+
+        if (!stub->xdata) {
+                *merged = dict_ref (xdata);
+                return 0;
+        }
+
+        *merged = dict_copy_with_ref (xdata, NULL);
+        if (!*merged)
+                return -1;
+
+        dict_copy (stub->xdata, *merged);
+
+        return 0;
+}
+
+/* winds the fop held by @stub to @subvol, with @xdata of the compound
+   merged into its own; the reply comes back to @op->collect on @frame */
+int
+compound_stub_wind (call_frame_t *frame, xlator_t *subvol, call_stub_t *stub,
+                    dict_t *xdata, compound_op_t *op)
+{
+        dict_t *merged = NULL;
+        int     ret    = 0;
+
+        if (compound_stub_xdata (stub, xdata, &merged) < 0) {
+                op->collect (frame, op, NULL, -1, ENOMEM);
+                return -1;
+        }
+
+        switch (stub->fop) {
+        case GF_FOP_STAT:
+                STACK_WIND_COOKIE (frame, compound_stat_cbk, op, subvol,
+                                   subvol->fops->stat,
+                                   &stub->args.stat.loc, merged);
+                break;
+        case GF_FOP_FSTAT:
+                STACK_WIND_COOKIE (frame, compound_fstat_cbk, op, subvol,
+                                   subvol->fops->fstat,
+                                   stub->args.fstat.fd, merged);
+                break;
+        case GF_FOP_INODELK:
+                STACK_WIND_COOKIE (frame, compound_inodelk_cbk, op, subvol,
+                                   subvol->fops->inodelk,
+                                   stub->args.inodelk.volume,
+                                   &stub->args.inodelk.loc,
+                                   stub->args.inodelk.cmd,
+                                   &stub->args.inodelk.lock, merged);
+                break;
+        case GF_FOP_FINODELK:
+                STACK_WIND_COOKIE (frame, compound_finodelk_cbk, op, subvol,
+                                   subvol->fops->finodelk,
+                                   stub->args.finodelk.volume,
+                                   stub->args.finodelk.fd,
+                                   stub->args.finodelk.cmd,
+                                   &stub->args.finodelk.lock, merged);
+                break;
+        case GF_FOP_XATTROP:
+                STACK_WIND_COOKIE (frame, compound_xattrop_cbk, op, subvol,
+                                   subvol->fops->xattrop,
+                                   &stub->args.xattrop.loc,
+                                   stub->args.xattrop.optype,
+                                   stub->args.xattrop.xattr, merged);
+                break;
+        case GF_FOP_FXATTROP:
+                STACK_WIND_COOKIE (frame, compound_fxattrop_cbk, op, subvol,
+                                   subvol->fops->fxattrop,
+                                   stub->args.fxattrop.fd,
+                                   stub->args.fxattrop.optype,
+                                   stub->args.fxattrop.xattr, merged);
+                break;
+        case GF_FOP_WRITE:
+                STACK_WIND_COOKIE (frame, compound_writev_cbk, op, subvol,
+                                   subvol->fops->writev,
+                                   stub->args.writev.fd,
+                                   stub->args.writev.vector,
+                                   stub->args.writev.count,
+                                   stub->args.writev.off,
+                                   stub->args.writev.flags,
+                                   stub->args.writev.iobref, merged);
+                break;
+        case GF_FOP_SETXATTR:
+                STACK_WIND_COOKIE (frame, compound_setxattr_cbk, op, subvol,
+                                   subvol->fops->setxattr,
+                                   &stub->args.setxattr.loc,
+                                   stub->args.setxattr.dict,
+                                   stub->args.setxattr.flags, merged);
+                break;
+        case GF_FOP_FSETXATTR:
+                STACK_WIND_COOKIE (frame, compound_fsetxattr_cbk, op, subvol,
+                                   subvol->fops->fsetxattr,
+                                   stub->args.fsetxattr.fd,
+                                   stub->args.fsetxattr.dict,
+                                   stub->args.fsetxattr.flags, merged);
+                break;
+        case GF_FOP_FLUSH:
+                STACK_WIND_COOKIE (frame, compound_flush_cbk, op, subvol,
+                                   subvol->fops->flush,
+                                   stub->args.flush.fd, merged);
+                break;
+        case GF_FOP_FSYNC:
+                STACK_WIND_COOKIE (frame, compound_fsync_cbk, op, subvol,
+                                   subvol->fops->fsync,
+                                   stub->args.fsync.fd,
+                                   stub->args.fsync.datasync, merged);
+                break;
+        case GF_FOP_CREATE:
+                STACK_WIND_COOKIE (frame, compound_create_cbk, op, subvol,
+                                   subvol->fops->create,
+                                   &stub->args.create.loc,
+                                   stub->args.create.flags,
+                                   stub->args.create.mode,
+                                   stub->args.create.umask,
+                                   stub->args.create.fd, merged);
+                break;
+        case GF_FOP_FTRUNCATE:
+                STACK_WIND_COOKIE (frame, compound_ftruncate_cbk, op, subvol,
+                                   subvol->fops->ftruncate,
+                                   stub->args.ftruncate.fd,
+                                   stub->args.ftruncate.off, merged);
+                break;
+        case GF_FOP_FSETATTR:
+                STACK_WIND_COOKIE (frame, compound_fsetattr_cbk, op, subvol,
+                                   subvol->fops->fsetattr,
+                                   stub->args.fsetattr.fd,
+                                   &stub->args.fsetattr.stbuf,
+                                   stub->args.fsetattr.valid, merged);
+                break;
+        default:
+                gf_log_callingfn ("compound", GF_LOG_ERROR,
+                                  "fop %d cannot be part of a compound",
+                                  stub->fop);
+                ret = -1;
+                break;
+        }
+
+        if (merged)
+                dict_unref (merged);
+
+        return ret;
+}
+
+
+/* Serial execution, used by translators which have no better way of
+   handling a compound than running its fops one after the other. */
+
+typedef struct {
+        call_frame_t     *frame;
+        xlator_t         *subvol;
+        struct list_head *stubs;
+        struct list_head *next;
+        dict_t           *xdata;
+        struct list_head  replies;
+        compound_op_t     op;
+        int32_t           op_ret;
+        int32_t           op_errno;
+} compound_serial_t;
+
+static void
+compound_serial_done (compound_serial_t *state)
+{
+        STACK_UNWIND_STRICT (compound, state->frame, state->op_ret,
+                             state->op_errno, &state->replies, NULL);
+
+        compound_replies_destroy (&state->replies);
+        if (state->xdata)
+                dict_unref (state->xdata);
+        GF_FREE (state);
+}
+
+static void
+compound_serial_next (compound_serial_t *state)
+{
+        call_stub_t *stub = NULL;
+
+        stub = list_entry (state->next, call_stub_t, list);
+        state->next = state->next->next;
+        state->op.index++;
+
+        compound_stub_wind (state->frame, state->subvol, stub, state->xdata,
+                            &state->op);
+}
+
+static int
+compound_serial_collect (call_frame_t *frame, compound_op_t *op,
+                         call_stub_t *reply, int32_t op_ret, int32_t op_errno)
+{
+        compound_serial_t *state = op->data;
+
+        if (reply) {
+                list_add_tail (&reply->list, &state->replies);
+        } else {
+                op_ret = -1;
+                op_errno = ENOMEM;
+        }
+
+        state->op_ret = op_ret;
+        state->op_errno = op_errno;
+
+        if ((op_ret < 0) || (state->next == state->stubs))
+                compound_serial_done (state);
+        else
+                compound_serial_next (state);
+
+        return 0;
+}
+
+int
+compound_fop_serial (call_frame_t *frame, xlator_t *subvol,
+                     struct list_head *stubs, dict_t *xdata)
+{
+        compound_serial_t *state    = NULL;
+        int32_t            op_errno = EINVAL;
+        struct list_head   replies;
+
+        if (compound_stubs_validate (stubs) < 0)
+                goto err;
+
+        state = GF_CALLOC (1, sizeof (*state), gf_common_mt_compound_state_t);
+        if (!state) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        state->frame = frame;
+        state->subvol = subvol;
+        state->stubs = stubs;
+        state->next = stubs->next;
+        if (xdata)
+                state->xdata = dict_ref (xdata);
+        INIT_LIST_HEAD (&state->replies);
+        state->op.collect = compound_serial_collect;
+        state->op.data = state;
+        state->op.index = -1;
+
+        compound_serial_next (state);
+        return 0;
+
+err:
+        INIT_LIST_HEAD (&replies);
+        STACK_UNWIND_STRICT (compound, frame, -1, op_errno, &replies, NULL);
+        return -1;
+}
@@ -0,0 +1,66 @@
+/*
+  Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef _COMPOUND_FOP_H
+#define _COMPOUND_FOP_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "call-stub.h"
+
+/*
+ * A compound carries a short list of wind stubs (built with fop_*_stub ()
+ * and linked through stub->list) which are executed in order.  Execution
+ * stops at the first fop which fails.  The caller is answered once, with a
+ * list of cbk stubs holding the reply of every fop which was executed.
+ * Those reply stubs belong to the unwinding translator and are destroyed
+ * as soon as the compound_cbk returns; they must never be resumed.  The
+ * wind stubs stay with the caller, who destroys them after the reply.
+ * The xdata given to the compound goes with every fop in it, under the
+ * fop's own keys.
+ */
+
+#define GF_COMPOUND_MAX_OPS  16
+
+typedef struct compound_op compound_op_t;
+
+/* called once per wound stub, with the reply (NULL on ENOMEM) */
+typedef int (*compound_collect_t) (call_frame_t *frame, compound_op_t *op,
+                                   call_stub_t *reply, int32_t op_ret,
+                                   int32_t op_errno);
+
+struct compound_op {
+        compound_collect_t  collect;
+        void               *data;
+        int                 index;
+};
+
+gf_boolean_t
+compound_fop_supported (glusterfs_fop_t fop);
+
+int
+compound_stubs_validate (struct list_head *stubs);
+
+int
+compound_stub_wind (call_frame_t *frame, xlator_t *subvol, call_stub_t *stub,
+                    dict_t *xdata, compound_op_t *op);
+
+int
+compound_fop_serial (call_frame_t *frame, xlator_t *subvol,
+                     struct list_head *stubs, dict_t *xdata);
+
+void
+compound_replies_destroy (struct list_head *replies);
+
+#endif /* _COMPOUND_FOP_H */
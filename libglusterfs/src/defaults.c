@@ -26,6 +26,7 @@
 #endif
 
 #include "xlator.h"
+#include "compound-fop.h"
 
 /* _CBK function section */
 
@@ -1292,6 +1293,27 @@ default_getspec (call_frame_t *frame, xlator_t *this, const char *key,
         return 0;
 }
 
+int32_t
+default_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      struct list_head *replies, dict_t *xdata)
+{
+        STACK_UNWIND_STRICT (compound, frame, op_ret, op_errno, replies,
+                             xdata);
+        return 0;
+}
+
+/* A translator which does not know about compounds gets them split into
+   their member fops right here, so each one still passes through its own
+   fops table. */
+int32_t
+default_compound (call_frame_t *frame, xlator_t *this,
+                  struct list_head *stubs, dict_t *xdata)
+{
+        compound_fop_serial (frame, this, stubs, xdata);
+        return 0;
+}
+
 /* notify */
 int
 default_notify (xlator_t *this, int32_t event, void *data, ...)
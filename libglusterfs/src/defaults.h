@@ -41,6 +41,11 @@ int32_t default_getspec (call_frame_t *frame,
                          const char *key,
                          int32_t flag);
 
+int32_t default_compound (call_frame_t *frame,
+                          xlator_t *this,
+                          struct list_head *stubs,
+                          dict_t *xdata);
+
 int32_t default_rchecksum (call_frame_t *frame,
                            xlator_t *this,
                            fd_t *fd, off_t offset,
@@ -667,6 +672,11 @@ int32_t
 default_getspec_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                      int32_t op_ret, int32_t op_errno, char *spec_data);
 
+int32_t
+default_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      struct list_head *replies, dict_t *xdata);
+
 int32_t
 default_mem_acct_init (xlator_t *this);
 
@@ -30,6 +30,16 @@
 #include "byte-order.h"
 #include "globals.h"
 
+#define DICT_SLOT_EMPTY     -1
+#define DICT_SLOT_DELETED   -2
+
+/* first key chunk allocated once keys_internal is full, later chunks
+   double in size */
+#define DICT_KEY_CHUNK_SIZE 1024
+
+static int
+_dict_members_resize (dict_t *this, int32_t size);
+
 data_t *
 get_new_data ()
 {
@@ -53,30 +63,11 @@ get_new_dict_full (int size_hint)
                 return NULL;
         }
 
-        dict->hash_size = size_hint;
-        if (size_hint == 1) {
-                /*
-                 * This is the only case we ever see currently.  If we ever
-                 * need to support resizing the hash table, the resize function
-                 * will have to take into account the possibility that
-                 * "members" is not separately allocated (i.e. don't just call
-                 * realloc() blindly.
-                 */
-                dict->members = &dict->members_internal;
-        }
-        else {
-                /*
-                 * We actually need to allocate space for size_hint *pointers*
-                 * but we actually allocate space for one *structure*.  Since
-                 * a data_pair_t consists of five pointers, we're wasting four
-                 * pointers' worth for N=1, and will overrun what we allocated
-                 * for N>5.  If anybody ever starts using size_hint, we'll need
-                 * to fix this.
-                 */
-                GF_ASSERT (size_hint <=
-                           (sizeof(data_pair_t) / sizeof(data_pair_t *)));
-                dict->members = mem_get0 (THIS->ctx->dict_pair_pool);
-                if (!dict->members) {
+        dict->members = dict->members_internal;
+        dict->members_size = DICT_INLINE_PAIRS;
+
+        if (size_hint > DICT_INLINE_PAIRS) {
+                if (_dict_members_resize (dict, size_hint)) {
                         mem_put (dict);
                         return NULL;
                 }
@@ -188,26 +179,243 @@ err_out:
         return NULL;
 }
 
-static data_pair_t *
-_dict_lookup (dict_t *this, char *key)
+/* To be called with this->lock held. Places the pair at position idx of
+   members in the index */
+static void
+_dict_index_insert (dict_t *this, uint32_t hash, int32_t idx)
 {
-        if (!this || !key) {
-                gf_log_callingfn ("dict", GF_LOG_WARNING,
-                                  "!this || !key (%s)", key);
+        uint32_t mask = 0;
+        uint32_t slot = 0;
+
+        mask = this->hash_size - 1;
+        slot = hash & mask;
+
+        /* a deleted slot can be taken over, the key is known to be absent */
+        while (this->index[slot] >= 0)
+                slot = (slot + 1) & mask;
+
+        this->index[slot] = idx;
+}
+
+
+/* To be called with this->lock held. Rebuilds the index from members,
+   dropping the deleted slots */
+static void
+_dict_index_fill (dict_t *this)
+{
+        int32_t i = 0;
+
+        memset (this->index, 0xff, this->hash_size * sizeof (*this->index));
+
+        for (i = 0; i < this->members_used; i++) {
+                if (this->members[i].key)
+                        _dict_index_insert (this, this->members[i].key_hash,
+                                            i);
+        }
+}
+
+
+/* To be called with this->lock held, or on a dict nobody else has yet.
+   Grows members to hold at least size pairs. The index, once there is
+   one, has twice as many slots as members, so that live and deleted
+   slots together never fill it */
+static int
+_dict_members_resize (dict_t *this, int32_t size)
+{
+        data_pair_t *members = NULL;
+        int32_t     *index = NULL;
+        int32_t      new_size = 0;
+
+        new_size = this->members_size;
+        while (new_size < size)
+                new_size *= 2;
+
+        if (new_size == this->members_size)
+                return 0;
+
+        index = GF_MALLOC (new_size * 2 * sizeof (*index),
+                           gf_common_mt_dict_index);
+        if (!index)
+                return -1;
+
+        if (this->members == this->members_internal) {
+                members = GF_CALLOC (new_size, sizeof (*members),
+                                     gf_common_mt_data_pair_t);
+                if (!members)
+                        goto err;
+
+                memcpy (members, this->members,
+                        this->members_used * sizeof (*members));
+        } else {
+                members = GF_REALLOC (this->members,
+                                      new_size * sizeof (*members));
+                if (!members)
+                        goto err;
+
+                memset (&members[this->members_size], 0,
+                        (new_size - this->members_size) * sizeof (*members));
+        }
+
+        GF_FREE (this->index);
+
+        this->members = members;
+        this->members_size = new_size;
+        this->index = index;
+        this->hash_size = new_size * 2;
+
+        _dict_index_fill (this);
+
+        return 0;
+err:
+        GF_FREE (index);
+        return -1;
+}
+
+
+/* To be called with this->lock held. Makes sure a pair can be appended */
+static int
+_dict_members_make_room (dict_t *this)
+{
+        int32_t i = 0;
+        int32_t j = 0;
+
+        if (this->members_used < this->members_size)
+                return 0;
+
+        /* squeeze out the holes left by dict_del if they are at least half
+           of the members, unless a dict_foreach is walking the members by
+           position */
+        if (this->walkers || (this->count > this->members_used / 2))
+                return _dict_members_resize (this, this->members_size + 1);
+
+        for (i = 0; i < this->members_used; i++) {
+                if (!this->members[i].key)
+                        continue;
+                if (i != j)
+                        this->members[j] = this->members[i];
+                j++;
+        }
+
+        memset (&this->members[j], 0,
+                (this->members_used - j) * sizeof (*this->members));
+        this->members_used = j;
+
+        if (this->index)
+                _dict_index_fill (this);
+
+        return 0;
+}
+
+
+/* Copies a key into the dict's own storage. The storage is never moved,
+   so keys handed out stay put while the dict grows */
+static char *
+_dict_key_store (dict_t *this, const char *key, int32_t keylen)
+{
+        struct _dict_key_chunk *chunk = NULL;
+        int32_t                 size = 0;
+        char                   *dst = NULL;
+
+        if (this->keys_internal_used + keylen + 1 <= DICT_INLINE_KEY_SIZE) {
+                dst = this->keys_internal + this->keys_internal_used;
+                this->keys_internal_used += keylen + 1;
+                goto copy;
+        }
+
+        chunk = this->keys;
+        if (!chunk || (chunk->used + keylen + 1 > chunk->size)) {
+                size = chunk ? (chunk->size * 2) : DICT_KEY_CHUNK_SIZE;
+                if (size < keylen + 1)
+                        size = keylen + 1;
+
+                chunk = GF_MALLOC (sizeof (*chunk) + size,
+                                   gf_common_mt_dict_keys);
+                if (!chunk)
+                        return NULL;
+
+                chunk->size = size;
+                chunk->used = 0;
+                chunk->next = this->keys;
+                this->keys = chunk;
+        }
+
+        dst = chunk->buf + chunk->used;
+        chunk->used += keylen + 1;
+copy:
+        memcpy (dst, key, keylen);
+        dst[keylen] = '\0';
+
+        return dst;
+}
+
+
+/* Gives back the space of a deleted key, which is only possible for the
+   key stored last */
+static void
+_dict_key_release (dict_t *this, char *key, int32_t keylen)
+{
+        if (this->keys &&
+            (key + keylen + 1 == this->keys->buf + this->keys->used)) {
+                this->keys->used -= keylen + 1;
+                return;
+        }
+
+        if (key + keylen + 1 == this->keys_internal + this->keys_internal_used)
+                this->keys_internal_used -= keylen + 1;
+}
+
+
+static data_pair_t *
+_dict_lookup_hashed (dict_t *this, char *key, uint32_t hash, int32_t *slotp)
+{
+        data_pair_t *pair = NULL;
+        uint32_t     mask = 0;
+        uint32_t     slot = 0;
+        int32_t      idx = 0;
+
+        if (!this->index) {
+                for (idx = 0; idx < this->members_used; idx++) {
+                        pair = &this->members[idx];
+                        if (pair->key && (pair->key_hash == hash) &&
+                            !strcmp (pair->key, key))
+                                return pair;
+                }
+
                 return NULL;
         }
 
-        int hashval = SuperFastHash (key, strlen (key)) % this->hash_size;
-        data_pair_t *pair;
+        mask = this->hash_size - 1;
+
+        for (slot = hash & mask; (idx = this->index[slot]) != DICT_SLOT_EMPTY;
+             slot = (slot + 1) & mask) {
+                if (idx == DICT_SLOT_DELETED)
+                        continue;
 
-        for (pair = this->members[hashval]; pair != NULL; pair = pair->hash_next) {
-                if (pair->key && !strcmp (pair->key, key))
+                pair = &this->members[idx];
+                if ((pair->key_hash == hash) && !strcmp (pair->key, key)) {
+                        if (slotp)
+                                *slotp = slot;
                         return pair;
+                }
         }
 
         return NULL;
 }
 
+
+static data_pair_t *
+_dict_lookup (dict_t *this, char *key)
+{
+        if (!this || !key) {
+                gf_log_callingfn ("dict", GF_LOG_WARNING,
+                                  "!this || !key (%s)", key);
+                return NULL;
+        }
+
+        return _dict_lookup_hashed (this, key,
+                                    SuperFastHash (key, strlen (key)), NULL);
+}
+
 int32_t
 dict_lookup (dict_t *this, char *key, data_t **data)
 {
@@ -236,80 +444,49 @@ _dict_set (dict_t *this,
            char *key,
            data_t *value)
 {
-        int hashval;
-        data_pair_t *pair;
-        char key_free = 0;
-        int tmp = 0;
-        int ret = 0;
+        data_pair_t *pair = NULL;
+        data_t      *unref_data = NULL;
+        char         ref_key[32] = {0, };
+        int32_t      keylen = 0;
+        uint32_t     hash = 0;
 
         if (!key) {
-                ret = gf_asprintf (&key, "ref:%p", value);
-                if (-1 == ret) {
-                        gf_log ("dict", GF_LOG_WARNING, "asprintf failed %s", key);
-                        return -1;
-                }
-                key_free = 1;
+                snprintf (ref_key, sizeof (ref_key), "ref:%p", value);
+                key = ref_key;
         }
 
-        tmp = SuperFastHash (key, strlen (key));
-        hashval = (tmp % this->hash_size);
-        pair = _dict_lookup (this, key);
+        keylen = strlen (key);
+        hash = SuperFastHash (key, keylen);
+
+        pair = _dict_lookup_hashed (this, key, hash, NULL);
 
         if (pair) {
-                data_t *unref_data = pair->value;
+                unref_data = pair->value;
                 pair->value = data_ref (value);
                 data_unref (unref_data);
-                if (key_free)
-                        GF_FREE (key);
                 /* Indicates duplicate key */
                 return 0;
         }
-        if (this->free_pair_in_use) {
-                pair = mem_get0 (THIS->ctx->dict_pair_pool);
-                if (!pair) {
-                        if (key_free)
-                                GF_FREE (key);
-                        return -1;
-                }
-        }
-        else {
-                pair = &this->free_pair;
-                this->free_pair_in_use = _gf_true;
-        }
 
-        if (key_free) {
-                /* It's ours.  Use it. */
-                pair->key = key;
-                key_free = 0;
-        }
-        else {
-                pair->key = (char *) GF_CALLOC (1, strlen (key) + 1,
-                                                gf_common_mt_char);
-                if (!pair->key) {
-                        if (pair == &this->free_pair) {
-                                this->free_pair_in_use = _gf_false;
-                        }
-                        else {
-                                mem_put (pair);
-                        }
-                        return -1;
-                }
-                strcpy (pair->key, key);
-        }
+        if (_dict_members_make_room (this))
+                return -1;
+
+        pair = &this->members[this->members_used];
+
+        pair->key = _dict_key_store (this, key, keylen);
+        if (!pair->key)
+                return -1;
+
+        pair->key_len = keylen;
+        pair->key_hash = hash;
         pair->value = data_ref (value);
 
-        pair->hash_next = this->members[hashval];
-        this->members[hashval] = pair;
+        if (this->index)
+                _dict_index_insert (this, hash, this->members_used);
 
-        pair->next = this->members_list;
-        pair->prev = NULL;
-        if (this->members_list)
-                this->members_list->prev = pair;
-        this->members_list = pair;
+        this->members_used++;
         this->count++;
 
-        if (key_free)
-                GF_FREE (key);
         return 0;
 }
 
@@ -362,6 +539,9 @@ dict_get (dict_t *this, char *key)
 void
 dict_del (dict_t *this, char *key)
 {
+        data_pair_t *pair = NULL;
+        int32_t      slot = 0;
+
         if (!this || !key) {
                 gf_log_callingfn ("dict", GF_LOG_WARNING,
                                   "!this || key=%s", key);
@@ -370,40 +550,25 @@ dict_del (dict_t *this, char *key)
 
         LOCK (&this->lock);
 
-        int hashval = SuperFastHash (key, strlen (key)) % this->hash_size;
-        data_pair_t *pair = this->members[hashval];
-        data_pair_t *prev = NULL;
-
-        while (pair) {
-                if (strcmp (pair->key, key) == 0) {
-                        if (prev)
-                                prev->hash_next = pair->hash_next;
-                        else
-                                this->members[hashval] = pair->hash_next;
-
-                        data_unref (pair->value);
-
-                        if (pair->prev)
-                                pair->prev->next = pair->next;
-                        else
-                                this->members_list = pair->next;
-
-                        if (pair->next)
-                                pair->next->prev = pair->prev;
-
-                        GF_FREE (pair->key);
-                        if (pair == &this->free_pair) {
-                                this->free_pair_in_use = _gf_false;
-                        }
-                        else {
-                                mem_put (pair);
-                        }
-                        this->count--;
-                        break;
+        pair = _dict_lookup_hashed (this, key,
+                                    SuperFastHash (key, strlen (key)), &slot);
+        if (pair) {
+                if (this->index)
+                        this->index[slot] = DICT_SLOT_DELETED;
+
+                data_unref (pair->value);
+                _dict_key_release (this, pair->key, pair->key_len);
+                memset (pair, 0, sizeof (*pair));
+                this->count--;
+
+                /* while searched linearly, trailing holes can be reused
+                   right away; the index instead relies on members_used
+                   bounding its deleted slots */
+                if (!this->index) {
+                        while (this->members_used &&
+                               !this->members[this->members_used - 1].key)
+                                this->members_used--;
                 }
-
-                prev = pair;
-                pair = pair->hash_next;
         }
 
         UNLOCK (&this->lock);
@@ -414,30 +579,32 @@ dict_del (dict_t *this, char *key)
 void
 dict_destroy (dict_t *this)
 {
+        struct _dict_key_chunk *chunk = NULL;
+        struct _dict_key_chunk *next = NULL;
+        int32_t                 i = 0;
+
         if (!this) {
                 gf_log_callingfn ("dict", GF_LOG_WARNING, "dict is NULL");
                 return;
         }
 
-        data_pair_t *pair = this->members_list;
-        data_pair_t *prev = this->members_list;
-
         LOCK_DESTROY (&this->lock);
 
-        while (prev) {
-                pair = pair->next;
-                data_unref (prev->value);
-                GF_FREE (prev->key);
-                if (prev != &this->free_pair) {
-                        mem_put (prev);
-                }
-                prev = pair;
+        for (i = 0; i < this->members_used; i++) {
+                if (this->members[i].key)
+                        data_unref (this->members[i].value);
         }
 
-        if (this->members != &this->members_internal) {
-                mem_put (this->members);
+        for (chunk = this->keys; chunk; chunk = next) {
+                next = chunk->next;
+                GF_FREE (chunk);
         }
 
+        if (this->members != this->members_internal)
+                GF_FREE (this->members);
+
+        GF_FREE (this->index);
+
         GF_FREE (this->extra_free);
         free (this->extra_stdfree);
 
@@ -1068,20 +1235,27 @@ dict_foreach (dict_t *dict,
                 return -1;
         }
 
-        int          ret   = -1;
-        data_pair_t *pairs = NULL;
-        data_pair_t *next  = NULL;
+        int          ret   = 0;
+        int32_t      i     = 0;
+        data_pair_t *pair  = NULL;
 
-        pairs = dict->members_list;
-        while (pairs) {
-                next = pairs->next;
-                ret = fn (dict, pairs->key, pairs->value, data);
+        __sync_fetch_and_add (&dict->walkers, 1);
+
+        /* newest first; fn may add to or delete from the dict, so the
+           members are looked up by position on every step */
+        for (i = dict->members_used - 1; i >= 0; i--) {
+                pair = &dict->members[i];
+                if (!pair->key)
+                        continue;
+
+                ret = fn (dict, pair->key, pair->value, data);
                 if (ret == -1)
-                        return -1;
-                pairs = next;
+                        break;
         }
 
-        return 0;
+        __sync_fetch_and_sub (&dict->walkers, 1);
+
+        return (ret == -1) ? -1 : 0;
 }
 
 /* return values:
@@ -1105,21 +1279,28 @@ dict_foreach_fnmatch (dict_t *dict, char *pattern,
 
         int          ret = -1;
         int          count = 0;
-        data_pair_t *pairs = NULL;
-        data_pair_t *next  = NULL;
-
-        pairs = dict->members_list;
-        while (pairs) {
-                next = pairs->next;
-                if (!fnmatch (pattern, pairs->key, 0)) {
-                        ret = fn (dict, pairs->key, pairs->value, data);
-                        if (ret == -1)
-                                return -1;
+        int32_t      i = 0;
+        data_pair_t *pair = NULL;
+
+        __sync_fetch_and_add (&dict->walkers, 1);
+
+        for (i = dict->members_used - 1; i >= 0; i--) {
+                pair = &dict->members[i];
+                if (!pair->key)
+                        continue;
+
+                if (!fnmatch (pattern, pair->key, 0)) {
+                        ret = fn (dict, pair->key, pair->value, data);
+                        if (ret == -1) {
+                                count = -1;
+                                break;
+                        }
                         count++;
                 }
-                pairs = next;
         }
 
+        __sync_fetch_and_sub (&dict->walkers, 1);
+
         return count;
 }
 
@@ -1154,7 +1335,7 @@ dict_copy (dict_t *dict,
         }
 
         if (!new)
-                new = get_new_dict_full (dict->hash_size);
+                new = get_new_dict_full (dict->count);
 
         dict_foreach (dict, _copy, new);
 
@@ -2187,6 +2368,7 @@ _dict_serialized_length (dict_t *this)
         int ret            = -EINVAL;
         int count          = 0;
         int len            = 0;
+        int32_t i          = 0;
         data_pair_t * pair = NULL;
 
         len = DICT_HDR_LEN;
@@ -2197,23 +2379,20 @@ _dict_serialized_length (dict_t *this)
                 goto out;
         }
 
-        pair = this->members_list;
-
-        while (count) {
-                if (!pair) {
+        for (i = this->members_used - 1; count; i--) {
+                if (i < 0) {
                         gf_log ("dict", GF_LOG_ERROR,
                                 "less than count data pairs found!");
                         goto out;
                 }
 
-                len += DICT_DATA_HDR_KEY_LEN + DICT_DATA_HDR_VAL_LEN;
+                pair = &this->members[i];
+                if (!pair->key)
+                        continue;
 
-                if (!pair->key) {
-                        gf_log ("dict", GF_LOG_ERROR, "pair->key is null!");
-                        goto out;
-                }
+                len += DICT_DATA_HDR_KEY_LEN + DICT_DATA_HDR_VAL_LEN;
 
-                len += strlen (pair->key) + 1  /* for '\0' */;
+                len += pair->key_len + 1  /* for '\0' */;
 
                 if (!pair->value) {
                         gf_log ("dict", GF_LOG_ERROR,
@@ -2230,7 +2409,6 @@ _dict_serialized_length (dict_t *this)
 
                 len += pair->value->len;
 
-                pair = pair->next;
                 count--;
         }
 
@@ -2257,6 +2435,7 @@ _dict_serialize (dict_t *this, char *buf)
         int           ret     = -1;
         data_pair_t * pair    = NULL;
         int32_t       count   = 0;
+        int32_t       i       = 0;
         int32_t       keylen  = 0;
         int32_t       vallen  = 0;
         int32_t       netword = 0;
@@ -2278,22 +2457,19 @@ _dict_serialize (dict_t *this, char *buf)
         netword = hton32 (count);
         memcpy (buf, &netword, sizeof(netword));
         buf += DICT_HDR_LEN;
-        pair = this->members_list;
 
-        while (count) {
-                if (!pair) {
+        for (i = this->members_used - 1; count; i--) {
+                if (i < 0) {
                         gf_log ("dict", GF_LOG_ERROR,
                                 "less than count data pairs found!");
                         goto out;
                 }
 
-                if (!pair->key) {
-                        gf_log ("dict", GF_LOG_ERROR,
-                                "pair->key is null!");
-                        goto out;
-                }
+                pair = &this->members[i];
+                if (!pair->key)
+                        continue;
 
-                keylen  = strlen (pair->key);
+                keylen  = pair->key_len;
                 netword = hton32 (keylen);
                 memcpy (buf, &netword, sizeof(netword));
                 buf += DICT_DATA_HDR_KEY_LEN;
@@ -2321,7 +2497,6 @@ _dict_serialize (dict_t *this, char *buf)
                 memcpy (buf, pair->value->data, vallen);
                 buf += vallen;
 
-                pair = pair->next;
                 count--;
         }
 
@@ -2414,6 +2589,7 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
         int32_t  keylen  = 0;
         int32_t  vallen  = 0;
         int32_t  hostord = 0;
+        dict_t * this    = NULL;
 
         buf = orig_buf;
 
@@ -2459,8 +2635,15 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
                 goto out;
         }
 
-        /* count will be set by the dict_set's below */
-        (*fill)->count = 0;
+        this = *fill;
+
+        /* keys are copied into the dict's own storage, and the members
+           are sized for all of them up front; failing to do so here only
+           means growing as they are added */
+        LOCK (&this->lock);
+
+        if (count > this->members_size - this->members_used)
+                _dict_members_resize (this, this->members_used + count);
 
         for (i = 0; i < count; i++) {
                 if ((buf + DICT_DATA_HDR_KEY_LEN) > (orig_buf + size)) {
@@ -2469,7 +2652,7 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
                                           "available (%lu) < required (%lu)",
                                           (long)(orig_buf + size),
                                           (long)(buf + DICT_DATA_HDR_KEY_LEN));
-                        goto out;
+                        goto unlock;
                 }
                 memcpy (&hostord, buf, sizeof(hostord));
                 keylen = ntoh32 (hostord);
@@ -2481,7 +2664,7 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
                                           "available (%lu) < required (%lu)",
                                           (long)(orig_buf + size),
                                           (long)(buf + DICT_DATA_HDR_VAL_LEN));
-                        goto out;
+                        goto unlock;
                 }
                 memcpy (&hostord, buf, sizeof(hostord));
                 vallen = ntoh32 (hostord);
@@ -2493,7 +2676,7 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
                                           "available (%lu) < required (%lu)",
                                           (long)(orig_buf + size),
                                           (long)(buf + keylen));
-                        goto out;
+                        goto unlock;
                 }
                 key = buf;
                 buf += keylen + 1;  /* for '\0' */
@@ -2504,17 +2687,29 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
                                           "available (%lu) < required (%lu)",
                                           (long)(orig_buf + size),
                                           (long)(buf + vallen));
+                        goto unlock;
                 }
                 value = get_new_data ();
+                if (!value)
+                        goto unlock;
                 value->len  = vallen;
                 value->data = memdup (buf, vallen);
+                if (!value->data) {
+                        data_destroy (value);
+                        goto unlock;
+                }
                 value->is_static = 0;
                 buf += vallen;
 
-                dict_set (*fill, key, value);
+                if (_dict_set (this, key, value)) {
+                        data_destroy (value);
+                        goto unlock;
+                }
         }
 
         ret = 0;
+unlock:
+        UNLOCK (&this->lock);
 out:
         return ret;
 }
@@ -2594,6 +2789,7 @@ _dict_serialize_value_with_delim (dict_t *this, char *buf, int32_t *serz_len,
         int32_t      count     = 0;
         int32_t      vallen    = 0;
         int32_t      total_len = 0;
+        int32_t      i         = 0;
         data_pair_t *pair      = NULL;
 
         if (!buf) {
@@ -2607,16 +2803,18 @@ _dict_serialize_value_with_delim (dict_t *this, char *buf, int32_t *serz_len,
                 goto out;
         }
 
-        pair = this->members_list;
-
-        while (count) {
-                if (!pair) {
+        for (i = this->members_used - 1; count; i--) {
+                if (i < 0) {
                         gf_log ("dict", GF_LOG_ERROR,
                                 "less than count data pairs found");
                         goto out;
                 }
 
-                if (!pair->key || !pair->value) {
+                pair = &this->members[i];
+                if (!pair->key)
+                        continue;
+
+                if (!pair->value) {
                         gf_log ("dict", GF_LOG_ERROR,
                                 "key or value is null");
                         goto out;
@@ -2635,7 +2833,6 @@ _dict_serialize_value_with_delim (dict_t *this, char *buf, int32_t *serz_len,
 
                 total_len += (vallen + 1);
 
-                pair = pair->next;
                 count--;
         }
 
@@ -2675,6 +2872,7 @@ dict_dump (dict_t *this)
 {
         int          ret     = 0;
         int          dumplen = 0;
+        int32_t      i       = 0;
         data_pair_t *trav    = NULL;
         char         dump[64*1024]; /* This is debug only, hence
                                        performance should not matter */
@@ -2688,7 +2886,11 @@ dict_dump (dict_t *this)
 
         /* There is a possibility of issues if data is binary, ignore it
            for now as debugging is more important */
-        for (trav = this->members_list; trav; trav = trav->next) {
+        for (i = this->members_used - 1; i >= 0; i--) {
+                trav = &this->members[i];
+                if (!trav->key)
+                        continue;
+
                 ret = snprintf (&dump[dumplen], ((64*1024) - dumplen - 1),
                                 "(%s:%s)", trav->key, trav->value->data);
                 if ((ret == -1) || !ret)
@@ -44,28 +44,23 @@ typedef struct _data_pair data_pair_t;
         } while (0)
 
 
+/* dict_unserialize() copies out keys and values, so @buff is not needed
+   once this is done; it may well point into the request buffer */
 #define GF_PROTOCOL_DICT_UNSERIALIZE(xl,to,buff,len,ret,ope,labl) do {  \
-                char *buf = NULL;                                       \
                 if (!len)                                               \
                         break;                                          \
                 to = dict_new();                                        \
                 GF_VALIDATE_OR_GOTO (xl->name, to, labl);               \
                                                                         \
-                buf = memdup (buff, len);                               \
-                GF_VALIDATE_OR_GOTO (xl->name, buf, labl);              \
-                                                                        \
-                ret = dict_unserialize (buf, len, &to);                 \
+                ret = dict_unserialize (buff, len, &to);                \
                 if (ret < 0) {                                          \
                         gf_log (xl->name, GF_LOG_WARNING,               \
                                 "failed to unserialize dictionary (%s)", \
                                 (#to));                                 \
                                                                         \
                         ope = EINVAL;                                   \
-                        GF_FREE (buf);                                  \
                         goto labl;                                      \
                 }                                                       \
-                                                                        \
-                to->extra_free = buf;                                   \
         } while (0)
 
 struct _data {
@@ -78,27 +73,47 @@ struct _data {
         gf_lock_t      lock;
 };
 
+/* pairs and key bytes kept inside dict_t itself, so that the small dicts
+   which make up most of the xdata traffic need no allocation beyond the
+   dict_t and its values */
+#define DICT_INLINE_PAIRS     8
+#define DICT_INLINE_KEY_SIZE  256
+
 struct _data_pair {
-        struct _data_pair *hash_next;
-        struct _data_pair *prev;
-        struct _data_pair *next;
         data_t            *value;
-        char              *key;
+        char              *key;         /* NULL for a deleted pair */
+        uint32_t           key_hash;
+        int32_t            key_len;
+};
+
+struct _dict_key_chunk {
+        struct _dict_key_chunk *next;
+        int32_t                 size;
+        int32_t                 used;
+        char                    buf[];
 };
 
 struct _dict {
         unsigned char   is_static:1;
-        int32_t         hash_size;
-        int32_t         count;
+        int32_t         hash_size;      /* slots in index, 0 while the
+                                           members are searched linearly */
+        int32_t         count;          /* live pairs */
         int32_t         refcount;
-        data_pair_t   **members;
-        data_pair_t    *members_list;
+        data_pair_t    *members;        /* pairs in the order they were
+                                           added, with holes where deleted */
+        int32_t         members_used;
+        int32_t         members_size;
+        int32_t        *index;          /* open addressed, linear probing
+                                           positions into members */
+        int32_t         walkers;        /* dict_foreach calls in progress */
         char           *extra_free;
         char           *extra_stdfree;
         gf_lock_t       lock;
-        data_pair_t    *members_internal;
-        data_pair_t     free_pair;
-        gf_boolean_t    free_pair_in_use;
+        struct _dict_key_chunk *keys;   /* key storage past keys_internal,
+                                           never moved */
+        int32_t         keys_internal_used;
+        data_pair_t     members_internal[DICT_INLINE_PAIRS];
+        char            keys_internal[DICT_INLINE_KEY_SIZE];
 };
 
 
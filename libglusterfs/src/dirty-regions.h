@@ -0,0 +1,159 @@
+/*
+  Copyright (c) 2008-2012 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef __DIRTY_REGIONS_H__
+#define __DIRTY_REGIONS_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "byte-order.h"
+
+/* Regions of a file written while its replicas were out of sync, kept by
+   the index xlator of a brick and read by AFR's data self-heal.
+
+   The file is cut into chunks of chunk_size bytes and chunk N is recorded
+   in bit (N % nbits), so a bit stands for every chunk folded onto it and a
+   set bit only ever means "may differ". All fields are in network byte
+   order, the structure is stored and sent as is. */
+
+#define GF_DIRTY_REGIONS_MAGIC  0x47464452      /* "GFDR" */
+#define GF_DIRTY_REGIONS_BITS   8192
+
+/* regions are not known, the whole file may differ */
+#define GF_DIRTY_REGIONS_FULL   0x1
+
+struct gf_dirty_regions {
+        uint32_t        magic;
+        uint32_t        flags;
+        uint32_t        chunk_size;
+        uint32_t        nbits;
+        uint64_t        epoch;          /* brick lifetime the regions
+                                           belong to */
+        unsigned char   bits[GF_DIRTY_REGIONS_BITS / 8];
+};
+
+static inline void
+gf_dirty_regions_init (struct gf_dirty_regions *r, uint32_t chunk_size,
+                       uint64_t epoch, uint32_t flags)
+{
+        memset (r, 0, sizeof (*r));
+        r->magic      = hton32 (GF_DIRTY_REGIONS_MAGIC);
+        r->flags      = hton32 (flags);
+        r->chunk_size = hton32 (chunk_size);
+        r->nbits      = hton32 (GF_DIRTY_REGIONS_BITS);
+        r->epoch      = hton64 (epoch);
+}
+
+static inline int
+gf_dirty_regions_valid (struct gf_dirty_regions *r, size_t len)
+{
+        return ((len == sizeof (*r)) &&
+                (ntoh32 (r->magic) == GF_DIRTY_REGIONS_MAGIC) &&
+                (ntoh32 (r->nbits) == GF_DIRTY_REGIONS_BITS) &&
+                (ntoh32 (r->chunk_size) != 0));
+}
+
+static inline int
+gf_dirty_regions_full (struct gf_dirty_regions *r)
+{
+        return (ntoh32 (r->flags) & GF_DIRTY_REGIONS_FULL);
+}
+
+/* returns non-zero when the regions changed */
+static inline int
+gf_dirty_regions_mark_full (struct gf_dirty_regions *r)
+{
+        uint32_t flags = ntoh32 (r->flags);
+
+        if (flags & GF_DIRTY_REGIONS_FULL)
+                return 0;
+
+        r->flags = hton32 (flags | GF_DIRTY_REGIONS_FULL);
+        return 1;
+}
+
+/* returns non-zero when the regions changed */
+static inline int
+gf_dirty_regions_mark (struct gf_dirty_regions *r, off_t offset, size_t len)
+{
+        uint64_t chunk   = ntoh32 (r->chunk_size);
+        uint64_t first   = 0;
+        uint64_t last    = 0;
+        uint64_t bit     = 0;
+        int      changed = 0;
+
+        if (!len || gf_dirty_regions_full (r))
+                return 0;
+
+        first = offset / chunk;
+        last  = (offset + len - 1) / chunk;
+        if (last - first >= GF_DIRTY_REGIONS_BITS - 1) {
+                first = 0;
+                last  = GF_DIRTY_REGIONS_BITS - 1;
+        }
+
+        for (; first <= last; first++) {
+                bit = first % GF_DIRTY_REGIONS_BITS;
+                if (r->bits[bit / 8] & (1 << (bit % 8)))
+                        continue;
+                r->bits[bit / 8] |= (1 << (bit % 8));
+                changed = 1;
+        }
+
+        return changed;
+}
+
+/* adds the regions of src to dst, returns -1 if they are not cut alike */
+static inline int
+gf_dirty_regions_merge (struct gf_dirty_regions *dst,
+                        struct gf_dirty_regions *src)
+{
+        int i = 0;
+
+        if (dst->chunk_size != src->chunk_size)
+                return -1;
+
+        dst->flags |= src->flags;
+        for (i = 0; i < sizeof (dst->bits); i++)
+                dst->bits[i] |= src->bits[i];
+
+        return 0;
+}
+
+static inline int
+gf_dirty_regions_test (struct gf_dirty_regions *r, off_t offset, size_t len)
+{
+        uint64_t chunk = ntoh32 (r->chunk_size);
+        uint64_t first = 0;
+        uint64_t last  = 0;
+        uint64_t bit   = 0;
+
+        if (gf_dirty_regions_full (r))
+                return 1;
+        if (!len)
+                return 0;
+
+        first = offset / chunk;
+        last  = (offset + len - 1) / chunk;
+        if (last - first >= GF_DIRTY_REGIONS_BITS - 1)
+                last = first + GF_DIRTY_REGIONS_BITS - 1;
+
+        for (; first <= last; first++) {
+                bit = first % GF_DIRTY_REGIONS_BITS;
+                if (r->bits[bit / 8] & (1 << (bit % 8)))
+                        return 1;
+        }
+
+        return 0;
+}
+
+#endif /* __DIRTY_REGIONS_H__ */
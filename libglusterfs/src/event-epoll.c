@@ -94,6 +94,8 @@ event_pool_new_epoll (int count)
 
         event_pool->count = count;
 
+        event_pool->eventthreadcount = 1;
+
         pthread_mutex_init (&event_pool->mutex, NULL);
         pthread_cond_init (&event_pool->cond, NULL);
 
@@ -138,6 +140,8 @@ event_register_epoll (struct event_pool *event_pool, int fd,
                 event_pool->reg[idx].events = EPOLLPRI;
                 event_pool->reg[idx].handler = handler;
                 event_pool->reg[idx].data = data;
+                event_pool->reg[idx].gen = ++event_pool->gen;
+                event_pool->reg[idx].in_handler = 0;
 
                 switch (poll_in) {
                 case 1:
@@ -173,7 +177,7 @@ event_register_epoll (struct event_pool *event_pool, int fd,
 
                 event_pool->changed = 1;
 
-                epoll_event.events = event_pool->reg[idx].events;
+                epoll_event.events = event_pool->reg[idx].events | EPOLLONESHOT;
                 ev_data->fd = fd;
                 ev_data->idx = idx;
 
@@ -244,8 +248,18 @@ event_unregister_epoll (struct event_pool *event_pool, int fd, int idx_hint)
                         goto unlock;
                 }
 
-                epoll_event.events = event_pool->reg[lastidx].events;
-                ev_data->fd = event_pool->reg[lastidx].fd;
+                /* just replace the unregistered idx by last one */
+                event_pool->reg[idx] = event_pool->reg[lastidx];
+                event_pool->used--;
+
+                /* a dispatcher thread is running the handler of the moved
+                 * fd, it picks up the new index when it re-arms the fd.
+                 */
+                if (event_pool->reg[idx].in_handler)
+                        goto unlock;
+
+                epoll_event.events = event_pool->reg[idx].events | EPOLLONESHOT;
+                ev_data->fd = event_pool->reg[idx].fd;
                 ev_data->idx = idx;
 
                 ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, ev_data->fd,
@@ -253,14 +267,10 @@ event_unregister_epoll (struct event_pool *event_pool, int fd, int idx_hint)
                 if (ret == -1) {
                         gf_log ("epoll", GF_LOG_ERROR,
                                 "fail to modify fd(=%d) index %d to %d (%s)",
-                                ev_data->fd, event_pool->used, idx,
+                                ev_data->fd, lastidx, idx,
                                 strerror (errno));
                         goto unlock;
                 }
-
-                /* just replace the unregistered idx by last one */
-                event_pool->reg[idx] = event_pool->reg[lastidx];
-                event_pool->used--;
         }
 unlock:
         pthread_mutex_unlock (&event_pool->mutex);
@@ -327,7 +337,15 @@ event_select_on_epoll (struct event_pool *event_pool, int fd, int idx_hint,
                         break;
                 }
 
-                epoll_event.events = event_pool->reg[idx].events;
+                /* the fd is disarmed while its handler runs, the new
+                 * events get applied when the handler returns.
+                 */
+                if (event_pool->reg[idx].in_handler) {
+                        ret = 0;
+                        goto unlock;
+                }
+
+                epoll_event.events = event_pool->reg[idx].events | EPOLLONESHOT;
                 ev_data->fd = fd;
                 ev_data->idx = idx;
 
@@ -347,6 +365,42 @@ out:
 }
 
 
+static void
+event_dispatch_epoll_rearm (struct event_pool *event_pool, int fd,
+                            int idx_hint, int gen)
+{
+        struct epoll_event  epoll_event = {0, };
+        struct event_data  *ev_data = (void *)&epoll_event.data;
+        int                 idx = -1;
+        int                 ret = -1;
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                idx = __event_getindex (event_pool, fd, idx_hint);
+
+                /* unregistered (and possibly reused) while in the handler */
+                if (idx == -1 || event_pool->reg[idx].gen != gen)
+                        goto unlock;
+
+                event_pool->reg[idx].in_handler = 0;
+
+                epoll_event.events = event_pool->reg[idx].events | EPOLLONESHOT;
+                ev_data->fd = fd;
+                ev_data->idx = idx;
+
+                ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, fd,
+                                 &epoll_event);
+                if (ret == -1) {
+                        gf_log ("epoll", GF_LOG_ERROR,
+                                "failed to re-arm fd(=%d) in epoll fd(=%d) "
+                                "(%s)", fd, event_pool->fd, strerror (errno));
+                }
+        }
+unlock:
+        pthread_mutex_unlock (&event_pool->mutex);
+}
+
+
 static int
 event_dispatch_epoll_handler (struct event_pool *event_pool,
                               struct epoll_event *events, int i)
@@ -355,6 +409,7 @@ event_dispatch_epoll_handler (struct event_pool *event_pool,
         event_handler_t     handler = NULL;
         void               *data = NULL;
         int                 idx = -1;
+        int                 gen = -1;
         int                 ret = -1;
 
 
@@ -374,79 +429,209 @@ event_dispatch_epoll_handler (struct event_pool *event_pool,
                         goto unlock;
                 }
 
+                /* another dispatcher thread already owns this fd, it
+                 * re-arms the fd once done and the event is seen again.
+                 */
+                if (event_pool->reg[idx].in_handler)
+                        goto unlock;
+
+                event_pool->reg[idx].in_handler = 1;
+
                 handler = event_pool->reg[idx].handler;
                 data = event_pool->reg[idx].data;
+                gen = event_pool->reg[idx].gen;
         }
 unlock:
         pthread_mutex_unlock (&event_pool->mutex);
 
-        if (handler)
+        if (handler) {
                 ret = handler (event_data->fd, event_data->idx, data,
                                (events[i].events & (EPOLLIN|EPOLLPRI)),
                                (events[i].events & (EPOLLOUT)),
                                (events[i].events & (EPOLLERR|EPOLLHUP)));
+
+                event_dispatch_epoll_rearm (event_pool, event_data->fd,
+                                            event_data->idx, gen);
+        }
+
         return ret;
 }
 
 
-static int
-event_dispatch_epoll (struct event_pool *event_pool)
+struct event_epoll_poller {
+        struct event_pool *event_pool;
+        int                index;
+};
+
+
+static void *
+event_dispatch_epoll_worker (void *data)
 {
-        struct epoll_event *events = NULL;
-        int                 size = 0;
-        int                 i = 0;
-        int                 ret = -1;
+        struct event_epoll_poller *poller = data;
+        struct event_pool         *event_pool = NULL;
+        struct epoll_event         event = {0, };
+        int                        index = 0;
+        int                        ret = -1;
 
-        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+        event_pool = poller->event_pool;
+        index = poller->index;
+        GF_FREE (poller);
 
-        while (1) {
-                pthread_mutex_lock (&event_pool->mutex);
-                {
-                        while (event_pool->used == 0)
-                                pthread_cond_wait (&event_pool->cond,
-                                                   &event_pool->mutex);
+        gf_log ("epoll", GF_LOG_DEBUG, "started epoll dispatcher thread %d",
+                index);
 
-                        if (event_pool->used > event_pool->evcache_size) {
-                                GF_FREE (event_pool->evcache);
+        while (1) {
+                /* one event per wakeup, so that the ready fds get spread
+                 * across all the dispatcher threads.
+                 */
+                ret = epoll_wait (event_pool->fd, &event, 1, -1);
 
-                                event_pool->evcache = events = NULL;
+                if (ret == 0)
+                        /* timeout */
+                        continue;
 
-                                event_pool->evcache_size =
-                                        event_pool->used + 256;
+                if (ret == -1 && errno == EINTR)
+                        /* sys call */
+                        continue;
 
-                                events = GF_CALLOC (event_pool->evcache_size,
-                                                    sizeof (struct epoll_event),
-                                                    gf_common_mt_epoll_event);
-                                if (!events)
-                                        break;
+                if (ret == 1 && event.events)
+                        event_dispatch_epoll_handler (event_pool, &event, 0);
 
-                                event_pool->evcache = events;
+                /* threads above the configured count exit lazily, after
+                 * the event they were woken up for has been handled.
+                 */
+                pthread_mutex_lock (&event_pool->mutex);
+                {
+                        if (index >= event_pool->eventthreadcount) {
+                                event_pool->pollers[index] = 0;
+                                event_pool->activethreadcount--;
+                                pthread_mutex_unlock (&event_pool->mutex);
+                                break;
                         }
                 }
                 pthread_mutex_unlock (&event_pool->mutex);
+        }
 
-                ret = epoll_wait (event_pool->fd, event_pool->evcache,
-                                  event_pool->evcache_size, -1);
+        gf_log ("epoll", GF_LOG_DEBUG, "exited epoll dispatcher thread %d",
+                index);
 
-                if (ret == 0)
-                        /* timeout */
-                        continue;
+        return NULL;
+}
 
-                if (ret == -1 && errno == EINTR)
-                        /* sys call */
+
+/* spawn the missing dispatcher threads. Slot 0 is the thread which called
+ * event_dispatch(), it never exits.
+ */
+static int
+__event_epoll_start_pollers (struct event_pool *event_pool)
+{
+        struct event_epoll_poller *poller = NULL;
+        int                        i = 0;
+        int                        ret = 0;
+
+        for (i = 1; i < event_pool->eventthreadcount; i++) {
+                if (event_pool->pollers[i])
                         continue;
 
-                size = ret;
+                poller = GF_CALLOC (1, sizeof (*poller),
+                                    gf_common_mt_epoll_poller_t);
+                if (!poller) {
+                        ret = -1;
+                        break;
+                }
 
-                for (i = 0; i < size; i++) {
-                        if (!events || !events[i].events)
-                                continue;
+                poller->event_pool = event_pool;
+                poller->index = i;
 
-                        ret = event_dispatch_epoll_handler (event_pool,
-                                                            events, i);
+                ret = pthread_create (&event_pool->pollers[i], NULL,
+                                      event_dispatch_epoll_worker, poller);
+                if (ret) {
+                        gf_log ("epoll", GF_LOG_ERROR,
+                                "failed to start dispatcher thread %d (%s)",
+                                i, strerror (ret));
+                        event_pool->pollers[i] = 0;
+                        GF_FREE (poller);
+                        ret = -1;
+                        break;
                 }
+
+                pthread_detach (event_pool->pollers[i]);
+                event_pool->activethreadcount++;
+        }
+
+        return ret;
+}
+
+
+static int
+event_reconfigure_threads_epoll (struct event_pool *event_pool, int value)
+{
+        int ret = 0;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        if (value < 1)
+                value = 1;
+
+        if (value > EVENT_MAX_THREADS) {
+                gf_log ("epoll", GF_LOG_WARNING, "event thread count %d "
+                        "capped to %d", value, EVENT_MAX_THREADS);
+                value = EVENT_MAX_THREADS;
+        }
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                if (event_pool->eventthreadcount != value)
+                        gf_log ("epoll", GF_LOG_INFO, "reconfiguring event "
+                                "threads from %d to %d",
+                                event_pool->eventthreadcount, value);
+
+                event_pool->eventthreadcount = value;
+
+                /* shrinking is done by the pollers themselves */
+                if (event_pool->dispatched)
+                        ret = __event_epoll_start_pollers (event_pool);
+        }
+        pthread_mutex_unlock (&event_pool->mutex);
+
+out:
+        return ret;
+}
+
+
+static int
+event_dispatch_epoll (struct event_pool *event_pool)
+{
+        struct event_epoll_poller *poller = NULL;
+        int                        ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        poller = GF_CALLOC (1, sizeof (*poller), gf_common_mt_epoll_poller_t);
+        if (!poller)
+                goto out;
+
+        poller->event_pool = event_pool;
+        poller->index = 0;
+
+        pthread_mutex_lock (&event_pool->mutex);
+        {
+                event_pool->dispatched = 1;
+                event_pool->pollers[0] = pthread_self ();
+                event_pool->activethreadcount = 1;
+
+                ret = __event_epoll_start_pollers (event_pool);
         }
+        pthread_mutex_unlock (&event_pool->mutex);
+
+        if (ret)
+                gf_log ("epoll", GF_LOG_WARNING, "continuing with %d "
+                        "dispatcher thread(s)",
+                        event_pool->activethreadcount);
+
+        event_dispatch_epoll_worker (poller);
 
+        ret = 0;
 out:
         return ret;
 }
@@ -457,7 +642,8 @@ struct event_ops event_ops_epoll = {
         .event_register   = event_register_epoll,
         .event_select_on  = event_select_on_epoll,
         .event_unregister = event_unregister_epoll,
-        .event_dispatch   = event_dispatch_epoll
+        .event_dispatch   = event_dispatch_epoll,
+        .event_reconfigure_threads = event_reconfigure_threads_epoll
 };
 
 #endif
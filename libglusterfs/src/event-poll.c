@@ -363,31 +363,37 @@ unlock:
 }
 
 
+/* refreshes the pollfd array of the dispatcher (@ufds, room for @ufds_size)
+ * when the registered fds changed */
 static int
 event_dispatch_poll_resize (struct event_pool *event_pool,
-                            struct pollfd *ufds, int size)
+                            struct pollfd **ufdsp, int *ufds_size, int size)
 {
+        struct pollfd   *ufds = NULL;
         int              i = 0;
 
+        ufds = *ufdsp;
+
         pthread_mutex_lock (&event_pool->mutex);
         {
                 if (event_pool->changed == 0) {
                         goto unlock;
                 }
 
-                if (event_pool->used > event_pool->evcache_size) {
-                        GF_FREE (event_pool->evcache);
-
-                        event_pool->evcache = ufds = NULL;
+                if (event_pool->used > *ufds_size) {
+                        GF_FREE (ufds);
 
-                        event_pool->evcache_size = event_pool->used;
+                        *ufdsp = ufds = NULL;
+                        *ufds_size = 0;
+                        size = 0;
 
                         ufds = GF_CALLOC (sizeof (struct pollfd),
-                                          event_pool->evcache_size,
+                                          event_pool->used,
                                           gf_common_mt_pollfd);
                         if (!ufds)
                                 goto unlock;
-                        event_pool->evcache = ufds;
+                        *ufdsp = ufds;
+                        *ufds_size = event_pool->used;
                 }
 
                 for (i = 0; i < event_pool->used; i++) {
@@ -409,6 +415,7 @@ static int
 event_dispatch_poll (struct event_pool *event_pool)
 {
         struct pollfd   *ufds = NULL;
+        int              ufds_size = 0;
         int              size = 0;
         int              i = 0;
         int              ret = -1;
@@ -416,8 +423,8 @@ event_dispatch_poll (struct event_pool *event_pool)
         GF_VALIDATE_OR_GOTO ("event", event_pool, out);
 
         while (1) {
-                size = event_dispatch_poll_resize (event_pool, ufds, size);
-                ufds = event_pool->evcache;
+                size = event_dispatch_poll_resize (event_pool, &ufds,
+                                                   &ufds_size, size);
 
                 ret = poll (ufds, size, 1);
 
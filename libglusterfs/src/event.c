@@ -115,3 +115,38 @@ event_dispatch (struct event_pool *event_pool)
 out:
         return ret;
 }
+
+
+int
+event_reconfigure_threads (struct event_pool *event_pool, int value)
+{
+        int ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        if (!event_pool->ops->event_reconfigure_threads) {
+                gf_log ("event", GF_LOG_INFO, "multi-threaded event "
+                        "dispatch is not supported by this event backend");
+                goto out;
+        }
+
+        ret = event_pool->ops->event_reconfigure_threads (event_pool, value);
+
+out:
+        return ret;
+}
+
+
+/* number of threads dispatching the events of @event_pool, as configured */
+int
+event_pool_threads (struct event_pool *event_pool)
+{
+        int ret = 1;
+
+        GF_VALIDATE_OR_GOTO ("event", event_pool, out);
+
+        if (event_pool->eventthreadcount > 1)
+                ret = event_pool->eventthreadcount;
+out:
+        return ret;
+}
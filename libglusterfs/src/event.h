@@ -18,6 +18,8 @@
 
 #include <pthread.h>
 
+#define EVENT_MAX_THREADS  32
+
 struct event_pool;
 struct event_ops;
 struct event_data {
@@ -41,6 +43,8 @@ struct event_pool {
 		int events;
 		void *data;
 		event_handler_t handler;
+		int gen;
+		int in_handler;
 	} *reg;
 
 	int used;
@@ -49,8 +53,11 @@ struct event_pool {
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
 
-	void *evcache;
-	int evcache_size;
+	int gen;                  /* registration generation counter */
+	int eventthreadcount;     /* number of dispatcher threads wanted */
+	int activethreadcount;    /* number of dispatcher threads running */
+	int dispatched;           /* event_dispatch() has been entered */
+	pthread_t pollers[EVENT_MAX_THREADS];
 };
 
 struct event_ops {
@@ -66,6 +73,9 @@ struct event_ops {
         int (*event_unregister) (struct event_pool *event_pool, int fd, int idx);
 
         int (*event_dispatch) (struct event_pool *event_pool);
+
+        int (*event_reconfigure_threads) (struct event_pool *event_pool,
+                                          int newcount);
 };
 
 struct event_pool * event_pool_new (int count);
@@ -76,5 +86,7 @@ int event_register (struct event_pool *event_pool, int fd,
 		    void *data, int poll_in, int poll_out);
 int event_unregister (struct event_pool *event_pool, int fd, int idx);
 int event_dispatch (struct event_pool *event_pool);
+int event_reconfigure_threads (struct event_pool *event_pool, int value);
+int event_pool_threads (struct event_pool *event_pool);
 
 #endif /* _EVENT_H_ */
@@ -106,8 +106,20 @@
 #define QUOTA_SIZE_KEY "trusted.glusterfs.quota.size"
 #define GFID_TO_PATH_KEY "glusterfs.gfid2path"
 
+/* rchecksum: strong checksum asked for in, and used for, a reply */
+#define GF_RCHECKSUM_TYPE_KEY "glusterfs.rchecksum-type"
+#define GF_RCHECKSUM_TYPE_FAST "murmur3"
+
 /* Index xlator related */
 #define GF_XATTROP_INDEX_GFID "glusterfs.xattrop_index_gfid"
+#define GF_XATTR_DIRTY_REGIONS "trusted.afr.dirty-regions"
+/* readdir of the names changed in a dirty directory, also set in the reply
+   by the brick that served it */
+#define GF_XATTROP_ENTRY_CHANGES "glusterfs.xattrop-entry-changes"
+/* name an entry changelog update is for, sent along with the xattrop */
+#define GF_XATTROP_ENTRY_CHANGES_NAME "glusterfs.xattrop-entry-changes-name"
+/* sent along with an xattrop after which any name may differ */
+#define GF_XATTROP_ENTRY_CHANGES_ALL "glusterfs.xattrop-entry-changes-all"
 
 #define GF_GFIDLESS_LOOKUP "gfidless-lookup"
 /* replace-brick and pump related internal xattrs */
@@ -187,6 +199,7 @@ typedef enum {
         GF_FOP_RELEASEDIR,
         GF_FOP_GETSPEC,
         GF_FOP_FREMOVEXATTR,
+        GF_FOP_COMPOUND,
         GF_FOP_MAXVALUE,
 } glusterfs_fop_t;
 
@@ -384,7 +397,6 @@ struct _glusterfs_ctx {
         char                *statedump_path;
 
         struct mem_pool    *dict_pool;
-        struct mem_pool    *dict_pair_pool;
         struct mem_pool    *dict_data_pool;
 
         glusterfsd_mgmt_event_notify_fn_t notify; /* Used for xlators to make
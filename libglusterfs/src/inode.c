@@ -28,13 +28,30 @@
    move latest accessed dentry to list_head of inode
 */
 
-#define INODE_DUMP_LIST(head, key_buf, key_prefix, list_type)           \
+/* Locking:
+
+   table->lock            dentries (name_hash, inode->dentry_list and the
+                          parent links), i.e. the namespace
+   shards[i].hash_lock    the inode_hash buckets with bucket % SHARDS == i
+   shards[i].lock         the active/lru/purge lists of the inodes mapped
+                          onto shard i, their nlookup, and the 0 <-> 1
+                          transitions of their ref
+
+   taken in that order. Any ref which is not the first or last one is
+   taken and dropped with an atomic op alone; dropping the last one takes
+   table->lock too, as the dentries of an inode going to the lru list
+   which are no longer hashed are unset then. Inodes whose last ref is
+   dropped while unlooked-up are only parked on their shard's purge list;
+   inode_table_prune() unhashes them, unsets their dentries and destroys
+   them, and until it does a lookup by gfid or by name revives them.
+*/
+
+#define INODE_DUMP_LIST(head, key_buf, key_prefix, list_type, idx)      \
         {                                                               \
-                int i = 1;                                              \
                 inode_t *inode = NULL;                                  \
                 list_for_each_entry (inode, head, list) {               \
                         gf_proc_dump_build_key(key_buf, key_prefix,     \
-                                               "%s.%d",list_type, i++); \
+                                               "%s.%d",list_type, ++idx); \
                         gf_proc_dump_add_section(key_buf);              \
                         inode_dump(inode, key);                         \
                 }                                                       \
@@ -78,6 +95,28 @@ hash_gfid (uuid_t uuid, int mod)
 }
 
 
+static struct _inode_table_shard *
+inode_shard (inode_t *inode)
+{
+        unsigned long idx = 0;
+
+        idx = ((unsigned long)inode) / sizeof (*inode);
+
+        return &inode->table->shards[idx % INODE_TABLE_SHARDS];
+}
+
+
+static pthread_mutex_t *
+inode_hash_stripe (inode_table_t *table, uuid_t gfid)
+{
+        int hash = 0;
+
+        hash = hash_gfid (gfid, 65536);
+
+        return &table->shards[hash % INODE_TABLE_SHARDS].hash_lock;
+}
+
+
 static void
 __dentry_hash (dentry_t *dentry)
 {
@@ -329,30 +368,51 @@ noctx:
 }
 
 
+/* To be called with the inode's shard lock held */
 static void
 __inode_activate (inode_t *inode)
 {
+        struct _inode_table_shard *shard = NULL;
+
         if (!inode)
                 return;
 
-        list_move (&inode->list, &inode->table->active);
-        inode->table->active_size++;
+        shard = inode_shard (inode);
+
+        list_move (&inode->list, &shard->active);
+        shard->active_size++;
+        __sync_fetch_and_add (&inode->table->active_size, 1);
 }
 
 
+/* To be called with the inode's shard lock held, and table->lock: see
+   __inode_unset_unhashed () */
 static void
 __inode_passivate (inode_t *inode)
 {
-        dentry_t      *dentry = NULL;
-        dentry_t      *t = NULL;
+        struct _inode_table_shard *shard = NULL;
 
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
                 return;
         }
 
-        list_move_tail (&inode->list, &inode->table->lru);
-        inode->table->lru_size++;
+        shard = inode_shard (inode);
+
+        list_move_tail (&inode->list, &shard->lru);
+        shard->lru_size++;
+        __sync_fetch_and_add (&inode->table->lru_size, 1);
+}
+
+
+/* The second half of passivating @inode, once its shard lock is dropped:
+   unsetting a dentry unrefs its parent, which may take another shard
+   lock. table->lock is held, so the inode can not be reaped meanwhile */
+static void
+__inode_unset_unhashed (inode_t *inode)
+{
+        dentry_t      *dentry = NULL;
+        dentry_t      *t = NULL;
 
         list_for_each_entry_safe (dentry, t, &inode->dentry_list, inode_list) {
                 if (!__is_dentry_hashed (dentry))
@@ -361,49 +421,74 @@ __inode_passivate (inode_t *inode)
 }
 
 
+/* To be called with the inode's shard lock held. Unhashing the inode and
+   unsetting its dentries need the hash stripe and namespace locks, and
+   are left to inode_table_prune() */
 static void
 __inode_retire (inode_t *inode)
 {
-        dentry_t      *dentry = NULL;
-        dentry_t      *t = NULL;
+        struct _inode_table_shard *shard = NULL;
 
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
                 return;
         }
 
-        list_move_tail (&inode->list, &inode->table->purge);
-        inode->table->purge_size++;
+        shard = inode_shard (inode);
 
-        __inode_unhash (inode);
+        list_move_tail (&inode->list, &shard->purge);
+        shard->purge_size++;
+        __sync_fetch_and_add (&inode->table->purge_size, 1);
 
-        list_for_each_entry_safe (dentry, t, &inode->dentry_list, inode_list) {
-                __dentry_unset (dentry);
-        }
+        inode->purging = _gf_true;
 }
 
 
+/* To be called with table->lock held */
 static inode_t *
 __inode_unref (inode_t *inode)
 {
+        struct _inode_table_shard *shard = NULL;
+        uint32_t                   ref = 0;
+        gf_boolean_t               passivated = _gf_false;
+
         if (!inode)
                 return NULL;
 
         if (__is_root_gfid(inode->gfid))
                 return inode;
 
-        GF_ASSERT (inode->ref);
+        /* a ref which is not the last one can go without moving the
+           inode between lists */
+        ref = inode->ref;
+        while (ref > 1) {
+                if (__sync_bool_compare_and_swap (&inode->ref, ref, ref - 1))
+                        return inode;
+                ref = inode->ref;
+        }
+
+        shard = inode_shard (inode);
 
-        --inode->ref;
+        pthread_mutex_lock (&shard->lock);
+        {
+                GF_ASSERT (inode->ref);
 
-        if (!inode->ref) {
-                inode->table->active_size--;
+                if (__sync_sub_and_fetch (&inode->ref, 1) == 0) {
+                        shard->active_size--;
+                        __sync_fetch_and_sub (&inode->table->active_size, 1);
 
-                if (inode->nlookup)
-                        __inode_passivate (inode);
-                else
-                        __inode_retire (inode);
+                        if (inode->nlookup) {
+                                __inode_passivate (inode);
+                                passivated = _gf_true;
+                        } else {
+                                __inode_retire (inode);
+                        }
+                }
         }
+        pthread_mutex_unlock (&shard->lock);
+
+        if (passivated)
+                __inode_unset_unhashed (inode);
 
         return inode;
 }
@@ -412,14 +497,38 @@ __inode_unref (inode_t *inode)
 static inode_t *
 __inode_ref (inode_t *inode)
 {
+        struct _inode_table_shard *shard = NULL;
+        uint32_t                   ref = 0;
+
         if (!inode)
                 return NULL;
 
-        if (!inode->ref) {
-                inode->table->lru_size--;
-                __inode_activate (inode);
+        ref = inode->ref;
+        while (ref > 0) {
+                if (__sync_bool_compare_and_swap (&inode->ref, ref, ref + 1))
+                        return inode;
+                ref = inode->ref;
         }
-        inode->ref++;
+
+        shard = inode_shard (inode);
+
+        pthread_mutex_lock (&shard->lock);
+        {
+                if (__sync_fetch_and_add (&inode->ref, 1) == 0) {
+                        if (inode->purging) {
+                                inode->purging = _gf_false;
+                                shard->purge_size--;
+                                __sync_fetch_and_sub (&inode->table->purge_size,
+                                                      1);
+                        } else {
+                                shard->lru_size--;
+                                __sync_fetch_and_sub (&inode->table->lru_size,
+                                                      1);
+                        }
+                        __inode_activate (inode);
+                }
+        }
+        pthread_mutex_unlock (&shard->lock);
 
         return inode;
 }
@@ -429,18 +538,28 @@ inode_t *
 inode_unref (inode_t *inode)
 {
         inode_table_t *table = NULL;
+        uint32_t       ref = 0;
 
         if (!inode)
                 return NULL;
 
         table = inode->table;
 
+        /* the last ref may unset dentries, see __inode_unset_unhashed () */
+        ref = inode->ref;
+        while (ref > 1) {
+                if (__sync_bool_compare_and_swap (&inode->ref, ref, ref - 1))
+                        goto out;
+                ref = inode->ref;
+        }
+
         pthread_mutex_lock (&table->lock);
         {
                 inode = __inode_unref (inode);
         }
         pthread_mutex_unlock (&table->lock);
 
+out:
         inode_table_prune (table);
 
         return inode;
@@ -450,20 +569,10 @@ inode_unref (inode_t *inode)
 inode_t *
 inode_ref (inode_t *inode)
 {
-        inode_table_t *table = NULL;
-
         if (!inode)
                 return NULL;
 
-        table = inode->table;
-
-        pthread_mutex_lock (&table->lock);
-        {
-                inode = __inode_ref (inode);
-        }
-        pthread_mutex_unlock (&table->lock);
-
-        return inode;
+        return __inode_ref (inode);
 }
 
 
@@ -539,9 +648,6 @@ __inode_create (inode_table_t *table)
                 goto out;
         }
 
-        list_add (&newi->list, &table->lru);
-        table->lru_size++;
-
 out:
 
         return newi;
@@ -551,22 +657,27 @@ out:
 inode_t *
 inode_new (inode_table_t *table)
 {
-        inode_t *inode = NULL;
+        inode_t                   *inode = NULL;
+        struct _inode_table_shard *shard = NULL;
 
         if (!table) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
                 return NULL;
         }
 
-        pthread_mutex_lock (&table->lock);
+        inode = __inode_create (table);
+        if (inode == NULL)
+                goto out;
+
+        shard = inode_shard (inode);
+
+        pthread_mutex_lock (&shard->lock);
         {
-                inode = __inode_create (table);
-                if (inode != NULL) {
-                        __inode_ref (inode);
-                }
+                inode->ref = 1;
+                __inode_activate (inode);
         }
-        pthread_mutex_unlock (&table->lock);
-
+        pthread_mutex_unlock (&shard->lock);
+out:
         return inode;
 }
 
@@ -743,6 +854,7 @@ __is_root_gfid (uuid_t gfid)
 }
 
 
+/* To be called with the hash stripe lock of gfid held */
 inode_t *
 __inode_find (inode_table_t *table, uuid_t gfid)
 {
@@ -775,20 +887,23 @@ out:
 inode_t *
 inode_find (inode_table_t *table, uuid_t gfid)
 {
-        inode_t   *inode = NULL;
+        inode_t          *inode = NULL;
+        pthread_mutex_t  *stripe = NULL;
 
         if (!table) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "table not found");
                 return NULL;
         }
 
-        pthread_mutex_lock (&table->lock);
+        stripe = inode_hash_stripe (table, gfid);
+
+        pthread_mutex_lock (stripe);
         {
                 inode = __inode_find (table, gfid);
                 if (inode)
                         __inode_ref (inode);
         }
-        pthread_mutex_unlock (&table->lock);
+        pthread_mutex_unlock (stripe);
 
         return inode;
 }
@@ -803,6 +918,7 @@ __inode_link (inode_t *inode, inode_t *parent, const char *name,
         inode_t       *old_inode = NULL;
         inode_table_t *table = NULL;
         inode_t       *link_inode = NULL;
+        pthread_mutex_t *stripe = NULL;
 
         if (!inode)
                 return NULL;
@@ -829,15 +945,21 @@ __inode_link (inode_t *inode, inode_t *parent, const char *name,
                 if (uuid_is_null (iatt->ia_gfid))
                         return NULL;
 
-                old_inode = __inode_find (table, iatt->ia_gfid);
+                stripe = inode_hash_stripe (table, iatt->ia_gfid);
 
-                if (old_inode) {
-                        link_inode = old_inode;
-                } else {
-                        uuid_copy (inode->gfid, iatt->ia_gfid);
-                        inode->ia_type    = iatt->ia_type;
-                        __inode_hash (inode);
+                pthread_mutex_lock (stripe);
+                {
+                        old_inode = __inode_find (table, iatt->ia_gfid);
+
+                        if (old_inode) {
+                                link_inode = old_inode;
+                        } else {
+                                uuid_copy (inode->gfid, iatt->ia_gfid);
+                                inode->ia_type    = iatt->ia_type;
+                                __inode_hash (inode);
+                        }
                 }
+                pthread_mutex_unlock (stripe);
         }
 
         if (name) {
@@ -906,20 +1028,20 @@ inode_link (inode_t *inode, inode_t *parent, const char *name,
 int
 inode_lookup (inode_t *inode)
 {
-        inode_table_t *table = NULL;
+        struct _inode_table_shard *shard = NULL;
 
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
                 return -1;
         }
 
-        table = inode->table;
+        shard = inode_shard (inode);
 
-        pthread_mutex_lock (&table->lock);
+        pthread_mutex_lock (&shard->lock);
         {
                 __inode_lookup (inode);
         }
-        pthread_mutex_unlock (&table->lock);
+        pthread_mutex_unlock (&shard->lock);
 
         return 0;
 }
@@ -928,7 +1050,8 @@ inode_lookup (inode_t *inode)
 int
 inode_forget (inode_t *inode, uint64_t nlookup)
 {
-        inode_table_t *table = NULL;
+        inode_table_t             *table = NULL;
+        struct _inode_table_shard *shard = NULL;
 
         if (!inode) {
                 gf_log_callingfn (THIS->name, GF_LOG_WARNING, "inode not found");
@@ -936,12 +1059,13 @@ inode_forget (inode_t *inode, uint64_t nlookup)
         }
 
         table = inode->table;
+        shard = inode_shard (inode);
 
-        pthread_mutex_lock (&table->lock);
+        pthread_mutex_lock (&shard->lock);
         {
                 __inode_forget (inode, nlookup);
         }
-        pthread_mutex_unlock (&table->lock);
+        pthread_mutex_unlock (&shard->lock);
 
         inode_table_prune (table);
 
@@ -1240,35 +1364,136 @@ inode_path (inode_t *inode, const char *name, char **bufp)
 }
 
 
+/* To be called with the table lock held. Takes the inode at the head of
+   the shard's purge list off the list and out of the gfid hash, or returns
+   NULL once the list is empty */
+static inode_t *
+__inode_table_shard_reap (inode_table_t *table,
+                          struct _inode_table_shard *shard)
+{
+        inode_t          *inode = NULL;
+        pthread_mutex_t  *stripe = NULL;
+        gf_boolean_t      reaped = _gf_false;
+
+        while (!reaped) {
+                pthread_mutex_lock (&shard->lock);
+                {
+                        inode = NULL;
+                        if (!list_empty (&shard->purge))
+                                inode = list_entry (shard->purge.next,
+                                                    inode_t, list);
+                }
+                pthread_mutex_unlock (&shard->lock);
+
+                if (!inode)
+                        break;
+
+                /* the gfid cannot change and the inode cannot be freed
+                   under the table lock, but a find may revive it before
+                   the stripe lock is had */
+                stripe = inode_hash_stripe (table, inode->gfid);
+
+                pthread_mutex_lock (stripe);
+                pthread_mutex_lock (&shard->lock);
+                {
+                        if (inode->purging) {
+                                list_del_init (&inode->list);
+                                shard->purge_size--;
+                                __sync_fetch_and_sub (&table->purge_size, 1);
+                                __inode_unhash (inode);
+                                reaped = _gf_true;
+                        }
+                }
+                pthread_mutex_unlock (&shard->lock);
+                pthread_mutex_unlock (stripe);
+        }
+
+        return inode;
+}
+
+
 static int
 inode_table_prune (inode_table_t *table)
 {
-        int               ret = 0;
-        struct list_head  purge = {0, };
-        inode_t          *del = NULL;
-        inode_t          *tmp = NULL;
-        inode_t          *entry = NULL;
+        int                        ret = 0;
+        int                        i = 0;
+        int                        count = 0;
+        struct list_head           purge = {0, };
+        struct _inode_table_shard *shard = NULL;
+        inode_t                   *del = NULL;
+        inode_t                   *tmp = NULL;
+        inode_t                   *entry = NULL;
+        dentry_t                  *dentry = NULL;
+        dentry_t                  *t = NULL;
 
         if (!table)
                 return -1;
 
+        /* unlocked peek, so that the usual unref with nothing to prune
+           does not go through the table lock */
+        if (!table->purge_size &&
+            !(table->lru_limit && table->lru_size > table->lru_limit))
+                return 0;
+
         INIT_LIST_HEAD (&purge);
 
         pthread_mutex_lock (&table->lock);
         {
+                /* one inode from each shard per round, so that the lru
+                   lists shrink evenly */
                 while (table->lru_limit
                        && table->lru_size > (table->lru_limit)) {
+                        count = 0;
+
+                        for (i = 0; i < INODE_TABLE_SHARDS; i++) {
+                                if (table->lru_size <= table->lru_limit)
+                                        break;
+
+                                shard = &table->shards[i];
+
+                                pthread_mutex_lock (&shard->lock);
+                                {
+                                        if (!list_empty (&shard->lru)) {
+                                                entry = list_entry (shard->lru.next,
+                                                                    inode_t, list);
+
+                                                shard->lru_size--;
+                                                __sync_fetch_and_sub (&table->lru_size,
+                                                                      1);
+                                                __inode_retire (entry);
+                                                count++;
+                                        }
+                                }
+                                pthread_mutex_unlock (&shard->lock);
+                        }
 
-                        entry = list_entry (table->lru.next, inode_t, list);
-
-                        table->lru_size--;
-                        __inode_retire (entry);
+                        if (!count)
+                                break;
 
-                        ret++;
+                        ret += count;
                 }
 
-                list_splice_init (&table->purge, &purge);
-                table->purge_size = 0;
+                /* unsetting the dentries of a reaped inode can drop the
+                   last ref on its parent, which is then reaped in the
+                   next pass */
+                do {
+                        count = 0;
+
+                        for (i = 0; i < INODE_TABLE_SHARDS; i++) {
+                                shard = &table->shards[i];
+
+                                while ((del = __inode_table_shard_reap (table,
+                                                                        shard))) {
+                                        list_for_each_entry_safe (dentry, t,
+                                                                  &del->dentry_list,
+                                                                  inode_list) {
+                                                __dentry_unset (dentry);
+                                        }
+                                        list_add_tail (&del->list, &purge);
+                                        count++;
+                                }
+                        }
+                } while (count);
         }
         pthread_mutex_unlock (&table->lock);
 
@@ -1287,13 +1512,24 @@ inode_table_prune (inode_table_t *table)
 static void
 __inode_table_init_root (inode_table_t *table)
 {
-        inode_t     *root = NULL;
-        struct iatt  iatt = {0, };
+        inode_t                   *root = NULL;
+        struct iatt                iatt = {0, };
+        struct _inode_table_shard *shard = NULL;
 
         if (!table)
                 return;
 
         root = __inode_create (table);
+        if (!root)
+                return;
+
+        shard = inode_shard (root);
+
+        pthread_mutex_lock (&shard->lock);
+        {
+                __inode_passivate (root);
+        }
+        pthread_mutex_unlock (&shard->lock);
 
         iatt.ia_gfid[15] = 1;
         iatt.ia_ino = 1;
@@ -1363,9 +1599,13 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
                 INIT_LIST_HEAD (&new->name_hash[i]);
         }
 
-        INIT_LIST_HEAD (&new->active);
-        INIT_LIST_HEAD (&new->lru);
-        INIT_LIST_HEAD (&new->purge);
+        for (i = 0; i < INODE_TABLE_SHARDS; i++) {
+                INIT_LIST_HEAD (&new->shards[i].active);
+                INIT_LIST_HEAD (&new->shards[i].lru);
+                INIT_LIST_HEAD (&new->shards[i].purge);
+                pthread_mutex_init (&new->shards[i].lock, NULL);
+                pthread_mutex_init (&new->shards[i].hash_lock, NULL);
+        }
 
         ret = gf_asprintf (&new->name, "%s/inode", xl->name);
         if (-1 == ret) {
@@ -1373,10 +1613,10 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
                 ;
         }
 
-        __inode_table_init_root (new);
-
         pthread_mutex_init (&new->lock, NULL);
 
+        __inode_table_init_root (new);
+
         ret = 0;
 out:
         if (ret) {
@@ -1671,6 +1911,8 @@ inode_table_dump (inode_table_t *itable, char *prefix)
 
         char    key[GF_DUMP_MAX_BUF_LEN];
         int     ret = 0;
+        int     i = 0;
+        int     idx = 0;
 
         if (!itable)
                 return;
@@ -1682,6 +1924,10 @@ inode_table_dump (inode_table_t *itable, char *prefix)
                 return;
         }
 
+        /* with every shard held the lists and sizes add up */
+        for (i = 0; i < INODE_TABLE_SHARDS; i++)
+                pthread_mutex_lock (&itable->shards[i].lock);
+
         gf_proc_dump_build_key(key, prefix, "hashsize");
         gf_proc_dump_write(key, "%d", itable->hashsize);
         gf_proc_dump_build_key(key, prefix, "name");
@@ -1696,9 +1942,21 @@ inode_table_dump (inode_table_t *itable, char *prefix)
         gf_proc_dump_build_key(key, prefix, "purge_size");
         gf_proc_dump_write(key, "%d", itable->purge_size);
 
-        INODE_DUMP_LIST(&itable->active, key, prefix, "active");
-        INODE_DUMP_LIST(&itable->lru, key, prefix, "lru");
-        INODE_DUMP_LIST(&itable->purge, key, prefix, "purge");
+        idx = 0;
+        for (i = 0; i < INODE_TABLE_SHARDS; i++)
+                INODE_DUMP_LIST(&itable->shards[i].active, key, prefix,
+                                "active", idx);
+        idx = 0;
+        for (i = 0; i < INODE_TABLE_SHARDS; i++)
+                INODE_DUMP_LIST(&itable->shards[i].lru, key, prefix,
+                                "lru", idx);
+        idx = 0;
+        for (i = 0; i < INODE_TABLE_SHARDS; i++)
+                INODE_DUMP_LIST(&itable->shards[i].purge, key, prefix,
+                                "purge", idx);
+
+        for (i = INODE_TABLE_SHARDS - 1; i >= 0; i--)
+                pthread_mutex_unlock (&itable->shards[i].lock);
 
         pthread_mutex_unlock(&itable->lock);
 }
@@ -1747,11 +2005,15 @@ inode_table_dump_to_dict (inode_table_t *itable, char *prefix, dict_t *dict)
         int             ret = 0;
         inode_t         *inode = NULL;
         int             count = 0;
+        int             i = 0;
 
         ret = pthread_mutex_trylock (&itable->lock);
         if (ret)
                 return;
 
+        for (i = 0; i < INODE_TABLE_SHARDS; i++)
+                pthread_mutex_lock (&itable->shards[i].lock);
+
         memset (key, 0, sizeof (key));
         snprintf (key, sizeof (key), "%s.itable.active_size", prefix);
         ret = dict_set_uint32 (dict, key, itable->active_size);
@@ -1770,30 +2032,39 @@ inode_table_dump_to_dict (inode_table_t *itable, char *prefix, dict_t *dict)
         if (ret)
                 goto out;
 
-        list_for_each_entry (inode, &itable->active, list) {
-                memset (key, 0, sizeof (key));
-                snprintf (key, sizeof (key), "%s.itable.active%d", prefix,
-                          count++);
-                inode_dump_to_dict (inode, key, dict);
+        for (i = 0; i < INODE_TABLE_SHARDS; i++) {
+                list_for_each_entry (inode, &itable->shards[i].active, list) {
+                        memset (key, 0, sizeof (key));
+                        snprintf (key, sizeof (key), "%s.itable.active%d",
+                                  prefix, count++);
+                        inode_dump_to_dict (inode, key, dict);
+                }
         }
         count = 0;
 
-        list_for_each_entry (inode, &itable->lru, list) {
-                memset (key, 0, sizeof (key));
-                snprintf (key, sizeof (key), "%s.itable.lru%d", prefix,
-                          count++);
-                inode_dump_to_dict (inode, key, dict);
+        for (i = 0; i < INODE_TABLE_SHARDS; i++) {
+                list_for_each_entry (inode, &itable->shards[i].lru, list) {
+                        memset (key, 0, sizeof (key));
+                        snprintf (key, sizeof (key), "%s.itable.lru%d",
+                                  prefix, count++);
+                        inode_dump_to_dict (inode, key, dict);
+                }
         }
         count = 0;
 
-        list_for_each_entry (inode, &itable->purge, list) {
-                memset (key, 0, sizeof (key));
-                snprintf (key, sizeof (key), "%s.itable.purge%d", prefix,
-                          count++);
-                inode_dump_to_dict (inode, key, dict);
+        for (i = 0; i < INODE_TABLE_SHARDS; i++) {
+                list_for_each_entry (inode, &itable->shards[i].purge, list) {
+                        memset (key, 0, sizeof (key));
+                        snprintf (key, sizeof (key), "%s.itable.purge%d",
+                                  prefix, count++);
+                        inode_dump_to_dict (inode, key, dict);
+                }
         }
 
 out:
+        for (i = INODE_TABLE_SHARDS - 1; i >= 0; i--)
+                pthread_mutex_unlock (&itable->shards[i].lock);
+
         pthread_mutex_unlock (&itable->lock);
 
         return;
@@ -36,8 +36,29 @@ typedef struct _dentry dentry_t;
 #include "uuid.h"
 
 
+/* number of independently locked slices of the inode lists and of the
+   gfid hash; an inode's list slice is picked by its address, a gfid
+   bucket's lock by the bucket number */
+#define INODE_TABLE_SHARDS 32
+
+struct _inode_table_shard {
+        pthread_mutex_t    lock;        /* for the lists below, and for
+                                           ref 0 <-> 1 and nlookup of the
+                                           inodes on them */
+        struct list_head   active;      /* inodes of this shard in an fop */
+        uint32_t           active_size;
+        struct list_head   lru;         /* lru.next least recent */
+        uint32_t           lru_size;
+        struct list_head   purge;       /* unused and forgotten (or evicted),
+                                           destroyed by the next prune */
+        uint32_t           purge_size;
+        pthread_mutex_t    hash_lock;   /* for the inode_hash buckets
+                                           striped onto this shard */
+};
+
 struct _inode_table {
-        pthread_mutex_t    lock;
+        pthread_mutex_t    lock;        /* for dentries: name_hash, dentry
+                                           lists and parent links */
         size_t             hashsize;    /* bucket size of inode hash and dentry hash */
         char              *name;        /* name of the inode table, just for gf_log() */
         inode_t           *root;        /* root directory inode, with number 1 */
@@ -45,13 +66,10 @@ struct _inode_table {
         uint32_t           lru_limit;   /* maximum LRU cache size */
         struct list_head  *inode_hash;  /* buckets for inode hash table */
         struct list_head  *name_hash;   /* buckets for dentry hash table */
-        struct list_head   active;      /* list of inodes currently active (in an fop) */
-        uint32_t           active_size; /* count of inodes in active list */
-        struct list_head   lru;         /* list of inodes recently used.
-                                           lru.next most recent */
-        uint32_t           lru_size;    /* count of inodes in lru list  */
-        struct list_head   purge;       /* list of inodes to be purged soon */
-        uint32_t           purge_size;  /* count of inodes in purge list */
+        uint32_t           active_size; /* count of inodes in active lists */
+        uint32_t           lru_size;    /* count of inodes in lru lists  */
+        uint32_t           purge_size;  /* count of inodes in purge lists */
+        struct _inode_table_shard shards[INODE_TABLE_SHARDS];
 
         struct mem_pool   *inode_pool;  /* memory pool for inodes */
         struct mem_pool   *dentry_pool; /* memory pool for dentrys */
@@ -93,6 +111,7 @@ struct _inode {
         struct list_head     dentry_list;   /* list of directory entries for this inode */
         struct list_head     hash;          /* hash table pointers */
         struct list_head     list;          /* active/lru/purge */
+        gf_boolean_t         purging;       /* on the purge list */
 
 	struct _inode_ctx   *_ctx;    /* replacement for dict_t *(inode->ctx) */
 };
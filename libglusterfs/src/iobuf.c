@@ -18,10 +18,20 @@
   TODO: implement destroy margins and prefetching of arenas
 */
 
+static void iobuf_cache_destroy (void *data);
+static void __iobuf_pool_destroy_caches (struct iobuf_pool *iobuf_pool);
+void __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena);
+void iobuf_put (struct iobuf *iobuf);
+
 #define IOBUF_ARENA_MAX_INDEX  (sizeof (gf_iobuf_init_config) /         \
                                 (sizeof (struct iobuf_init_config)))
 
-/* Make sure this array is sorted based on pagesize */
+/* the arena list holding the iobufs which are bigger than any page size */
+#define IOBUF_STDALLOC_INDEX   (GF_VARIABLE_IOBUF_COUNT - 1)
+
+/* Default page sizes of a new pool, can be changed later with
+ * iobuf_pool_set_page_sizes(). Make sure this array is sorted based on
+ * pagesize */
 struct iobuf_init_config gf_iobuf_init_config[] = {
         /* { pagesize, num_pages }, */
         {128, 1024},
@@ -34,35 +44,39 @@ struct iobuf_init_config gf_iobuf_init_config[] = {
         {1 * 1024 * 1024, 2},
 };
 
+/* The page size table of the pool changes with iobuf_pool_set_page_sizes(),
+ * the two lookups below are for callers holding iobuf_pool->mutex. The per
+ * thread caches look up their own copy instead.
+ */
 int
-gf_iobuf_get_arena_index (size_t page_size)
+gf_iobuf_get_arena_index (struct iobuf_pool *iobuf_pool, size_t page_size)
 {
         int i = -1;
 
-        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
-                if (page_size <= gf_iobuf_init_config[i].pagesize)
+        for (i = 0; i < iobuf_pool->config_cnt; i++) {
+                if (page_size <= iobuf_pool->config[i].pagesize)
                         break;
         }
 
-        if (i >= IOBUF_ARENA_MAX_INDEX)
+        if (i >= iobuf_pool->config_cnt)
                 i = -1;
 
         return i;
 }
 
 size_t
-gf_iobuf_get_pagesize (size_t page_size)
+gf_iobuf_get_pagesize (struct iobuf_pool *iobuf_pool, size_t page_size)
 {
         int    i    = 0;
         size_t size = 0;
 
-        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
-                size = gf_iobuf_init_config[i].pagesize;
+        for (i = 0; i < iobuf_pool->config_cnt; i++) {
+                size = iobuf_pool->config[i].pagesize;
                 if (page_size <= size)
                         break;
         }
 
-        if (i >= IOBUF_ARENA_MAX_INDEX)
+        if (i >= iobuf_pool->config_cnt)
                 size = -1;
 
         return size;
@@ -154,6 +168,45 @@ out:
 }
 
 
+static void *
+__iobuf_arena_mmap (struct iobuf_pool *iobuf_pool, size_t arena_size)
+{
+        void *mem_base = MAP_FAILED;
+
+        if (!iobuf_pool->hugepages || arena_size < GF_IOBUF_HUGEPAGE_SIZE)
+                goto normal;
+
+#ifdef MAP_HUGETLB
+        /* explicit huge pages, only if the arena is made of whole ones */
+        if ((arena_size % GF_IOBUF_HUGEPAGE_SIZE) == 0) {
+                mem_base = mmap (NULL, arena_size, PROT_READ|PROT_WRITE,
+                                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+                if (mem_base != MAP_FAILED)
+                        goto out;
+
+                gf_log ("iobuf", GF_LOG_DEBUG, "huge page mapping of %zu "
+                        "bytes failed (%s), trying transparent huge pages",
+                        arena_size, strerror (errno));
+        }
+#endif
+
+normal:
+        mem_base = mmap (NULL, arena_size, PROT_READ|PROT_WRITE,
+                         MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+#ifdef MADV_HUGEPAGE
+        if (mem_base != MAP_FAILED && iobuf_pool->hugepages
+            && arena_size >= GF_IOBUF_HUGEPAGE_SIZE)
+                madvise (mem_base, arena_size, MADV_HUGEPAGE);
+#endif
+
+#ifdef MAP_HUGETLB
+out:
+#endif
+        return mem_base;
+}
+
+
 struct iobuf_arena *
 __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool, size_t page_size,
                      int32_t num_iobufs)
@@ -173,16 +226,15 @@ __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool, size_t page_size,
         INIT_LIST_HEAD (&iobuf_arena->passive.list);
         iobuf_arena->iobuf_pool = iobuf_pool;
 
-        rounded_size = gf_iobuf_get_pagesize (page_size);
+        rounded_size = gf_iobuf_get_pagesize (iobuf_pool, page_size);
 
         iobuf_arena->page_size  = rounded_size;
         iobuf_arena->page_count = num_iobufs;
 
         iobuf_arena->arena_size = rounded_size * num_iobufs;
 
-        iobuf_arena->mem_base = mmap (NULL, iobuf_arena->arena_size,
-                                      PROT_READ|PROT_WRITE,
-                                      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        iobuf_arena->mem_base = __iobuf_arena_mmap (iobuf_pool,
+                                                    iobuf_arena->arena_size);
         if (iobuf_arena->mem_base == MAP_FAILED) {
                 gf_log (THIS->name, GF_LOG_WARNING, "maping failed");
                 goto err;
@@ -215,7 +267,7 @@ __iobuf_arena_unprune (struct iobuf_pool *iobuf_pool, size_t page_size)
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        index = gf_iobuf_get_arena_index (page_size);
+        index = gf_iobuf_get_arena_index (iobuf_pool, page_size);
         if (index == -1) {
                 gf_log ("iobuf", GF_LOG_ERROR, "page_size (%zu) of "
                         "iobufs in arena being added is greater than max "
@@ -240,7 +292,7 @@ __iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool, size_t page_size,
         struct iobuf_arena *iobuf_arena  = NULL;
         int                 index        = 0;
 
-        index = gf_iobuf_get_arena_index (page_size);
+        index = gf_iobuf_get_arena_index (iobuf_pool, page_size);
         if (index == -1) {
                 gf_log ("iobuf", GF_LOG_ERROR, "page_size (%zu) of "
                         "iobufs in arena being added is greater than max "
@@ -294,7 +346,14 @@ iobuf_pool_destroy (struct iobuf_pool *iobuf_pool)
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
+        /* take back what the threads still hold before the arenas go */
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                __iobuf_pool_destroy_caches (iobuf_pool);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        for (i = 0; i < iobuf_pool->config_cnt; i++) {
                 list_for_each_entry_safe (iobuf_arena, tmp,
                                           &iobuf_pool->arenas[i], list) {
                         list_del_init (&iobuf_arena->list);
@@ -328,7 +387,7 @@ iobuf_create_stdalloc_arena (struct iobuf_pool *iobuf_pool)
         iobuf_arena->page_size = 0x7fffffff;
 
         list_add_tail (&iobuf_arena->list,
-                       &iobuf_pool->arenas[IOBUF_ARENA_MAX_INDEX]);
+                       &iobuf_pool->arenas[IOBUF_STDALLOC_INDEX]);
 
 err:
         return;
@@ -349,7 +408,8 @@ iobuf_pool_new (void)
                 goto out;
 
         pthread_mutex_init (&iobuf_pool->mutex, NULL);
-        for (i = 0; i <= IOBUF_ARENA_MAX_INDEX; i++) {
+        INIT_LIST_HEAD (&iobuf_pool->caches);
+        for (i = 0; i < GF_VARIABLE_IOBUF_COUNT; i++) {
                 INIT_LIST_HEAD (&iobuf_pool->arenas[i]);
                 INIT_LIST_HEAD (&iobuf_pool->filled[i]);
                 INIT_LIST_HEAD (&iobuf_pool->purge[i]);
@@ -357,10 +417,21 @@ iobuf_pool_new (void)
 
         iobuf_pool->default_page_size  = 128 * GF_UNIT_KB;
 
+        memcpy (iobuf_pool->config, gf_iobuf_init_config,
+                sizeof (gf_iobuf_init_config));
+        iobuf_pool->config_cnt = IOBUF_ARENA_MAX_INDEX;
+
+        if (pthread_key_create (&iobuf_pool->cache_key,
+                                iobuf_cache_destroy) == 0)
+                iobuf_pool->cache_key_valid = 1;
+        else
+                gf_log ("iobuf", GF_LOG_WARNING, "failed to create the "
+                        "thread cache key, iobufs will not be cached");
+
         arena_size = 0;
-        for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
-                page_size = gf_iobuf_init_config[i].pagesize;
-                num_pages = gf_iobuf_init_config[i].num_pages;
+        for (i = 0; i < iobuf_pool->config_cnt; i++) {
+                page_size = iobuf_pool->config[i].pagesize;
+                num_pages = iobuf_pool->config[i].num_pages;
 
                 iobuf_pool_add_arena (iobuf_pool, page_size, num_pages);
 
@@ -413,7 +484,7 @@ iobuf_pool_prune (struct iobuf_pool *iobuf_pool)
 
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
-                for (i = 0; i < IOBUF_ARENA_MAX_INDEX; i++) {
+                for (i = 0; i < iobuf_pool->config_cnt; i++) {
                         if (list_empty (&iobuf_pool->arenas[i])) {
                                 continue;
                         }
@@ -440,7 +511,7 @@ __iobuf_select_arena (struct iobuf_pool *iobuf_pool, size_t page_size)
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
-        index = gf_iobuf_get_arena_index (page_size);
+        index = gf_iobuf_get_arena_index (iobuf_pool, page_size);
         if (index == -1) {
                 gf_log ("iobuf", GF_LOG_ERROR, "page_size (%zu) of "
                         "iobufs in arena being added is greater than max "
@@ -459,7 +530,7 @@ __iobuf_select_arena (struct iobuf_pool *iobuf_pool, size_t page_size)
         if (!iobuf_arena) {
                 /* all arenas were full, find the right count to add */
                 iobuf_arena = __iobuf_pool_add_arena (iobuf_pool, page_size,
-                                                      gf_iobuf_init_config[index].num_pages);
+                                                      iobuf_pool->config[index].num_pages);
         }
 
 out:
@@ -511,7 +582,7 @@ __iobuf_get (struct iobuf_arena *iobuf_arena, size_t page_size)
                 iobuf_arena->max_active = iobuf_arena->active_cnt;
 
         if (iobuf_arena->passive_cnt == 0) {
-                index = gf_iobuf_get_arena_index (page_size);
+                index = gf_iobuf_get_arena_index (iobuf_pool, page_size);
                 if (index == -1) {
                         gf_log ("iobuf", GF_LOG_ERROR, "page_size (%zu) of "
                                 "iobufs in arena being added is greater "
@@ -527,6 +598,347 @@ out:
         return iobuf;
 }
 
+/* Per-thread iobuf caches.
+ *
+ * A thread keeps a few passive iobufs of each page size for itself, so that
+ * most of its iobuf_get()/iobuf_unref() calls do not need the pool mutex.
+ * Cached iobufs stay on the active list of their arena, the cache is refilled
+ * and drained in batches under the mutex.
+ *
+ * Every cache is on iobuf_pool->caches, so that a change of page sizes and
+ * iobuf_pool_destroy() can hand back what the threads hold. The owner takes
+ * cache->lock, which nobody else wants but for those flushes, for each use.
+ * Lock order: iobuf_pool->mutex, then cache->lock.
+ */
+struct iobuf_cache {
+        struct list_head   list;
+        struct iobuf_pool *iobuf_pool;
+        gf_lock_t          lock;
+        int                pagesize_cnt; /* copy of the page sizes of */
+        size_t             pagesize[GF_VARIABLE_IOBUF_COUNT - 1]; /* pool */
+        int                count[GF_VARIABLE_IOBUF_COUNT];
+        struct iobuf      *iobufs[GF_VARIABLE_IOBUF_COUNT][GF_IOBUF_CACHE_COUNT];
+};
+
+
+static int
+iobuf_cache_limit (size_t page_size)
+{
+        size_t limit = 0;
+
+        limit = GF_IOBUF_CACHE_BYTES / page_size;
+        if (limit > GF_IOBUF_CACHE_COUNT)
+                limit = GF_IOBUF_CACHE_COUNT;
+
+        return limit;
+}
+
+
+/* called with the pool mutex and cache->lock held */
+static void
+__iobuf_cache_drain (struct iobuf_cache *cache, int index, int count)
+{
+        struct iobuf *iobuf = NULL;
+
+        while (count-- > 0 && cache->count[index] > 0) {
+                iobuf = cache->iobufs[index][--cache->count[index]];
+                __iobuf_put (iobuf, iobuf->iobuf_arena);
+        }
+}
+
+
+static void
+__iobuf_cache_flush (struct iobuf_cache *cache)
+{
+        int i = 0;
+
+        for (i = 0; i < GF_VARIABLE_IOBUF_COUNT; i++)
+                __iobuf_cache_drain (cache, i, cache->count[i]);
+}
+
+
+/* index the page size of @page_size falls in, -1 if too big. called with
+ * cache->lock held */
+static int
+__iobuf_cache_index (struct iobuf_cache *cache, size_t page_size)
+{
+        int i = 0;
+
+        for (i = 0; i < cache->pagesize_cnt; i++) {
+                if (page_size <= cache->pagesize[i])
+                        return i;
+        }
+
+        return -1;
+}
+
+
+static size_t
+iobuf_cache_pagesize (struct iobuf_cache *cache, size_t page_size)
+{
+        size_t pagesize = -1;
+        int    index = 0;
+
+        LOCK (&cache->lock);
+        {
+                index = __iobuf_cache_index (cache, page_size);
+                if (index != -1)
+                        pagesize = cache->pagesize[index];
+        }
+        UNLOCK (&cache->lock);
+
+        return pagesize;
+}
+
+
+/* empty @cache and pick up the current page sizes of the pool. called with
+ * the pool mutex and cache->lock held */
+static void
+__iobuf_cache_sync (struct iobuf_cache *cache, struct iobuf_pool *iobuf_pool)
+{
+        int i = 0;
+
+        __iobuf_cache_flush (cache);
+
+        for (i = 0; i < iobuf_pool->config_cnt; i++)
+                cache->pagesize[i] = iobuf_pool->config[i].pagesize;
+        cache->pagesize_cnt = iobuf_pool->config_cnt;
+}
+
+
+/* hand back the iobufs of every thread, the pool mutex is held */
+static void
+__iobuf_pool_flush_caches (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_cache *cache = NULL;
+
+        list_for_each_entry (cache, &iobuf_pool->caches, list) {
+                LOCK (&cache->lock);
+                {
+                        __iobuf_cache_flush (cache);
+                }
+                UNLOCK (&cache->lock);
+        }
+}
+
+
+/* for iobuf_pool_destroy (): no thread is to use the pool any more, their
+ * caches are freed here rather than at thread exit. the pool mutex is held */
+static void
+__iobuf_pool_destroy_caches (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_cache *cache = NULL;
+        struct iobuf_cache *tmp = NULL;
+
+        if (!iobuf_pool->cache_key_valid)
+                return;
+
+        iobuf_pool->cache_key_valid = 0;
+
+        list_for_each_entry_safe (cache, tmp, &iobuf_pool->caches, list) {
+                list_del_init (&cache->list);
+
+                LOCK (&cache->lock);
+                {
+                        __iobuf_cache_flush (cache);
+                }
+                UNLOCK (&cache->lock);
+
+                LOCK_DESTROY (&cache->lock);
+                FREE (cache);
+        }
+
+        pthread_key_delete (iobuf_pool->cache_key);
+}
+
+
+static void
+iobuf_cache_destroy (void *data)
+{
+        struct iobuf_cache *cache = data;
+        struct iobuf_pool  *iobuf_pool = NULL;
+
+        iobuf_pool = cache->iobuf_pool;
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                list_del_init (&cache->list);
+
+                LOCK (&cache->lock);
+                {
+                        __iobuf_cache_flush (cache);
+                }
+                UNLOCK (&cache->lock);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        LOCK_DESTROY (&cache->lock);
+        FREE (cache);
+}
+
+
+static struct iobuf_cache *
+iobuf_cache_get (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_cache *cache = NULL;
+
+        if (!iobuf_pool->cache_key_valid)
+                return NULL;
+
+        cache = pthread_getspecific (iobuf_pool->cache_key);
+        if (cache)
+                return cache;
+
+        cache = CALLOC (1, sizeof (*cache));
+        if (!cache)
+                return NULL;
+
+        INIT_LIST_HEAD (&cache->list);
+        LOCK_INIT (&cache->lock);
+        cache->iobuf_pool = iobuf_pool;
+
+        if (pthread_setspecific (iobuf_pool->cache_key, cache) != 0) {
+                LOCK_DESTROY (&cache->lock);
+                FREE (cache);
+                return NULL;
+        }
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                LOCK (&cache->lock);
+                {
+                        __iobuf_cache_sync (cache, iobuf_pool);
+                }
+                UNLOCK (&cache->lock);
+
+                list_add_tail (&cache->list, &iobuf_pool->caches);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        return cache;
+}
+
+
+static struct iobuf *
+iobuf_get_from_cache (struct iobuf_pool *iobuf_pool, struct iobuf_cache *cache,
+                      size_t rounded_size)
+{
+        struct iobuf_arena *iobuf_arena = NULL;
+        struct iobuf       *iobuf = NULL;
+        int                 index = 0;
+        int                 limit = 0;
+
+        limit = iobuf_cache_limit (rounded_size);
+        if (!limit)
+                goto out;
+
+        LOCK (&cache->lock);
+        {
+                index = __iobuf_cache_index (cache, rounded_size);
+                if ((index != -1) && cache->count[index])
+                        iobuf = cache->iobufs[index][--cache->count[index]];
+        }
+        UNLOCK (&cache->lock);
+
+        if (index == -1)
+                goto out;
+
+        if (!iobuf) {
+                pthread_mutex_lock (&iobuf_pool->mutex);
+                LOCK (&cache->lock);
+                {
+                        /* the page sizes may have changed meanwhile */
+                        index = __iobuf_cache_index (cache, rounded_size);
+
+                        while (index != -1 &&
+                               cache->count[index] < (limit + 1) / 2) {
+                                iobuf_arena = __iobuf_select_arena
+                                        (iobuf_pool, rounded_size);
+                                if (!iobuf_arena)
+                                        break;
+
+                                iobuf = __iobuf_get (iobuf_arena,
+                                                     rounded_size);
+                                if (!iobuf)
+                                        break;
+
+                                cache->iobufs[index][cache->count[index]++]
+                                        = iobuf;
+                        }
+
+                        iobuf = NULL;
+                        if (index != -1 && cache->count[index])
+                                iobuf = cache->iobufs[index]
+                                        [--cache->count[index]];
+                }
+                UNLOCK (&cache->lock);
+                pthread_mutex_unlock (&iobuf_pool->mutex);
+
+                if (!iobuf)
+                        goto out;
+        }
+
+        LOCK (&iobuf->lock);
+        {
+                __iobuf_ref (iobuf);
+        }
+        UNLOCK (&iobuf->lock);
+
+out:
+        return iobuf;
+}
+
+
+static int
+iobuf_put_to_cache (struct iobuf_pool *iobuf_pool, struct iobuf *iobuf)
+{
+        struct iobuf_cache *cache = NULL;
+        int                 index = 0;
+        int                 limit = 0;
+        int                 ret = -1;
+
+        limit = iobuf_cache_limit (iobuf->iobuf_arena->page_size);
+        if (!limit)
+                return -1;
+
+        cache = iobuf_cache_get (iobuf_pool);
+        if (!cache)
+                return -1;
+
+        LOCK (&cache->lock);
+        {
+                index = __iobuf_cache_index (cache,
+                                             iobuf->iobuf_arena->page_size);
+                if ((index != -1) && (cache->count[index] < limit)) {
+                        cache->iobufs[index][cache->count[index]++] = iobuf;
+                        ret = 0;
+                }
+        }
+        UNLOCK (&cache->lock);
+
+        if (ret == 0 || index == -1)
+                return ret;
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        LOCK (&cache->lock);
+        {
+                index = __iobuf_cache_index (cache,
+                                             iobuf->iobuf_arena->page_size);
+                if (index != -1) {
+                        if (cache->count[index] >= limit)
+                                __iobuf_cache_drain (cache, index,
+                                                     (limit + 1) / 2);
+                        cache->iobufs[index][cache->count[index]++] = iobuf;
+                        ret = 0;
+                }
+        }
+        UNLOCK (&cache->lock);
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        return ret;
+}
+
+
 struct iobuf *
 iobuf_get_from_stdalloc (struct iobuf_pool *iobuf_pool, size_t page_size)
 {
@@ -535,8 +947,9 @@ iobuf_get_from_stdalloc (struct iobuf_pool *iobuf_pool, size_t page_size)
         struct iobuf_arena *trav        = NULL;
         int                 ret         = -1;
 
-        /* The first arena in the 'MAX-INDEX' will always be used for misc */
-        list_for_each_entry (trav, &iobuf_pool->arenas[IOBUF_ARENA_MAX_INDEX],
+        /* The first arena in the 'STDALLOC-INDEX' will always be used for
+           misc */
+        list_for_each_entry (trav, &iobuf_pool->arenas[IOBUF_STDALLOC_INDEX],
                              list) {
                 iobuf_arena = trav;
                 break;
@@ -576,29 +989,32 @@ iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
 {
         struct iobuf       *iobuf        = NULL;
         struct iobuf_arena *iobuf_arena  = NULL;
+        struct iobuf_cache *cache        = NULL;
         size_t              rounded_size = 0;
 
         if (page_size == 0) {
                 page_size = iobuf_pool->default_page_size;
         }
 
-        rounded_size = gf_iobuf_get_pagesize (page_size);
-        if (rounded_size == -1) {
-                /* make sure to provide the requested buffer with standard
-                   memory allocations */
-                iobuf = iobuf_get_from_stdalloc (iobuf_pool, page_size);
-
-                gf_log ("iobuf", GF_LOG_DEBUG, "request for iobuf of size %zu "
-                        "is serviced using standard calloc() (%p) as it "
-                        "exceeds the maximum available buffer size",
-                        page_size, iobuf);
-
-                iobuf_pool->request_misses++;
-                return iobuf;
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache) {
+                rounded_size = iobuf_cache_pagesize (cache, page_size);
+                if (rounded_size != -1)
+                        iobuf = iobuf_get_from_cache (iobuf_pool, cache,
+                                                      rounded_size);
+                if (iobuf)
+                        return iobuf;
         }
 
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
+                /* the page sizes may have changed since the cache looked */
+                rounded_size = gf_iobuf_get_pagesize (iobuf_pool, page_size);
+                if (rounded_size == -1) {
+                        iobuf_pool->request_misses++;
+                        goto unlock;
+                }
+
                 /* most eligible arena for picking an iobuf */
                 iobuf_arena = __iobuf_select_arena (iobuf_pool, rounded_size);
                 if (!iobuf_arena)
@@ -613,6 +1029,17 @@ iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
 unlock:
         pthread_mutex_unlock (&iobuf_pool->mutex);
 
+        if (rounded_size == -1) {
+                /* make sure to provide the requested buffer with standard
+                   memory allocations */
+                iobuf = iobuf_get_from_stdalloc (iobuf_pool, page_size);
+
+                gf_log ("iobuf", GF_LOG_DEBUG, "request for iobuf of size %zu "
+                        "is serviced using standard calloc() (%p) as it "
+                        "exceeds the maximum available buffer size",
+                        page_size, iobuf);
+        }
+
         return iobuf;
 }
 
@@ -621,9 +1048,17 @@ iobuf_get (struct iobuf_pool *iobuf_pool)
 {
         struct iobuf       *iobuf        = NULL;
         struct iobuf_arena *iobuf_arena  = NULL;
+        struct iobuf_cache *cache        = NULL;
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
 
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache)
+                iobuf = iobuf_get_from_cache (iobuf_pool, cache,
+                                              iobuf_pool->default_page_size);
+        if (iobuf)
+                goto out;
+
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
                 /* most eligible arena for picking an iobuf */
@@ -661,7 +1096,8 @@ __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 
         iobuf_pool = iobuf_arena->iobuf_pool;
 
-        index = gf_iobuf_get_arena_index (iobuf_arena->page_size);
+        index = gf_iobuf_get_arena_index (iobuf_pool,
+                                          iobuf_arena->page_size);
         if (index == -1) {
                 gf_log ("iobuf", GF_LOG_DEBUG, "freeing the iobuf (%p) "
                         "allocated with standard calloc()", iobuf);
@@ -702,6 +1138,12 @@ iobuf_put (struct iobuf *iobuf)
 
         GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
 
+        if (iobuf->pipe_backed) {
+                close (iobuf->pipe_fd);
+                iobuf->pipe_backed = _gf_false;
+                iobuf->pipe_fd = -1;
+        }
+
         iobuf_arena = iobuf->iobuf_arena;
         if (!iobuf_arena) {
                 gf_log (THIS->name, GF_LOG_WARNING, "arena not found");
@@ -714,6 +1156,9 @@ iobuf_put (struct iobuf *iobuf)
                 return;
         }
 
+        if (iobuf_put_to_cache (iobuf_pool, iobuf) == 0)
+                return;
+
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
                 __iobuf_put (iobuf, iobuf_arena);
@@ -913,6 +1358,173 @@ out:
 }
 
 
+/* hand the read end of a pipe holding the first @len bytes of the payload
+   to @iobuf, which owns it from now on */
+int
+iobuf_set_pipe_backing (struct iobuf *iobuf, int pipe_fd, size_t len)
+{
+        int  ret = -EINVAL;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
+
+        if (len > iobuf_size (iobuf))
+                goto out;
+
+        LOCK (&iobuf->lock);
+        {
+                if (iobuf->pipe_backed)
+                        close (iobuf->pipe_fd);
+
+                iobuf->pipe_fd     = pipe_fd;
+                iobuf->pipe_off    = 0;
+                iobuf->pipe_len    = len;
+                iobuf->pipe_backed = _gf_true;
+        }
+        UNLOCK (&iobuf->lock);
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+/* copy what is left in the pipe into ->ptr. the pipe only holds pages
+   which are in memory already, this never waits for a disk. */
+int
+__iobuf_materialize (struct iobuf *iobuf)
+{
+        ssize_t  size = 0;
+        int      ret = 0;
+
+        while (iobuf->pipe_off < iobuf->pipe_len) {
+                size = read (iobuf->pipe_fd, iobuf->ptr + iobuf->pipe_off,
+                             iobuf->pipe_len - iobuf->pipe_off);
+                if (size == -1 && errno == EINTR)
+                        continue;
+                if (size == -1) {
+                        ret = -errno;
+                        break;
+                }
+                if (size == 0) {
+                        ret = -EIO;
+                        break;
+                }
+                iobuf->pipe_off += size;
+        }
+
+        close (iobuf->pipe_fd);
+        iobuf->pipe_fd = -1;
+        iobuf->pipe_backed = _gf_false;
+
+        if (ret)
+                gf_log ("iobuf", GF_LOG_WARNING, "reading in pipe-backed "
+                        "iobuf (%p) failed: %s", iobuf, strerror (-ret));
+        return ret;
+}
+
+
+int
+iobuf_materialize (struct iobuf *iobuf)
+{
+        int      ret  = 0;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf, out);
+
+        LOCK (&iobuf->lock);
+        {
+                if (iobuf->pipe_backed)
+                        ret = __iobuf_materialize (iobuf);
+        }
+        UNLOCK (&iobuf->lock);
+
+out:
+        return ret;
+}
+
+
+int
+iobref_materialize (struct iobref *iobref)
+{
+        int  i = 0;
+        int  ret = 0;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
+
+        LOCK (&iobref->lock);
+        {
+                for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
+                        if (!iobref->iobrefs[i])
+                                break;
+
+                        ret = iobuf_materialize (iobref->iobrefs[i]);
+                        if (ret)
+                                break;
+                }
+        }
+        UNLOCK (&iobref->lock);
+
+out:
+        return ret;
+}
+
+
+gf_boolean_t
+iobref_is_pipe_backed (struct iobref *iobref)
+{
+        int           i = 0;
+        gf_boolean_t  pipe_backed = _gf_false;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
+
+        LOCK (&iobref->lock);
+        {
+                for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
+                        if (!iobref->iobrefs[i])
+                                break;
+
+                        if (iobref->iobrefs[i]->pipe_backed) {
+                                pipe_backed = _gf_true;
+                                break;
+                        }
+                }
+        }
+        UNLOCK (&iobref->lock);
+
+out:
+        return pipe_backed;
+}
+
+
+struct iobuf *
+iobref_pipe_backed_iobuf (struct iobref *iobref, void *ptr)
+{
+        int           i = 0;
+        struct iobuf *iobuf = NULL;
+        struct iobuf *trav = NULL;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobref, out);
+
+        LOCK (&iobref->lock);
+        {
+                for (i = 0; i < GF_IOBREF_IOBUF_COUNT; i++) {
+                        trav = iobref->iobrefs[i];
+                        if (!trav)
+                                break;
+
+                        if (trav->pipe_backed && (ptr >= trav->ptr) &&
+                            (ptr < (trav->ptr + trav->pipe_len))) {
+                                iobuf = trav;
+                                break;
+                        }
+                }
+        }
+        UNLOCK (&iobref->lock);
+
+out:
+        return iobuf;
+}
+
+
 size_t
 iobuf_size (struct iobuf *iobuf)
 {
@@ -979,6 +1591,10 @@ iobuf_info_dump (struct iobuf *iobuf, const char *key_prefix)
         gf_proc_dump_write(key, "%d", my_iobuf.ref);
         gf_proc_dump_build_key(key, key_prefix,"ptr");
         gf_proc_dump_write(key, "%p", my_iobuf.ptr);
+        if (my_iobuf.pipe_backed) {
+                gf_proc_dump_build_key(key, key_prefix,"pipe_len");
+                gf_proc_dump_write(key, "%zu", my_iobuf.pipe_len);
+        }
 
 out:
         return;
@@ -1044,7 +1660,10 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
         gf_proc_dump_write("iobuf_pool.request_misses", "%"PRId64,
                            iobuf_pool->request_misses);
 
-        for (j = 0; j < IOBUF_ARENA_MAX_INDEX; j++) {
+        gf_proc_dump_write("iobuf_pool.hugepages", "%d",
+                           iobuf_pool->hugepages);
+
+        for (j = 0; j < iobuf_pool->config_cnt; j++) {
                 list_for_each_entry (trav, &iobuf_pool->arenas[j], list) {
                         snprintf(msg, sizeof(msg),
                                  "arena.%d", i);
@@ -1088,3 +1707,307 @@ iobuf_to_iovec(struct iobuf *iob, struct iovec *iov)
 out:
         return;
 }
+
+
+static int
+__iobuf_pool_page_size_busy (struct iobuf_pool *iobuf_pool, int index)
+{
+        struct iobuf_arena *trav = NULL;
+
+        if (!list_empty (&iobuf_pool->filled[index]))
+                return 1;
+
+        list_for_each_entry (trav, &iobuf_pool->arenas[index], list) {
+                if (trav->active_cnt)
+                        return 1;
+        }
+
+        return 0;
+}
+
+
+static int
+iobuf_config_insert (struct iobuf_init_config *config, int *count,
+                     size_t pagesize, int32_t num_pages)
+{
+        int i = 0;
+        int j = 0;
+
+        for (i = 0; i < *count; i++) {
+                if (config[i].pagesize == pagesize) {
+                        config[i].num_pages = num_pages;
+                        return 0;
+                }
+                if (config[i].pagesize > pagesize)
+                        break;
+        }
+
+        if (*count == GF_VARIABLE_IOBUF_COUNT - 1)
+                return -1;
+
+        for (j = *count; j > i; j--)
+                config[j] = config[j - 1];
+
+        config[i].pagesize = pagesize;
+        config[i].num_pages = num_pages;
+        (*count)++;
+
+        return 0;
+}
+
+
+static void
+__iobuf_pool_rehash_arenas (struct iobuf_pool *iobuf_pool,
+                            struct list_head *from, struct list_head *to)
+{
+        struct iobuf_arena *iobuf_arena = NULL;
+        struct iobuf_arena *tmp         = NULL;
+        int                 index       = 0;
+
+        list_for_each_entry_safe (iobuf_arena, tmp, from, list) {
+                index = gf_iobuf_get_arena_index (iobuf_pool,
+                                                  iobuf_arena->page_size);
+                if (index == -1 ||
+                    iobuf_pool->config[index].pagesize !=
+                    iobuf_arena->page_size) {
+                        /* page size went away, only idle arenas get here */
+                        list_del_init (&iobuf_arena->list);
+                        iobuf_pool->arena_cnt--;
+                        __iobuf_arena_destroy (iobuf_arena);
+                        continue;
+                }
+
+                list_move_tail (&iobuf_arena->list, &to[index]);
+        }
+}
+
+
+/* Makes @config (@count sizes, sorted) the page sizes of the pool. Page
+ * sizes which still have iobufs in use are kept.
+ */
+static int
+iobuf_pool_set_config (struct iobuf_pool *iobuf_pool,
+                       struct iobuf_init_config *config, int count)
+{
+        struct list_head          arenas, filled, purge;
+        struct iobuf_cache       *cache = NULL;
+        size_t                    arena_size = 0;
+        int                       i = 0;
+        int                       ret = -1;
+
+        if (!count || config[count - 1].pagesize <
+            iobuf_pool->default_page_size) {
+                gf_log ("iobuf", GF_LOG_ERROR, "page sizes do not cover the "
+                        "default page size %zu",
+                        iobuf_pool->default_page_size);
+                goto out;
+        }
+
+        INIT_LIST_HEAD (&arenas);
+        INIT_LIST_HEAD (&filled);
+        INIT_LIST_HEAD (&purge);
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                /* iobufs parked in the thread caches are not in use, they
+                   must not keep their page sizes alive */
+                __iobuf_pool_flush_caches (iobuf_pool);
+
+                for (i = 0; i < iobuf_pool->config_cnt; i++) {
+                        if (!__iobuf_pool_page_size_busy (iobuf_pool, i))
+                                continue;
+
+                        /* keeps the entry if the page size is listed */
+                        if (iobuf_config_insert
+                            (config, &count, iobuf_pool->config[i].pagesize,
+                             iobuf_pool->config[i].num_pages)) {
+                                gf_log ("iobuf", GF_LOG_ERROR, "too many page "
+                                        "sizes with the ones in use");
+                                goto unlock;
+                        }
+                }
+
+                /* nothing to do */
+                if (count == iobuf_pool->config_cnt &&
+                    !memcmp (config, iobuf_pool->config,
+                             count * sizeof (*config))) {
+                        ret = 1;
+                        goto unlock;
+                }
+
+                for (i = 0; i < iobuf_pool->config_cnt; i++) {
+                        list_splice_init (&iobuf_pool->arenas[i], &arenas);
+                        list_splice_init (&iobuf_pool->filled[i], &filled);
+                        list_splice_init (&iobuf_pool->purge[i], &purge);
+                }
+
+                memcpy (iobuf_pool->config, config,
+                        count * sizeof (*config));
+                iobuf_pool->config_cnt = count;
+
+                __iobuf_pool_rehash_arenas (iobuf_pool, &arenas,
+                                            iobuf_pool->arenas);
+                __iobuf_pool_rehash_arenas (iobuf_pool, &filled,
+                                            iobuf_pool->filled);
+                __iobuf_pool_rehash_arenas (iobuf_pool, &purge,
+                                            iobuf_pool->purge);
+
+                /* the caches index by page size */
+                list_for_each_entry (cache, &iobuf_pool->caches, list) {
+                        LOCK (&cache->lock);
+                        {
+                                __iobuf_cache_sync (cache, iobuf_pool);
+                        }
+                        UNLOCK (&cache->lock);
+                }
+
+                for (i = 0; i < count; i++)
+                        arena_size += config[i].pagesize * config[i].num_pages;
+                iobuf_pool->arena_size = arena_size;
+
+                ret = 0;
+        }
+unlock:
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+out:
+        return ret;
+}
+
+
+/* Replace the page sizes of the pool with @page_sizes, a comma separated
+ * list of <page-size>[:<pages-per-arena>] entries (eg. "4KB:256,128KB:32").
+ * Page sizes which still have iobufs in use are kept.
+ */
+int
+iobuf_pool_set_page_sizes (struct iobuf_pool *iobuf_pool,
+                           const char *page_sizes)
+{
+        struct iobuf_init_config  config[GF_VARIABLE_IOBUF_COUNT - 1];
+        char                     *dup_str = NULL;
+        char                     *entry = NULL;
+        char                     *saveptr = NULL;
+        char                     *count_str = NULL;
+        uint64_t                  pagesize = 0;
+        int32_t                   num_pages = 0;
+        int                       count = 0;
+        int                       ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
+        GF_VALIDATE_OR_GOTO ("iobuf", page_sizes, out);
+
+        dup_str = gf_strdup (page_sizes);
+        if (!dup_str)
+                goto out;
+
+        for (entry = strtok_r (dup_str, ", ", &saveptr); entry;
+             entry = strtok_r (NULL, ", ", &saveptr)) {
+                num_pages = 8;
+
+                count_str = strchr (entry, ':');
+                if (count_str) {
+                        *count_str++ = '\0';
+                        if (gf_string2int32 (count_str, &num_pages) ||
+                            num_pages <= 0) {
+                                gf_log ("iobuf", GF_LOG_ERROR, "invalid page "
+                                        "count '%s'", count_str);
+                                goto out;
+                        }
+                }
+
+                if (gf_string2bytesize (entry, &pagesize) || !pagesize) {
+                        gf_log ("iobuf", GF_LOG_ERROR, "invalid page size "
+                                "'%s'", entry);
+                        goto out;
+                }
+
+                if (iobuf_config_insert (config, &count, pagesize,
+                                         num_pages)) {
+                        gf_log ("iobuf", GF_LOG_ERROR, "too many page sizes "
+                                "(max %d)", GF_VARIABLE_IOBUF_COUNT - 1);
+                        goto out;
+                }
+        }
+
+        ret = iobuf_pool_set_config (iobuf_pool, config, count);
+        if (!ret)
+                gf_log ("iobuf", GF_LOG_INFO, "iobuf page sizes set to '%s' "
+                        "(%d sizes)", page_sizes, count);
+        if (ret > 0)
+                ret = 0;
+out:
+        GF_FREE (dup_str);
+
+        return ret;
+}
+
+
+/* Back to the page sizes a new pool starts with */
+int
+iobuf_pool_reset_page_sizes (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_init_config  config[GF_VARIABLE_IOBUF_COUNT - 1];
+        int                       ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
+
+        memcpy (config, gf_iobuf_init_config, sizeof (gf_iobuf_init_config));
+
+        ret = iobuf_pool_set_config (iobuf_pool, config,
+                                     IOBUF_ARENA_MAX_INDEX);
+        if (!ret)
+                gf_log ("iobuf", GF_LOG_INFO, "iobuf page sizes set back to "
+                        "the defaults");
+        if (ret > 0)
+                ret = 0;
+out:
+        return ret;
+}
+
+
+/* Applies the "iobuf-page-sizes" and "iobuf-hugepages" options of an
+ * xlator, options not given go back to their defaults.
+ */
+void
+iobuf_pool_reconfigure (struct iobuf_pool *iobuf_pool, dict_t *options,
+                        const char *name)
+{
+        char         *page_sizes = NULL;
+        gf_boolean_t  hugepages = _gf_false;
+
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
+        GF_VALIDATE_OR_GOTO ("iobuf", options, out);
+
+        if (dict_get_str (options, "iobuf-page-sizes", &page_sizes) == 0) {
+                if (iobuf_pool_set_page_sizes (iobuf_pool, page_sizes))
+                        gf_log (name, GF_LOG_WARNING, "invalid "
+                                "iobuf-page-sizes '%s', keeping the current "
+                                "page sizes", page_sizes);
+        } else {
+                iobuf_pool_reset_page_sizes (iobuf_pool);
+        }
+
+        if (dict_get_str_boolean (options, "iobuf-hugepages", _gf_false) > 0)
+                hugepages = _gf_true;
+
+        iobuf_pool_set_hugepages (iobuf_pool, hugepages);
+out:
+        return;
+}
+
+
+void
+iobuf_pool_set_hugepages (struct iobuf_pool *iobuf_pool,
+                          gf_boolean_t hugepages)
+{
+        GF_VALIDATE_OR_GOTO ("iobuf", iobuf_pool, out);
+
+        /* applies to the arenas allocated from now on */
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                iobuf_pool->hugepages = hugepages;
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+out:
+        return;
+}
@@ -13,6 +13,7 @@
 
 #include "list.h"
 #include "common-utils.h"
+#include "dict.h"
 #include <pthread.h>
 #include <sys/mman.h>
 #include <sys/uio.h>
@@ -36,6 +37,13 @@
 
 #define GF_IOBUF_ALIGN_SIZE 512
 
+/* arenas of at least this size can be backed by huge pages */
+#define GF_IOBUF_HUGEPAGE_SIZE (2 * GF_UNIT_MB)
+
+/* iobufs a thread may keep for itself, per page size and in bytes */
+#define GF_IOBUF_CACHE_COUNT 16
+#define GF_IOBUF_CACHE_BYTES (512 * GF_UNIT_KB)
+
 /* one allocatable unit for the consumers of the IOBUF API */
 /* each unit hosts @page_size bytes of memory */
 struct iobuf;
@@ -70,6 +78,15 @@ struct iobuf {
 
         void                *free_ptr; /* in case of stdalloc, this is the
                                           one to be freed */
+
+        /* pipe-backed iobufs: the payload has not been copied into ->ptr,
+           it sits in the pipe pipe_fd (the read end, closed when the iobuf
+           is put) as references to page cache pages. pipe_off of the
+           pipe_len bytes have been consumed from the pipe already */
+        gf_boolean_t         pipe_backed;
+        int                  pipe_fd;
+        size_t               pipe_off;
+        size_t               pipe_len;
 };
 
 
@@ -123,6 +140,14 @@ struct iobuf_pool {
 
         uint64_t            request_misses; /* mostly the requests for higher
                                                value of iobufs */
+
+        struct iobuf_init_config config[GF_VARIABLE_IOBUF_COUNT - 1];
+        int                 config_cnt; /* number of page sizes, sorted */
+        gf_boolean_t        hugepages;  /* back big arenas by huge pages */
+
+        pthread_key_t       cache_key;  /* per-thread iobuf cache */
+        int                 cache_key_valid;
+        struct list_head    caches;     /* of all threads, to flush them */
 };
 
 
@@ -133,6 +158,13 @@ void iobuf_unref (struct iobuf *iobuf);
 struct iobuf *iobuf_ref (struct iobuf *iobuf);
 void iobuf_pool_destroy (struct iobuf_pool *iobuf_pool);
 void iobuf_to_iovec(struct iobuf *iob, struct iovec *iov);
+int iobuf_pool_set_page_sizes (struct iobuf_pool *iobuf_pool,
+                               const char *page_sizes);
+void iobuf_pool_set_hugepages (struct iobuf_pool *iobuf_pool,
+                               gf_boolean_t hugepages);
+int iobuf_pool_reset_page_sizes (struct iobuf_pool *iobuf_pool);
+void iobuf_pool_reconfigure (struct iobuf_pool *iobuf_pool, dict_t *options,
+                             const char *name);
 
 #define iobuf_ptr(iob) ((iob)->ptr)
 #define iobpool_default_pagesize(iobpool) ((iobpool)->default_page_size)
@@ -151,6 +183,13 @@ void iobref_unref (struct iobref *iobref);
 int iobref_add (struct iobref *iobref, struct iobuf *iobuf);
 int iobref_merge (struct iobref *to, struct iobref *from);
 
+int iobuf_set_pipe_backing (struct iobuf *iobuf, int pipe_fd, size_t len);
+int __iobuf_materialize (struct iobuf *iobuf);
+int iobuf_materialize (struct iobuf *iobuf);
+int iobref_materialize (struct iobref *iobref);
+gf_boolean_t iobref_is_pipe_backed (struct iobref *iobref);
+struct iobuf *iobref_pipe_backed_iobuf (struct iobref *iobref, void *ptr);
+
 
 size_t iobuf_size (struct iobuf *iobuf);
 size_t iobref_size (struct iobref *iobref);
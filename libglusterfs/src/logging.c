@@ -21,11 +21,13 @@
 #include <locale.h>
 #include <string.h>
 #include <stdlib.h>
+#include <signal.h>
 
 #include "xlator.h"
 #include "logging.h"
 #include "defaults.h"
 #include "glusterfs.h"
+#include "statedump.h"
 
 #ifdef GF_LINUX_HOST_OS
 #include <syslog.h>
@@ -45,6 +47,619 @@ struct _log_msg {
         struct list_head queue;
 };
 
+/*
+ * Every thread that logs gets its own single-producer ring. The thread
+ * formats the message, copies it into the ring and goes on; the writer
+ * thread is the only consumer and does the file and syslog I/O. A ring
+ * that is full drops the message (and counts it), unless the message is
+ * an error or worse, which is written synchronously instead. Records carry
+ * a process-wide sequence number, by which the writer merges the rings.
+ */
+
+struct gf_log_rec {
+        uint32_t          size;    /* bytes taken in the ring */
+        uint32_t          len;     /* 0 for the padding before a wrap */
+        uint64_t          seq;
+        gf_loglevel_t     level;
+        glusterfs_ctx_t  *ctx;
+        char              msg[];
+};
+
+#define GF_LOG_REC_SIZE(len)                                            \
+        ((sizeof (struct gf_log_rec) + (len) + 1 + 7) & ~((size_t)7))
+
+struct gf_log_ring {
+        struct list_head  list;
+        char             *buf;
+        uint64_t          head;      /* advanced by the owning thread */
+        uint64_t          tail;      /* advanced by the drainer */
+        uint64_t          limit;     /* head when the drain started */
+        uint64_t          dropped;   /* bumped by the owning thread */
+        uint64_t          reported;  /* drops already logged */
+        glusterfs_ctx_t  *ctx;       /* where to report the drops */
+        int               dead;      /* owning thread has exited */
+};
+
+enum {
+        GF_LOG_WRITER_IDLE,
+        GF_LOG_WRITER_RUNNING,
+        GF_LOG_WRITER_STOPPED,
+};
+
+static pthread_key_t    gf_log_ring_key;
+static pthread_once_t   gf_log_ring_once = PTHREAD_ONCE_INIT;
+
+/* protects the list of rings and makes the drainer a single consumer */
+static pthread_mutex_t  gf_log_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct list_head gf_log_rings = {&gf_log_rings, &gf_log_rings};
+static uint32_t         gf_log_ring_count;
+
+/* writer thread state, wakeups go through the mutex */
+static pthread_mutex_t  gf_log_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   gf_log_writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t        gf_log_writer_thread;
+static int              gf_log_writer_state;
+static int              gf_log_writer_sleeping;
+static int              gf_log_writer_kicked;
+static int              gf_log_writer_stop;
+
+static uint64_t         gf_log_seq;
+static int              gf_log_crashed;
+static uint64_t         gf_log_dropped;
+static uint64_t         gf_log_written;
+
+static char *level_strings[] = {"",  /* NONE */
+                                "M", /* EMERGENCY */
+                                "A", /* ALERT */
+                                "C", /* CRITICAL */
+                                "E", /* ERROR */
+                                "W", /* WARNING */
+                                "N", /* NOTICE */
+                                "I", /* INFO */
+                                "D", /* DEBUG */
+                                "T", /* TRACE */
+                                ""};
+
+
+static void
+__gf_log_rotate (glusterfs_ctx_t *ctx)
+{
+        FILE  *new_logfile = NULL;
+        FILE  *errfile = NULL;
+        int    fd = -1;
+
+        ctx->log.logrotate = 0;
+
+        if (!ctx->log.filename)
+                return;
+
+        errfile = ctx->log.logfile ? ctx->log.logfile : stderr;
+
+        fd = open (ctx->log.filename, O_CREAT | O_RDONLY, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+                fprintf (errfile, "logrotate: failed to create logfile %s "
+                         "(%s)\n", ctx->log.filename, strerror (errno));
+                return;
+        }
+        close (fd);
+
+        new_logfile = fopen (ctx->log.filename, "a");
+        if (!new_logfile) {
+                fprintf (errfile, "logrotate: failed to open logfile %s "
+                         "(%s)\n", ctx->log.filename, strerror (errno));
+                return;
+        }
+
+        if (ctx->log.logfile)
+                fclose (ctx->log.logfile);
+
+        ctx->log.gf_log_logfile = ctx->log.logfile = new_logfile;
+}
+
+
+static int
+gf_log_file_lock (glusterfs_ctx_t *ctx)
+{
+        /* after a crash the lock may be held by the thread that died */
+        if (gf_log_crashed)
+                return (pthread_mutex_trylock (&ctx->log.logfile_mutex) == 0);
+
+        pthread_mutex_lock (&ctx->log.logfile_mutex);
+        return 1;
+}
+
+
+static void
+gf_log_emit (glusterfs_ctx_t *ctx, gf_loglevel_t level, const char *msg,
+             gf_boolean_t flush)
+{
+        int  locked = 0;
+
+        locked = gf_log_file_lock (ctx);
+        {
+                if (ctx->log.logrotate && locked)
+                        __gf_log_rotate (ctx);
+
+                if (ctx->log.logfile) {
+                        fprintf (ctx->log.logfile, "%s\n", msg);
+                        if (flush)
+                                fflush (ctx->log.logfile);
+                } else {
+                        fprintf (stderr, "%s\n", msg);
+                }
+
+#ifdef GF_LINUX_HOST_OS
+                /* We want only serious log in 'syslog', not our debug
+                   and trace logs */
+                if (ctx->log.gf_log_syslog && level &&
+                    (level <= ctx->log.sys_log_level))
+                        syslog ((level-1), "%s\n", msg);
+#endif
+        }
+        if (locked)
+                pthread_mutex_unlock (&ctx->log.logfile_mutex);
+}
+
+
+static void
+gf_log_flush_file (glusterfs_ctx_t *ctx)
+{
+        if (!gf_log_file_lock (ctx))
+                return;
+        {
+                if (ctx->log.logfile)
+                        fflush (ctx->log.logfile);
+        }
+        pthread_mutex_unlock (&ctx->log.logfile_mutex);
+}
+
+
+static void
+gf_log_report_drops (struct gf_log_ring *ring)
+{
+        char            msg[256]     = {0,};
+        char            timestr[256] = {0,};
+        struct timeval  tv           = {0,};
+        uint64_t        dropped      = 0;
+
+        dropped = __atomic_load_n (&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped == ring->reported || !ring->ctx)
+                return;
+
+        gettimeofday (&tv, NULL);
+        gf_time_fmt (timestr, sizeof timestr, tv.tv_sec, gf_timefmt_FT);
+        snprintf (timestr + strlen (timestr), sizeof timestr - strlen (timestr),
+                  ".%"GF_PRI_SUSECONDS, tv.tv_usec);
+
+        snprintf (msg, sizeof msg, "[%s] W [logging.c] 0-logging: "
+                  "%"PRIu64" messages dropped, log buffer was full",
+                  timestr, dropped - ring->reported);
+        ring->reported = dropped;
+
+        gf_log_emit (ring->ctx, GF_LOG_WARNING, msg, _gf_false);
+}
+
+
+/* the oldest message of @ring up to ring->limit, NULL if there is none */
+static struct gf_log_rec *
+gf_log_ring_peek (struct gf_log_ring *ring)
+{
+        struct gf_log_rec *rec  = NULL;
+        uint64_t           tail = 0;
+
+        tail = ring->tail;
+
+        while (tail != ring->limit) {
+                rec = (struct gf_log_rec *)
+                        (ring->buf + (tail % GF_LOG_RING_SIZE));
+                if (rec->len)
+                        return rec;
+
+                /* padding before a wrap */
+                tail += rec->size;
+                __atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+
+        return NULL;
+}
+
+
+static void
+gf_log_ring_free (struct gf_log_ring *ring)
+{
+        FREE (ring->buf);
+        FREE (ring);
+}
+
+
+static int
+__gf_log_drain_all (void)
+{
+        struct gf_log_ring *ring  = NULL;
+        struct gf_log_ring *tmp   = NULL;
+        struct gf_log_ring *next  = NULL;
+        struct gf_log_rec  *rec   = NULL;
+        struct gf_log_rec  *oldest = NULL;
+        glusterfs_ctx_t    *last  = NULL;
+        int                 count = 0;
+
+        /* what is in the rings now, messages put meanwhile wait for the
+           next round so that this one ends */
+        list_for_each_entry (ring, &gf_log_rings, list)
+                ring->limit = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+
+        /* write the messages of all threads in the order they were put */
+        for (;;) {
+                next = NULL;
+                oldest = NULL;
+
+                list_for_each_entry (ring, &gf_log_rings, list) {
+                        rec = gf_log_ring_peek (ring);
+                        if (rec && (!oldest || rec->seq < oldest->seq)) {
+                                next = ring;
+                                oldest = rec;
+                        }
+                }
+
+                if (!next)
+                        break;
+
+                if (last && last != oldest->ctx)
+                        gf_log_flush_file (last);
+                last = oldest->ctx;
+
+                gf_log_emit (oldest->ctx, oldest->level, oldest->msg,
+                             _gf_false);
+                count++;
+
+                __atomic_store_n (&next->tail, next->tail + oldest->size,
+                                  __ATOMIC_RELEASE);
+        }
+
+        list_for_each_entry_safe (ring, tmp, &gf_log_rings, list) {
+                gf_log_report_drops (ring);
+
+                if (__atomic_load_n (&ring->dead, __ATOMIC_ACQUIRE) &&
+                    ring->tail == __atomic_load_n (&ring->head,
+                                                   __ATOMIC_ACQUIRE)) {
+                        list_del (&ring->list);
+                        gf_log_ring_count--;
+                        gf_log_ring_free (ring);
+                }
+        }
+
+        if (last)
+                gf_log_flush_file (last);
+
+        __atomic_add_fetch (&gf_log_written, count, __ATOMIC_RELAXED);
+
+        return count;
+}
+
+
+static int
+gf_log_drain_all (void)
+{
+        int  count = 0;
+
+        pthread_mutex_lock (&gf_log_ring_lock);
+        {
+                count = __gf_log_drain_all ();
+        }
+        pthread_mutex_unlock (&gf_log_ring_lock);
+
+        return count;
+}
+
+
+static void *
+gf_log_writer (void *data)
+{
+        for (;;) {
+                if (gf_log_drain_all () && !gf_log_writer_stop)
+                        continue;
+
+                if (gf_log_writer_stop)
+                        break;
+
+                /* pairs with the fence in gf_log_ring_put(): either the
+                   second drain sees the message or the producer sees us
+                   sleeping and kicks */
+                __atomic_store_n (&gf_log_writer_sleeping, 1,
+                                  __ATOMIC_SEQ_CST);
+                __atomic_thread_fence (__ATOMIC_SEQ_CST);
+
+                if (gf_log_drain_all ()) {
+                        __atomic_store_n (&gf_log_writer_sleeping, 0,
+                                          __ATOMIC_SEQ_CST);
+                        continue;
+                }
+
+                pthread_mutex_lock (&gf_log_writer_lock);
+                {
+                        /* a producer kicks whenever it sees us sleeping */
+                        while (!gf_log_writer_kicked && !gf_log_writer_stop)
+                                pthread_cond_wait (&gf_log_writer_cond,
+                                                   &gf_log_writer_lock);
+                        gf_log_writer_kicked = 0;
+                }
+                pthread_mutex_unlock (&gf_log_writer_lock);
+
+                __atomic_store_n (&gf_log_writer_sleeping, 0,
+                                  __ATOMIC_SEQ_CST);
+        }
+
+        return NULL;
+}
+
+
+static void
+gf_log_writer_kick (void)
+{
+        pthread_mutex_lock (&gf_log_writer_lock);
+        {
+                gf_log_writer_kicked = 1;
+                pthread_cond_signal (&gf_log_writer_cond);
+        }
+        pthread_mutex_unlock (&gf_log_writer_lock);
+}
+
+
+static void
+gf_log_ring_destroy (void *data)
+{
+        struct gf_log_ring *ring = data;
+
+        /* the writer frees it once it is drained */
+        __atomic_store_n (&ring->dead, 1, __ATOMIC_RELEASE);
+}
+
+
+static void
+gf_log_atfork_prepare (void)
+{
+        pthread_mutex_lock (&gf_log_ring_lock);
+        __gf_log_drain_all ();
+        pthread_mutex_lock (&gf_log_writer_lock);
+}
+
+
+static void
+gf_log_atfork_parent (void)
+{
+        pthread_mutex_unlock (&gf_log_writer_lock);
+        pthread_mutex_unlock (&gf_log_ring_lock);
+}
+
+
+static void
+gf_log_atfork_child (void)
+{
+        struct gf_log_ring *ring = NULL;
+        struct gf_log_ring *mine = NULL;
+
+        /* only the forking thread exists in the child, and there is no
+           writer until somebody logs again */
+        mine = pthread_getspecific (gf_log_ring_key);
+        list_for_each_entry (ring, &gf_log_rings, list) {
+                if (ring != mine)
+                        ring->dead = 1;
+        }
+
+        if (gf_log_writer_state == GF_LOG_WRITER_RUNNING)
+                gf_log_writer_state = GF_LOG_WRITER_IDLE;
+        gf_log_writer_sleeping = 0;
+        gf_log_writer_kicked = 0;
+
+        pthread_mutex_unlock (&gf_log_writer_lock);
+        pthread_mutex_unlock (&gf_log_ring_lock);
+}
+
+
+static void
+gf_log_ring_key_init (void)
+{
+        if (pthread_key_create (&gf_log_ring_key, gf_log_ring_destroy) != 0) {
+                gf_log_writer_state = GF_LOG_WRITER_STOPPED;
+                return;
+        }
+
+        pthread_atfork (gf_log_atfork_prepare, gf_log_atfork_parent,
+                        gf_log_atfork_child);
+        atexit (gf_log_flush);
+}
+
+
+static void
+gf_log_writer_start (void)
+{
+        sigset_t  set;
+        sigset_t  old;
+        int       ret = -1;
+
+        pthread_once (&gf_log_ring_once, gf_log_ring_key_init);
+
+        pthread_mutex_lock (&gf_log_writer_lock);
+        {
+                if (gf_log_writer_state != GF_LOG_WRITER_IDLE)
+                        goto unlock;
+
+                gf_log_writer_stop = 0;
+
+                /* signals are for the threads that wait for them */
+                sigfillset (&set);
+                pthread_sigmask (SIG_BLOCK, &set, &old);
+                ret = pthread_create (&gf_log_writer_thread, NULL,
+                                      gf_log_writer, NULL);
+                pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+                gf_log_writer_state = ret ? GF_LOG_WRITER_STOPPED
+                                          : GF_LOG_WRITER_RUNNING;
+        }
+unlock:
+        pthread_mutex_unlock (&gf_log_writer_lock);
+}
+
+
+static struct gf_log_ring *
+gf_log_ring_get (gf_boolean_t may_alloc)
+{
+        struct gf_log_ring *ring = NULL;
+
+        ring = pthread_getspecific (gf_log_ring_key);
+        if (ring || !may_alloc)
+                return ring;
+
+        ring = CALLOC (1, sizeof (*ring));
+        if (!ring)
+                return NULL;
+
+        ring->buf = MALLOC (GF_LOG_RING_SIZE);
+        if (!ring->buf) {
+                FREE (ring);
+                return NULL;
+        }
+
+        if (pthread_setspecific (gf_log_ring_key, ring) != 0) {
+                gf_log_ring_free (ring);
+                return NULL;
+        }
+
+        pthread_mutex_lock (&gf_log_ring_lock);
+        {
+                list_add_tail (&ring->list, &gf_log_rings);
+                gf_log_ring_count++;
+        }
+        pthread_mutex_unlock (&gf_log_ring_lock);
+
+        return ring;
+}
+
+
+static int
+gf_log_ring_put (struct gf_log_ring *ring, glusterfs_ctx_t *ctx,
+                 gf_loglevel_t level, const char *msg, size_t len)
+{
+        struct gf_log_rec *rec  = NULL;
+        uint64_t           head = 0;
+        uint64_t           tail = 0;
+        size_t             need = 0;
+        size_t             room = 0;
+        size_t             pad  = 0;
+
+        need = GF_LOG_REC_SIZE (len);
+        if (need > GF_LOG_RING_SIZE / 2)
+                return -E2BIG;
+
+        head = ring->head;
+        tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+
+        /* a record never wraps, pad up to the end of the buffer instead */
+        room = GF_LOG_RING_SIZE - (head % GF_LOG_RING_SIZE);
+        if (room < need)
+                pad = room;
+
+        if (GF_LOG_RING_SIZE - (head - tail) < need + pad)
+                return -ENOSPC;
+
+        if (pad) {
+                rec = (struct gf_log_rec *)
+                        (ring->buf + (head % GF_LOG_RING_SIZE));
+                rec->size = pad;
+                rec->len = 0;
+                head += pad;
+        }
+
+        rec = (struct gf_log_rec *)(ring->buf + (head % GF_LOG_RING_SIZE));
+        rec->size = need;
+        rec->len = len;
+        rec->seq = __atomic_fetch_add (&gf_log_seq, 1, __ATOMIC_RELAXED);
+        rec->level = level;
+        rec->ctx = ctx;
+        memcpy (rec->msg, msg, len);
+        rec->msg[len] = '\0';
+
+        ring->ctx = ctx;
+        __atomic_store_n (&ring->head, head + need, __ATOMIC_RELEASE);
+
+        __atomic_thread_fence (__ATOMIC_SEQ_CST);
+        if (__atomic_load_n (&gf_log_writer_sleeping, __ATOMIC_SEQ_CST))
+                gf_log_writer_kick ();
+
+        return 0;
+}
+
+
+static void
+gf_log_submit (glusterfs_ctx_t *ctx, gf_loglevel_t level, const char *msg,
+               size_t len, gf_boolean_t may_alloc)
+{
+        struct gf_log_ring *ring = NULL;
+        int                 ret  = -1;
+
+        if (gf_log_writer_state == GF_LOG_WRITER_IDLE && may_alloc)
+                gf_log_writer_start ();
+
+        if (gf_log_writer_state == GF_LOG_WRITER_RUNNING) {
+                ring = gf_log_ring_get (may_alloc);
+                if (ring)
+                        ret = gf_log_ring_put (ring, ctx, level, msg, len);
+        }
+
+        if (ret == 0)
+                return;
+
+        if (ret == -ENOSPC && level > GF_LOG_ERROR) {
+                __atomic_add_fetch (&ring->dropped, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch (&gf_log_dropped, 1, __ATOMIC_RELAXED);
+                return;
+        }
+
+        /* no writer, message too large, or too important to drop */
+        gf_log_emit (ctx, level, msg, _gf_false);
+}
+
+
+void
+gf_log_flush (void)
+{
+        gf_log_drain_all ();
+}
+
+
+void
+gf_log_flush_on_crash (void)
+{
+        int  locked = 0;
+
+        gf_log_crashed = 1;
+
+        /* the crashing thread may be the one holding the lock */
+        locked = (pthread_mutex_trylock (&gf_log_ring_lock) == 0);
+        __gf_log_drain_all ();
+        if (locked)
+                pthread_mutex_unlock (&gf_log_ring_lock);
+}
+
+
+void
+gf_log_dump (void)
+{
+        static char *states[] = {"idle", "running", "stopped"};
+
+        gf_proc_dump_add_section ("logging");
+        gf_proc_dump_write ("writer", "%s", states[gf_log_writer_state]);
+        gf_proc_dump_write ("rings", "%u", gf_log_ring_count);
+        gf_proc_dump_write ("ring-size", "%d", GF_LOG_RING_SIZE);
+        gf_proc_dump_write ("written", "%"PRIu64,
+                            __atomic_load_n (&gf_log_written,
+                                             __ATOMIC_RELAXED));
+        gf_proc_dump_write ("dropped", "%"PRIu64,
+                            __atomic_load_n (&gf_log_dropped,
+                                             __ATOMIC_RELAXED));
+}
+
+
 void
 gf_log_logrotate (int signum)
 {
@@ -98,7 +713,24 @@ gf_log_set_xl_loglevel (void *this, gf_loglevel_t level)
 void
 gf_log_fini (void)
 {
-        pthread_mutex_destroy (&THIS->ctx->log.logfile_mutex);
+        int  running = 0;
+
+        pthread_mutex_lock (&gf_log_writer_lock);
+        {
+                running = (gf_log_writer_state == GF_LOG_WRITER_RUNNING);
+                gf_log_writer_state = GF_LOG_WRITER_STOPPED;
+                gf_log_writer_stop = 1;
+                pthread_cond_signal (&gf_log_writer_cond);
+        }
+        pthread_mutex_unlock (&gf_log_writer_lock);
+
+        if (running)
+                pthread_join (gf_log_writer_thread, NULL);
+
+        /* whatever got queued while the writer was stopping; from here on
+           every message is written synchronously, so the logfile mutex is
+           left alone for the threads that are still around */
+        gf_log_drain_all ();
 }
 
 
@@ -196,18 +828,6 @@ _gf_log_nomem (const char *domain, const char *file,
         if (level > ctx->log.loglevel)
                 goto out;
 
-        static char *level_strings[] = {"",  /* NONE */
-                                        "M", /* EMERGENCY */
-                                        "A", /* ALERT */
-                                        "C", /* CRITICAL */
-                                        "E", /* ERROR */
-                                        "W", /* WARNING */
-                                        "N", /* NOTICE */
-                                        "I", /* INFO */
-                                        "D", /* DEBUG */
-                                        "T", /* TRACE */
-                                        ""};
-
         if (!domain || !file || !function) {
                 fprintf (stderr,
                          "logging: %s:%s():%d: invalid argument\n",
@@ -263,24 +883,8 @@ _gf_log_nomem (const char *domain, const char *file,
                 goto out;
         }
 
-        pthread_mutex_lock (&ctx->log.logfile_mutex);
-        {
-                if (ctx->log.logfile) {
-                        fprintf (ctx->log.logfile, "%s\n", msg);
-                } else {
-                        fprintf (stderr, "%s\n", msg);
-                }
-
-#ifdef GF_LINUX_HOST_OS
-                /* We want only serious log in 'syslog', not our debug
-                   and trace logs */
-                if (ctx->log.gf_log_syslog && level &&
-                    (level <= ctx->log.sys_log_level))
-                        syslog ((level-1), "%s\n", msg);
-#endif
-        }
-
-        pthread_mutex_unlock (&ctx->log.logfile_mutex);
+        /* no allocation here, not even for this thread's ring */
+        gf_log_submit (ctx, level, msg, ret, _gf_false);
 out:
         return ret;
  }
@@ -312,18 +916,6 @@ _gf_log_callingfn (const char *domain, const char *file, const char *function,
         if (level > ctx->log.loglevel)
                 goto out;
 
-        static char *level_strings[] = {"",  /* NONE */
-                                        "M", /* EMERGENCY */
-                                        "A", /* ALERT */
-                                        "C", /* CRITICAL */
-                                        "E", /* ERROR */
-                                        "W", /* WARNING */
-                                        "N", /* NOTICE */
-                                        "I", /* INFO */
-                                        "D", /* DEBUG */
-                                        "T", /* TRACE */
-                                        ""};
-
         if (!domain || !file || !function || !fmt) {
                 fprintf (stderr,
                          "logging: %s:%s():%d: invalid argument\n",
@@ -392,24 +984,7 @@ _gf_log_callingfn (const char *domain, const char *file, const char *function,
         strcpy (msg, str1);
         strcpy (msg + len, str2);
 
-        pthread_mutex_lock (&ctx->log.logfile_mutex);
-        {
-                if (ctx->log.logfile) {
-                        fprintf (ctx->log.logfile, "%s\n", msg);
-                } else {
-                        fprintf (stderr, "%s\n", msg);
-                }
-
-#ifdef GF_LINUX_HOST_OS
-                /* We want only serious log in 'syslog', not our debug
-                   and trace logs */
-                if (ctx->log.gf_log_syslog && level &&
-                    (level <= ctx->log.sys_log_level))
-                        syslog ((level-1), "%s\n", msg);
-#endif
-        }
-
-        pthread_mutex_unlock (&ctx->log.logfile_mutex);
+        gf_log_submit (ctx, level, msg, strlen (msg), _gf_true);
 
 out:
         GF_FREE (msg);
@@ -426,16 +1001,14 @@ _gf_log (const char *domain, const char *file, const char *function, int line,
          gf_loglevel_t level, const char *fmt, ...)
 {
         const char    *basename = NULL;
-        FILE          *new_logfile = NULL;
         va_list        ap;
         char           timestr[256] = {0,};
+        char           buf[GF_LOG_MSG_INLINE];
         struct timeval tv = {0,};
-        char          *str1 = NULL;
-        char          *str2 = NULL;
-        char          *msg  = NULL;
-        size_t         len  = 0;
+        char          *msg  = buf;
+        int            hlen = 0;
+        int            mlen = 0;
         int            ret  = 0;
-        int            fd   = -1;
         xlator_t      *this = NULL;
         glusterfs_ctx_t *ctx = NULL;
 
@@ -449,18 +1022,6 @@ _gf_log (const char *domain, const char *file, const char *function, int line,
         if (level > ctx->log.loglevel)
                 goto out;
 
-        static char *level_strings[] = {"",  /* NONE */
-                                        "M", /* EMERGENCY */
-                                        "A", /* ALERT */
-                                        "C", /* CRITICAL */
-                                        "E", /* ERROR */
-                                        "W", /* WARNING */
-                                        "N", /* NOTICE */
-                                        "I", /* INFO */
-                                        "D", /* DEBUG */
-                                        "T", /* TRACE */
-                                        ""};
-
         if (!domain || !file || !function || !fmt) {
                 fprintf (stderr,
                          "logging: %s:%s():%d: invalid argument\n",
@@ -468,43 +1029,9 @@ _gf_log (const char *domain, const char *file, const char *function, int line,
                 return -1;
         }
 
-
-        if (ctx->log.logrotate) {
-                ctx->log.logrotate = 0;
-
-                fd = open (ctx->log.filename,
-                           O_CREAT | O_RDONLY, S_IRUSR | S_IWUSR);
-                if (fd < 0) {
-                        gf_log ("logrotate", GF_LOG_ERROR,
-                                "%s", strerror (errno));
-                        return -1;
-                }
-                close (fd);
-
-                new_logfile = fopen (ctx->log.filename, "a");
-                if (!new_logfile) {
-                        gf_log ("logrotate", GF_LOG_CRITICAL,
-                                "failed to open logfile %s (%s)",
-                                ctx->log.filename, strerror (errno));
-                        goto log;
-                }
-
-                pthread_mutex_lock (&ctx->log.logfile_mutex);
-                {
-                        if (ctx->log.logfile)
-                                fclose (ctx->log.logfile);
-
-                        ctx->log.gf_log_logfile = ctx->log.logfile = new_logfile;
-                }
-                pthread_mutex_unlock (&ctx->log.logfile_mutex);
-
-        }
-
-log:
         ret = gettimeofday (&tv, NULL);
         if (-1 == ret)
                 goto out;
-        va_start (ap, fmt);
         gf_time_fmt (timestr, sizeof timestr, tv.tv_sec, gf_timefmt_FT);
         snprintf (timestr + strlen (timestr), sizeof timestr - strlen (timestr),
                   ".%"GF_PRI_SUSECONDS, tv.tv_usec);
@@ -515,53 +1042,37 @@ log:
         else
                 basename = file;
 
-        ret = gf_asprintf (&str1, "[%s] %s [%s:%d:%s] %d-%s: ",
-                           timestr, level_strings[level],
-                           basename, line, function,
-                           ((this->graph)?this->graph->id:0), domain);
-        if (-1 == ret) {
-                goto err;
-        }
-
-        ret = vasprintf (&str2, fmt, ap);
-        if (-1 == ret) {
-                goto err;
-        }
+        hlen = snprintf (buf, sizeof buf, "[%s] %s [%s:%d:%s] %d-%s: ",
+                         timestr, level_strings[level],
+                         basename, line, function,
+                         ((this->graph)?this->graph->id:0), domain);
+        if (hlen < 0)
+                goto out;
+        if (hlen >= sizeof buf)
+                hlen = sizeof buf - 1;
 
+        va_start (ap, fmt);
+        mlen = vsnprintf (buf + hlen, sizeof buf - hlen, fmt, ap);
         va_end (ap);
+        if (mlen < 0)
+                goto out;
 
-        len = strlen (str1);
-        msg = GF_MALLOC (len + strlen (str2) + 1, gf_common_mt_char);
-
-        strcpy (msg, str1);
-        strcpy (msg + len, str2);
-
-        pthread_mutex_lock (&ctx->log.logfile_mutex);
-        {
-
-                if (ctx->log.logfile) {
-                        fprintf (ctx->log.logfile, "%s\n", msg);
-                } else {
-                        fprintf (stderr, "%s\n", msg);
-                }
+        if (hlen + mlen >= sizeof buf) {
+                /* does not fit on the stack, format it again on the heap */
+                msg = GF_MALLOC (hlen + mlen + 1, gf_common_mt_char);
+                if (!msg)
+                        goto out;
 
-#ifdef GF_LINUX_HOST_OS
-                /* We want only serious log in 'syslog', not our debug
-                   and trace logs */
-                if (ctx->log.gf_log_syslog && level &&
-                    (level <= ctx->log.sys_log_level))
-                        syslog ((level-1), "%s\n", msg);
-#endif
+                memcpy (msg, buf, hlen);
+                va_start (ap, fmt);
+                vsnprintf (msg + hlen, mlen + 1, fmt, ap);
+                va_end (ap);
         }
 
-        pthread_mutex_unlock (&ctx->log.logfile_mutex);
-
-err:
-        GF_FREE (msg);
+        gf_log_submit (ctx, level, msg, hlen + mlen, _gf_true);
 
-        GF_FREE (str1);
-
-        FREE (str2);
+        if (msg != buf)
+                GF_FREE (msg);
 
 out:
         return (0);
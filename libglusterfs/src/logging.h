@@ -59,6 +59,13 @@ typedef enum {
         GF_LOG_TRACE,      /* full trace of operation */
 } gf_loglevel_t;
 
+/* Bytes of ring buffer each logging thread gets. Messages are formatted by
+   the caller and drained to the log file by a single writer thread. */
+#define GF_LOG_RING_SIZE   (64 * 1024)
+
+/* Messages up to this size are formatted on the stack */
+#define GF_LOG_MSG_INLINE  4096
+
 typedef struct gf_log_handle_ {
         pthread_mutex_t  logfile_mutex;
         uint8_t          logrotate;
@@ -80,6 +87,11 @@ int gf_log_init (void *data, const char *filename);
 void gf_log_logrotate (int signum);
 
 void gf_log_cleanup (void);
+void gf_log_fini (void);
+
+void gf_log_flush (void);
+void gf_log_flush_on_crash (void);
+void gf_log_dump (void);
 
 int _gf_log (const char *domain, const char *file,
              const char *function, int32_t line, gf_loglevel_t level,
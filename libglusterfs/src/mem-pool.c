@@ -13,6 +13,7 @@
 #include "xlator.h"
 #include <stdlib.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #define GF_MEM_POOL_LIST_BOUNDARY        (sizeof(struct list_head))
 #define GF_MEM_POOL_PTR                  (sizeof(struct mem_pool*))
@@ -30,6 +31,11 @@
 
 #define GLUSTERFS_ENV_MEM_ACCT_STR  "GLUSTERFS_DISABLE_MEM_ACCT"
 
+/* per-thread chunk caches ("magazines") in front of the shared pool */
+#define GF_MEM_POOL_CACHE_SLOTS    512
+#define GF_MEM_POOL_MAGAZINE_SIZE  32
+#define GF_MEM_POOL_MAGAZINE_BATCH (GF_MEM_POOL_MAGAZINE_SIZE / 2)
+
 void
 gf_mem_acct_enable_set (void *data)
 {
@@ -283,6 +289,208 @@ free:
 
 
 
+/* A thread's cache is only ever touched by that thread. A pool which goes
+ * away only gives up its slot; the magazines it leaves behind are told
+ * apart by their generation and dropped by their owner, next time it
+ * looks at the slot or when it exits.
+ */
+struct mem_pool_magazine {
+        struct mem_pool *pool;
+        uint64_t         gen;         /* pool->cache_gen when created */
+        int              count;
+        uint64_t         alloc_count; /* not yet added to pool->alloc_count */
+        void            *chunks[GF_MEM_POOL_MAGAZINE_SIZE];
+};
+
+struct mem_pool_cache {
+        struct mem_pool_magazine *mags[GF_MEM_POOL_CACHE_SLOTS];
+};
+
+static pthread_key_t    mem_pool_cache_key;
+static pthread_once_t   mem_pool_cache_once = PTHREAD_ONCE_INIT;
+static int              mem_pool_cache_key_valid;
+
+/* protects the slot allocation, and keeps a pool from being destroyed
+   while an exiting thread drains into it */
+static pthread_mutex_t  mem_pool_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+/* generation of the pool owning each slot, 0 if the slot is free */
+static uint64_t         mem_pool_cache_slots[GF_MEM_POOL_CACHE_SLOTS];
+static uint64_t         mem_pool_cache_gen;
+
+
+static void
+__mem_pool_magazine_drain (struct mem_pool_magazine *mag, int count)
+{
+        struct mem_pool  *pool = mag->pool;
+        struct list_head *list = NULL;
+
+        while (count-- > 0 && mag->count > 0) {
+                list = mag->chunks[--mag->count];
+                INIT_LIST_HEAD (list);
+                list_add (list, &pool->list);
+                pool->cold_count++;
+        }
+
+        pool->alloc_count += mag->alloc_count;
+        mag->alloc_count = 0;
+}
+
+
+static void
+mem_pool_cache_destroy (void *data)
+{
+        struct mem_pool_cache    *cache = data;
+        struct mem_pool_magazine *mag = NULL;
+        int                       i = 0;
+
+        pthread_mutex_lock (&mem_pool_cache_lock);
+        {
+                for (i = 0; i < GF_MEM_POOL_CACHE_SLOTS; i++) {
+                        mag = cache->mags[i];
+                        if (!mag)
+                                continue;
+
+                        /* the pool is gone, and its chunks with it */
+                        if (mem_pool_cache_slots[i] != mag->gen) {
+                                FREE (mag);
+                                continue;
+                        }
+
+                        LOCK (&mag->pool->lock);
+                        {
+                                __mem_pool_magazine_drain (mag, mag->count);
+                        }
+                        UNLOCK (&mag->pool->lock);
+
+                        FREE (mag);
+                }
+        }
+        pthread_mutex_unlock (&mem_pool_cache_lock);
+
+        FREE (cache);
+}
+
+
+static void
+mem_pool_cache_key_init (void)
+{
+        if (pthread_key_create (&mem_pool_cache_key,
+                                mem_pool_cache_destroy) == 0)
+                mem_pool_cache_key_valid = 1;
+}
+
+
+static struct mem_pool_magazine *
+mem_pool_magazine_get (struct mem_pool *pool)
+{
+        struct mem_pool_cache    *cache = NULL;
+        struct mem_pool_magazine *mag = NULL;
+
+        if (pool->cache_index < 0 || !mem_pool_cache_key_valid)
+                return NULL;
+
+        cache = pthread_getspecific (mem_pool_cache_key);
+        if (!cache) {
+                cache = CALLOC (1, sizeof (*cache));
+                if (!cache)
+                        return NULL;
+
+                if (pthread_setspecific (mem_pool_cache_key, cache) != 0) {
+                        FREE (cache);
+                        return NULL;
+                }
+        }
+
+        mag = cache->mags[pool->cache_index];
+        if (mag && (mag->gen != pool->cache_gen)) {
+                /* left behind by a destroyed pool which had this slot */
+                FREE (mag);
+                mag = cache->mags[pool->cache_index] = NULL;
+        }
+
+        if (!mag) {
+                mag = CALLOC (1, sizeof (*mag));
+                if (!mag)
+                        return NULL;
+
+                mag->pool = pool;
+                mag->gen = pool->cache_gen;
+                cache->mags[pool->cache_index] = mag;
+        }
+
+        return mag;
+}
+
+
+static void
+mem_pool_cache_slot_alloc (struct mem_pool *pool)
+{
+        int  i = 0;
+
+        pool->cache_index = -1;
+
+        pthread_once (&mem_pool_cache_once, mem_pool_cache_key_init);
+
+        pthread_mutex_lock (&mem_pool_cache_lock);
+        {
+                for (i = 0; i < GF_MEM_POOL_CACHE_SLOTS; i++) {
+                        if (!mem_pool_cache_slots[i]) {
+                                pool->cache_gen = ++mem_pool_cache_gen;
+                                pool->cache_index = i;
+                                mem_pool_cache_slots[i] = pool->cache_gen;
+                                break;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&mem_pool_cache_lock);
+}
+
+
+/* The magazines of a pool which is being destroyed are left to their
+ * threads, which see the slot's generation change and drop them. The
+ * chunks in them are part of the slab which gets freed along with the
+ * pool, and what they allocated is not folded into alloc_count.
+ */
+static void
+mem_pool_cache_slot_release (struct mem_pool *pool)
+{
+        if (pool->cache_index < 0)
+                return;
+
+        pthread_mutex_lock (&mem_pool_cache_lock);
+        {
+                mem_pool_cache_slots[pool->cache_index] = 0;
+                pool->cache_index = -1;
+        }
+        pthread_mutex_unlock (&mem_pool_cache_lock);
+}
+
+
+static void
+mem_pool_account_get (struct mem_pool *pool)
+{
+        int hot = 0;
+        int max = 0;
+
+        hot = __sync_add_and_fetch (&pool->hot_count, 1);
+
+        max = pool->max_alloc;
+        while (max < hot) {
+                if (__sync_bool_compare_and_swap (&pool->max_alloc, max, hot))
+                        break;
+                max = pool->max_alloc;
+        }
+}
+
+
+int
+mem_pool_cold_count (struct mem_pool *pool)
+{
+        /* chunks sitting in the per-thread magazines are cold too */
+        return pool->count - pool->hot_count;
+}
+
+
 struct mem_pool *
 mem_pool_new_fn (unsigned long sizeof_type,
                  unsigned long count, char *name)
@@ -320,6 +528,7 @@ mem_pool_new_fn (unsigned long sizeof_type,
 
         mem_pool->padded_sizeof_type = padded_sizeof_type;
         mem_pool->cold_count = count;
+        mem_pool->count = count;
         mem_pool->real_sizeof_type = sizeof_type;
 
         pool = GF_CALLOC (count, padded_sizeof_type, gf_common_mt_long);
@@ -338,6 +547,8 @@ mem_pool_new_fn (unsigned long sizeof_type,
         mem_pool->pool = pool;
         mem_pool->pool_end = pool + (count * (padded_sizeof_type));
 
+        mem_pool_cache_slot_alloc (mem_pool);
+
         /* add this pool to the global list */
         ctx = THIS->ctx;
         if (!ctx)
@@ -370,16 +581,42 @@ mem_get0 (struct mem_pool *mem_pool)
 void *
 mem_get (struct mem_pool *mem_pool)
 {
-        struct list_head *list = NULL;
-        void             *ptr = NULL;
-        int             *in_use = NULL;
-        struct mem_pool **pool_ptr = NULL;
+        struct mem_pool_magazine *mag = NULL;
+        struct list_head         *list = NULL;
+        void                     *ptr = NULL;
+        int                      *in_use = NULL;
+        struct mem_pool         **pool_ptr = NULL;
 
         if (!mem_pool) {
                 gf_log_callingfn ("mem-pool", GF_LOG_ERROR, "invalid argument");
                 return NULL;
         }
 
+        mag = mem_pool_magazine_get (mem_pool);
+        if (mag) {
+                if (!mag->count) {
+                        LOCK (&mem_pool->lock);
+                        {
+                                /* refill half a magazine in one go */
+                                while (mag->count < GF_MEM_POOL_MAGAZINE_BATCH
+                                       && mem_pool->cold_count) {
+                                        list = mem_pool->list.next;
+                                        list_del (list);
+                                        mem_pool->cold_count--;
+                                        mag->chunks[mag->count++] = list;
+                                }
+                        }
+                        UNLOCK (&mem_pool->lock);
+                }
+
+                if (mag->count) {
+                        mag->alloc_count++;
+                        ptr = mag->chunks[--mag->count];
+                        mem_pool_account_get (mem_pool);
+                        goto fwd_addr_out;
+                }
+        }
+
         LOCK (&mem_pool->lock);
         {
                 mem_pool->alloc_count++;
@@ -387,18 +624,11 @@ mem_get (struct mem_pool *mem_pool)
                         list = mem_pool->list.next;
                         list_del (list);
 
-                        mem_pool->hot_count++;
                         mem_pool->cold_count--;
-
-                        if (mem_pool->max_alloc < mem_pool->hot_count)
-                                mem_pool->max_alloc = mem_pool->hot_count;
+                        mem_pool_account_get (mem_pool);
 
                         ptr = list;
-                        in_use = (ptr + GF_MEM_POOL_LIST_BOUNDARY +
-                                  GF_MEM_POOL_PTR);
-                        *in_use = 1;
-
-                        goto fwd_addr_out;
+                        goto unlock;
                 }
 
                 /* This is a problem area. If we've run out of
@@ -435,11 +665,19 @@ mem_get (struct mem_pool *mem_pool)
                  * the pool.
                  */
         }
+unlock:
+        UNLOCK (&mem_pool->lock);
+
+        if (!ptr)
+                return NULL;
+
 fwd_addr_out:
+        in_use = (ptr + GF_MEM_POOL_LIST_BOUNDARY + GF_MEM_POOL_PTR);
+        *in_use = 1;
+
         pool_ptr = mem_pool_from_ptr (ptr);
         *pool_ptr = (struct mem_pool *)mem_pool;
         ptr = mem_pool_chunkhead2ptr (ptr);
-        UNLOCK (&mem_pool->lock);
 
         return ptr;
 }
@@ -472,6 +710,7 @@ mem_put (void *ptr)
         void   *head = NULL;
         struct mem_pool **tmp = NULL;
         struct mem_pool *pool = NULL;
+        struct mem_pool_magazine *mag = NULL;
 
         if (!ptr) {
                 gf_log_callingfn ("mem-pool", GF_LOG_ERROR, "invalid argument");
@@ -492,52 +731,73 @@ mem_put (void *ptr)
                                   "mem-pool ptr is NULL");
                 return;
         }
-        LOCK (&pool->lock);
-        {
 
-                switch (__is_member (pool, ptr))
-                {
-                case 1:
-                        in_use = (head + GF_MEM_POOL_LIST_BOUNDARY +
-                                  GF_MEM_POOL_PTR);
-                        if (!is_mem_chunk_in_use(in_use)) {
-                                gf_log_callingfn ("mem-pool", GF_LOG_CRITICAL,
-                                                  "mem_put called on freed ptr %p of mem "
-                                                  "pool %p", ptr, pool);
-                                break;
-                        }
-                        pool->hot_count--;
-                        pool->cold_count++;
-                        *in_use = 0;
-                        list_add (list, &pool->list);
+        switch (__is_member (pool, ptr))
+        {
+        case 1:
+                in_use = (head + GF_MEM_POOL_LIST_BOUNDARY +
+                          GF_MEM_POOL_PTR);
+                if (!is_mem_chunk_in_use(in_use)) {
+                        gf_log_callingfn ("mem-pool", GF_LOG_CRITICAL,
+                                          "mem_put called on freed ptr %p of mem "
+                                          "pool %p", ptr, pool);
                         break;
-                case -1:
-                        /* For some reason, the address given is within
-                         * the address range of the mem-pool but does not align
-                         * with the expected start of a chunk that includes
-                         * the list headers also. Sounds like a problem in
-                         * layers of clouds up above us. ;)
-                         */
-                        abort ();
+                }
+                *in_use = 0;
+                __sync_sub_and_fetch (&pool->hot_count, 1);
+
+                mag = mem_pool_magazine_get (pool);
+                if (!mag) {
+                        LOCK (&pool->lock);
+                        {
+                                pool->cold_count++;
+                                list_add (list, &pool->list);
+                        }
+                        UNLOCK (&pool->lock);
                         break;
-                case 0:
-                        /* The address is outside the range of the mem-pool. We
-                         * assume here that this address was allocated at a
-                         * point when the mem-pool was out of chunks in mem_get
-                         * or the programmer has made a mistake by calling the
-                         * wrong de-allocation interface. We do
-                         * not have enough info to distinguish between the two
-                         * situations.
-                         */
+                }
+
+                if (mag->count == GF_MEM_POOL_MAGAZINE_SIZE) {
+                        /* give half of a full magazine back in one go */
+                        LOCK (&pool->lock);
+                        {
+                                __mem_pool_magazine_drain
+                                        (mag, GF_MEM_POOL_MAGAZINE_BATCH);
+                        }
+                        UNLOCK (&pool->lock);
+                }
+
+                mag->chunks[mag->count++] = head;
+                break;
+        case -1:
+                /* For some reason, the address given is within
+                 * the address range of the mem-pool but does not align
+                 * with the expected start of a chunk that includes
+                 * the list headers also. Sounds like a problem in
+                 * layers of clouds up above us. ;)
+                 */
+                abort ();
+                break;
+        case 0:
+                /* The address is outside the range of the mem-pool. We
+                 * assume here that this address was allocated at a
+                 * point when the mem-pool was out of chunks in mem_get
+                 * or the programmer has made a mistake by calling the
+                 * wrong de-allocation interface. We do
+                 * not have enough info to distinguish between the two
+                 * situations.
+                 */
+                LOCK (&pool->lock);
+                {
                         pool->curr_stdalloc--;
-                        GF_FREE (list);
-                        break;
-                default:
-                        /* log error */
-                        break;
                 }
+                UNLOCK (&pool->lock);
+                GF_FREE (list);
+                break;
+        default:
+                /* log error */
+                break;
         }
-        UNLOCK (&pool->lock);
 }
 
 void
@@ -546,6 +806,8 @@ mem_pool_destroy (struct mem_pool *pool)
         if (!pool)
                 return;
 
+        mem_pool_cache_slot_release (pool);
+
         gf_log (THIS->name, GF_LOG_INFO, "size=%lu max=%d total=%"PRIu64,
                 pool->padded_sizeof_type, pool->max_alloc, pool->alloc_count);
 
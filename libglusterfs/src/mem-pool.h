@@ -144,6 +144,11 @@ struct mem_pool {
         int               max_stdalloc;
         char             *name;
         struct list_head  global_list;
+        unsigned long     count;       /* number of chunks in the slab */
+        int               cache_index; /* slot in the per-thread caches,
+                                          -1 if the pool is not cached */
+        uint64_t          cache_gen;   /* tells this pool's magazines from
+                                          those of earlier slot owners */
 };
 
 struct mem_pool *
@@ -157,6 +162,8 @@ void *mem_get0 (struct mem_pool *pool);
 
 void mem_pool_destroy (struct mem_pool *pool);
 
+int mem_pool_cold_count (struct mem_pool *pool);
+
 void gf_mem_acct_enable_set (void *ctx);
 
 #endif /* _MEM_POOL_H */
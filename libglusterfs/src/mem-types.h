@@ -102,6 +102,15 @@ enum gf_common_mem_types_ {
         gf_common_mt_buffer_t             = 86,
         gf_common_mt_circular_buffer_t    = 87,
         gf_common_mt_eh_t                 = 88,
-        gf_common_mt_end                  = 89
+        gf_common_mt_epoll_poller_t       = 89,
+        gf_common_mt_dict_keys            = 90,
+        gf_common_mt_dict_index           = 91,
+        gf_common_mt_rpcclnt_savedframe_hash = 92,
+        gf_common_mt_compound_state_t     = 93,
+        gf_common_mt_rpcclnt_held_t       = 94,
+        gf_common_mt_shm_private_t        = 95,
+        gf_common_mt_shm_ioq_t            = 96,
+        gf_common_mt_ssl_ticket_keys_t    = 97,
+        gf_common_mt_end                  = 98
 };
 #endif
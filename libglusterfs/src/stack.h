@@ -106,8 +106,12 @@ struct _call_stack_t {
 
         int32_t                       op;
         int8_t                        type;
+        uint8_t                       flags;  /* GF_STACK_* */
 };
 
+/* whoever sends the reply can take pipe-backed iobufs (see iobuf.h) */
+#define GF_STACK_PIPE_PAYLOAD  0x01
+
 
 #define frame_set_uid_gid(frm, u, g)            \
         do {                                    \
@@ -14,6 +14,7 @@
 #include "iobuf.h"
 #include "statedump.h"
 #include "stack.h"
+#include "timer.h"
 #include "common-utils.h"
 
 #ifdef HAVE_MALLOC_H
@@ -332,7 +333,8 @@ gf_proc_dump_mempool_info (glusterfs_ctx_t *ctx)
                 gf_proc_dump_write ("-----", "-----");
                 gf_proc_dump_write ("pool-name", "%s", pool->name);
                 gf_proc_dump_write ("hot-count", "%d", pool->hot_count);
-                gf_proc_dump_write ("cold-count", "%d", pool->cold_count);
+                gf_proc_dump_write ("cold-count", "%d",
+                                    mem_pool_cold_count (pool));
                 gf_proc_dump_write ("padded_sizeof", "%lu",
                                     pool->padded_sizeof_type);
                 gf_proc_dump_write ("alloc-count", "%"PRIu64, pool->alloc_count);
@@ -369,7 +371,7 @@ gf_proc_dump_mempool_info_to_dict (glusterfs_ctx_t *ctx, dict_t *dict)
 
                 memset (key, 0, sizeof (key));
                 snprintf (key, sizeof (key), "pool%d.coldcount", count);
-                ret = dict_set_int32 (dict, key, pool->cold_count);
+                ret = dict_set_int32 (dict, key, mem_pool_cold_count (pool));
                 if (ret)
                         return;
 
@@ -754,12 +756,15 @@ gf_proc_dump_info (int signum, glusterfs_ctx_t *ctx)
         if (GF_PROC_DUMP_IS_OPTION_ENABLED (mem)) {
                 gf_proc_dump_mem_info ();
                 gf_proc_dump_mempool_info (ctx);
+                gf_log_dump ();
         }
 
         if (GF_PROC_DUMP_IS_OPTION_ENABLED (iobuf))
                 iobuf_stats_dump (ctx->iobuf_pool);
-        if (GF_PROC_DUMP_IS_OPTION_ENABLED (callpool))
+        if (GF_PROC_DUMP_IS_OPTION_ENABLED (callpool)) {
                 gf_proc_dump_pending_frames (ctx->pool);
+                gf_timer_registry_dump (ctx);
+        }
 
         if (ctx->master) {
                 gf_proc_dump_add_section ("fuse");
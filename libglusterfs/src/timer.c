@@ -17,8 +17,254 @@
 #include "logging.h"
 #include "common-utils.h"
 #include "globals.h"
+#include "statedump.h"
+
+#define GF_TIMER_WHEEL_ROOT_MASK   (GF_TIMER_WHEEL_ROOT_SIZE - 1)
+#define GF_TIMER_WHEEL_MASK        (GF_TIMER_WHEEL_SIZE - 1)
+#define GF_TIMER_WHEEL_SPAN        (1ULL << (GF_TIMER_WHEEL_ROOT_BITS +      \
+                                             GF_TIMER_WHEEL_LEVELS *         \
+                                             GF_TIMER_WHEEL_BITS))
+#define GF_TIMER_NEVER             ((uint64_t) -1)
+
+#define list_empty_timer(head)     ((head)->next == (head))
+
+#define gf_timer_map_set(map, i)   ((map)[(i) / 64] |= (1ULL << ((i) % 64)))
+#define gf_timer_map_clear(map, i) ((map)[(i) / 64] &= ~(1ULL << ((i) % 64)))
+
+
+static uint64_t
+gf_timer_now (void)
+{
+        struct timespec ts = {0, };
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t) ts.tv_sec) * 1000 + (ts.tv_nsec / 1000000);
+}
+
+
+static void
+gf_timer_list_add_tail (gf_timer_t *head, gf_timer_t *event)
+{
+        event->next = head;
+        event->prev = head->prev;
+        event->prev->next = event;
+        head->prev = event;
+}
+
+
+static void
+gf_timer_list_del (gf_timer_t *event)
+{
+        event->next->prev = event->prev;
+        event->prev->next = event->next;
+}
+
+
+static void
+gf_timer_list_splice_tail (gf_timer_t *from, gf_timer_t *to)
+{
+        if (list_empty_timer (from))
+                return;
+
+        from->next->prev = to->prev;
+        to->prev->next = from->next;
+        from->prev->next = to;
+        to->prev = from->prev;
+
+        from->next = from->prev = from;
+}
+
+
+/* Places an event in the slot of the wheel covering its expiry, relative
+   to the tick about to be run */
+static void
+__gf_timer_wheel_add (gf_timer_registry_t *reg, gf_timer_t *event)
+{
+        gf_timer_t *head = NULL;
+        uint64_t    expires = 0;
+        uint64_t    delta = 0;
+        int         level = 0;
+        int         shift = 0;
+        int         idx = 0;
+
+        expires = event->expires;
+        if (expires < reg->tick)
+                expires = reg->tick;
+
+        delta = expires - reg->tick;
+
+        if (delta < GF_TIMER_WHEEL_ROOT_SIZE) {
+                idx = expires & GF_TIMER_WHEEL_ROOT_MASK;
+                head = &reg->root[idx];
+                gf_timer_map_set (reg->root_map, idx);
+                goto add;
+        }
+
+        if (delta >= GF_TIMER_WHEEL_SPAN) {
+                delta = GF_TIMER_WHEEL_SPAN - 1;
+                expires = reg->tick + delta;
+        }
+
+        shift = GF_TIMER_WHEEL_ROOT_BITS;
+        for (level = 0; level < GF_TIMER_WHEEL_LEVELS - 1; level++) {
+                if (delta < (1ULL << (shift + GF_TIMER_WHEEL_BITS)))
+                        break;
+                shift += GF_TIMER_WHEEL_BITS;
+        }
+
+        idx = (expires >> shift) & GF_TIMER_WHEEL_MASK;
+        head = &reg->level[level][idx];
+        gf_timer_map_set (&reg->level_map[level], idx);
+add:
+        gf_timer_list_add_tail (head, event);
+}
+
+
+/* Distance from slot from, going round, to the first slot of a map of
+   size slots with its bit set, -1 if none is */
+static int
+gf_timer_map_next (uint64_t *map, int size, int from)
+{
+        uint64_t bits = 0;
+        int      words = size / 64;
+        int      word = 0;
+        int      i = 0;
+
+        for (i = 0; i <= words; i++) {
+                word = (from / 64 + i) % words;
+                bits = map[word];
+                if (i == 0)
+                        bits &= ~0ULL << (from % 64);
+                else if (i == words)
+                        bits &= (1ULL << (from % 64)) - 1;
+                if (bits)
+                        return (word * 64 + __builtin_ctzll (bits) - from)
+                                & (size - 1);
+        }
+
+        return -1;
+}
+
+
+/* Earliest tick from reg->tick on at which a root slot fires or a slot of
+   an upper level is cascaded down */
+static uint64_t
+__gf_timer_wheel_next (gf_timer_registry_t *reg)
+{
+        uint64_t next = GF_TIMER_NEVER;
+        uint64_t when = 0;
+        uint64_t cur = 0;
+        int      level = 0;
+        int      shift = 0;
+        int      from = 0;
+        int      off = 0;
+        int      i = 0;
+
+        if (!reg->pending)
+                return next;
+
+        from = reg->tick & GF_TIMER_WHEEL_ROOT_MASK;
+        while ((off = gf_timer_map_next (reg->root_map,
+                                         GF_TIMER_WHEEL_ROOT_SIZE,
+                                         from)) >= 0) {
+                i = (from + off) & GF_TIMER_WHEEL_ROOT_MASK;
+                if (list_empty_timer (&reg->root[i])) {
+                        gf_timer_map_clear (reg->root_map, i);
+                        continue;
+                }
+
+                next = reg->tick + off;
+                break;
+        }
+
+        shift = GF_TIMER_WHEEL_ROOT_BITS;
+        for (level = 0; level < GF_TIMER_WHEEL_LEVELS; level++) {
+                /* a slot is cascaded when the tick has its index at this
+                   level and zeroes below */
+                cur = (reg->tick + (1ULL << shift) - 1) >> shift;
+                from = cur & GF_TIMER_WHEEL_MASK;
+
+                while ((off = gf_timer_map_next (&reg->level_map[level],
+                                                 GF_TIMER_WHEEL_SIZE,
+                                                 from)) >= 0) {
+                        i = (from + off) & GF_TIMER_WHEEL_MASK;
+                        if (list_empty_timer (&reg->level[level][i])) {
+                                gf_timer_map_clear (&reg->level_map[level], i);
+                                continue;
+                        }
+
+                        when = (cur + off) << shift;
+                        if (when < next)
+                                next = when;
+                        break;
+                }
+
+                shift += GF_TIMER_WHEEL_BITS;
+        }
+
+        return next;
+}
+
+
+/* Runs the wheel up to and including tick now, moving the events due onto
+   expired */
+static void
+__gf_timer_wheel_advance (gf_timer_registry_t *reg, uint64_t now,
+                          gf_timer_t *expired)
+{
+        gf_timer_t  cascade = {0, };
+        gf_timer_t *event = NULL;
+        uint64_t    next = 0;
+        int         idx = 0;
+        int         slot = 0;
+        int         level = 0;
+        int         shift = 0;
+
+        while (reg->tick <= now) {
+                idx = reg->tick & GF_TIMER_WHEEL_ROOT_MASK;
+
+                if (idx && list_empty_timer (&reg->root[idx])) {
+                        /* nothing on this tick, skip to the next which
+                           has something to do */
+                        next = __gf_timer_wheel_next (reg);
+                        if (next > now) {
+                                reg->tick = now + 1;
+                                break;
+                        }
+                        reg->tick = next;
+                        idx = reg->tick & GF_TIMER_WHEEL_ROOT_MASK;
+                }
+
+                if (!idx) {
+                        shift = GF_TIMER_WHEEL_ROOT_BITS;
+                        for (level = 0; level < GF_TIMER_WHEEL_LEVELS;
+                             level++) {
+                                cascade.next = cascade.prev = &cascade;
+                                slot = (reg->tick >> shift) & GF_TIMER_WHEEL_MASK;
+                                gf_timer_list_splice_tail
+                                        (&reg->level[level][slot], &cascade);
+                                gf_timer_map_clear (&reg->level_map[level],
+                                                    slot);
+
+                                while (!list_empty_timer (&cascade)) {
+                                        event = cascade.next;
+                                        gf_timer_list_del (event);
+                                        __gf_timer_wheel_add (reg, event);
+                                }
+
+                                if ((reg->tick >> shift) & GF_TIMER_WHEEL_MASK)
+                                        break;
+                                shift += GF_TIMER_WHEEL_BITS;
+                        }
+                }
+
+                gf_timer_list_splice_tail (&reg->root[idx], expired);
+                gf_timer_map_clear (reg->root_map, idx);
+                reg->tick++;
+        }
+}
 
-#define TS(tv) ((((unsigned long long) tv.tv_sec) * 1000000) + (tv.tv_usec))
 
 gf_timer_t *
 gf_timer_call_after (glusterfs_ctx_t *ctx,
@@ -28,8 +274,6 @@ gf_timer_call_after (glusterfs_ctx_t *ctx,
 {
         gf_timer_registry_t *reg = NULL;
         gf_timer_t *event = NULL;
-        gf_timer_t *trav = NULL;
-        unsigned long long at = 0L;
 
         if (ctx == NULL)
         {
@@ -48,26 +292,19 @@ gf_timer_call_after (glusterfs_ctx_t *ctx,
         if (!event) {
                 return NULL;
         }
-        gettimeofday (&event->at, NULL);
-        event->at.tv_usec = ((event->at.tv_usec + delta.tv_usec) % 1000000);
-        event->at.tv_sec += ((event->at.tv_usec + delta.tv_usec) / 1000000);
-        event->at.tv_sec += delta.tv_sec;
-        at = TS (event->at);
+        /* rounded up, an event never fires early */
+        event->expires = gf_timer_now () + ((uint64_t) delta.tv_sec) * 1000 +
+                         (delta.tv_usec + 999) / 1000;
         event->callbk = callbk;
         event->data = data;
         event->xl = THIS;
         pthread_mutex_lock (&reg->lock);
         {
-                trav = reg->active.prev;
-                while (trav != &reg->active) {
-                        if (TS (trav->at) < at)
-                                break;
-                        trav = trav->prev;
-                }
-                event->prev = trav;
-                event->next = event->prev->next;
-                event->prev->next = event;
-                event->next->prev = event;
+                __gf_timer_wheel_add (reg, event);
+                reg->pending++;
+
+                if (event->expires < reg->wakeup)
+                        pthread_cond_signal (&reg->cond);
         }
         pthread_mutex_unlock (&reg->lock);
         return event;
@@ -83,12 +320,8 @@ gf_timer_call_stale (gf_timer_registry_t *reg,
                 return 0;
         }
 
-        event->next->prev = event->prev;
-        event->prev->next = event->next;
-        event->next = &reg->stale;
-        event->prev = event->next->prev;
-        event->next->prev = event;
-        event->prev->next = event;
+        gf_timer_list_del (event);
+        gf_timer_list_add_tail (&reg->stale, event);
 
         return 0;
 }
@@ -114,8 +347,9 @@ gf_timer_call_cancel (glusterfs_ctx_t *ctx,
 
         pthread_mutex_lock (&reg->lock);
         {
-                event->next->prev = event->prev;
-                event->prev->next = event->next;
+                gf_timer_list_del (event);
+                if (!event->fired)
+                        reg->pending--;
         }
         pthread_mutex_unlock (&reg->lock);
 
@@ -123,11 +357,31 @@ gf_timer_call_cancel (glusterfs_ctx_t *ctx,
         return 0;
 }
 
+
+static void
+__gf_timer_free_list (gf_timer_t *head)
+{
+        gf_timer_t *event = NULL;
+
+        while (!list_empty_timer (head)) {
+                event = head->next;
+                gf_timer_list_del (event);
+                GF_FREE (event);
+        }
+}
+
+
 void *
 gf_timer_proc (void *ctx)
 {
         gf_timer_registry_t *reg = NULL;
-	const struct timespec sleepts = {.tv_sec = 1, .tv_nsec = 0, };
+        gf_timer_t           expired = {0, };
+        gf_timer_t          *event = NULL;
+        uint64_t             now = 0;
+        uint64_t             next = 0;
+        struct timespec      deadline = {0, };
+        int                  i = 0;
+        int                  j = 0;
 
         if (ctx == NULL)
         {
@@ -141,49 +395,66 @@ gf_timer_proc (void *ctx)
                 return NULL;
         }
 
-        while (!reg->fin) {
-                unsigned long long now;
-                struct timeval now_tv;
-                gf_timer_t *event = NULL;
+        expired.next = expired.prev = &expired;
 
-                gettimeofday (&now_tv, NULL);
-                now = TS (now_tv);
-                while (1) {
-                        unsigned long long at;
-                        char need_cbk = 0;
+        pthread_mutex_lock (&reg->lock);
+        while (!reg->fin) {
+                now = gf_timer_now ();
+                __gf_timer_wheel_advance (reg, now, &expired);
+
+                /* one at a time, as a callback may cancel events which
+                   are still on the list */
+                while (!list_empty_timer (&expired)) {
+                        event = expired.next;
+                        gf_timer_call_stale (reg, event);
+                        event->fired = 1;
+
+                        reg->pending--;
+                        reg->fired++;
+
+                        now = gf_timer_now ();
+                        if (now > event->expires) {
+                                reg->lag_total += now - event->expires;
+                                if (now - event->expires > reg->lag_max)
+                                        reg->lag_max = now - event->expires;
+                        }
 
-                        pthread_mutex_lock (&reg->lock);
+                        pthread_mutex_unlock (&reg->lock);
                         {
-                                event = reg->active.next;
-                                at = TS (event->at);
-                                if (event != &reg->active && now >= at) {
-                                        need_cbk = 1;
-                                        gf_timer_call_stale (reg, event);
-                                }
+                                if (event->xl)
+                                        THIS = event->xl;
+                                event->callbk (event->data);
                         }
-                        pthread_mutex_unlock (&reg->lock);
-                        if (event->xl)
-                                THIS = event->xl;
-                        if (need_cbk)
-                                event->callbk  (event->data);
-
-                        else
-                                break;
+                        pthread_mutex_lock (&reg->lock);
                 }
-                nanosleep (&sleepts, NULL);
-        }
 
-        pthread_mutex_lock (&reg->lock);
-        {
-                while (reg->active.next != &reg->active) {
-                        gf_timer_call_cancel (ctx, reg->active.next);
+                next = __gf_timer_wheel_next (reg);
+                if (next <= gf_timer_now ())
+                        continue;
+
+                reg->wakeup = next;
+                if (next == GF_TIMER_NEVER) {
+                        pthread_cond_wait (&reg->cond, &reg->lock);
+                } else {
+                        deadline.tv_sec = next / 1000;
+                        deadline.tv_nsec = (next % 1000) * 1000000;
+                        pthread_cond_timedwait (&reg->cond, &reg->lock,
+                                                &deadline);
                 }
+                reg->wakeup = 0;
+        }
 
-                while (reg->stale.next != &reg->stale) {
-                        gf_timer_call_cancel (ctx, reg->stale.next);
-                }
+        __gf_timer_free_list (&expired);
+        for (i = 0; i < GF_TIMER_WHEEL_ROOT_SIZE; i++)
+                __gf_timer_free_list (&reg->root[i]);
+        for (i = 0; i < GF_TIMER_WHEEL_LEVELS; i++) {
+                for (j = 0; j < GF_TIMER_WHEEL_SIZE; j++)
+                        __gf_timer_free_list (&reg->level[i][j]);
         }
+        __gf_timer_free_list (&reg->stale);
         pthread_mutex_unlock (&reg->lock);
+
+        pthread_cond_destroy (&reg->cond);
         pthread_mutex_destroy (&reg->lock);
         GF_FREE (((glusterfs_ctx_t *)ctx)->timer);
 
@@ -193,6 +464,10 @@ gf_timer_proc (void *ctx)
 gf_timer_registry_t *
 gf_timer_registry_init (glusterfs_ctx_t *ctx)
 {
+        pthread_condattr_t attr;
+        int                i = 0;
+        int                j = 0;
+
         if (ctx == NULL) {
                 gf_log_callingfn ("timer", GF_LOG_ERROR, "invalid argument");
                 return NULL;
@@ -207,10 +482,27 @@ gf_timer_registry_init (glusterfs_ctx_t *ctx)
                         goto out;
 
                 pthread_mutex_init (&reg->lock, NULL);
-                reg->active.next = &reg->active;
-                reg->active.prev = &reg->active;
+
+                /* deadlines are on the monotonic clock, so that changing
+                   the wall clock neither fires nor holds back events */
+                pthread_condattr_init (&attr);
+                pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+                pthread_cond_init (&reg->cond, &attr);
+                pthread_condattr_destroy (&attr);
+
                 reg->stale.next = &reg->stale;
                 reg->stale.prev = &reg->stale;
+                for (i = 0; i < GF_TIMER_WHEEL_ROOT_SIZE; i++) {
+                        reg->root[i].next = &reg->root[i];
+                        reg->root[i].prev = &reg->root[i];
+                }
+                for (i = 0; i < GF_TIMER_WHEEL_LEVELS; i++) {
+                        for (j = 0; j < GF_TIMER_WHEEL_SIZE; j++) {
+                                reg->level[i][j].next = &reg->level[i][j];
+                                reg->level[i][j].prev = &reg->level[i][j];
+                        }
+                }
+                reg->tick = gf_timer_now ();
 
                 ctx->timer = reg;
                 pthread_create (&reg->th, NULL, gf_timer_proc, ctx);
@@ -218,3 +510,29 @@ gf_timer_registry_init (glusterfs_ctx_t *ctx)
 out:
         return ctx->timer;
 }
+
+void
+gf_timer_registry_dump (glusterfs_ctx_t *ctx)
+{
+        gf_timer_registry_t *reg = NULL;
+        int                  ret = -1;
+
+        if (!ctx || !ctx->timer)
+                return;
+
+        reg = ctx->timer;
+
+        ret = pthread_mutex_trylock (&reg->lock);
+        if (ret)
+                return;
+        {
+                gf_proc_dump_add_section ("timer");
+                gf_proc_dump_write ("pending", "%"PRIu64, reg->pending);
+                gf_proc_dump_write ("fired", "%"PRIu64, reg->fired);
+                gf_proc_dump_write ("lag-max-ms", "%"PRIu64, reg->lag_max);
+                gf_proc_dump_write ("lag-avg-ms", "%"PRIu64,
+                                    reg->fired ? (reg->lag_total / reg->fired)
+                                    : 0);
+        }
+        pthread_mutex_unlock (&reg->lock);
+}
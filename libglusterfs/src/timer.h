@@ -23,20 +23,46 @@
 
 typedef void (*gf_timer_cbk_t) (void *);
 
+/* The timing wheel ticks once a millisecond. The root level has a slot per
+   tick for the next 256 ticks; each of the levels above covers 64 slots of
+   the whole level below it, which reaches ~49 days. Events further out
+   are parked in the last level and re-placed when it comes around */
+#define GF_TIMER_WHEEL_ROOT_BITS   8
+#define GF_TIMER_WHEEL_ROOT_SIZE   (1 << GF_TIMER_WHEEL_ROOT_BITS)
+#define GF_TIMER_WHEEL_BITS        6
+#define GF_TIMER_WHEEL_SIZE        (1 << GF_TIMER_WHEEL_BITS)
+#define GF_TIMER_WHEEL_LEVELS      4
+
 struct _gf_timer {
         struct _gf_timer *next, *prev;
-        struct timeval    at;
+        uint64_t          expires;     /* tick (monotonic ms) to fire at */
         gf_timer_cbk_t    callbk;
         void             *data;
         xlator_t         *xl;
+        char              fired;
 };
 
 struct _gf_timer_registry {
         pthread_t        th;
         char             fin;
-        struct _gf_timer stale;
-        struct _gf_timer active;
+        struct _gf_timer stale;        /* fired, not yet cancelled */
+        struct _gf_timer root[GF_TIMER_WHEEL_ROOT_SIZE];
+        struct _gf_timer level[GF_TIMER_WHEEL_LEVELS][GF_TIMER_WHEEL_SIZE];
+        /* a bit per slot which may hold events, set when one is added and
+           cleared when the slot is run or found empty (cancel does not know
+           the slot it unlinks from) */
+        uint64_t         root_map[GF_TIMER_WHEEL_ROOT_SIZE / 64];
+        uint64_t         level_map[GF_TIMER_WHEEL_LEVELS];
+        uint64_t         tick;         /* next tick to be run */
+        uint64_t         wakeup;       /* tick gf_timer_proc sleeps until,
+                                          0 while it is running events */
         pthread_mutex_t  lock;
+        pthread_cond_t   cond;
+
+        uint64_t         pending;      /* not yet fired */
+        uint64_t         fired;
+        uint64_t         lag_total;    /* ms events fired after their time */
+        uint64_t         lag_max;
 };
 
 typedef struct _gf_timer gf_timer_t;
@@ -58,4 +84,7 @@ gf_timer_proc (void *data);
 gf_timer_registry_t *
 gf_timer_registry_init (glusterfs_ctx_t *ctx);
 
+void
+gf_timer_registry_dump (glusterfs_ctx_t *ctx);
+
 #endif /* _TIMER_H */
@@ -341,6 +341,16 @@ typedef int32_t (*fop_fremovexattr_cbk_t) (call_frame_t *frame,
                                            int32_t op_ret,
                                            int32_t op_errno, dict_t *xdata);
 
+/* @replies holds one cbk stub per executed fop, in order; a compound
+   stops at the first fop that fails */
+typedef int32_t (*fop_compound_cbk_t) (call_frame_t *frame,
+                                       void *cookie,
+                                       xlator_t *this,
+                                       int32_t op_ret,
+                                       int32_t op_errno,
+                                       struct list_head *replies,
+                                       dict_t *xdata);
+
 typedef int32_t (*fop_lk_cbk_t) (call_frame_t *frame,
                                  void *cookie,
                                  xlator_t *this,
@@ -565,6 +575,12 @@ typedef int32_t (*fop_fremovexattr_t) (call_frame_t *frame,
                                        fd_t *fd,
                                        const char *name, dict_t *xdata);
 
+/* @stubs is a list of wind stubs (fop_*_stub) linked through stub->list */
+typedef int32_t (*fop_compound_t) (call_frame_t *frame,
+                                   xlator_t *this,
+                                   struct list_head *stubs,
+                                   dict_t *xdata);
+
 typedef int32_t (*fop_lk_t) (call_frame_t *frame,
                              xlator_t *this,
                              fd_t *fd,
@@ -678,6 +694,7 @@ struct xlator_fops {
         fop_setattr_t        setattr;
         fop_fsetattr_t       fsetattr;
         fop_getspec_t        getspec;
+        fop_compound_t       compound;
 
         /* these entries are used for a typechecking hack in STACK_WIND _only_ */
         fop_lookup_cbk_t         lookup_cbk;
@@ -722,6 +739,7 @@ struct xlator_fops {
         fop_setattr_cbk_t        setattr_cbk;
         fop_fsetattr_cbk_t       fsetattr_cbk;
         fop_getspec_cbk_t        getspec_cbk;
+        fop_compound_cbk_t       compound_cbk;
 };
 
 typedef int32_t (*cbk_forget_t) (xlator_t *this,
@@ -56,6 +56,7 @@ enum gf_fop_procnum {
         GFS3_OP_RELEASE,
         GFS3_OP_RELEASEDIR,
         GFS3_OP_FREMOVEXATTR,
+        GFS3_OP_COMPOUND,
         GFS3_OP_MAXVALUE,
 } ;
 
@@ -192,7 +193,8 @@ typedef enum {
         GF_AFR_OP_INDEX_SUMMARY,
         GF_AFR_OP_HEALED_FILES,
         GF_AFR_OP_HEAL_FAILED_FILES,
-        GF_AFR_OP_SPLIT_BRAIN_FILES
+        GF_AFR_OP_SPLIT_BRAIN_FILES,
+        GF_AFR_OP_STATISTICS,
 } gf_xl_afr_op_t ;
 
 #define GLUSTER_HNDSK_PROGRAM    14398633 /* Completely random */
@@ -208,6 +210,11 @@ typedef enum {
 #define GLUSTER_FOP_VERSION   330 /* 3.3.0 */
 #define GLUSTER_FOP_PROCCNT   GFS3_OP_MAXVALUE
 
+/* Bricks which take GFS3_OP_COMPOUND also list the fop program under this
+   version. Only its NULL procedure is served; compounds are sent with
+   GLUSTER_FOP_VERSION like any other fop. */
+#define GLUSTER_FOP_COMPOUND_VERSION 331
+
 /* Second version */
 #define GD_MGMT_PROGRAM          1238433 /* Completely random */
 #define GD_MGMT_VERSION          2   /* 0.0.2 */
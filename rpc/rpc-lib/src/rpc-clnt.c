@@ -28,6 +28,12 @@
 void
 rpc_clnt_reply_deinit (struct rpc_req *req, struct mem_pool *pool);
 
+static void
+rpc_clnt_release_held (struct rpc_clnt *rpc);
+
+static int
+_is_flow_controlled (rpc_clnt_prog_t *prog, int procnum);
+
 uint64_t
 rpc_clnt_new_callid (struct rpc_clnt *clnt)
 {
@@ -43,18 +49,92 @@ rpc_clnt_new_callid (struct rpc_clnt *clnt)
 }
 
 
+static struct list_head *
+__saved_frames_bucket (struct saved_frames *frames, uint64_t xid)
+{
+        return &frames->buckets[xid & (frames->bucket_count - 1)];
+}
+
+
+static void
+__saved_frames_rehash (struct saved_frames *frames)
+{
+        struct list_head   *buckets = NULL;
+        struct list_head   *old     = NULL;
+        struct saved_frame *trav    = NULL;
+        struct saved_frame *tmp     = NULL;
+        uint32_t            count   = 0;
+        uint32_t            i       = 0;
+
+        count = frames->bucket_count * 2;
+        buckets = GF_CALLOC (count, sizeof (*buckets),
+                             gf_common_mt_rpcclnt_savedframe_hash);
+        if (!buckets)
+                /* longer chains, but still correct */
+                return;
+
+        for (i = 0; i < count; i++)
+                INIT_LIST_HEAD (&buckets[i]);
+
+        old = frames->buckets;
+        frames->buckets = buckets;
+        frames->bucket_count = count;
+
+        for (i = 0; i < count / 2; i++) {
+                list_for_each_entry_safe (trav, tmp, &old[i], hash) {
+                        list_del (&trav->hash);
+                        list_add_tail (&trav->hash,
+                                       __saved_frames_bucket (frames,
+                                                              trav->rpcreq->xid));
+                }
+        }
+
+        GF_FREE (old);
+}
+
+
+static void
+__saved_frame_unlink (struct saved_frames *frames,
+                      struct saved_frame *saved_frame)
+{
+        list_del_init (&saved_frame->list);
+        list_del_init (&saved_frame->hash);
+        frames->count--;
+
+        if (_is_flow_controlled (saved_frame->rpcreq->prog,
+                                 saved_frame->rpcreq->procnum))
+                frames->flow_count--;
+}
+
+
+static struct saved_frame *
+__saved_frame_find (struct saved_frames *frames, int64_t callid)
+{
+	struct saved_frame *tmp = NULL;
+
+        list_for_each_entry (tmp, __saved_frames_bucket (frames, callid),
+                             hash) {
+		if (tmp->rpcreq->xid == callid)
+                        return tmp;
+        }
+
+        return NULL;
+}
+
+
 struct saved_frame *
 __saved_frames_get_timedout (struct saved_frames *frames, uint32_t timeout,
                              struct timeval *current)
 {
 	struct saved_frame *bailout_frame = NULL, *tmp = NULL;
 
+        /* the oldest frame is at the head, nothing behind it can be
+           older */
 	if (!list_empty(&frames->sf.list)) {
 		tmp = list_entry (frames->sf.list.next, typeof (*tmp), list);
 		if ((tmp->saved_at.tv_sec + timeout) < current->tv_sec) {
 			bailout_frame = tmp;
-			list_del_init (&bailout_frame->list);
-			frames->count--;
+                        __saved_frame_unlink (frames, bailout_frame);
 		}
 	}
 
@@ -62,13 +142,13 @@ __saved_frames_get_timedout (struct saved_frames *frames, uint32_t timeout,
 }
 
 static int
-_is_lock_fop (struct saved_frame *sframe)
+_is_lock_proc (rpc_clnt_prog_t *prog, int procnum)
 {
         int     fop     = 0;
 
-        if (SFRAME_GET_PROGNUM (sframe) == GLUSTER_FOP_PROGRAM &&
-            SFRAME_GET_PROGVER (sframe) == GLUSTER_FOP_VERSION)
-                fop = SFRAME_GET_PROCNUM (sframe);
+        if (prog->prognum == GLUSTER_FOP_PROGRAM &&
+            prog->progver == GLUSTER_FOP_VERSION)
+                fop = procnum;
 
         return ((fop == GFS3_OP_LK) ||
                 (fop == GFS3_OP_INODELK) ||
@@ -77,6 +157,22 @@ _is_lock_fop (struct saved_frame *sframe)
                 (fop == GFS3_OP_FENTRYLK));
 }
 
+static int
+_is_lock_fop (struct saved_frame *sframe)
+{
+        return _is_lock_proc (sframe->rpcreq->prog,
+                              SFRAME_GET_PROCNUM (sframe));
+}
+
+/* lock requests (and so their unlocks) may block on the brick for as long
+   as other locks are held; holding them back for credits could keep the
+   unlock that would free those credits from ever going out */
+static int
+_is_flow_controlled (rpc_clnt_prog_t *prog, int procnum)
+{
+        return (prog->flow_controlled && !_is_lock_proc (prog, procnum));
+}
+
 struct saved_frame *
 __saved_frames_put (struct saved_frames *frames, void *frame,
                     struct rpc_req *rpcreq)
@@ -91,6 +187,7 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
 
         memset (saved_frame, 0, sizeof (*saved_frame));
 	INIT_LIST_HEAD (&saved_frame->list);
+        INIT_LIST_HEAD (&saved_frame->hash);
 
 	saved_frame->capital_this = THIS;
 	saved_frame->frame        = frame;
@@ -102,8 +199,17 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
         else
                 list_add_tail (&saved_frame->list, &frames->sf.list);
 
+        list_add_tail (&saved_frame->hash,
+                       __saved_frames_bucket (frames, rpcreq->xid));
+
 	frames->count++;
 
+        if (_is_flow_controlled (rpcreq->prog, rpcreq->procnum))
+                frames->flow_count++;
+
+        if (frames->count > 2 * frames->bucket_count)
+                __saved_frames_rehash (frames);
+
 out:
 	return saved_frame;
 }
@@ -118,8 +224,7 @@ saved_frames_delete (struct saved_frame *saved_frame,
 
         pthread_mutex_lock (&conn->lock);
         {
-                list_del_init (&saved_frame->list);
-                conn->saved_frames->count--;
+                __saved_frame_unlink (conn->saved_frames, saved_frame);
         }
         pthread_mutex_unlock (&conn->lock);
 
@@ -189,6 +294,9 @@ call_bail (void *data)
         }
         pthread_mutex_unlock (&conn->lock);
 
+        if (!list_empty (&list))
+                rpc_clnt_release_held (clnt);
+
         list_for_each_entry_safe (trav, tmp, &list, list) {
                 gf_time_fmt (frame_sent, sizeof frame_sent,
                              trav->saved_at.tv_sec, gf_timefmt_FT);
@@ -256,6 +364,7 @@ struct saved_frames *
 saved_frames_new (void)
 {
 	struct saved_frames *saved_frames = NULL;
+        int                  i            = 0;
 
 	saved_frames = GF_CALLOC (1, sizeof (*saved_frames),
                                   gf_common_mt_rpcclnt_savedframe_t);
@@ -266,6 +375,18 @@ saved_frames_new (void)
 	INIT_LIST_HEAD (&saved_frames->sf.list);
 	INIT_LIST_HEAD (&saved_frames->lk_sf.list);
 
+        saved_frames->buckets = GF_CALLOC (SAVED_FRAMES_HASH_SIZE,
+                                           sizeof (*saved_frames->buckets),
+                                           gf_common_mt_rpcclnt_savedframe_hash);
+        if (!saved_frames->buckets) {
+                GF_FREE (saved_frames);
+                return NULL;
+        }
+
+        saved_frames->bucket_count = SAVED_FRAMES_HASH_SIZE;
+        for (i = 0; i < SAVED_FRAMES_HASH_SIZE; i++)
+                INIT_LIST_HEAD (&saved_frames->buckets[i]);
+
 	return saved_frames;
 }
 
@@ -282,21 +403,11 @@ __saved_frame_copy (struct saved_frames *frames, int64_t callid,
                 goto out;
         }
 
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			goto out;
-		}
-	}
-
-	list_for_each_entry (tmp, &frames->lk_sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			goto out;
-		}
-	}
+        tmp = __saved_frame_find (frames, callid);
+        if (tmp) {
+                *saved_frame = *tmp;
+                ret = 0;
+        }
 
 out:
 	return ret;
@@ -307,28 +418,10 @@ struct saved_frame *
 __saved_frame_get (struct saved_frames *frames, int64_t callid)
 {
 	struct saved_frame *saved_frame = NULL;
-	struct saved_frame *tmp = NULL;
-
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			goto out;
-		}
-	}
 
-	list_for_each_entry (tmp, &frames->lk_sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			goto out;
-		}
-	}
-
-out:
+        saved_frame = __saved_frame_find (frames, callid);
 	if (saved_frame) {
+                __saved_frame_unlink (frames, saved_frame);
                 THIS  = saved_frame->capital_this;
         }
 
@@ -379,6 +472,7 @@ saved_frames_unwind (struct saved_frames *saved_frames)
 
                 clnt = rpc_clnt_unref (clnt);
 		list_del_init (&trav->list);
+                list_del_init (&trav->hash);
                 mem_put (trav);
 	}
 }
@@ -392,10 +486,175 @@ saved_frames_destroy (struct saved_frames *frames)
 
 	saved_frames_unwind (frames);
 
+        GF_FREE (frames->buckets);
 	GF_FREE (frames);
 }
 
 
+/* a request of a flow controlled program, built but not yet handed to the
+   transport as the server has no credits left for it. the iovec arrays of
+   the caller are copied behind it, the buffers are kept by the iobrefs. */
+struct rpc_held_req {
+        struct list_head     list;
+        struct rpc_req      *rpcreq;
+        void                *frame;
+        rpc_transport_req_t  req;
+        struct iovec         rpchdr;
+        struct iovec         iov[0];
+};
+
+
+static gf_boolean_t
+__rpc_clnt_out_of_credits (struct rpc_clnt *rpc)
+{
+        rpc_clnt_connection_t *conn = &rpc->conn;
+
+        return (rpc->flow_control && conn->credits &&
+                (conn->saved_frames->flow_count >= conn->credits));
+}
+
+
+static struct iovec *
+rpc_held_copy_iov (struct iovec *dst, struct iovec *src, int count)
+{
+        if (count)
+                memcpy (dst, src, count * sizeof (*src));
+
+        return dst + count;
+}
+
+
+static int
+__rpc_clnt_hold (struct rpc_clnt *rpc, rpc_transport_req_t *req, void *frame)
+{
+        struct rpc_held_req *held  = NULL;
+        struct iovec        *iov   = NULL;
+        int                  count = 0;
+
+        count = req->msg.proghdrcount + req->msg.progpayloadcount +
+                req->rsp.rsphdr_count + req->rsp.rsp_payload_count;
+
+        held = GF_CALLOC (1, sizeof (*held) + count * sizeof (*iov),
+                          gf_common_mt_rpcclnt_held_t);
+        if (!held)
+                return -1;
+
+        held->rpcreq = req->rpc_req;
+        held->frame  = frame;
+        held->req    = *req;
+        held->rpchdr = *req->msg.rpchdr;
+        held->req.msg.rpchdr = &held->rpchdr;
+
+        iov = held->iov;
+        held->req.msg.proghdr = iov;
+        iov = rpc_held_copy_iov (iov, req->msg.proghdr,
+                                 req->msg.proghdrcount);
+        held->req.msg.progpayload = iov;
+        iov = rpc_held_copy_iov (iov, req->msg.progpayload,
+                                 req->msg.progpayloadcount);
+        held->req.rsp.rsphdr = iov;
+        iov = rpc_held_copy_iov (iov, req->rsp.rsphdr,
+                                 req->rsp.rsphdr_count);
+        held->req.rsp.rsp_payload = iov;
+        rpc_held_copy_iov (iov, req->rsp.rsp_payload,
+                           req->rsp.rsp_payload_count);
+
+        held->req.msg.iobref = iobref_ref (req->msg.iobref);
+        if (req->rsp.rsp_iobref)
+                held->req.rsp.rsp_iobref = iobref_ref (req->rsp.rsp_iobref);
+
+        list_add_tail (&held->list, &rpc->conn.held);
+        rpc->conn.held_count++;
+
+        return 0;
+}
+
+
+static void
+rpc_held_req_destroy (struct rpc_held_req *held)
+{
+        iobref_unref (held->req.msg.iobref);
+        if (held->req.rsp.rsp_iobref)
+                iobref_unref (held->req.rsp.rsp_iobref);
+
+        GF_FREE (held);
+}
+
+
+/* fail requests which never made it to the transport */
+static void
+rpc_held_unwind (struct rpc_clnt *rpc, struct list_head *list)
+{
+        struct rpc_held_req *held = NULL;
+        struct rpc_held_req *tmp  = NULL;
+
+        list_for_each_entry_safe (held, tmp, list, list) {
+                list_del_init (&held->list);
+
+                held->rpcreq->rpc_status = -1;
+                held->rpcreq->cbkfn (held->rpcreq, NULL, 0, held->frame);
+                mem_put (held->rpcreq);
+
+                rpc_held_req_destroy (held);
+        }
+}
+
+
+/* submit held requests for as long as there are credits for them */
+static void
+rpc_clnt_release_held (struct rpc_clnt *rpc)
+{
+        rpc_clnt_connection_t *conn   = NULL;
+        struct rpc_held_req   *held   = NULL;
+        struct list_head       failed;
+        int                    ret    = -1;
+
+        conn = &rpc->conn;
+        INIT_LIST_HEAD (&failed);
+
+        pthread_mutex_lock (&conn->lock);
+        {
+                while (!list_empty (&conn->held) &&
+                       !__rpc_clnt_out_of_credits (rpc)) {
+                        held = list_entry (conn->held.next,
+                                           struct rpc_held_req, list);
+                        list_del_init (&held->list);
+                        conn->held_count--;
+
+                        ret = rpc_transport_submit_request (conn->trans,
+                                                            &held->req);
+                        if (ret == -1) {
+                                list_add_tail (&held->list, &failed);
+                                continue;
+                        }
+
+                        __save_frame (rpc, held->frame, held->rpcreq);
+                        rpc_held_req_destroy (held);
+                }
+        }
+        pthread_mutex_unlock (&conn->lock);
+
+        rpc_held_unwind (rpc, &failed);
+}
+
+
+void
+rpc_clnt_set_flow_control (struct rpc_clnt *rpc, gf_boolean_t on)
+{
+        if (!rpc)
+                return;
+
+        pthread_mutex_lock (&rpc->conn.lock);
+        {
+                rpc->flow_control = on;
+        }
+        pthread_mutex_unlock (&rpc->conn.lock);
+
+        if (!on)
+                rpc_clnt_release_held (rpc);
+}
+
+
 void
 rpc_clnt_reconnect (void *trans_ptr)
 {
@@ -521,12 +780,14 @@ rpc_clnt_connection_cleanup (rpc_clnt_connection_t *conn)
 {
         struct saved_frames    *saved_frames = NULL;
         struct rpc_clnt         *clnt  = NULL;
+        struct list_head        held;
 
         if (!conn) {
                 goto out;
         }
 
         clnt = conn->rpc_clnt;
+        INIT_LIST_HEAD (&held);
 
         gf_log (conn->trans->name, GF_LOG_TRACE,
                 "cleaning up state in transport object %p", conn->trans);
@@ -536,6 +797,11 @@ rpc_clnt_connection_cleanup (rpc_clnt_connection_t *conn)
                 saved_frames = conn->saved_frames;
                 conn->saved_frames = saved_frames_new ();
 
+                /* the next server tells its own window */
+                list_splice_init (&conn->held, &held);
+                conn->held_count = 0;
+                conn->credits = 0;
+
                 /* bailout logic cleanup */
                 if (conn->timer) {
                         gf_timer_call_cancel (clnt->ctx, conn->timer);
@@ -553,6 +819,7 @@ rpc_clnt_connection_cleanup (rpc_clnt_connection_t *conn)
         pthread_mutex_unlock (&conn->lock);
 
         saved_frames_destroy (saved_frames);
+        rpc_held_unwind (clnt, &held);
 
 out:
         return 0;
@@ -667,6 +934,17 @@ rpc_clnt_reply_init (rpc_clnt_connection_t *conn, rpc_transport_pollin_t *msg,
                 goto out;
         }
 
+        if ((rpc_reply_status (&rpcmsg) == MSG_ACCEPTED) &&
+            (rpc_reply_verf_flavour (&rpcmsg) == AUTH_GLUSTERFS_CREDITS) &&
+            (rpc_reply_verf_len (&rpcmsg) == sizeof (uint32_t))) {
+                pthread_mutex_lock (&conn->lock);
+                {
+                        conn->credits =
+                                ntoh32 (*(uint32_t *)req->verf.authdata);
+                }
+                pthread_mutex_unlock (&conn->lock);
+        }
+
         ret = rpc_clnt_reply_fill (msg, conn, &rpcmsg, progmsg, req,
                                    saved_frame);
         if (ret != 0) {
@@ -781,6 +1059,10 @@ rpc_clnt_handle_reply (struct rpc_clnt *clnt, rpc_transport_pollin_t *pollin)
                         "initialising rpc reply failed");
         }
 
+        /* a credit came back, and maybe a new window with it */
+        if (!list_empty (&conn->held))
+                rpc_clnt_release_held (clnt);
+
         req->cbkfn (req, req->rsp, req->rspcnt, saved_frame->frame);
 
         if (req) {
@@ -958,6 +1240,7 @@ rpc_clnt_connection_init (struct rpc_clnt *clnt, glusterfs_ctx_t *ctx,
 
         conn = &clnt->conn;
         pthread_mutex_init (&clnt->conn.lock, NULL);
+        INIT_LIST_HEAD (&conn->held);
 
         ret = dict_get_int32 (options, "frame-timeout",
                               &conn->frame_timeout);
@@ -1233,6 +1516,11 @@ rpc_clnt_record_build_record (struct rpc_clnt *clnt, int prognum, int progver,
                 goto out;
         }
 
+        /* ask for a credit window in the reply, servers not knowing about
+           it echo the empty verifier */
+        if (clnt->flow_control)
+                request.rm_call.cb_verf.oa_flavor = AUTH_GLUSTERFS_CREDITS;
+
         xdr_size = xdr_sizeof ((xdrproc_t)xdr_callmsg, &request);
 
         /* First, try to get a pointer into the buffer which the RPC
@@ -1485,6 +1773,22 @@ rpc_clnt_submit (struct rpc_clnt *rpc, rpc_clnt_prog_t *prog,
                                 conn->config.remote_port = 0;
                 }
 
+                /* keep the order: once anything is held, all that is
+                   flow controlled is held */
+                if (_is_flow_controlled (prog, procnum) && frame &&
+                    conn->connected &&
+                    (!list_empty (&conn->held) ||
+                     __rpc_clnt_out_of_credits (rpc))) {
+                        ret = __rpc_clnt_hold (rpc, &req, frame);
+                        if (ret == 0) {
+                                gf_log ("rpc-clnt", GF_LOG_TRACE, "holding "
+                                        "request (XID: 0x%ux) until the "
+                                        "server grants a credit",
+                                        rpcreq->xid);
+                                goto unlock;
+                        }
+                }
+
                 ret = rpc_transport_submit_request (rpc->conn.trans,
                                                     &req);
                 if (ret == -1) {
@@ -1507,6 +1811,7 @@ rpc_clnt_submit (struct rpc_clnt *rpc, rpc_clnt_prog_t *prog,
                                 rpcreq->procnum, rpc->conn.trans->name);
                 }
         }
+unlock:
         pthread_mutex_unlock (&conn->lock);
 
         if (ret == -1) {
@@ -1563,6 +1868,7 @@ rpc_clnt_destroy (struct rpc_clnt *rpc)
 
         rpc_clnt_reconnect_cleanup (&rpc->conn);
         saved_frames_destroy (rpc->conn.saved_frames);
+        rpc_held_unwind (rpc, &rpc->conn.held);
         pthread_mutex_destroy (&rpc->lock);
         pthread_mutex_destroy (&rpc->conn.lock);
 
@@ -1595,6 +1901,20 @@ rpc_clnt_unref (struct rpc_clnt *rpc)
 }
 
 
+void
+rpc_clnt_enable (struct rpc_clnt *rpc)
+{
+        if (!rpc)
+                return;
+
+        pthread_mutex_lock (&rpc->conn.lock);
+        {
+                rpc->disabled = 0;
+        }
+        pthread_mutex_unlock (&rpc->conn.lock);
+}
+
+
 void
 rpc_clnt_disable (struct rpc_clnt *rpc)
 {
@@ -54,12 +54,22 @@ struct saved_frame {
 	struct timeval           saved_at;
         struct rpc_req          *rpcreq;
         rpc_transport_rsp_t      rsp;
+        struct list_head         hash;    /* xid chain in saved_frames */
 };
 
+/* Initial number of xid buckets, doubled whenever the outstanding calls
+   outnumber the buckets two to one */
+#define SAVED_FRAMES_HASH_SIZE  256
+
+/* sf is in send order, which is also bail-out order since every frame gets
+   the same frame-timeout. lk_sf holds lock fops, which are never bailed. */
 struct saved_frames {
 	int64_t            count;
 	struct saved_frame sf;
 	struct saved_frame lk_sf;
+        struct list_head  *buckets;
+        uint32_t           bucket_count;
+        uint32_t           flow_count; /* of flow controlled programs */
 };
 
 
@@ -76,6 +86,8 @@ typedef struct rpc_clnt_program {
         rpc_clnt_procedure_t *proctable;
         char                **procnames;
         int                   numproc;
+        gf_boolean_t          flow_controlled; /* held back while the server
+                                                  grants no more credits */
 } rpc_clnt_prog_t;
 
 typedef int (*rpcclnt_cb_fn) (struct rpc_clnt *rpc, void *mydata, void *data);
@@ -143,6 +155,10 @@ struct rpc_clnt_connection {
 	struct timeval           last_sent;
 	struct timeval           last_received;
 	int32_t                  ping_started;
+        uint32_t                 credits;      /* granted by the server,
+                                                  0: no limit */
+        struct list_head         held;         /* waiting for credits */
+        uint32_t                 held_count;
 };
 typedef struct rpc_clnt_connection rpc_clnt_connection_t;
 
@@ -182,6 +198,7 @@ typedef struct rpc_clnt {
         int                   refcount;
         int                   auth_null;
         char                  disabled;
+        char                  flow_control;
 } rpc_clnt_t;
 
 
@@ -193,6 +210,8 @@ int rpc_clnt_start (struct rpc_clnt *rpc);
 int rpc_clnt_register_notify (struct rpc_clnt *rpc, rpc_clnt_notify_t fn,
                               void *mydata);
 
+void rpc_clnt_set_flow_control (struct rpc_clnt *rpc, gf_boolean_t on);
+
 /* Some preconditions related to vectors holding responses.
  * @rsphdr: should contain pointer to buffer which can hold response header
  *          and length of the program header. In case of procedures whose
@@ -244,4 +263,8 @@ rpc_clnt_transport_unix_options_build (dict_t **options, char *filepath,
 void
 rpc_clnt_disable (struct rpc_clnt *rpc);
 
+/* undo rpc_clnt_disable (), rpc_clnt_start () connects again */
+void
+rpc_clnt_enable (struct rpc_clnt *rpc);
+
 #endif /* !_RPC_CLNT_H */
@@ -47,6 +47,23 @@ out:
         return ret;
 }
 
+int32_t
+rpc_transport_throttle (rpc_transport_t *this, gf_boolean_t onoff)
+{
+        int32_t ret = -1;
+        GF_VALIDATE_OR_GOTO ("rpc", this, out);
+
+        if (!this->ops->throttle) {
+                errno = ENOSYS;
+                goto out;
+        }
+
+        ret = this->ops->throttle (this, onoff);
+
+out:
+        return ret;
+}
+
 int32_t
 rpc_transport_get_myname (rpc_transport_t *this, char *hostname, int hostlen)
 {
@@ -368,6 +385,14 @@ rpc_transport_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
 	GF_VALIDATE_OR_GOTO("rpc_transport", this, fail);
 	GF_VALIDATE_OR_GOTO("rpc_transport", this->ops, fail);
 
+        /* transports which only know how to send memory get the
+           payload copied in here */
+        if (!this->pipe_payload && reply->msg.iobref) {
+                ret = iobref_materialize (reply->msg.iobref);
+                if (ret)
+                        goto fail;
+        }
+
 	ret = this->ops->submit_reply (this, reply);
 fail:
 	return ret;
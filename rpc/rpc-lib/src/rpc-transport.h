@@ -202,9 +202,26 @@ struct rpc_transport {
 
         uint64_t                   total_bytes_read;
         uint64_t                   total_bytes_write;
+        uint64_t                   total_msgs_write;
+        uint64_t                   total_writev_calls;
+        uint64_t                   total_spin_hits;    /* messages found by
+                                                          busy-polling */
+        uint64_t                   total_spin_misses;  /* spins that ended
+                                                          in epoll */
+
+        /* server side request accounting, owned by rpcsvc */
+        uint32_t                   outstanding_rpc_count;
+        gf_boolean_t               rpc_throttled;
+        struct list_head           rpcsvc_queue;   /* requests waiting for
+                                                      dispatch */
+        struct list_head           rpcsvc_active;  /* in svc->active */
+        uint32_t                   rpcsvc_queued;
+        int64_t                    rpcsvc_deficit;
 
         struct list_head           list;
         int                        bind_insecure;
+        gf_boolean_t               pipe_payload; /* can send pipe-backed
+                                                    iobufs as they are */
 	void                      *dl_handle; /* handle of dlopen() */
 };
 
@@ -229,6 +246,8 @@ struct rpc_transport_ops {
         int32_t (*get_myaddr)     (rpc_transport_t *this, char *peeraddr,
                                    int addrlen, struct sockaddr_storage *sa,
                                    socklen_t sasize);
+        /* stop (onoff = _gf_true) or resume reading from the peer */
+        int32_t (*throttle)       (rpc_transport_t *this, gf_boolean_t onoff);
 };
 
 
@@ -285,6 +304,9 @@ int32_t
 rpc_transport_get_myaddr (rpc_transport_t *this, char *peeraddr, int addrlen,
                           struct sockaddr_storage *sa, size_t salen);
 
+int32_t
+rpc_transport_throttle (rpc_transport_t *this, gf_boolean_t onoff);
+
 rpc_transport_pollin_t *
 rpc_transport_pollin_alloc (rpc_transport_t *this, struct iovec *vector,
                             int count, struct iobuf *hdr_iobuf,
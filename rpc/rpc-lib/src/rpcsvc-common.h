@@ -67,6 +67,23 @@ typedef struct rpcsvc_state {
         void                    *mydata; /* This is xlator */
         rpcsvc_notify_t          notifyfn;
         struct mem_pool         *rxpool;
+
+        /* input from a client with this many requests in progress is not
+         * read until one of them is replied to (0 = no limit).
+         */
+        uint32_t                 outstanding_rpc_limit;
+
+        /* at most this many requests are handed to the programs at once,
+         * the rest wait in per-client queues served in deficit round
+         * robin order (0 = dispatch right away).
+         */
+        uint32_t                 dispatch_limit;
+
+        pthread_mutex_t          queue_lock;
+        struct list_head         active;   /* clients with queued requests */
+        uint32_t                 dispatched;
+        uint32_t                 queued;
+        gf_boolean_t             dispatching;
 } rpcsvc_t;
 
 
@@ -27,6 +27,7 @@
 #include "xdr-common.h"
 #include "xdr-generic.h"
 #include "rpc-common-xdr.h"
+#include "protocol-common.h"
 
 #include <errno.h>
 #include <pthread.h>
@@ -58,6 +59,9 @@ int
 rpcsvc_notify (rpc_transport_t *trans, void *mydata,
                rpc_transport_event_t event, void *data, ...);
 
+void
+rpcsvc_request_destroy (rpcsvc_request_t *req);
+
 rpcsvc_notify_wrapper_t *
 rpcsvc_notify_wrapper_alloc (void)
 {
@@ -255,6 +259,9 @@ rpcsvc_accept (rpcsvc_t *svc, rpc_transport_t *listen_trans,
                 goto out;
         }
 
+        INIT_LIST_HEAD (&new_trans->rpcsvc_queue);
+        INIT_LIST_HEAD (&new_trans->rpcsvc_active);
+
         rpcsvc_program_notify (listener, RPCSVC_EVENT_ACCEPT, new_trans);
         ret = 0;
 out:
@@ -262,6 +269,253 @@ out:
 }
 
 
+/* called with svc->queue_lock held. stop reading from @trans while it has
+ * outstanding_rpc_limit requests in progress.
+ */
+static void
+__rpcsvc_throttle (rpcsvc_t *svc, rpc_transport_t *trans)
+{
+        gf_boolean_t  throttle = _gf_false;
+
+        throttle = (svc->outstanding_rpc_limit &&
+                    (trans->outstanding_rpc_count >=
+                     svc->outstanding_rpc_limit));
+
+        if (throttle == trans->rpc_throttled)
+                return;
+
+        if (rpc_transport_throttle (trans, throttle) != 0) {
+                gf_log (GF_RPCSVC, GF_LOG_DEBUG, "transport %s cannot be "
+                        "throttled", trans->name);
+                return;
+        }
+
+        trans->rpc_throttled = throttle;
+
+        gf_log (GF_RPCSVC, GF_LOG_DEBUG, "%s input from %s (%u requests "
+                "outstanding)", throttle ? "throttling" : "resuming",
+                trans->peerinfo.identifier, trans->outstanding_rpc_count);
+}
+
+
+/* called with svc->queue_lock held. pick the next request to dispatch in
+ * deficit round robin order: the client at the head of svc->active gets
+ * requests dispatched as long as its deficit covers their cost, then goes
+ * to the tail with another quantum added.
+ */
+static rpcsvc_request_t *
+__rpcsvc_queue_next (rpcsvc_t *svc)
+{
+        rpc_transport_t  *trans = NULL;
+        rpcsvc_request_t *req = NULL;
+
+        while (!list_empty (&svc->active)) {
+                trans = list_entry (svc->active.next, rpc_transport_t,
+                                    rpcsvc_active);
+                req = list_entry (trans->rpcsvc_queue.next,
+                                  rpcsvc_request_t, queue);
+
+                if (trans->rpcsvc_deficit < (int64_t) req->cost) {
+                        trans->rpcsvc_deficit += RPCSVC_DRR_QUANTUM;
+                        list_move_tail (&trans->rpcsvc_active, &svc->active);
+                        continue;
+                }
+
+                trans->rpcsvc_deficit -= req->cost;
+                list_del_init (&req->queue);
+                trans->rpcsvc_queued--;
+                svc->queued--;
+
+                if (list_empty (&trans->rpcsvc_queue)) {
+                        list_del_init (&trans->rpcsvc_active);
+                        trans->rpcsvc_deficit = 0;
+                }
+
+                return req;
+        }
+
+        return NULL;
+}
+
+
+/* hand queued requests to their actors while below svc->dispatch_limit. only
+ * one thread runs the loop at a time, so an actor replying inline does not
+ * recurse into it.
+ */
+static void
+rpcsvc_queue_run (rpcsvc_t *svc)
+{
+        rpcsvc_request_t *req = NULL;
+        xlator_t         *old_THIS = NULL;
+        int               ret = -1;
+
+        pthread_mutex_lock (&svc->queue_lock);
+        {
+                if (svc->dispatching) {
+                        pthread_mutex_unlock (&svc->queue_lock);
+                        return;
+                }
+                svc->dispatching = _gf_true;
+        }
+        pthread_mutex_unlock (&svc->queue_lock);
+
+        old_THIS = THIS;
+
+        for (;;) {
+                pthread_mutex_lock (&svc->queue_lock);
+                {
+                        req = NULL;
+                        if (!svc->dispatch_limit ||
+                            (svc->dispatched < svc->dispatch_limit))
+                                req = __rpcsvc_queue_next (svc);
+
+                        if (req) {
+                                req->dispatched = _gf_true;
+                                svc->dispatched++;
+                        } else {
+                                svc->dispatching = _gf_false;
+                        }
+                }
+                pthread_mutex_unlock (&svc->queue_lock);
+
+                if (!req)
+                        break;
+
+                THIS = svc->mydata;
+
+                ret = req->prog->actors[req->procnum].actor (req);
+                if (ret == RPCSVC_ACTOR_ERROR) {
+                        ret = rpcsvc_error_reply (req);
+                }
+
+                if (ret)
+                        gf_log ("rpcsvc", GF_LOG_WARNING,
+                                "failed to queue error reply");
+        }
+
+        THIS = old_THIS;
+}
+
+
+static void
+rpcsvc_request_enqueue (rpcsvc_t *svc, rpcsvc_request_t *req)
+{
+        rpc_transport_t *trans = NULL;
+        int              i = 0;
+
+        trans = req->trans;
+
+        req->cost = RPCSVC_DRR_CALL_COST;
+        for (i = 0; i < req->count; i++)
+                req->cost += req->msg[i].iov_len;
+
+        pthread_mutex_lock (&svc->queue_lock);
+        {
+                list_add_tail (&req->queue, &trans->rpcsvc_queue);
+                if (!trans->rpcsvc_queued++)
+                        list_add_tail (&trans->rpcsvc_active, &svc->active);
+                svc->queued++;
+        }
+        pthread_mutex_unlock (&svc->queue_lock);
+}
+
+
+/* drop the requests of a disconnected client which were never dispatched */
+static void
+rpcsvc_queue_purge (rpcsvc_t *svc, rpc_transport_t *trans)
+{
+        rpcsvc_request_t *req = NULL;
+        rpcsvc_request_t *tmp = NULL;
+        struct list_head  purged;
+
+        INIT_LIST_HEAD (&purged);
+
+        pthread_mutex_lock (&svc->queue_lock);
+        {
+                list_splice_init (&trans->rpcsvc_queue, &purged);
+                svc->queued -= trans->rpcsvc_queued;
+                trans->rpcsvc_queued = 0;
+                trans->rpcsvc_deficit = 0;
+                list_del_init (&trans->rpcsvc_active);
+        }
+        pthread_mutex_unlock (&svc->queue_lock);
+
+        list_for_each_entry_safe (req, tmp, &purged, queue) {
+                list_del_init (&req->queue);
+                rpcsvc_request_destroy (req);
+        }
+}
+
+
+/* lock requests may wait on the brick for as long as the lock is held,
+ * possibly by this very client. were they counted or queued, enough
+ * blocked locks would keep the unlock from being read or dispatched, so
+ * they never are; nor are compounds, which can carry locks.
+ */
+static gf_boolean_t
+rpcsvc_request_may_block (rpcsvc_request_t *req)
+{
+        if ((req->prognum != GLUSTER_FOP_PROGRAM) ||
+            (req->progver != GLUSTER_FOP_VERSION))
+                return _gf_false;
+
+        switch (req->procnum) {
+        case GFS3_OP_LK:
+        case GFS3_OP_INODELK:
+        case GFS3_OP_FINODELK:
+        case GFS3_OP_ENTRYLK:
+        case GFS3_OP_FENTRYLK:
+        case GFS3_OP_COMPOUND:
+                return _gf_true;
+        }
+
+        return _gf_false;
+}
+
+
+static void
+rpcsvc_request_outstanding (rpcsvc_request_t *req)
+{
+        rpcsvc_t *svc = req->svc;
+
+        if (rpcsvc_request_may_block (req))
+                return;
+
+        pthread_mutex_lock (&svc->queue_lock);
+        {
+                req->outstanding = _gf_true;
+                req->trans->outstanding_rpc_count++;
+                __rpcsvc_throttle (svc, req->trans);
+        }
+        pthread_mutex_unlock (&svc->queue_lock);
+}
+
+
+static void
+rpcsvc_request_done (rpcsvc_request_t *req)
+{
+        rpcsvc_t     *svc = req->svc;
+        gf_boolean_t  run = _gf_false;
+
+        pthread_mutex_lock (&svc->queue_lock);
+        {
+                if (req->outstanding) {
+                        req->trans->outstanding_rpc_count--;
+                        __rpcsvc_throttle (svc, req->trans);
+                }
+
+                if (req->dispatched) {
+                        svc->dispatched--;
+                        run = (svc->queued > 0);
+                }
+        }
+        pthread_mutex_unlock (&svc->queue_lock);
+
+        if (run)
+                rpcsvc_queue_run (svc);
+}
+
+
 void
 rpcsvc_request_destroy (rpcsvc_request_t *req)
 {
@@ -269,6 +523,10 @@ rpcsvc_request_destroy (rpcsvc_request_t *req)
                 goto out;
         }
 
+        if (req->outstanding || req->dispatched) {
+                rpcsvc_request_done (req);
+        }
+
         if (req->iobref) {
                 iobref_unref (req->iobref);
         }
@@ -325,6 +583,7 @@ rpcsvc_request_init (rpcsvc_t *svc, rpc_transport_t *trans,
         req->cred.datalen = rpc_call_cred_len (callmsg);
         req->verf.flavour = rpc_call_verf_flavour (callmsg);
         req->verf.datalen = rpc_call_verf_len (callmsg);
+        req->credits = (req->verf.flavour == AUTH_GLUSTERFS_CREDITS);
 
         /* AUTH */
         rpcsvc_auth_request_init (req);
@@ -478,6 +737,8 @@ rpcsvc_handle_rpc_call (rpcsvc_t *svc, rpc_transport_t *trans,
         if (!req)
                 goto err;
 
+        rpcsvc_request_outstanding (req);
+
         if (!rpcsvc_request_accepted (req))
                 goto err_reply;
 
@@ -494,6 +755,15 @@ rpcsvc_handle_rpc_call (rpcsvc_t *svc, rpc_transport_t *trans,
                         return -1;
         }
 
+        if ((req->rpc_err == SUCCESS) && svc->dispatch_limit &&
+            !rpcsvc_request_may_block (req)) {
+                /* wait for a turn among the other clients */
+                rpcsvc_request_enqueue (svc, req);
+                rpcsvc_queue_run (svc);
+                ret = 0;
+                goto err;
+        }
+
         if (req->rpc_err == SUCCESS) {
                 /* Before going to xlator code, set the THIS properly */
                 THIS = svc->mydata;
@@ -541,6 +811,9 @@ rpcsvc_handle_disconnect (rpcsvc_t *svc, rpc_transport_t *trans)
         event = (trans->listener == NULL) ? RPCSVC_EVENT_LISTENER_DEAD
                 : RPCSVC_EVENT_DISCONNECT;
 
+        if (event == RPCSVC_EVENT_DISCONNECT)
+                rpcsvc_queue_purge (svc, trans);
+
         pthread_mutex_lock (&svc->rpclock);
         {
                 if (!svc->notify_count)
@@ -901,6 +1174,32 @@ out:
 }
 
 
+/*
+ * the number of requests a client asking for credits may have in progress
+ * (0 = no limit). one slot of outstanding_rpc_limit is left for the calls
+ * it does not hold back, like pings. while the dispatch queue backs up the
+ * window shrinks in proportion, so that clients keep requests to themselves
+ * rather than have them wait in brick memory.
+ */
+static uint32_t
+rpcsvc_credit_grant (rpcsvc_t *svc)
+{
+        uint32_t  limit = 0;
+        uint32_t  busy  = 0;
+
+        if (!svc->outstanding_rpc_limit)
+                return 0;
+
+        limit = max (svc->outstanding_rpc_limit - 1, 1);
+
+        busy = svc->dispatched + svc->queued;
+        if (!svc->dispatch_limit || (busy <= svc->dispatch_limit))
+                return limit;
+
+        return max ((uint64_t)limit * svc->dispatch_limit / busy, 1);
+}
+
+
 int
 rpcsvc_fill_reply (rpcsvc_request_t *req, struct rpc_msg *reply)
 {
@@ -918,6 +1217,13 @@ rpcsvc_fill_reply (rpcsvc_request_t *req, struct rpc_msg *reply)
 
         prog = rpcsvc_request_program (req);
 
+        if (req->credits) {
+                *(uint32_t *)req->verf.authdata =
+                        hton32 (rpcsvc_credit_grant (req->svc));
+                req->verf.flavour = AUTH_GLUSTERFS_CREDITS;
+                req->verf.datalen = sizeof (uint32_t);
+        }
+
         if (req->rpc_status == MSG_ACCEPTED)
                 rpc_fill_accepted_reply (reply, req->rpc_err,
                                          (prog) ? prog->proglowvers : 0,
@@ -1763,11 +2069,72 @@ rpcsvc_init_options (rpcsvc_t *svc, dict_t *options)
                 gf_log (GF_RPCSVC, GF_LOG_DEBUG, "Portmap registration "
                         "disabled");
 
-        ret = 0;
+        ret = rpcsvc_set_outstanding_rpc_limit (svc, options, 0);
+        if (ret)
+                goto out;
+
+        ret = rpcsvc_set_dispatch_limit (svc, options);
 out:
         return ret;
 }
 
+
+int
+rpcsvc_set_outstanding_rpc_limit (rpcsvc_t *svc, dict_t *options,
+                                  uint32_t defvalue)
+{
+        uint32_t  limit = defvalue;
+
+        GF_ASSERT (svc);
+        GF_ASSERT (options);
+
+        if (dict_get (options, "rpc.outstanding-rpc-limit") &&
+            (dict_get_uint32 (options, "rpc.outstanding-rpc-limit",
+                              &limit) != 0)) {
+                gf_log (GF_RPCSVC, GF_LOG_ERROR, "invalid value of "
+                        "rpc.outstanding-rpc-limit");
+                return -1;
+        }
+
+        if (limit > RPCSVC_MAX_OUTSTANDING_RPC_LIMIT)
+                limit = RPCSVC_MAX_OUTSTANDING_RPC_LIMIT;
+
+        svc->outstanding_rpc_limit = limit;
+        gf_log (GF_RPCSVC, GF_LOG_DEBUG, "outstanding rpc limit set to %u",
+                limit);
+
+        return 0;
+}
+
+
+int
+rpcsvc_set_dispatch_limit (rpcsvc_t *svc, dict_t *options)
+{
+        uint32_t  limit = 0;
+
+        GF_ASSERT (svc);
+        GF_ASSERT (options);
+
+        if (dict_get (options, "rpc.dispatch-limit") &&
+            (dict_get_uint32 (options, "rpc.dispatch-limit", &limit) != 0)) {
+                gf_log (GF_RPCSVC, GF_LOG_ERROR, "invalid value of "
+                        "rpc.dispatch-limit");
+                return -1;
+        }
+
+        if (limit > RPCSVC_MAX_DISPATCH_LIMIT)
+                limit = RPCSVC_MAX_DISPATCH_LIMIT;
+
+        svc->dispatch_limit = limit;
+
+        /* requests already queued go out when the dispatched ones finish,
+           or right away when queueing was just turned off */
+        if (svc->queued)
+                rpcsvc_queue_run (svc);
+
+        return 0;
+}
+
 int
 rpcsvc_transport_unix_options_build (dict_t **options, char *filepath)
 {
@@ -1831,6 +2198,8 @@ rpcsvc_init (xlator_t *xl, glusterfs_ctx_t *ctx, dict_t *options,
                 return NULL;
 
         pthread_mutex_init (&svc->rpclock, NULL);
+        pthread_mutex_init (&svc->queue_lock, NULL);
+        INIT_LIST_HEAD (&svc->active);
         INIT_LIST_HEAD (&svc->authschemes);
         INIT_LIST_HEAD (&svc->notify);
         INIT_LIST_HEAD (&svc->listeners);
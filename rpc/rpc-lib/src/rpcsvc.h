@@ -49,6 +49,16 @@
 #define RPCSVC_CONN_READ        (128 * GF_UNIT_KB)
 #define RPCSVC_PAGE_SIZE        (128 * GF_UNIT_KB)
 
+#define RPCSVC_DEFAULT_OUTSTANDING_RPC_LIMIT 64
+#define RPCSVC_MAX_OUTSTANDING_RPC_LIMIT     65536
+#define RPCSVC_MAX_DISPATCH_LIMIT            65536
+
+/* deficit round robin: a client's turn is worth RPCSVC_DRR_QUANTUM bytes, a
+ * request costs its size plus RPCSVC_DRR_CALL_COST.
+ */
+#define RPCSVC_DRR_QUANTUM      (32 * GF_UNIT_KB)
+#define RPCSVC_DRR_CALL_COST    (4 * GF_UNIT_KB)
+
 /* RPC Record States */
 #define RPCSVC_READ_FRAGHDR     1
 #define RPCSVC_READ_FRAG        2
@@ -231,6 +241,19 @@ struct rpcsvc_request {
 
         /* Container for transport to store request-specific item */
         void                    *trans_private;
+
+        /* counted in trans->outstanding_rpc_count */
+        gf_boolean_t            outstanding;
+
+        /* counted in svc->dispatched */
+        gf_boolean_t            dispatched;
+
+        /* the client asked for a credit window in the reply verifier */
+        gf_boolean_t            credits;
+
+        /* in trans->rpcsvc_queue while waiting for dispatch */
+        struct list_head        queue;
+        size_t                  cost;
 };
 
 #define rpcsvc_request_program(req) ((rpcsvc_program_t *)((req)->prog))
@@ -539,6 +562,11 @@ rpcsvc_transport_unix_options_build (dict_t **options, char *filepath);
 int
 rpcsvc_set_allow_insecure (rpcsvc_t *svc, dict_t *options);
 int
+rpcsvc_set_outstanding_rpc_limit (rpcsvc_t *svc, dict_t *options,
+                                  uint32_t defvalue);
+int
+rpcsvc_set_dispatch_limit (rpcsvc_t *svc, dict_t *options);
+int
 rpcsvc_auth_array (rpcsvc_t *svc, char *volname, int *autharr, int arrlen);
 char *
 rpcsvc_volume_allowed (dict_t *options, char *volname);
@@ -36,6 +36,9 @@ typedef enum {
         AUTH_GLUSTERFS = 5,
         AUTH_GLUSTERFS_v2 = 390039, /* using a number from  'unused' range,
                                        from the list available in RFC5531 */
+        AUTH_GLUSTERFS_CREDITS = 390040, /* verifier: empty in a call asking
+                                            for a credit window, which the
+                                            reply carries as a uint32 */
 } gf_rpc_authtype_t;
 
 /* Converts a given network buffer from its XDR format to a structure
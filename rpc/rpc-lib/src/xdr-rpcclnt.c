@@ -43,6 +43,7 @@ xdr_to_rpc_reply (char *msgbuf, size_t len, struct rpc_msg *reply,
         memset (reply, 0, sizeof (struct rpc_msg));
 
         reply->acpted_rply.ar_verf = _null_auth;
+        reply->acpted_rply.ar_verf.oa_base = verfbytes;
         reply->acpted_rply.ar_results.where = NULL;
         reply->acpted_rply.ar_results.proc = (xdrproc_t)(xdr_void);
 
@@ -29,6 +29,7 @@
 #define rpc_reply_status(reply)           ((reply)->ru.RM_rmb.rp_stat)
 #define rpc_accepted_reply_status(reply)  ((reply)->acpted_rply.ar_stat)
 #define rpc_reply_verf_flavour(reply)     ((reply)->acpted_rply.ar_verf.oa_flavor)
+#define rpc_reply_verf_len(reply)         ((reply)->acpted_rply.ar_verf.oa_length)
 
 int xdr_to_rpc_reply (char *msgbuf, size_t len, struct rpc_msg *reply,
                       struct iovec *payload, char *verfbytes);
@@ -0,0 +1,1707 @@
+/*
+  Copyright (c) 2008-2012 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "shm.h"
+#include "dict.h"
+#include "rpc-transport.h"
+#include "logging.h"
+#include "xlator.h"
+#include "common-utils.h"
+#include "compat-errno.h"
+
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#define SA(ptr) ((struct sockaddr *)ptr)
+
+#define SHM_RING_SIZE_OPT   "transport.shm.ring-size"
+#define SHM_SOCKET_DIR_OPT  "transport.shm.socket-dir"
+
+int shm_init (rpc_transport_t *this);
+
+
+static int
+__shm_nonblock (int fd)
+{
+        int flags = 0;
+        int ret = -1;
+
+        flags = fcntl (fd, F_GETFL);
+
+        if (flags != -1)
+                ret = fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+
+        return ret;
+}
+
+
+static void
+shm_sock_path (shm_private_t *priv, uint16_t port, struct sockaddr_un *sun)
+{
+        memset (sun, 0, sizeof (*sun));
+        sun->sun_family = AF_UNIX;
+        snprintf (sun->sun_path, sizeof (sun->sun_path),
+                  "%s/gluster-shm-%d.socket", priv->socket_dir, port);
+}
+
+
+/* the peer can write anywhere in the rings. only let in what could as
+   well have come from a privileged port. */
+static int
+shm_peer_check (rpc_transport_t *this, int sock, pid_t *pid)
+{
+        struct ucred cred = {0, };
+        socklen_t    len = sizeof (cred);
+
+        if (getsockopt (sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not get peer credentials (%s)",
+                        strerror (errno));
+                return -1;
+        }
+
+        if (cred.uid != 0 && cred.uid != geteuid ()) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "rejecting peer %d running as uid %d",
+                        (int) cred.pid, (int) cred.uid);
+                return -1;
+        }
+
+        if (pid)
+                *pid = cred.pid;
+
+        return 0;
+}
+
+
+static int
+shm_send_fds (int sock, struct shm_hello *hello, int *fds, int nfds)
+{
+        struct msghdr   msg = {0, };
+        struct iovec    iov = {0, };
+        struct cmsghdr *cmsg = NULL;
+        char            buf[CMSG_SPACE (2 * sizeof (int))];
+
+        memset (buf, 0, sizeof (buf));
+
+        iov.iov_base = hello;
+        iov.iov_len = sizeof (*hello);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = buf;
+        msg.msg_controllen = CMSG_SPACE (nfds * sizeof (int));
+
+        cmsg = CMSG_FIRSTHDR (&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN (nfds * sizeof (int));
+        memcpy (CMSG_DATA (cmsg), fds, nfds * sizeof (int));
+
+        if (sendmsg (sock, &msg, MSG_NOSIGNAL) != sizeof (*hello))
+                return -1;
+
+        return 0;
+}
+
+
+/* returns the number of fds received, -1 with errno EAGAIN when nothing
+   has come in yet */
+static int
+shm_recv_fds (int sock, struct shm_hello *hello, int *fds, int nfds)
+{
+        struct msghdr   msg = {0, };
+        struct iovec    iov = {0, };
+        struct cmsghdr *cmsg = NULL;
+        char            buf[CMSG_SPACE (2 * sizeof (int))];
+        ssize_t         ret = 0;
+        int             count = 0;
+
+        iov.iov_base = hello;
+        iov.iov_len = sizeof (*hello);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = buf;
+        msg.msg_controllen = sizeof (buf);
+
+        ret = recvmsg (sock, &msg, MSG_CMSG_CLOEXEC);
+        if (ret == -1)
+                return -1;
+
+        for (cmsg = CMSG_FIRSTHDR (&msg); cmsg;
+             cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET ||
+                    cmsg->cmsg_type != SCM_RIGHTS)
+                        continue;
+
+                count = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+                if (count > nfds) {
+                        /* close what does not fit */
+                        int  i = 0;
+                        int *extra = (int *) CMSG_DATA (cmsg);
+
+                        for (i = nfds; i < count; i++)
+                                close (extra[i]);
+                        count = nfds;
+                }
+                memcpy (fds, CMSG_DATA (cmsg), count * sizeof (int));
+                break;
+        }
+
+        if (ret != sizeof (*hello) || (msg.msg_flags & MSG_CTRUNC)) {
+                while (count > 0)
+                        close (fds[--count]);
+                errno = EPROTO;
+                return -1;
+        }
+
+        return count;
+}
+
+
+static void
+__shm_unmap (shm_private_t *priv)
+{
+        if (priv->map)
+                munmap (priv->map, priv->map_size);
+
+        priv->map = NULL;
+        priv->map_size = 0;
+        priv->tx = priv->rx = NULL;
+        priv->tx_data = priv->rx_data = NULL;
+}
+
+
+/* the client sends on the first ring and receives on the second */
+static int
+__shm_map (rpc_transport_t *this, int memfd, uint32_t ring_size)
+{
+        shm_private_t   *priv = NULL;
+        struct shm_ring *ring = NULL;
+        void            *map = NULL;
+        size_t           map_size = 0;
+
+        priv = this->private;
+        map_size = SHM_CTL_SIZE + 2 * (size_t) ring_size;
+
+        map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    memfd, 0);
+        if (map == MAP_FAILED) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not map the rings (%s)", strerror (errno));
+                return -1;
+        }
+
+        __shm_unmap (priv);
+
+        priv->map = map;
+        priv->map_size = map_size;
+        priv->ring_size = ring_size;
+
+        ring = map;
+        priv->tx = priv->is_server ? &ring[1] : &ring[0];
+        priv->rx = priv->is_server ? &ring[0] : &ring[1];
+        priv->tx_data = (char *)map + SHM_CTL_SIZE +
+                (priv->is_server ? ring_size : 0);
+        priv->rx_data = (char *)map + SHM_CTL_SIZE +
+                (priv->is_server ? 0 : ring_size);
+
+        return 0;
+}
+
+
+static int
+__shm_create_rings (rpc_transport_t *this)
+{
+        shm_private_t   *priv = NULL;
+        struct shm_ring *ring = NULL;
+        int              memfd = -1;
+
+        priv = this->private;
+
+        memfd = memfd_create ("gluster-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (memfd == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "memfd_create failed (%s)", strerror (errno));
+                goto err;
+        }
+
+        if (ftruncate (memfd, SHM_CTL_SIZE + 2 * (off_t) priv->ring_size)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not size the rings (%s)", strerror (errno));
+                goto err;
+        }
+
+        /* the server will not map what could be shrunk under it */
+        if (fcntl (memfd, F_ADD_SEALS,
+                   F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not seal the rings (%s)", strerror (errno));
+                goto err;
+        }
+
+        if (__shm_map (this, memfd, priv->ring_size))
+                goto err;
+
+        /* nothing sent yet, both sides wait for the first doorbell */
+        ring = priv->map;
+        ring[0].waiting = 1;
+        ring[1].waiting = 1;
+
+        return memfd;
+err:
+        if (memfd != -1)
+                close (memfd);
+        return -1;
+}
+
+
+static void
+shm_ring_copy_in (char *data, uint32_t size, uint64_t pos, void *buf,
+                  size_t len)
+{
+        uint32_t off = pos & (size - 1);
+        size_t   first = min (len, (size_t) (size - off));
+
+        memcpy (data + off, buf, first);
+        if (first < len)
+                memcpy (data, (char *)buf + first, len - first);
+}
+
+
+static void
+shm_ring_copy_out (char *data, uint32_t size, uint64_t pos, void *buf,
+                   size_t len)
+{
+        uint32_t off = pos & (size - 1);
+        size_t   first = min (len, (size_t) (size - off));
+
+        memcpy (buf, data + off, first);
+        if (first < len)
+                memcpy ((char *)buf + first, data, len - first);
+}
+
+
+static void
+shm_doorbell (int efd)
+{
+        uint64_t one = 1;
+
+        if (efd != -1 && write (efd, &one, sizeof (one)) == -1 &&
+            errno != EAGAIN)
+                gf_log ("shm", GF_LOG_DEBUG, "doorbell write failed (%s)",
+                        strerror (errno));
+}
+
+
+static inline uint32_t
+shm_record_size (struct shm_ioq *entry)
+{
+        return (sizeof (struct shm_record) + entry->hdrlen +
+                entry->payloadlen + 7) & ~7;
+}
+
+
+static void
+shm_ioq_fill (struct shm_ioq *entry, rpc_transport_msg_t *msg, uint32_t type)
+{
+        memset (entry, 0, sizeof (*entry));
+
+        entry->type = type;
+        entry->hdrlen = iov_length (msg->rpchdr, msg->rpchdrcount)
+                + iov_length (msg->proghdr, msg->proghdrcount);
+        entry->payloadlen = iov_length (msg->progpayload,
+                                        msg->progpayloadcount);
+
+        if (msg->rpchdr != NULL) {
+                memcpy (&entry->vector[entry->count], msg->rpchdr,
+                        sizeof (struct iovec) * msg->rpchdrcount);
+                entry->count += msg->rpchdrcount;
+        }
+
+        if (msg->proghdr != NULL) {
+                memcpy (&entry->vector[entry->count], msg->proghdr,
+                        sizeof (struct iovec) * msg->proghdrcount);
+                entry->count += msg->proghdrcount;
+        }
+
+        if (msg->progpayload != NULL) {
+                memcpy (&entry->vector[entry->count], msg->progpayload,
+                        sizeof (struct iovec) * msg->progpayloadcount);
+                entry->count += msg->progpayloadcount;
+        }
+
+        INIT_LIST_HEAD (&entry->list);
+}
+
+
+static void
+__shm_ioq_entry_free (struct shm_ioq *entry)
+{
+        list_del_init (&entry->list);
+        if (entry->iobref)
+                iobref_unref (entry->iobref);
+
+        GF_FREE (entry);
+}
+
+
+static void
+__shm_ioq_flush (rpc_transport_t *this)
+{
+        shm_private_t  *priv = NULL;
+        struct shm_ioq *entry = NULL;
+
+        priv = this->private;
+
+        while (!list_empty (&priv->ioq)) {
+                entry = list_entry (priv->ioq.next, struct shm_ioq, list);
+                __shm_ioq_entry_free (entry);
+        }
+}
+
+
+/*
+ * copy @entry into the tx ring. returns 0 when done, 1 when the ring has
+ * no room for it yet; the consumer rings us once it has made some.
+ */
+static int
+__shm_ring_write (rpc_transport_t *this, struct shm_ioq *entry)
+{
+        shm_private_t     *priv = NULL;
+        struct shm_ring   *tx = NULL;
+        struct shm_record  rec = {0, };
+        uint64_t           head = 0;
+        uint64_t           pos = 0;
+        int                i = 0;
+
+        priv = this->private;
+        tx = priv->tx;
+
+        rec.size = shm_record_size (entry);
+        rec.type = entry->type;
+        rec.hdrlen = entry->hdrlen;
+        rec.payloadlen = entry->payloadlen;
+
+        head = tx->head;
+        if (priv->ring_size - (head - tx->tail) < rec.size) {
+                tx->space_wanted = 1;
+                __sync_synchronize ();
+                /* the consumer may have moved on before seeing the flag */
+                if (priv->ring_size - (head - tx->tail) < rec.size) {
+                        priv->ring_full++;
+                        return 1;
+                }
+                tx->space_wanted = 0;
+        }
+        /* no reads of the ring below may be done before the tail check */
+        __sync_synchronize ();
+
+        pos = head;
+        shm_ring_copy_in (priv->tx_data, priv->ring_size, pos, &rec,
+                          sizeof (rec));
+        pos += sizeof (rec);
+
+        for (i = 0; i < entry->count; i++) {
+                shm_ring_copy_in (priv->tx_data, priv->ring_size, pos,
+                                  entry->vector[i].iov_base,
+                                  entry->vector[i].iov_len);
+                pos += entry->vector[i].iov_len;
+        }
+
+        /* publish the record, then see whether the consumer sleeps */
+        __sync_synchronize ();
+        tx->head = head + rec.size;
+        __sync_synchronize ();
+
+        if (tx->waiting && __sync_bool_compare_and_swap (&tx->waiting, 1, 0))
+                shm_doorbell (priv->peer_efd);
+
+        this->total_bytes_write += rec.size;
+        this->total_msgs_write++;
+
+        return 0;
+}
+
+
+/* returns 0 when the ioq got emptied, 1 when it waits for room */
+static int
+__shm_ioq_churn (rpc_transport_t *this)
+{
+        shm_private_t  *priv = NULL;
+        struct shm_ioq *entry = NULL;
+        int             ret = 0;
+
+        priv = this->private;
+
+        while (!list_empty (&priv->ioq)) {
+                entry = list_entry (priv->ioq.next, struct shm_ioq, list);
+
+                ret = __shm_ring_write (this, entry);
+                if (ret)
+                        break;
+
+                __shm_ioq_entry_free (entry);
+        }
+
+        return ret;
+}
+
+
+static int
+__shm_ioq_submit (rpc_transport_t *this, rpc_transport_msg_t *msg,
+                  uint32_t type)
+{
+        shm_private_t  *priv = NULL;
+        struct shm_ioq  entry;
+        struct shm_ioq *queued = NULL;
+        int             count = 0;
+
+        priv = this->private;
+
+        count = msg->rpchdrcount + msg->proghdrcount + msg->progpayloadcount;
+        if (count > MAX_IOVEC) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "msg has %d vectors, at most %d are supported",
+                        count, MAX_IOVEC);
+                return -1;
+        }
+
+        shm_ioq_fill (&entry, msg, type);
+
+        if (shm_record_size (&entry) > priv->ring_size) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "msg size (%u) bigger than the ring (%u)",
+                        entry.hdrlen + entry.payloadlen, priv->ring_size);
+                return -1;
+        }
+
+        /* only go straight to the ring behind an empty queue, the
+           order must hold */
+        if (list_empty (&priv->ioq) && __shm_ring_write (this, &entry) == 0)
+                return 0;
+
+        queued = GF_CALLOC (1, sizeof (*queued), gf_common_mt_shm_ioq_t);
+        if (!queued)
+                return -1;
+
+        *queued = entry;
+        INIT_LIST_HEAD (&queued->list);
+        if (msg->iobref != NULL)
+                queued->iobref = iobref_ref (msg->iobref);
+
+        list_add_tail (&queued->list, &priv->ioq);
+
+        return 0;
+}
+
+
+/* returns 1 when the ring is empty */
+static int
+shm_read_msg (rpc_transport_t *this, rpc_transport_pollin_t **pollin)
+{
+        shm_private_t     *priv = NULL;
+        struct shm_ring   *rx = NULL;
+        struct shm_record  rec = {0, };
+        struct iobuf      *hdr_iobuf = NULL;
+        struct iobuf      *iobuf = NULL;
+        struct iobref     *iobref = NULL;
+        struct iovec       vector[2];
+        uint64_t           head = 0;
+        uint64_t           tail = 0;
+        uint64_t           pos = 0;
+        int                count = 1;
+        int                ret = -1;
+
+        priv = this->private;
+        rx = priv->rx;
+
+        head = rx->head;
+        tail = rx->tail;
+        if (head == tail)
+                return 1;
+        /* the record is complete once head says so */
+        __sync_synchronize ();
+
+        /* head is the peer's to write, nothing it says can be trusted */
+        if (head - tail > priv->ring_size || head - tail < sizeof (rec)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "bad ring positions (head %"PRIu64", tail %"PRIu64
+                        "), disconnecting", head, tail);
+                goto out;
+        }
+
+        shm_ring_copy_out (priv->rx_data, priv->ring_size, tail, &rec,
+                           sizeof (rec));
+
+        if ((rec.size & 7) || (rec.size > head - tail) ||
+            (rec.hdrlen == 0) || (rec.hdrlen > rec.size) ||
+            (rec.payloadlen > rec.size) ||
+            (sizeof (rec) + rec.hdrlen + rec.payloadlen > rec.size) ||
+            (rec.type != SHM_MSG_CALL && rec.type != SHM_MSG_REPLY)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "bad record (size %u, type %u, hdrlen %u, payload "
+                        "%u) in the ring, disconnecting", rec.size, rec.type,
+                        rec.hdrlen, rec.payloadlen);
+                goto out;
+        }
+
+        iobref = iobref_new ();
+        if (!iobref)
+                goto out;
+
+        hdr_iobuf = iobuf_get2 (this->ctx->iobuf_pool, rec.hdrlen);
+        if (!hdr_iobuf)
+                goto out;
+        iobref_add (iobref, hdr_iobuf);
+
+        pos = tail + sizeof (rec);
+        shm_ring_copy_out (priv->rx_data, priv->ring_size, pos,
+                           iobuf_ptr (hdr_iobuf), rec.hdrlen);
+        pos += rec.hdrlen;
+        vector[0].iov_base = iobuf_ptr (hdr_iobuf);
+        vector[0].iov_len = rec.hdrlen;
+
+        /* payload separate, as socket.c hands in vectored reads and
+           writes */
+        if (rec.payloadlen) {
+                iobuf = iobuf_get2 (this->ctx->iobuf_pool, rec.payloadlen);
+                if (!iobuf)
+                        goto out;
+                iobref_add (iobref, iobuf);
+
+                shm_ring_copy_out (priv->rx_data, priv->ring_size, pos,
+                                   iobuf_ptr (iobuf), rec.payloadlen);
+                vector[1].iov_base = iobuf_ptr (iobuf);
+                vector[1].iov_len = rec.payloadlen;
+                count = 2;
+        }
+
+        /* done with the ring, hand the room back */
+        __sync_synchronize ();
+        rx->tail = tail + rec.size;
+        __sync_synchronize ();
+
+        if (rx->space_wanted &&
+            __sync_bool_compare_and_swap (&rx->space_wanted, 1, 0))
+                shm_doorbell (priv->peer_efd);
+
+        this->total_bytes_read += rec.size;
+
+        *pollin = rpc_transport_pollin_alloc (this, vector, count, hdr_iobuf,
+                                              iobref, NULL);
+        if (*pollin == NULL)
+                goto out;
+
+        (*pollin)->is_reply = (rec.type == SHM_MSG_REPLY);
+        ret = 0;
+out:
+        if (hdr_iobuf)
+                iobuf_unref (hdr_iobuf);
+        if (iobuf)
+                iobuf_unref (iobuf);
+        if (iobref)
+                iobref_unref (iobref);
+
+        return ret;
+}
+
+
+/* the peer rang: there is something in rx, or room in tx, or both */
+static int
+shm_event_poll_in (rpc_transport_t *this)
+{
+        shm_private_t          *priv = NULL;
+        rpc_transport_pollin_t *pollin = NULL;
+        uint64_t                rung = 0;
+        int                     queued = 0;
+        int                     sent = 0;
+        int                     ret = 0;
+        int                     i = 0;
+
+        priv = this->private;
+
+        if (read (priv->efd, &rung, sizeof (rung)) == -1 && errno != EAGAIN)
+                return -1;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->connected != 1) {
+                        pthread_mutex_unlock (&priv->lock);
+                        return 0;
+                }
+
+                queued = !list_empty (&priv->ioq);
+                if (queued)
+                        sent = !__shm_ioq_churn (this);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        if (sent)
+                rpc_transport_notify (this, RPC_TRANSPORT_MSG_SENT, NULL);
+
+        priv->rx->waiting = 0;
+
+        for (i = 0; i < GF_SHM_POLL_BATCH; i++) {
+                if (priv->throttled)
+                        /* shm_throttle() rings us when it lifts */
+                        return 0;
+
+                pollin = NULL;
+                ret = shm_read_msg (this, &pollin);
+                if (ret < 0)
+                        return -1;
+
+                if (ret == 1) {
+                        priv->rx->waiting = 1;
+                        __sync_synchronize ();
+                        if (priv->rx->head == priv->rx->tail)
+                                return 0;
+                        priv->rx->waiting = 0;
+                        continue;
+                }
+
+                rpc_transport_notify (this, RPC_TRANSPORT_MSG_RECEIVED,
+                                      pollin);
+                rpc_transport_pollin_destroy (pollin);
+        }
+
+        /* let the other connections of this event thread have a go, and
+           come back for the rest */
+        shm_doorbell (priv->efd);
+
+        return 0;
+}
+
+
+static int
+shm_efd_event_handler (int fd, int idx, void *data,
+                       int poll_in, int poll_out, int poll_err)
+{
+        rpc_transport_t *this = NULL;
+        shm_private_t   *priv = NULL;
+        gf_boolean_t     retired = _gf_false;
+        int              ret = 0;
+
+        this = data;
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->xl, out);
+
+        THIS = this->xl;
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                retired = (fd != priv->efd);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        if (!retired && poll_in)
+                ret = shm_event_poll_in (this);
+
+        if (!retired && (ret < 0 || poll_err)) {
+                /* the unix socket sees the hangup and cleans up */
+                pthread_mutex_lock (&priv->lock);
+                {
+                        if (priv->sock != -1)
+                                shutdown (priv->sock, SHUT_RDWR);
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
+
+        /* __shm_reset() leaves the eventfd to us, we are the only ones
+           who know nobody is in here any more */
+        pthread_mutex_lock (&priv->lock);
+        {
+                retired = (fd != priv->efd);
+                if (retired) {
+                        event_unregister (this->ctx->event_pool, fd, idx);
+                        close (fd);
+                        priv->efd_retiring = 0;
+                }
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        if (retired)
+                /* taken in __shm_register_efd() */
+                rpc_transport_unref (this);
+
+out:
+        return ret;
+}
+
+
+static void
+__shm_reset (rpc_transport_t *this)
+{
+        shm_private_t *priv = NULL;
+
+        priv = this->private;
+
+        if (priv->efd != -1 && priv->efd_idx != -1) {
+                /* an event thread could be in the doorbell handler. ring
+                   it so that it lets go of the eventfd once out. */
+                priv->efd_retiring = 1;
+                shm_doorbell (priv->efd);
+        } else if (priv->efd != -1) {
+                close (priv->efd);
+        }
+        if (priv->peer_efd != -1)
+                close (priv->peer_efd);
+
+        event_unregister (this->ctx->event_pool, priv->sock, priv->idx);
+        close (priv->sock);
+
+        /* the rings stay mapped until the doorbell handler is done with
+           them. they go on the next connect or in fini. */
+        priv->sock = -1;
+        priv->idx = -1;
+        priv->efd = -1;
+        priv->efd_idx = -1;
+        priv->peer_efd = -1;
+        priv->connected = -1;
+}
+
+
+static int
+shm_event_poll_err (rpc_transport_t *this)
+{
+        shm_private_t *priv = NULL;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __shm_ioq_flush (this);
+                __shm_reset (this);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        rpc_transport_notify (this, RPC_TRANSPORT_DISCONNECT, this);
+
+        return 0;
+}
+
+
+static int
+__shm_register_efd (rpc_transport_t *this)
+{
+        shm_private_t *priv = NULL;
+
+        priv = this->private;
+
+        /* dropped by the handler when it lets go of the eventfd, fini
+           must not unmap the rings under it */
+        rpc_transport_ref (this);
+
+        priv->efd_idx = event_register (this->ctx->event_pool, priv->efd,
+                                        shm_efd_event_handler, this, 1, 0);
+        if (priv->efd_idx == -1) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not register the eventfd with events");
+                /* not the last ref, the unix socket holds one */
+                rpc_transport_unref (this);
+                return -1;
+        }
+
+        return 0;
+}
+
+
+/* server: map the client's rings and answer with our own eventfd */
+static int
+__shm_handshake_server (rpc_transport_t *this)
+{
+        shm_private_t    *priv = NULL;
+        struct shm_hello  hello = {0, };
+        struct stat       stbuf = {0, };
+        int               fds[2] = {-1, -1};
+        int               seals = 0;
+        int               ret = -1;
+
+        priv = this->private;
+
+        ret = shm_recv_fds (priv->sock, &hello, fds, 2);
+        if (ret == -1 && errno == EAGAIN)
+                return 0;
+
+        if (ret != 2 || hello.magic != GF_SHM_MAGIC ||
+            hello.version != GF_SHM_VERSION ||
+            hello.ring_size < GF_SHM_MIN_RING_SIZE ||
+            hello.ring_size > GF_SHM_MAX_RING_SIZE ||
+            (hello.ring_size & (hello.ring_size - 1))) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "bad hello from %s", this->peerinfo.identifier);
+                goto err;
+        }
+
+        /* a memfd the client could still shrink would have us fault on
+           the rings, so it has to be sealed first */
+        seals = fcntl (fds[0], F_GET_SEALS);
+        if (seals == -1 ||
+            (seals & (F_SEAL_SHRINK | F_SEAL_SEAL)) !=
+            (F_SEAL_SHRINK | F_SEAL_SEAL)) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "rings of %s are not sealed",
+                        this->peerinfo.identifier);
+                goto err;
+        }
+
+        if (fstat (fds[0], &stbuf) ||
+            stbuf.st_size < SHM_CTL_SIZE + 2 * (off_t) hello.ring_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "rings of %s are too small",
+                        this->peerinfo.identifier);
+                goto err;
+        }
+
+        ret = __shm_map (this, fds[0], hello.ring_size);
+        close (fds[0]);
+        fds[0] = -1;
+        if (ret)
+                goto err;
+
+        priv->peer_efd = fds[1];
+        fds[1] = -1;
+
+        priv->efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (priv->efd == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "eventfd creation failed (%s)", strerror (errno));
+                goto err;
+        }
+
+        hello.op_errno = 0;
+        if (shm_send_fds (priv->sock, &hello, &priv->efd, 1)) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "could not answer %s (%s)",
+                        this->peerinfo.identifier, strerror (errno));
+                goto err;
+        }
+
+        if (__shm_register_efd (this))
+                goto err;
+
+        priv->connected = 1;
+        return 0;
+err:
+        if (fds[0] != -1)
+                close (fds[0]);
+        if (fds[1] != -1)
+                close (fds[1]);
+        return -1;
+}
+
+
+/* client: the server has mapped the rings */
+static int
+__shm_handshake_client (rpc_transport_t *this)
+{
+        shm_private_t    *priv = NULL;
+        struct shm_hello  hello = {0, };
+        int               fd = -1;
+        int               ret = -1;
+
+        priv = this->private;
+
+        ret = shm_recv_fds (priv->sock, &hello, &fd, 1);
+        if (ret == -1 && errno == EAGAIN)
+                return 0;
+
+        if (ret != 1 || hello.magic != GF_SHM_MAGIC ||
+            hello.version != GF_SHM_VERSION || hello.op_errno) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "handshake with %s failed",
+                        this->peerinfo.identifier);
+                if (ret > 0)
+                        close (fd);
+                return -1;
+        }
+
+        priv->peer_efd = fd;
+
+        if (__shm_register_efd (this))
+                return -1;
+
+        priv->connected = 1;
+        return 1;
+}
+
+
+static int
+shm_event_handler (int fd, int idx, void *data,
+                   int poll_in, int poll_out, int poll_err)
+{
+        rpc_transport_t *this = NULL;
+        shm_private_t   *priv = NULL;
+        char             c = 0;
+        int              ret = 0;
+
+        this = data;
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->xl, out);
+
+        THIS = this->xl;
+        priv = this->private;
+
+        if (poll_in && !poll_err) {
+                pthread_mutex_lock (&priv->lock);
+                {
+                        priv->idx = idx;
+
+                        if (priv->connected == 0 && priv->is_server) {
+                                ret = __shm_handshake_server (this);
+                        } else if (priv->connected == 0) {
+                                ret = __shm_handshake_client (this);
+                        } else {
+                                /* nothing but the hangup comes this way */
+                                ret = recv (priv->sock, &c, 1, MSG_DONTWAIT);
+                                if (ret == -1 && errno == EAGAIN)
+                                        ret = 0;
+                                else
+                                        ret = -1;
+                        }
+                }
+                pthread_mutex_unlock (&priv->lock);
+
+                if (ret == 1) {
+                        ret = rpc_transport_notify (this,
+                                                    RPC_TRANSPORT_CONNECT,
+                                                    this);
+                        /* requests could have been rung for meanwhile */
+                        shm_doorbell (priv->efd);
+                }
+        }
+
+        if ((ret < 0) || poll_err) {
+                gf_log ("transport", ((ret >= 0) ? GF_LOG_INFO :
+                                      GF_LOG_DEBUG), "disconnecting now");
+                shm_event_poll_err (this);
+                rpc_transport_unref (this);
+        }
+
+out:
+        return ret;
+}
+
+
+static int
+shm_server_event_handler (int fd, int idx, void *data,
+                          int poll_in, int poll_out, int poll_err)
+{
+        rpc_transport_t    *this = NULL;
+        shm_private_t      *priv = NULL;
+        rpc_transport_t    *new_trans = NULL;
+        shm_private_t      *new_priv = NULL;
+        struct sockaddr_un *sun = NULL;
+        int                 new_sock = -1;
+        pid_t               pid = 0;
+        int                 ret = 0;
+
+        this = data;
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->xl, out);
+
+        THIS = this->xl;
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                priv->idx = idx;
+
+                if (!poll_in)
+                        goto unlock;
+
+                new_sock = accept4 (priv->sock, NULL, NULL,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (new_sock == -1) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "accept on %d failed (%s)",
+                                priv->sock, strerror (errno));
+                        goto unlock;
+                }
+
+                if (shm_peer_check (this, new_sock, &pid)) {
+                        close (new_sock);
+                        goto unlock;
+                }
+
+                new_trans = GF_CALLOC (1, sizeof (*new_trans),
+                                       gf_common_mt_rpc_trans_t);
+                if (!new_trans) {
+                        close (new_sock);
+                        goto unlock;
+                }
+
+                new_trans->name = gf_strdup (this->name);
+
+                /* unix peers are trusted like privileged ports */
+                new_trans->myinfo = this->myinfo;
+                sun = (struct sockaddr_un *) &new_trans->peerinfo.sockaddr;
+                sun->sun_family = AF_UNIX;
+                new_trans->peerinfo.sockaddr_len = sizeof (*sun);
+                snprintf (new_trans->peerinfo.identifier,
+                          sizeof (new_trans->peerinfo.identifier),
+                          "shm:%d", (int) pid);
+
+                ret = shm_init (new_trans);
+                if (ret != 0) {
+                        close (new_sock);
+                        GF_FREE (new_trans->name);
+                        GF_FREE (new_trans);
+                        goto unlock;
+                }
+                new_trans->ops = this->ops;
+                new_trans->init = this->init;
+                new_trans->fini = this->fini;
+                new_trans->ctx  = this->ctx;
+                new_trans->xl   = this->xl;
+                new_trans->mydata = this->mydata;
+                new_trans->notify = this->notify;
+                new_trans->listener = this;
+                new_priv = new_trans->private;
+
+                new_priv->sock = new_sock;
+                new_priv->is_server = 1;
+
+                pthread_mutex_lock (&new_priv->lock);
+                {
+                        /* handshaking until the client's hello arrives */
+                        new_priv->connected = 0;
+                        rpc_transport_ref (new_trans);
+
+                        new_priv->idx = event_register (this->ctx->event_pool,
+                                                        new_sock,
+                                                        shm_event_handler,
+                                                        new_trans, 1, 0);
+                        if (new_priv->idx == -1)
+                                ret = -1;
+                }
+                pthread_mutex_unlock (&new_priv->lock);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "failed to register the socket with event");
+                        goto unlock;
+                }
+
+                ret = rpc_transport_notify (this, RPC_TRANSPORT_ACCEPT,
+                                            new_trans);
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+out:
+        return ret;
+}
+
+
+int
+shm_disconnect (rpc_transport_t *this)
+{
+        shm_private_t *priv = NULL;
+        int            ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->sock != -1) {
+                        priv->connected = -1;
+                        /* the event handler sees the hangup */
+                        ret = shutdown (priv->sock, SHUT_RDWR);
+                        if (ret)
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "shutdown() returned %d. %s",
+                                        ret, strerror (errno));
+                }
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+out:
+        return ret;
+}
+
+
+static uint16_t
+shm_remote_port (rpc_transport_t *this)
+{
+        data_t   *data = NULL;
+        uint16_t  port = GF_SHM_DEFAULT_LISTEN_PORT;
+
+        if (this->options) {
+                data = dict_get (this->options, "remote-port");
+                if (data)
+                        port = data_to_uint16 (data);
+        }
+
+        return port;
+}
+
+
+int
+shm_connect (rpc_transport_t *this, int port)
+{
+        shm_private_t      *priv = NULL;
+        struct sockaddr_un  sun;
+        struct shm_hello    hello = {0, };
+        int                 fds[2] = {-1, -1};
+        int                 ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, err);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, err);
+
+        priv = this->private;
+
+        if (port <= 0)
+                port = shm_remote_port (this);
+
+        shm_sock_path (priv, port, &sun);
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->sock != -1) {
+                        gf_log (this->name, GF_LOG_TRACE,
+                                "connect() -- already connected");
+                        goto unlock;
+                }
+
+                /* the old rings are still read from, try again later */
+                if (priv->efd_retiring) {
+                        gf_log (this->name, GF_LOG_TRACE,
+                                "connect() -- old eventfd still in use");
+                        goto unlock;
+                }
+
+                memcpy (&this->peerinfo.sockaddr, &sun, sizeof (sun));
+                this->peerinfo.sockaddr_len = sizeof (sun);
+                strcpy (this->peerinfo.identifier, sun.sun_path);
+                this->myinfo.sockaddr.ss_family = AF_UNIX;
+                this->myinfo.sockaddr_len = sizeof (sa_family_t);
+
+                priv->sock = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (priv->sock == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "socket creation failed (%s)",
+                                strerror (errno));
+                        goto unlock;
+                }
+
+                if (__shm_nonblock (priv->sock) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "NBIO on %d failed (%s)",
+                                priv->sock, strerror (errno));
+                        close (priv->sock);
+                        priv->sock = -1;
+                        goto unlock;
+                }
+
+                priv->connected = 0;
+
+                /* a server not there yet shows up as a hangup, like on
+                   sockets, and the reconnect timer tries again */
+                ret = connect (priv->sock, SA (&sun), sizeof (sun));
+                if (ret == 0 && shm_peer_check (this, priv->sock, NULL) == 0) {
+                        fds[0] = __shm_create_rings (this);
+                        fds[1] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+                        if (fds[0] != -1 && fds[1] != -1) {
+                                hello.magic = GF_SHM_MAGIC;
+                                hello.version = GF_SHM_VERSION;
+                                hello.ring_size = priv->ring_size;
+                                if (shm_send_fds (priv->sock, &hello, fds,
+                                                  2) == 0) {
+                                        priv->efd = fds[1];
+                                        fds[1] = -1;
+                                }
+                        }
+                        if (fds[0] != -1)
+                                close (fds[0]);
+                        if (fds[1] != -1)
+                                close (fds[1]);
+                }
+                if (priv->efd == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "connection to %s failed (%s)",
+                                sun.sun_path, strerror (errno));
+                        shutdown (priv->sock, SHUT_RDWR);
+                }
+
+                rpc_transport_ref (this);
+
+                priv->idx = event_register (this->ctx->event_pool, priv->sock,
+                                            shm_event_handler, this, 1, 0);
+                if (priv->idx == -1) {
+                        gf_log ("", GF_LOG_WARNING,
+                                "failed to register the event");
+                        ret = -1;
+                } else {
+                        ret = 0;
+                }
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+err:
+        return ret;
+}
+
+
+int
+shm_listen (rpc_transport_t *this)
+{
+        shm_private_t      *priv = NULL;
+        struct sockaddr_un  sun;
+        data_t             *data = NULL;
+        uint16_t            port = GF_SHM_DEFAULT_LISTEN_PORT;
+        int                 ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+
+        priv = this->private;
+
+        if (this->options) {
+                data = dict_get (this->options,
+                                 "transport.socket.listen-port");
+                if (data)
+                        port = data_to_uint16 (data);
+        }
+
+        shm_sock_path (priv, port, &sun);
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->sock != -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "already listening");
+                        goto unlock;
+                }
+
+                memcpy (&this->myinfo.sockaddr, &sun, sizeof (sun));
+                this->myinfo.sockaddr_len = sizeof (sun);
+                strcpy (this->myinfo.identifier, sun.sun_path);
+
+                priv->sock = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (priv->sock == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "socket creation failed (%s)",
+                                strerror (errno));
+                        goto unlock;
+                }
+
+                if (__shm_nonblock (priv->sock) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "NBIO on %d failed (%s)",
+                                priv->sock, strerror (errno));
+                        goto close;
+                }
+
+                ret = mkdir_p (priv->socket_dir, 0755, _gf_true);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not create %s (%s)",
+                                priv->socket_dir, strerror (errno));
+                        goto close;
+                }
+
+                /* left over by an earlier instance on this port */
+                unlink (sun.sun_path);
+
+                ret = bind (priv->sock, SA (&sun), sizeof (sun));
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "binding to %s failed: %s",
+                                sun.sun_path, strerror (errno));
+                        goto close;
+                }
+
+                ret = listen (priv->sock, 10);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not set socket %d to listen mode (%s)",
+                                priv->sock, strerror (errno));
+                        goto close;
+                }
+
+                rpc_transport_ref (this);
+
+                priv->idx = event_register (this->ctx->event_pool, priv->sock,
+                                            shm_server_event_handler,
+                                            this, 1, 0);
+                if (priv->idx == -1) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "could not register socket %d with events",
+                                priv->sock);
+                        ret = -1;
+                        goto close;
+                }
+
+                goto unlock;
+close:
+                ret = -1;
+                close (priv->sock);
+                priv->sock = -1;
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+out:
+        return ret;
+}
+
+
+static int32_t
+shm_submit (rpc_transport_t *this, rpc_transport_msg_t *msg, uint32_t type)
+{
+        shm_private_t *priv = NULL;
+        int            ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->connected != 1) {
+                        if (!priv->submit_log) {
+                                gf_log (this->name, GF_LOG_INFO,
+                                        "not connected (priv->connected = %d)",
+                                        priv->connected);
+                                priv->submit_log = 1;
+                        }
+                        goto unlock;
+                }
+
+                priv->submit_log = 0;
+                ret = __shm_ioq_submit (this, msg, type);
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+out:
+        return ret;
+}
+
+
+int32_t
+shm_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
+{
+        return shm_submit (this, &req->msg, SHM_MSG_CALL);
+}
+
+
+int32_t
+shm_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
+{
+        return shm_submit (this, &reply->msg, SHM_MSG_REPLY);
+}
+
+
+int32_t
+shm_getpeername (rpc_transport_t *this, char *hostname, int hostlen)
+{
+        int32_t ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", hostname, out);
+
+        if (hostlen < (strlen (this->peerinfo.identifier) + 1)) {
+                goto out;
+        }
+
+        strcpy (hostname, this->peerinfo.identifier);
+        ret = 0;
+out:
+        return ret;
+}
+
+
+int32_t
+shm_getpeeraddr (rpc_transport_t *this, char *peeraddr, int addrlen,
+                 struct sockaddr_storage *sa, socklen_t salen)
+{
+        int32_t ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", sa, out);
+
+        *sa = this->peerinfo.sockaddr;
+
+        if (peeraddr != NULL) {
+                ret = shm_getpeername (this, peeraddr, addrlen);
+        }
+        ret = 0;
+
+out:
+        return ret;
+}
+
+
+int32_t
+shm_getmyname (rpc_transport_t *this, char *hostname, int hostlen)
+{
+        int32_t ret = -1;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", hostname, out);
+
+        if (hostlen < (strlen (this->myinfo.identifier) + 1)) {
+                goto out;
+        }
+
+        strcpy (hostname, this->myinfo.identifier);
+        ret = 0;
+out:
+        return ret;
+}
+
+
+int32_t
+shm_getmyaddr (rpc_transport_t *this, char *myaddr, int addrlen,
+               struct sockaddr_storage *sa, socklen_t salen)
+{
+        int32_t ret = 0;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", sa, out);
+
+        *sa =  this->myinfo.sockaddr;
+
+        if (myaddr != NULL) {
+                ret = shm_getmyname (this, myaddr, addrlen);
+        }
+
+out:
+        return ret;
+}
+
+
+int32_t
+shm_throttle (rpc_transport_t *this, gf_boolean_t onoff)
+{
+        shm_private_t *priv = NULL;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                priv->throttled = onoff;
+
+                /* pick up what came in while throttled */
+                if (!onoff && priv->connected == 1)
+                        shm_doorbell (priv->efd);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return 0;
+}
+
+
+struct rpc_transport_ops tops = {
+        .listen             = shm_listen,
+        .connect            = shm_connect,
+        .disconnect         = shm_disconnect,
+        .submit_request     = shm_submit_request,
+        .submit_reply       = shm_submit_reply,
+        .get_peername       = shm_getpeername,
+        .get_peeraddr       = shm_getpeeraddr,
+        .get_myname         = shm_getmyname,
+        .get_myaddr         = shm_getmyaddr,
+        .throttle           = shm_throttle,
+};
+
+
+static int
+shm_ring_size_option (rpc_transport_t *this, dict_t *options, uint32_t *size)
+{
+        char     *optstr = NULL;
+        uint64_t  value = 0;
+
+        if (dict_get_str (options, SHM_RING_SIZE_OPT, &optstr))
+                return 0;
+
+        if (gf_string2bytesize (optstr, &value) ||
+            value < GF_SHM_MIN_RING_SIZE || value > GF_SHM_MAX_RING_SIZE) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "invalid value for "SHM_RING_SIZE_OPT": %s", optstr);
+                return -1;
+        }
+
+        /* positions in the ring are masked */
+        while (value & (value - 1))
+                value &= value - 1;
+
+        *size = value;
+        return 0;
+}
+
+
+int
+reconfigure (rpc_transport_t *this, dict_t *options)
+{
+        shm_private_t *priv = NULL;
+        uint32_t       ring_size = 0;
+        int            ret = 0;
+
+        GF_VALIDATE_OR_GOTO ("shm", this, out);
+        GF_VALIDATE_OR_GOTO ("shm", this->private, out);
+
+        priv = this->private;
+        ring_size = priv->ring_size;
+
+        ret = shm_ring_size_option (this, options, &ring_size);
+        if (ret)
+                goto out;
+
+        /* used for the rings of the next connection */
+        priv->ring_size = ring_size;
+out:
+        return ret;
+}
+
+
+int
+shm_init (rpc_transport_t *this)
+{
+        shm_private_t *priv = NULL;
+        char          *optstr = NULL;
+
+        if (this->private) {
+                gf_log_callingfn (this->name, GF_LOG_ERROR,
+                                  "double init attempted");
+                return -1;
+        }
+
+        priv = GF_CALLOC (1, sizeof (*priv), gf_common_mt_shm_private_t);
+        if (!priv) {
+                return -1;
+        }
+
+        pthread_mutex_init (&priv->lock, NULL);
+
+        priv->sock = -1;
+        priv->idx = -1;
+        priv->efd = -1;
+        priv->efd_idx = -1;
+        priv->peer_efd = -1;
+        priv->connected = -1;
+        priv->ring_size = GF_SHM_DEFAULT_RING_SIZE;
+        INIT_LIST_HEAD (&priv->ioq);
+
+        this->private = priv;
+
+        optstr = GF_SHM_DEFAULT_SOCKET_DIR;
+
+        /* All the below section needs 'this->options' to be present */
+        if (!this->options)
+                goto out;
+
+        if (shm_ring_size_option (this, this->options, &priv->ring_size))
+                goto err;
+
+        if (dict_get_str (this->options, SHM_SOCKET_DIR_OPT, &optstr))
+                optstr = GF_SHM_DEFAULT_SOCKET_DIR;
+out:
+        priv->socket_dir = gf_strdup (optstr);
+        if (priv->socket_dir)
+                return 0;
+err:
+        pthread_mutex_destroy (&priv->lock);
+        GF_FREE (priv);
+        this->private = NULL;
+        return -1;
+}
+
+
+void
+fini (rpc_transport_t *this)
+{
+        shm_private_t *priv = NULL;
+
+        if (!this)
+                return;
+
+        priv = this->private;
+        if (priv) {
+                if (priv->sock != -1) {
+                        pthread_mutex_lock (&priv->lock);
+                        {
+                                __shm_ioq_flush (this);
+                                __shm_reset (this);
+                        }
+                        pthread_mutex_unlock (&priv->lock);
+                }
+                gf_log (this->name, GF_LOG_TRACE,
+                        "transport %p destroyed", this);
+
+                __shm_unmap (priv);
+                pthread_mutex_destroy (&priv->lock);
+                GF_FREE (priv->socket_dir);
+                GF_FREE (priv);
+        }
+
+        this->private = NULL;
+}
+
+
+int32_t
+init (rpc_transport_t *this)
+{
+        int ret = -1;
+
+        ret = shm_init (this);
+
+        if (ret == -1) {
+                gf_log (this->name, GF_LOG_DEBUG, "shm_init() failed");
+        }
+
+        return ret;
+}
+
+struct volume_options options[] = {
+        { .key   = {"remote-port",
+                    "transport.remote-port",
+                    "transport.socket.remote-port"},
+          .type  = GF_OPTION_TYPE_INT
+        },
+        { .key   = {"transport.socket.listen-port", "listen-port"},
+          .type  = GF_OPTION_TYPE_INT
+        },
+        { .key   = {SHM_RING_SIZE_OPT},
+          .type  = GF_OPTION_TYPE_SIZET,
+          .min   = GF_SHM_MIN_RING_SIZE,
+          .max   = GF_SHM_MAX_RING_SIZE,
+          .default_value = "4MB",
+          .description = "Size of each of the two rings of a connection, "
+                         "rounded down to a power of two. Messages larger "
+                         "than a ring can not be sent."
+        },
+        { .key   = {SHM_SOCKET_DIR_OPT},
+          .type  = GF_OPTION_TYPE_PATH,
+          .default_value = GF_SHM_DEFAULT_SOCKET_DIR,
+          .description = "Directory of the unix sockets listeners take "
+                         "connections on, named after their port."
+        },
+        { .key = {NULL} }
+};
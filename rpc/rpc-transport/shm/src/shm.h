@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2008-2012 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "event.h"
+#include "rpc-transport.h"
+#include "logging.h"
+#include "dict.h"
+#include "mem-pool.h"
+#include "globals.h"
+
+#include <sys/un.h>
+#include <limits.h>
+
+#ifndef MAX_IOVEC
+#define MAX_IOVEC 16
+#endif /* MAX_IOVEC */
+
+/*
+ * A connection is a pair of single producer, single consumer byte rings
+ * in a memfd the client creates, one for each direction. The unix socket
+ * the client connects to carries the memfd and the eventfds the two
+ * sides ring each other with, and stays open to tell either side about
+ * the other going away.
+ */
+
+#define GF_SHM_MAGIC                    0x47534852      /* "GSHR" */
+#define GF_SHM_VERSION                  1
+
+#define GF_SHM_DEFAULT_SOCKET_DIR       DATADIR "/run/gluster"
+#define GF_SHM_DEFAULT_LISTEN_PORT      GF_DEFAULT_BASE_PORT
+
+#define GF_SHM_DEFAULT_RING_SIZE        (4 * GF_UNIT_MB)
+#define GF_SHM_MIN_RING_SIZE            (256 * GF_UNIT_KB)
+#define GF_SHM_MAX_RING_SIZE            (64 * GF_UNIT_MB)
+
+/* messages handled per wakeup before the event thread moves on */
+#define GF_SHM_POLL_BATCH               64
+
+#define SHM_CACHELINE                   64
+#define SHM_CTL_SIZE                    4096
+
+typedef enum {
+        SHM_MSG_CALL  = 1,      /* submit_request(), a call or a callback */
+        SHM_MSG_REPLY = 2,      /* submit_reply() */
+} shm_msg_type_t;
+
+/* sent by the client with the memfd and its eventfd, and back by the
+   server with its own eventfd */
+struct shm_hello {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t ring_size;
+        int32_t  op_errno;
+};
+
+/* control block of a ring. head is moved by the producer only, tail by
+   the consumer only, both are running byte counts. */
+struct shm_ring {
+        volatile uint64_t head;
+        volatile uint32_t space_wanted; /* producer waits for the tail */
+        char              pad0[SHM_CACHELINE - 12];
+        volatile uint64_t tail;
+        volatile uint32_t waiting;      /* consumer sleeps on its eventfd */
+        char              pad1[SHM_CACHELINE - 12];
+};
+
+/* precedes every message in a ring */
+struct shm_record {
+        uint32_t size;          /* whole record, 8 byte aligned */
+        uint32_t type;          /* shm_msg_type_t */
+        uint32_t hdrlen;        /* rpc and program headers */
+        uint32_t payloadlen;    /* program payload */
+};
+
+struct shm_ioq {
+        struct list_head  list;
+        uint32_t          type;
+        struct iovec      vector[MAX_IOVEC];
+        int               count;
+        uint32_t          hdrlen;
+        uint32_t          payloadlen;
+        struct iobref    *iobref;
+};
+
+typedef struct {
+        int32_t            sock;        /* unix socket, handshake and hangup */
+        int32_t            idx;
+        int32_t            efd;         /* rung by the peer */
+        int32_t            efd_idx;
+        int32_t            peer_efd;
+        char               connected;   /* 1 up, 0 handshaking, -1 down */
+        char               is_server;
+        char               submit_log;
+        char               efd_retiring; /* old eventfd not let go of yet */
+        gf_boolean_t       throttled;
+        uint32_t           ring_size;
+        void              *map;
+        size_t             map_size;
+        struct shm_ring   *tx;
+        struct shm_ring   *rx;
+        char              *tx_data;
+        char              *rx_data;
+        struct list_head   ioq;         /* waiting for room in tx */
+        pthread_mutex_t    lock;
+        char              *socket_dir;
+        uint64_t           ring_full;
+} shm_private_t;
+
+#endif /* _SHM_H */
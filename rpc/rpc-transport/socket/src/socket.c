@@ -36,6 +36,10 @@
 #include <netinet/tcp.h>
 #include <rpc/xdr.h>
 #include <sys/ioctl.h>
+#include <openssl/rand.h>
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#include <openssl/core_names.h>
+#endif
 #define GF_LOG_ERRNO(errno) ((errno == ENOTCONN) ? GF_LOG_DEBUG : GF_LOG_ERROR)
 #define SA(ptr) ((struct sockaddr *)ptr)
 
@@ -44,6 +48,8 @@
 #define SSL_PRIVATE_KEY_OPT "transport.socket.ssl-private-key"
 #define SSL_CA_LIST_OPT     "transport.socket.ssl-ca-list"
 #define OWN_THREAD_OPT      "transport.socket.own-thread"
+#define SSL_KTLS_OPT        "transport.socket.ssl-ktls"
+#define SSL_TICKET_KEY_OPT  "transport.socket.ssl-ticket-key"
 
 /* TBD: do automake substitutions etc. (ick) to set these. */
 #if !defined(DEFAULT_CERT_PATH)
@@ -244,6 +250,265 @@ out:
 #define ssl_read_one(t,b,l)  ssl_do((t),(b),(l),(SSL_trinary_func *)SSL_read)
 #define ssl_write_one(t,b,l) ssl_do((t),(b),(l),(SSL_trinary_func *)SSL_write)
 
+/* kTLS needs both directions in the kernel before the connection can be
+   read and written like a plain socket */
+static gf_boolean_t
+ssl_ktls_active (socket_private_t *priv)
+{
+#if !defined(OPENSSL_NO_KTLS) && defined(SSL_OP_ENABLE_KTLS)
+        return BIO_get_ktls_send (SSL_get_wbio (priv->ssl_ssl)) &&
+               BIO_get_ktls_recv (SSL_get_rbio (priv->ssl_ssl));
+#else
+        return _gf_false;
+#endif
+}
+
+/* Keeps the last session a client got from its server, so that the next
+   connect of the same transport resumes it instead of doing a full
+   handshake. */
+static int
+ssl_new_session (SSL *ssl, SSL_SESSION *session)
+{
+        rpc_transport_t  *this = NULL;
+        socket_private_t *priv = NULL;
+
+        this = SSL_get_app_data (ssl);
+        if (!this || SSL_is_server (ssl))
+                return 0;
+
+        priv = this->private;
+        if (priv->ssl_session)
+                SSL_SESSION_free (priv->ssl_session);
+        priv->ssl_session = session;
+
+        return 1;
+}
+
+/*
+ * Session tickets are sealed with the key read from the file given in
+ * transport.socket.ssl-ticket-key (80 bytes, e.g. from "openssl rand 80"),
+ * so the servers sharing that file accept each other's tickets, also after
+ * a restart. Without the option no tickets are handed out at all.
+ *
+ * The key is rotated by replacing the file. It is looked at again every
+ * SSL_TICKET_KEY_CHECK seconds; a new key seals the tickets from then on,
+ * and the key it replaced still opens the ones sealed before (which get
+ * renewed) until the next rotation.
+ */
+static int
+ssl_ticket_key_read (const char *path, struct ssl_ticket_key *key,
+                     struct stat *stbuf)
+{
+        unsigned char  buf[SSL_TICKET_KEY_SIZE + 1];
+        ssize_t        len = 0;
+        int            fd = -1;
+        int            ret = -1;
+
+        fd = open (path, O_RDONLY);
+        if (fd == -1)
+                goto out;
+
+        if (fstat (fd, stbuf) == -1)
+                goto out;
+
+        len = read (fd, buf, sizeof (buf));
+        if (len != SSL_TICKET_KEY_SIZE) {
+                if (len >= 0)
+                        errno = EINVAL;
+                goto out;
+        }
+
+        memcpy (key->name, buf, sizeof (key->name));
+        memcpy (key->hmac, buf + 16, sizeof (key->hmac));
+        memcpy (key->aes, buf + 48, sizeof (key->aes));
+
+        ret = 0;
+out:
+        OPENSSL_cleanse (buf, sizeof (buf));
+        if (fd != -1)
+                close (fd);
+        return ret;
+}
+
+static ssl_ticket_keys_t *
+ssl_ticket_keys_new (rpc_transport_t *this, const char *path)
+{
+        ssl_ticket_keys_t *keys = NULL;
+        struct stat        stbuf = {0,};
+
+        keys = GF_CALLOC (1, sizeof (*keys), gf_common_mt_ssl_ticket_keys_t);
+        if (!keys)
+                return NULL;
+
+        if (ssl_ticket_key_read (path, &keys->current, &stbuf) != 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not read the session ticket key from %s "
+                        "(%s)", path, strerror (errno));
+                GF_FREE (keys);
+                return NULL;
+        }
+
+        keys->path = gf_strdup (path);
+        if (!keys->path) {
+                OPENSSL_cleanse (&keys->current, sizeof (keys->current));
+                GF_FREE (keys);
+                return NULL;
+        }
+
+        pthread_mutex_init (&keys->lock, NULL);
+        keys->checked = time (NULL);
+        keys->ino = stbuf.st_ino;
+        keys->mtime = stbuf.st_mtime;
+
+        return keys;
+}
+
+static void
+__ssl_ticket_keys_refresh (ssl_ticket_keys_t *keys)
+{
+        struct ssl_ticket_key  key;
+        struct stat            stbuf = {0,};
+        time_t                 now = 0;
+
+        now = time (NULL);
+        if (now - keys->checked < SSL_TICKET_KEY_CHECK)
+                return;
+        keys->checked = now;
+
+        if (stat (keys->path, &stbuf) == -1)
+                goto fail;
+
+        if ((stbuf.st_ino == keys->ino) && (stbuf.st_mtime == keys->mtime))
+                return;
+
+        if (ssl_ticket_key_read (keys->path, &key, &stbuf) != 0)
+                goto fail;
+
+        keys->ino = stbuf.st_ino;
+        keys->mtime = stbuf.st_mtime;
+
+        if (memcmp (key.name, keys->current.name, sizeof (key.name))) {
+                keys->previous = keys->current;
+                keys->has_previous = _gf_true;
+                keys->current = key;
+                gf_log ("socket", GF_LOG_INFO,
+                        "session ticket key rotated from %s", keys->path);
+        }
+
+        OPENSSL_cleanse (&key, sizeof (key));
+        return;
+
+fail:
+        gf_log ("socket", GF_LOG_WARNING, "could not re-read the session "
+                "ticket key from %s (%s), keeping the current one",
+                keys->path, strerror (errno));
+}
+
+/* the key for a ticket to seal (@enc) or open: returns 1 for the current
+   key, 2 for the previous one (ticket to be renewed), 0 for none */
+static int
+ssl_ticket_key_pick (SSL *ssl, unsigned char *name, int enc,
+                     struct ssl_ticket_key *key)
+{
+        ssl_ticket_keys_t *keys = NULL;
+        int                ret = 0;
+
+        keys = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+        if (!keys)
+                return 0;
+
+        pthread_mutex_lock (&keys->lock);
+        {
+                __ssl_ticket_keys_refresh (keys);
+
+                if (enc || !memcmp (name, keys->current.name, 16)) {
+                        *key = keys->current;
+                        ret = 1;
+                } else if (keys->has_previous &&
+                           !memcmp (name, keys->previous.name, 16)) {
+                        *key = keys->previous;
+                        ret = 2;
+                }
+        }
+        pthread_mutex_unlock (&keys->lock);
+
+        if (ret && enc) {
+                memcpy (name, key->name, 16);
+        }
+
+        return ret;
+}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+static int
+ssl_ticket_key_cb (SSL *ssl, unsigned char *name, unsigned char *iv,
+                   EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *mctx, int enc)
+{
+        struct ssl_ticket_key  key;
+        OSSL_PARAM             params[2];
+        int                    ret = 0;
+
+        ret = ssl_ticket_key_pick (ssl, name, enc, &key);
+        if (ret <= 0)
+                return ret;
+
+        params[0] = OSSL_PARAM_construct_utf8_string (OSSL_MAC_PARAM_DIGEST,
+                                                      "SHA256", 0);
+        params[1] = OSSL_PARAM_construct_end ();
+
+        if (enc) {
+                if ((RAND_bytes (iv, EVP_CIPHER_iv_length
+                                 (EVP_aes_256_cbc ())) != 1) ||
+                    !EVP_EncryptInit_ex (cctx, EVP_aes_256_cbc (), NULL,
+                                         key.aes, iv))
+                        ret = -1;
+        } else {
+                if (!EVP_DecryptInit_ex (cctx, EVP_aes_256_cbc (), NULL,
+                                         key.aes, iv))
+                        ret = -1;
+        }
+
+        if ((ret > 0) &&
+            !EVP_MAC_init (mctx, key.hmac, sizeof (key.hmac), params))
+                ret = -1;
+
+        OPENSSL_cleanse (&key, sizeof (key));
+        return ret;
+}
+#else
+static int
+ssl_ticket_key_cb (SSL *ssl, unsigned char *name, unsigned char *iv,
+                   EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc)
+{
+        struct ssl_ticket_key  key;
+        int                    ret = 0;
+
+        ret = ssl_ticket_key_pick (ssl, name, enc, &key);
+        if (ret <= 0)
+                return ret;
+
+        if (enc) {
+                if ((RAND_bytes (iv, EVP_CIPHER_iv_length
+                                 (EVP_aes_256_cbc ())) != 1) ||
+                    !EVP_EncryptInit_ex (cctx, EVP_aes_256_cbc (), NULL,
+                                         key.aes, iv))
+                        ret = -1;
+        } else {
+                if (!EVP_DecryptInit_ex (cctx, EVP_aes_256_cbc (), NULL,
+                                         key.aes, iv))
+                        ret = -1;
+        }
+
+        if ((ret > 0) &&
+            !HMAC_Init_ex (hctx, key.hmac, sizeof (key.hmac), EVP_sha256 (),
+                           NULL))
+                ret = -1;
+
+        OPENSSL_cleanse (&key, sizeof (key));
+        return ret;
+}
+#endif
+
 int
 ssl_setup_connection (rpc_transport_t *this, int server)
 {
@@ -255,6 +520,7 @@ ssl_setup_connection (rpc_transport_t *this, int server)
 	GF_VALIDATE_OR_GOTO(this->name,this->private,done);
 	priv = this->private;
 
+	priv->ktls = _gf_false;
 	priv->ssl_ssl = SSL_new(priv->ssl_ctx);
 	if (!priv->ssl_ssl) {
 		gf_log(this->name,GF_LOG_ERROR,"SSL_new failed");
@@ -268,6 +534,10 @@ ssl_setup_connection (rpc_transport_t *this, int server)
 		goto free_ssl;
 	}
 	SSL_set_bio(priv->ssl_ssl,priv->ssl_sbio,priv->ssl_sbio);
+	SSL_set_app_data(priv->ssl_ssl,this);
+	if (!server && priv->ssl_session) {
+		SSL_set_session(priv->ssl_ssl,priv->ssl_session);
+	}
 
 	if (server) {
 		ret = ssl_accept_one(this);
@@ -295,6 +565,13 @@ ssl_setup_connection (rpc_transport_t *this, int server)
 		NID_commonName, peer_CN, sizeof(peer_CN)-1);
 	peer_CN[sizeof(peer_CN)-1] = '\0';
 	gf_log(this->name,GF_LOG_INFO,"peer CN = %s", peer_CN);
+	if (SSL_session_reused(priv->ssl_ssl)) {
+		gf_log(this->name,GF_LOG_DEBUG,"resumed TLS session");
+	}
+
+	priv->ktls = ssl_ktls_active(priv);
+	gf_log(this->name,GF_LOG_DEBUG,"kernel TLS %s",
+	       priv->ktls ? "active" : "not active");
 	return 0;
 
 	/* Error paths. */
@@ -348,7 +625,8 @@ __socket_rwv (rpc_transport_t *this, struct iovec *vector, int count,
                         continue;
                 }
                 if (write) {
-			if (priv->use_ssl) {
+                        this->total_writev_calls++;
+			if (priv->use_ssl && !priv->ktls) {
 				ret = ssl_write_one(this,
 					opvector->iov_base, opvector->iov_len);
 			}
@@ -362,7 +640,7 @@ __socket_rwv (rpc_transport_t *this, struct iovec *vector, int count,
                         }
                         this->total_bytes_write += ret;
                 } else {
-			if (priv->use_ssl) {
+			if (priv->use_ssl && !priv->ktls) {
 				ret = ssl_read_one(this,
 					opvector->iov_base, opvector->iov_len);
 			}
@@ -474,6 +752,156 @@ __socket_writev (rpc_transport_t *this, struct iovec *vector, int count,
 }
 
 
+/*
+ * splice the part of a pipe-backed iobuf that @vector still covers into
+ * the socket. the pipe holds page cache pages the storage has read in
+ * already, so this never waits for a disk.
+ *
+ * return value as for __socket_rwv (). when splicing is not possible the
+ * rest of the payload is copied into the iobuf and 0 is returned with
+ * @vector left pending, to go out through writev.
+ */
+int
+__socket_splice (rpc_transport_t *this, struct iobuf *iobuf,
+                 struct iovec *vector)
+{
+        socket_private_t *priv = NULL;
+        ssize_t           ret = 0;
+
+        priv = this->private;
+
+        LOCK (&iobuf->lock);
+        {
+                if (!iobuf->pipe_backed)
+                        goto unlock;
+
+                /* the pipe can only be consumed in order */
+                if (vector->iov_base != iobuf->ptr + iobuf->pipe_off)
+                        goto materialize;
+
+                while (vector->iov_len > 0) {
+#ifdef GF_LINUX_HOST_OS
+                        ret = splice (iobuf->pipe_fd, NULL, priv->sock, NULL,
+                                      vector->iov_len,
+                                      SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+                        ret = -1;
+                        errno = ENOSYS;
+#endif
+                        if (ret == -1) {
+                                if (errno == EINTR)
+                                        continue;
+
+                                if (errno == EAGAIN) {
+                                        ret = 1;
+                                        goto unlock;
+                                }
+
+                                if ((errno == EINVAL) || (errno == ENOSYS))
+                                        goto materialize;
+
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "splice failed (%s)",
+                                        strerror (errno));
+                                goto unlock;
+                        }
+
+                        if (ret == 0) {
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "pipe-backed payload ran short");
+                                ret = -1;
+                                goto unlock;
+                        }
+
+                        this->total_bytes_write += ret;
+                        iobuf->pipe_off  += ret;
+                        vector->iov_base += ret;
+                        vector->iov_len  -= ret;
+                }
+
+                ret = 0;
+                goto unlock;
+
+        materialize:
+                ret = __iobuf_materialize (iobuf);
+                if (ret)
+                        ret = -1;
+        }
+unlock:
+        UNLOCK (&iobuf->lock);
+
+        return ret;
+}
+
+
+/*
+ * write the pending vectors of @entry, splicing the ones which live in a
+ * pipe-backed iobuf and writev-ing the rest.
+ *
+ * return value as for __socket_writev ().
+ */
+int
+__socket_ioq_writev (rpc_transport_t *this, struct ioq *entry)
+{
+        struct iobuf     *iobuf = NULL;
+        struct iovec     *end = NULL;
+        struct iovec     *pending_vector = NULL;
+        int               pending_count = 0;
+        int               idx = 0;
+        int               ret = -1;
+
+        if (!entry->pipe_backed)
+                return __socket_writev (this, entry->pending_vector,
+                                        entry->pending_count,
+                                        &entry->pending_vector,
+                                        &entry->pending_count);
+
+        end = entry->vector + entry->count;
+
+        while (entry->pending_count > 0) {
+                /* memory vectors in front of the next pipe-backed one
+                   go out in a single writev */
+                iobuf = NULL;
+                for (idx = 0; idx < entry->pending_count; idx++) {
+                        iobuf = iobref_pipe_backed_iobuf
+                                (entry->iobref,
+                                 entry->pending_vector[idx].iov_base);
+                        if (iobuf)
+                                break;
+                }
+
+                if (idx > 0) {
+                        ret = __socket_writev (this, entry->pending_vector,
+                                               idx, &pending_vector,
+                                               &pending_count);
+                        if (ret == -1)
+                                return -1;
+
+                        entry->pending_vector = pending_vector;
+                        entry->pending_count  = end - pending_vector;
+                        if (ret > 0)
+                                return entry->pending_count;
+
+                        continue;
+                }
+
+                ret = __socket_splice (this, iobuf, entry->pending_vector);
+                if (ret == -1)
+                        return -1;
+
+                if (ret > 0)
+                        return entry->pending_count;
+
+                if (!entry->pending_vector->iov_len) {
+                        entry->pending_vector++;
+                        entry->pending_count--;
+                }
+        }
+
+        return 0;
+}
+
+
 int
 __socket_disconnect (rpc_transport_t *this)
 {
@@ -602,6 +1030,28 @@ __socket_nodelay (int fd)
 }
 
 
+/* let reads on @fd poll the device queue for up to @usec when it is empty.
+ * raising it above net.core.busy_read needs CAP_NET_ADMIN; without it the
+ * transport still spins on the socket, just not down into the driver.
+ */
+static int
+__socket_busy_poll (int fd, uint32_t usec)
+{
+        int     ret = -1;
+
+#ifdef SO_BUSY_POLL
+        int     val = usec;
+
+        ret = setsockopt (fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof (val));
+        if (ret == -1)
+                gf_log (THIS->name, GF_LOG_DEBUG,
+                        "SO_BUSY_POLL on socket %d failed (%s)", fd,
+                        strerror (errno));
+#endif
+        return ret;
+}
+
+
 static int
 __socket_keepalive (int fd, int family, int keepalive_intvl, int keepalive_idle)
 {
@@ -795,8 +1245,10 @@ __socket_ioq_new (rpc_transport_t *this, rpc_transport_msg_t *msg)
         entry->pending_vector = entry->vector;
         entry->pending_count  = entry->count;
 
-        if (msg->iobref != NULL)
+        if (msg->iobref != NULL) {
                 entry->iobref = iobref_ref (msg->iobref);
+                entry->pipe_backed = iobref_is_pipe_backed (msg->iobref);
+        }
 
         INIT_LIST_HEAD (&entry->list);
 
@@ -843,34 +1295,165 @@ out:
 }
 
 
+static uint64_t
+__socket_now_usec (void)
+{
+        struct timespec  ts = {0, };
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+
+static void
+__socket_cork (rpc_transport_t *this, gf_boolean_t cork)
+{
+#ifdef TCP_CORK
+        socket_private_t *priv = NULL;
+        int               on = cork;
+        sa_family_t       family = 0;
+
+        priv = this->private;
+
+        if (priv->corked == cork)
+                return;
+
+        family = SA (&this->peerinfo.sockaddr)->sa_family;
+        if ((family != AF_INET) && (family != AF_INET6))
+                return;
+
+        if (setsockopt (priv->sock, IPPROTO_TCP, TCP_CORK, &on,
+                        sizeof (on)) == 0)
+                priv->corked = cork;
+#endif
+}
+
+
+/* a completely written entry leaves the queue */
+static void
+__socket_ioq_entry_done (rpc_transport_t *this, struct ioq *entry, int direct)
+{
+	socket_private_t *priv = NULL;
+	char              a_byte = 0;
+
+        GF_ASSERT (entry->pending_count == 0);
+        __socket_ioq_entry_free (entry);
+        this->total_msgs_write++;
+
+        priv = this->private;
+        if (priv->own_thread) {
+                /*
+                 * The pipe should only remain readable if there are
+                 * more entries after this, so drain the byte
+                 * representing this entry.
+                 */
+                if (!direct && read(priv->pipe[0],&a_byte,1) < 1) {
+                        gf_log(this->name,GF_LOG_WARNING,
+                               "read error on pipe");
+                }
+        }
+}
+
+
+/* move @entry's pending vector past the first *@bytes written */
+static void
+__socket_ioq_entry_advance (struct ioq *entry, size_t *bytes)
+{
+        struct iovec  *vector = NULL;
+        size_t         len = 0;
+
+        while (entry->pending_count > 0) {
+                vector = entry->pending_vector;
+
+                if (vector->iov_len) {
+                        if (!*bytes)
+                                break;
+
+                        len = min (vector->iov_len, *bytes);
+                        vector->iov_base += len;
+                        vector->iov_len  -= len;
+                        *bytes           -= len;
+
+                        if (vector->iov_len)
+                                break;
+                }
+
+                entry->pending_vector++;
+                entry->pending_count--;
+        }
+}
+
+
 int
 __socket_ioq_churn_entry (rpc_transport_t *this, struct ioq *entry, int direct)
 {
         int               ret = -1;
-	socket_private_t *priv = NULL;
-	char              a_byte = 0;
 
-        ret = __socket_writev (this, entry->pending_vector,
-                               entry->pending_count,
-                               &entry->pending_vector,
-                               &entry->pending_count);
+        ret = __socket_ioq_writev (this, entry);
 
         if (ret == 0) {
                 /* current entry was completely written */
-                GF_ASSERT (entry->pending_count == 0);
-                __socket_ioq_entry_free (entry);
-		priv = this->private;
-		if (priv->own_thread) {
-			/*
-			 * The pipe should only remain readable if there are
-			 * more entries after this, so drain the byte
-			 * representing this entry.
-			 */
-			if (!direct && read(priv->pipe[0],&a_byte,1) < 1) {
-				gf_log(this->name,GF_LOG_WARNING,
-				       "read error on pipe");
-			}
-		}
+                __socket_ioq_entry_done (this, entry, direct);
+        }
+
+        return ret;
+}
+
+
+/*
+ * write the entries at the head of the ioq with a single writev, as many
+ * as fit in SOCKET_IOQ_MAX_IOVEC vectors.
+ *
+ * return value as for __socket_ioq_churn_entry ().
+ */
+int
+__socket_ioq_churn_batch (rpc_transport_t *this)
+{
+        socket_private_t *priv = NULL;
+        struct ioq       *entry = NULL;
+        struct ioq       *tmp = NULL;
+        struct iovec      vector[SOCKET_IOQ_MAX_IOVEC];
+        struct iovec     *pending_vector = NULL;
+        int               pending_count = 0;
+        int               count = 0;
+        int               entries = 0;
+        size_t            bytes = 0;
+        int               ret = -1;
+
+        priv = this->private;
+
+        list_for_each_entry (entry, &priv->ioq, list) {
+                /* spliced payloads cannot be part of a writev */
+                if (entry->pipe_backed)
+                        break;
+
+                if (count + entry->pending_count > SOCKET_IOQ_MAX_IOVEC)
+                        break;
+
+                memcpy (&vector[count], entry->pending_vector,
+                        entry->pending_count * sizeof (struct iovec));
+                count += entry->pending_count;
+                entries++;
+        }
+
+        if (entries < 2)
+                return __socket_ioq_churn_entry (this, priv->ioq_next, 0);
+
+        ret = __socket_rwv (this, vector, count, &pending_vector,
+                            &pending_count, &bytes, 1);
+        if (ret == -1)
+                return -1;
+
+        list_for_each_entry_safe (entry, tmp, &priv->ioq, list) {
+                if (!entries--)
+                        break;
+
+                __socket_ioq_entry_advance (entry, &bytes);
+                if (entry->pending_count)
+                        break;
+
+                __socket_ioq_entry_done (this, entry, 0);
         }
 
         return ret;
@@ -882,23 +1465,30 @@ __socket_ioq_churn (rpc_transport_t *this)
 {
         socket_private_t *priv = NULL;
         int               ret = 0;
-        struct ioq       *entry = NULL;
 
         GF_VALIDATE_OR_GOTO ("socket", this, out);
         GF_VALIDATE_OR_GOTO ("socket", this->private, out);
 
         priv = this->private;
 
-        while (!list_empty (&priv->ioq)) {
-                /* pick next entry */
-                entry = priv->ioq_next;
+        /* a burst that takes more than one call (more vectors than
+           fit) goes out in full segments */
+        if (priv->coalesce_usec && !list_empty (&priv->ioq) &&
+            (priv->ioq.next->next != &priv->ioq))
+                __socket_cork (this, _gf_true);
 
-                ret = __socket_ioq_churn_entry (this, entry, 0);
+        while (!list_empty (&priv->ioq)) {
+                ret = __socket_ioq_churn_batch (this);
 
                 if (ret != 0)
                         break;
         }
 
+        if (priv->corked)
+                __socket_cork (this, _gf_false);
+
+        priv->ioq_deferred = _gf_false;
+
         if (!priv->own_thread && list_empty (&priv->ioq)) {
                 /* all pending writes done, not interested in POLLOUT */
                 priv->idx = event_select_on (this->ctx->event_pool,
@@ -1992,6 +2582,97 @@ socket_event_poll_in (rpc_transport_t *this)
 }
 
 
+/* with a single cpu the spinning thread only keeps the peer, or the
+ * io-thread producing the next message, from running.
+ */
+static uint32_t
+socket_busy_poll_check (rpc_transport_t *this, uint32_t usec)
+{
+        if (usec && sysconf (_SC_NPROCESSORS_ONLN) < 2) {
+                gf_log (this->name, GF_LOG_WARNING, "busy-polling needs more "
+                        "than one cpu, leaving it off");
+                usec = 0;
+        }
+
+        return usec;
+}
+
+
+/*
+ * busy-poll for the next message after one came in through epoll, so that
+ * a request/reply exchange in progress does not pay an epoll wakeup per
+ * message. the fd stays unarmed meanwhile (EPOLLONESHOT), so this is the
+ * only thread reading from it. the event thread is not there for the other
+ * connections while it spins, so this is only done when there are others.
+ *
+ * a hit restores the full window. a spin running out halves it, and below
+ * 1/16th of busy_poll_usec the connection is treated as idle and left to
+ * epoll, until two messages arrive within busy_poll_usec of each other.
+ */
+static int
+socket_event_spin_in (rpc_transport_t *this)
+{
+        socket_private_t *priv      = NULL;
+        uint64_t          now       = 0;
+        uint64_t          deadline  = 0;
+        uint32_t          min_usec  = 0;
+        ssize_t           n         = 0;
+        char              byte      = 0;
+        gf_boolean_t      stop      = _gf_false;
+        int               ret       = 0;
+
+        priv = this->private;
+        now = __socket_now_usec ();
+        min_usec = max (priv->busy_poll_usec / 16, 1);
+
+        if (!priv->spin_usec) {
+                if (now - priv->last_in_usec < priv->busy_poll_usec)
+                        priv->spin_usec = min_usec;
+                goto out;
+        }
+
+        deadline = now + priv->spin_usec;
+
+        while (ret == 0) {
+                /* nothing may be read while throttled, and queued output
+                 * waits for POLLOUT, which needs the fd re-armed */
+                pthread_mutex_lock (&priv->lock);
+                {
+                        stop = priv->throttled || !list_empty (&priv->ioq);
+                }
+                pthread_mutex_unlock (&priv->lock);
+                if (stop)
+                        break;
+
+                n = recv (priv->sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+                if (n > 0) {
+                        this->total_spin_hits++;
+                        priv->spin_usec = priv->busy_poll_usec;
+
+                        ret = socket_event_poll_in (this);
+                        deadline = __socket_now_usec () + priv->spin_usec;
+                        continue;
+                }
+
+                /* EOF and errors are for the epoll handler to report */
+                if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                        break;
+
+                if (__socket_now_usec () >= deadline) {
+                        this->total_spin_misses++;
+                        priv->spin_usec /= 2;
+                        if (priv->spin_usec < min_usec)
+                                priv->spin_usec = 0;
+                        break;
+                }
+        }
+
+out:
+        priv->last_in_usec = __socket_now_usec ();
+        return ret;
+}
+
+
 int
 socket_connect_finish (rpc_transport_t *this)
 {
@@ -2098,6 +2779,12 @@ socket_event_handler (int fd, int idx, void *data,
                 ret = socket_event_poll_in (this);
         }
 
+        if (!ret && poll_in && !poll_err && priv->busy_poll_usec &&
+            !priv->own_thread &&
+            event_pool_threads (this->ctx->event_pool) > 1) {
+                ret = socket_event_spin_in (this);
+        }
+
         if ((ret < 0) || poll_err) {
                 /* Logging has happened already in earlier cases */
                 gf_log ("transport", ((ret >= 0) ? GF_LOG_INFO : GF_LOG_DEBUG),
@@ -2111,6 +2798,68 @@ out:
 }
 
 
+/* Once the kernel does the TLS record layer, the connection is served by
+   the event threads like a plain one and its private poller goes away. */
+static int
+socket_ktls_handover (rpc_transport_t *this)
+{
+        socket_private_t *priv      = NULL;
+        int               server    = 0;
+        int               poll_out  = 0;
+        int               ret       = -1;
+
+        priv   = this->private;
+        server = (priv->connected == 1);
+
+        pthread_detach (pthread_self ());
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                priv->own_thread = _gf_false;
+
+                /* queued entries are written on POLLOUT from now on */
+                close (priv->pipe[0]);
+                close (priv->pipe[1]);
+                priv->pipe[0] = priv->pipe[1] = -1;
+
+                if (!priv->bio) {
+                        ret = __socket_nonblock (priv->sock);
+                        if (ret == -1) {
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "NBIO on %d failed (%s)",
+                                        priv->sock, strerror (errno));
+                                goto unlock;
+                        }
+                }
+
+                /* a client finishes its connect on the first event */
+                poll_out = !server || !list_empty (&priv->ioq);
+                priv->idx = event_register (this->ctx->event_pool,
+                                            priv->sock, socket_event_handler,
+                                            this, 1, poll_out);
+                ret = (priv->idx == -1) ? -1 : 0;
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+
+        if (ret == -1) {
+                __socket_disconnect (this);
+                rpc_transport_notify (this, RPC_TRANSPORT_DISCONNECT, this);
+                rpc_transport_unref (this);
+                return -1;
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG, "kernel TLS active, handing the "
+                "connection to the event threads");
+
+        if (server)
+                rpc_transport_notify (this->listener, RPC_TRANSPORT_ACCEPT,
+                                      this);
+
+        return 0;
+}
+
+
 void *
 socket_poller (void *ctx)
 {
@@ -2127,6 +2876,11 @@ socket_poller (void *ctx)
                                 priv->connected ? "server" : "client");
                         goto err;
                 }
+
+                if (priv->ktls) {
+                        socket_ktls_handover (this);
+                        return NULL;
+                }
         }
 
         if (!priv->bio) {
@@ -2169,15 +2923,20 @@ socket_poller (void *ctx)
 		pfd[0].events = POLL_MASK_ERROR;
 		pfd[0].revents = 0;
 		pfd[1].fd = priv->sock;
-		pfd[1].events = POLL_MASK_INPUT | POLL_MASK_ERROR;
+		pfd[1].events = POLL_MASK_ERROR;
 		pfd[1].revents = 0;
+		if (!priv->throttled) {
+			pfd[1].events |= POLL_MASK_INPUT;
+		}
 		if (to_write) {
 			pfd[1].events |= POLL_MASK_OUTPUT;
 		}
 		else {
 			pfd[0].events |= POLL_MASK_INPUT;
 		}
-		if (poll(pfd,2,-1) < 0) {
+		/* nothing wakes us up when the throttle is released, so
+		   look at it again every now and then */
+		if (poll(pfd,2,priv->throttled ? 100 : -1) < 0) {
 			gf_log(this->name,GF_LOG_ERROR,"poll failed");
 			break;
 		}
@@ -2340,8 +3099,18 @@ socket_server_event_handler (int fd, int idx, void *data,
                         new_priv = new_trans->private;
 
 			new_priv->use_ssl = priv->use_ssl;
+#ifdef GF_LINUX_HOST_OS
+                        new_trans->pipe_payload = !priv->use_ssl;
+#endif
 			new_priv->sock = new_sock;
 			new_priv->own_thread = priv->own_thread;
+			new_priv->own_thread_cfg = priv->own_thread;
+                        new_priv->coalesce_usec = priv->coalesce_usec;
+                        new_priv->busy_poll_usec = priv->busy_poll_usec;
+                        new_priv->spin_usec = priv->busy_poll_usec;
+                        if (priv->busy_poll_usec)
+                                __socket_busy_poll (new_sock,
+                                                    priv->busy_poll_usec);
 
                         new_priv->ssl_ctx = priv->ssl_ctx;
 			if (priv->use_ssl && !priv->own_thread) {
@@ -2490,6 +3259,9 @@ socket_connect (rpc_transport_t *this, int port)
         if (port > 0) {
                 sock_union.sin.sin_port = htons (port);
         }
+        /* a kTLS handover of the last connection does not stick */
+        priv->own_thread = priv->own_thread_cfg;
+
         if (ntohs(sock_union.sin.sin_port) == GF_DEFAULT_SOCKET_LISTEN_PORT) {
                 if (priv->use_ssl) {
                         gf_log(this->name,GF_LOG_DEBUG,
@@ -2559,6 +3331,10 @@ socket_connect (rpc_transport_t *this, int port)
                         }
                 }
 
+                priv->spin_usec = priv->busy_poll_usec;
+                if (priv->busy_poll_usec)
+                        __socket_busy_poll (priv->sock, priv->busy_poll_usec);
+
                 if (priv->keepalive) {
                         ret = __socket_keepalive (priv->sock,
                                                   sa_family,
@@ -2808,22 +3584,96 @@ out:
 }
 
 
-int32_t
-socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
+/*
+ * queue @entry, or write it right away when nothing is queued before it.
+ *
+ * with coalescing enabled, an entry finding the queue empty is not written
+ * here but left for the POLLOUT handler, so whatever else gets submitted
+ * until the event thread gets to the connection goes out in the same
+ * writev. there is no timer: when the event threads are busy and the batch
+ * has waited for longer than coalesce_usec, the next entry flushes it.
+ */
+static int
+__socket_ioq_submit (rpc_transport_t *this, struct ioq *entry, char a_byte)
 {
         socket_private_t *priv = NULL;
         int               ret = -1;
         char              need_poll_out = 0;
         char              need_append = 1;
+        char              need_churn = 0;
+
+        priv = this->private;
+
+        if (list_empty (&priv->ioq)) {
+                if (priv->coalesce_usec && !priv->own_thread) {
+                        priv->ioq_deferred = _gf_true;
+                        priv->ioq_since = __socket_now_usec ();
+                        need_poll_out = 1;
+                } else {
+                        ret = __socket_ioq_churn_entry (this, entry, 1);
+
+                        if (ret == 0) {
+                                need_append = 0;
+                        }
+                        if (ret > 0) {
+                                need_poll_out = 1;
+                        }
+                }
+        } else if (priv->ioq_deferred &&
+                   (__socket_now_usec () - priv->ioq_since >=
+                    priv->coalesce_usec)) {
+                need_churn = 1;
+        }
+
+        if (need_append) {
+                list_add_tail (&entry->list, &priv->ioq);
+                if (priv->own_thread) {
+                        /*
+                         * Make sure the polling thread wakes up, by
+                         * writing a byte to represent this entry.
+                         */
+                        if (write(priv->pipe[1],&a_byte,1) < 1) {
+                                gf_log(this->name,GF_LOG_WARNING,
+                                       "write error on pipe");
+                        }
+                }
+                ret = 0;
+        }
+
+        if (need_churn) {
+                /* the poller is late, stays registered for POLLOUT if
+                   this does not get everything out */
+                ret = __socket_ioq_churn (this);
+                if (ret == -1) {
+                        __socket_disconnect (this);
+                } else {
+                        ret = 0;
+                }
+        }
+
+        if (!priv->own_thread && need_poll_out) {
+                /* first entry to wait. continue writing on POLLOUT */
+                priv->idx = event_select_on (this->ctx->event_pool,
+                                             priv->sock,
+                                             priv->idx, -1, 1);
+        }
+
+        return ret;
+}
+
+
+int32_t
+socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
+{
+        socket_private_t *priv = NULL;
+        int               ret = -1;
         struct ioq       *entry = NULL;
-        glusterfs_ctx_t  *ctx = NULL;
 	char              a_byte = 'j';
 
         GF_VALIDATE_OR_GOTO ("socket", this, out);
         GF_VALIDATE_OR_GOTO ("socket", this->private, out);
 
         priv = this->private;
-        ctx  = this->ctx;
 
         pthread_mutex_lock (&priv->lock);
         {
@@ -2842,37 +3692,7 @@ socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
                 if (!entry)
                         goto unlock;
 
-                if (list_empty (&priv->ioq)) {
-                        ret = __socket_ioq_churn_entry (this, entry, 1);
-
-                        if (ret == 0) {
-                                need_append = 0;
-			}
-                        if (ret > 0) {
-                                need_poll_out = 1;
-			}
-                }
-
-                if (need_append) {
-                        list_add_tail (&entry->list, &priv->ioq);
-			if (priv->own_thread) {
-				/*
-				 * Make sure the polling thread wakes up, by
-				 * writing a byte to represent this entry.
-				 */
-				if (write(priv->pipe[1],&a_byte,1) < 1) {
-					gf_log(this->name,GF_LOG_WARNING,
-					       "write error on pipe");
-				}
-			}
-                        ret = 0;
-                }
-                if (!priv->own_thread && need_poll_out) {
-                        /* first entry to wait. continue writing on POLLOUT */
-                        priv->idx = event_select_on (ctx->event_pool,
-                                                     priv->sock,
-                                                     priv->idx, -1, 1);
-                }
+                ret = __socket_ioq_submit (this, entry, a_byte);
         }
 unlock:
         pthread_mutex_unlock (&priv->lock);
@@ -2887,17 +3707,13 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
 {
         socket_private_t *priv = NULL;
         int               ret = -1;
-        char              need_poll_out = 0;
-        char              need_append = 1;
         struct ioq       *entry = NULL;
-        glusterfs_ctx_t  *ctx = NULL;
 	char              a_byte = 'd';
 
         GF_VALIDATE_OR_GOTO ("socket", this, out);
         GF_VALIDATE_OR_GOTO ("socket", this->private, out);
 
         priv = this->private;
-        ctx  = this->ctx;
 
         pthread_mutex_lock (&priv->lock);
         {
@@ -2916,37 +3732,7 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
                 if (!entry)
                         goto unlock;
 
-                if (list_empty (&priv->ioq)) {
-                        ret = __socket_ioq_churn_entry (this, entry, 1);
-
-                        if (ret == 0) {
-                                need_append = 0;
-			}
-                        if (ret > 0) {
-                                need_poll_out = 1;
-			}
-                }
-
-                if (need_append) {
-                        list_add_tail (&entry->list, &priv->ioq);
-			if (priv->own_thread) {
-				/*
-				 * Make sure the polling thread wakes up, by
-				 * writing a byte to represent this entry.
-				 */
-				if (write(priv->pipe[1],&a_byte,1) < 1) {
-					gf_log(this->name,GF_LOG_WARNING,
-					       "write error on pipe");
-				}
-			}
-                        ret = 0;
-                }
-                if (!priv->own_thread && need_poll_out) {
-                        /* first entry to wait. continue writing on POLLOUT */
-                        priv->idx = event_select_on (ctx->event_pool,
-                                                     priv->sock,
-                                                     priv->idx, -1, 1);
-                }
+                ret = __socket_ioq_submit (this, entry, a_byte);
         }
 unlock:
         pthread_mutex_unlock (&priv->lock);
@@ -3035,6 +3821,30 @@ out:
 }
 
 
+int32_t
+socket_throttle (rpc_transport_t *this, gf_boolean_t onoff)
+{
+        socket_private_t *priv = NULL;
+
+        priv = this->private;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                priv->throttled = onoff;
+
+                /* the poller thread picks the change up on its own */
+                if (!priv->own_thread && priv->connected == 1 &&
+                    priv->sock != -1)
+                        priv->idx = event_select_on (this->ctx->event_pool,
+                                                     priv->sock, priv->idx,
+                                                     (int) !onoff, -1);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return 0;
+}
+
+
 struct rpc_transport_ops tops = {
         .listen             = socket_listen,
         .connect            = socket_connect,
@@ -3045,6 +3855,7 @@ struct rpc_transport_ops tops = {
         .get_peeraddr       = socket_getpeeraddr,
         .get_myname         = socket_getmyname,
         .get_myaddr         = socket_getmyaddr,
+        .throttle           = socket_throttle,
 };
 
 int
@@ -3055,6 +3866,7 @@ reconfigure (rpc_transport_t *this, dict_t *options)
         char             *optstr        = NULL;
         int               ret           = 0;
         uint64_t          windowsize    = 0;
+        uint32_t          coalesce_usec = 0;
 
         GF_VALIDATE_OR_GOTO ("socket", this, out);
         GF_VALIDATE_OR_GOTO ("socket", this->private, out);
@@ -3095,6 +3907,34 @@ reconfigure (rpc_transport_t *this, dict_t *options)
 
         priv->windowsize = (int)windowsize;
 
+        coalesce_usec = 0;
+        if (dict_get_uint32 (options, "transport.socket.coalesce-usec",
+                             &coalesce_usec) == 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "Reconfigured transport.socket.coalesce-usec to %u",
+                        coalesce_usec);
+        }
+
+        /* a batch deferred meanwhile is still flushed on POLLOUT */
+        pthread_mutex_lock (&priv->lock);
+        {
+                priv->coalesce_usec = coalesce_usec;
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        priv->busy_poll_usec = 0;
+        if (dict_get_uint32 (options, "transport.socket.busy-poll-usec",
+                             &priv->busy_poll_usec) == 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "Reconfigured transport.socket.busy-poll-usec to %u",
+                        priv->busy_poll_usec);
+        }
+        priv->busy_poll_usec = socket_busy_poll_check (this,
+                                                       priv->busy_poll_usec);
+        priv->spin_usec = priv->busy_poll_usec;
+        if (priv->sock != -1 && priv->connected == 1)
+                __socket_busy_poll (priv->sock, priv->busy_poll_usec);
+
         ret = 0;
 out:
         return ret;
@@ -3111,6 +3951,8 @@ socket_init (rpc_transport_t *this)
         uint32_t          keepalive = 0;
         uint32_t          backlog = 0;
 	int               session_id = 0;
+        char             *ticket_key = NULL;
+        ssl_ticket_keys_t *keys = NULL;
 
         if (this->private) {
                 gf_log_callingfn (this->name, GF_LOG_ERROR,
@@ -3223,6 +4065,24 @@ socket_init (rpc_transport_t *this)
                 priv->backlog = backlog;
         }
 
+        if (dict_get_uint32 (this->options,
+                             "transport.socket.coalesce-usec",
+                             &priv->coalesce_usec) == 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "coalescing socket writes for up to %u usec",
+                        priv->coalesce_usec);
+        }
+
+        if (dict_get_uint32 (this->options,
+                             "transport.socket.busy-poll-usec",
+                             &priv->busy_poll_usec) == 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "busy-polling connections for up to %u usec",
+                        priv->busy_poll_usec);
+        }
+        priv->busy_poll_usec = socket_busy_poll_check (this,
+                                                       priv->busy_poll_usec);
+
         optstr = NULL;
 
          /* Check if socket read failures are to be logged */
@@ -3289,6 +4149,9 @@ socket_init (rpc_transport_t *this)
          * if we're using the glusterd portmapper.
          */
         priv->use_ssl = priv->ssl_enabled;
+#ifdef GF_LINUX_HOST_OS
+        this->pipe_payload = !priv->ssl_enabled;
+#endif
 
 	priv->own_thread = priv->use_ssl;
 	if (dict_get_str(this->options,OWN_THREAD_OPT,&optstr) == 0) {
@@ -3299,11 +4162,30 @@ socket_init (rpc_transport_t *this)
 	}
 	gf_log(this->name,GF_LOG_INFO,"using %s polling thread",
 	       priv->own_thread ? "private" : "system");
+	priv->own_thread_cfg = priv->own_thread;
+
+	priv->ssl_ktls = _gf_false;
+	if (dict_get_str(this->options,SSL_KTLS_OPT,&optstr) == 0) {
+                if (gf_string2boolean (optstr, &priv->ssl_ktls) != 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+				"invalid value given for ssl-ktls boolean");
+		}
+	}
+
+	if (dict_get_str(this->options,SSL_TICKET_KEY_OPT,&optstr) == 0) {
+                if (!priv->ssl_enabled) {
+                        gf_log(this->name,GF_LOG_WARNING,
+                               "%s specified without %s (ignored)",
+                               SSL_TICKET_KEY_OPT, SSL_ENABLED_OPT);
+                }
+                ticket_key = optstr;
+	}
 
 	if (priv->use_ssl) {
 		SSL_library_init();
 		SSL_load_error_strings();
-		priv->ssl_meth = (SSL_METHOD *)TLSv1_method();
+		/* the highest version both ends have, kTLS needs TLS 1.2 */
+		priv->ssl_meth = (SSL_METHOD *)SSLv23_method();
 		priv->ssl_ctx = SSL_CTX_new(priv->ssl_meth);
 
                 if (SSL_CTX_set_cipher_list(priv->ssl_ctx,
@@ -3345,6 +4227,40 @@ socket_init (rpc_transport_t *this)
 					       sizeof(priv->ssl_session_id));
 
 		SSL_CTX_set_verify(priv->ssl_ctx,SSL_VERIFY_PEER,0);
+
+		SSL_CTX_set_session_cache_mode(priv->ssl_ctx,
+					       SSL_SESS_CACHE_BOTH);
+		SSL_CTX_sess_set_new_cb(priv->ssl_ctx,ssl_new_session);
+
+		if (ticket_key) {
+			keys = ssl_ticket_keys_new(this,ticket_key);
+			if (!keys)
+				goto err;
+		}
+		SSL_CTX_set_app_data(priv->ssl_ctx,keys);
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+		SSL_CTX_set_tlsext_ticket_key_evp_cb(priv->ssl_ctx,
+						     ssl_ticket_key_cb);
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb(priv->ssl_ctx,
+						 ssl_ticket_key_cb);
+#endif
+
+#if !defined(OPENSSL_NO_KTLS) && defined(SSL_OP_ENABLE_KTLS)
+		if (priv->ssl_ktls) {
+			/* readv() on a kTLS socket fails with EIO on anything
+			   but application data. TLS 1.2 without renegotiation
+			   sends nothing else after the handshake, short of the
+			   alert that ends the connection anyway; TLS 1.3 has
+			   tickets and key updates. */
+			SSL_CTX_set_options(priv->ssl_ctx,
+					    SSL_OP_ENABLE_KTLS |
+					    SSL_OP_NO_RENEGOTIATION);
+			SSL_CTX_set_max_proto_version(priv->ssl_ctx,
+						      TLS1_2_VERSION);
+			SSL_CTX_set_num_tickets(priv->ssl_ctx,0);
+		}
+#endif
 	}
 
 out:
@@ -3397,6 +4313,9 @@ fini (rpc_transport_t *this)
 		if (priv->ssl_ca_list) {
 			GF_FREE(priv->ssl_ca_list);
 		}
+		if (priv->ssl_session) {
+			SSL_SESSION_free(priv->ssl_session);
+		}
                 GF_FREE (priv);
         }
 
@@ -3474,6 +4393,32 @@ struct volume_options options[] = {
         { .key   = {"transport.socket.read-fail-log"},
           .type  = GF_OPTION_TYPE_BOOL
         },
+        { .key   = {"transport.socket.coalesce-usec"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 0,
+          .max   = GF_MAX_SOCKET_COALESCE_USEC,
+          .default_value = "0",
+          .description = "Leave a message submitted to an idle "
+                         "connection for the event thread to send, together "
+                         "with whatever is submitted until it gets to the "
+                         "connection. A message submitted after the oldest "
+                         "has waited this many microseconds sends them "
+                         "itself. Also applies to the connections already "
+                         "established when changed. 0 writes every message "
+                         "immediately."
+        },
+        { .key   = {"transport.socket.busy-poll-usec"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 0,
+          .max   = GF_MAX_SOCKET_BUSY_POLL_USEC,
+          .default_value = "0",
+          .description = "After a message comes in, keep the event thread "
+                         "polling the connection for the next one for up "
+                         "to this many microseconds before going back to "
+                         "epoll. The window shrinks while the connection "
+                         "is idle. Only done with more than one event "
+                         "thread. 0 always waits in epoll."
+        },
         { .key   = {SSL_ENABLED_OPT},
           .type  = GF_OPTION_TYPE_BOOL
         },
@@ -3489,5 +4434,22 @@ struct volume_options options[] = {
 	{ .key   = {OWN_THREAD_OPT},
 	  .type  = GF_OPTION_TYPE_BOOL
 	},
+	{ .key   = {SSL_KTLS_OPT},
+	  .type  = GF_OPTION_TYPE_BOOL,
+	  .default_value = "off",
+	  .description = "Hand the TLS record layer to the kernel after the "
+			 "handshake where it supports that, and serve the "
+			 "connection from the event threads. Limits the "
+			 "connection to TLS 1.2."
+	},
+	{ .key   = {SSL_TICKET_KEY_OPT},
+	  .type  = GF_OPTION_TYPE_PATH,
+	  .description = "File holding the 80 byte key TLS session tickets "
+			 "are sealed with. Servers sharing the file resume "
+			 "each other's sessions, also across restarts. "
+			 "Replacing the file rotates the key; the one before "
+			 "stays valid for opening tickets. Without it no "
+			 "tickets are issued."
+	},
         { .key = {NULL} }
 };
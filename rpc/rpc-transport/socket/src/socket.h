@@ -26,10 +26,25 @@
 #include "mem-pool.h"
 #include "globals.h"
 
+#include <limits.h>
+
 #ifndef MAX_IOVEC
 #define MAX_IOVEC 16
 #endif /* MAX_IOVEC */
 
+/* Most vectors gathered from the ioq into one writev() */
+#ifdef IOV_MAX
+#define SOCKET_IOQ_MAX_IOVEC IOV_MAX
+#else
+#define SOCKET_IOQ_MAX_IOVEC 1024
+#endif
+
+/* Longest a submission may be held back to be coalesced with others */
+#define GF_MAX_SOCKET_COALESCE_USEC     (100 * 1000)
+
+/* Longest an event thread may spin on a connection waiting for input */
+#define GF_MAX_SOCKET_BUSY_POLL_USEC    (10 * 1000)
+
 #define GF_DEFAULT_SOCKET_LISTEN_PORT  GF_DEFAULT_BASE_PORT
 
 #define RPC_MAX_FRAGMENT_SIZE 0x7fffffff
@@ -106,6 +121,7 @@ struct ioq {
         struct iovec      *pending_vector;
         int                pending_count;
         struct iobref     *iobref;
+        gf_boolean_t       pipe_backed; /* payload to splice, not writev */
 };
 
 typedef struct {
@@ -177,6 +193,29 @@ struct gf_sock_incoming {
         size_t               total_bytes_read;
 };
 
+/* session ticket key file: 16 bytes of key name, 32 of HMAC secret and
+   32 of AES key */
+#define SSL_TICKET_KEY_SIZE   80
+#define SSL_TICKET_KEY_CHECK  60  /* seconds between looks at the file */
+
+struct ssl_ticket_key {
+        unsigned char          name[16];
+        unsigned char          hmac[32];
+        unsigned char          aes[32];
+};
+
+/* shared by a listener and the connections it accepts, like the SSL_CTX */
+typedef struct {
+        pthread_mutex_t        lock;
+        char                  *path;
+        struct ssl_ticket_key  current;   /* seals and opens tickets */
+        struct ssl_ticket_key  previous;  /* only opens them */
+        gf_boolean_t           has_previous;
+        time_t                 checked;
+        ino_t                  ino;
+        time_t                 mtime;
+} ssl_ticket_keys_t;
+
 typedef struct {
         int32_t                sock;
         int32_t                idx;
@@ -212,10 +251,25 @@ typedef struct {
 	char                  *ssl_own_cert;
 	char                  *ssl_private_key;
 	char                  *ssl_ca_list;
+	gf_boolean_t           ssl_ktls;     /* let the kernel take over the
+	                                        record layer after handshake */
+	gf_boolean_t           ktls;         /* ... and it did */
+	SSL_SESSION           *ssl_session;  /* resumed on reconnect */
 	pthread_t              thread;
 	int                    pipe[2];
 	gf_boolean_t           own_thread;
+	gf_boolean_t           own_thread_cfg;
+        gf_boolean_t           throttled;
 	volatile int           socket_gen;
+        uint32_t               coalesce_usec; /* 0: write on submission */
+        gf_boolean_t           ioq_deferred;  /* ioq is waiting for the
+                                                 poller, not for room */
+        uint64_t               ioq_since;     /* when it started waiting */
+        gf_boolean_t           corked;
+        uint32_t               busy_poll_usec; /* 0: always wait in epoll */
+        uint32_t               spin_usec;      /* current spin window,
+                                                  0 while idle */
+        uint64_t               last_in_usec;   /* end of the last pollin */
 } socket_private_t;
 
 
@@ -1911,3 +1911,65 @@ xdr_gf_event_notify_rsp (XDR *xdrs, gf_event_notify_rsp *objp)
 		 return FALSE;
 	return TRUE;
 }
+
+bool_t
+xdr_gfs3_compound_req_op (XDR *xdrs, gfs3_compound_req_op *objp)
+{
+	register int32_t *buf;
+        buf = NULL;
+
+	 if (!xdr_int (xdrs, &objp->procnum))
+		 return FALSE;
+	 if (!xdr_bytes (xdrs, (char **)&objp->args.args_val, (u_int *) &objp->args.args_len, ~0))
+		 return FALSE;
+	 if (!xdr_u_int (xdrs, &objp->payload_size))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_gfs3_compound_req (XDR *xdrs, gfs3_compound_req *objp)
+{
+	register int32_t *buf;
+        buf = NULL;
+
+	 if (!xdr_array (xdrs, (char **)&objp->ops.ops_val, (u_int *) &objp->ops.ops_len, ~0,
+		sizeof (gfs3_compound_req_op), (xdrproc_t) xdr_gfs3_compound_req_op))
+		 return FALSE;
+	 if (!xdr_bytes (xdrs, (char **)&objp->xdata.xdata_val, (u_int *) &objp->xdata.xdata_len, ~0))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_gfs3_compound_rsp_op (XDR *xdrs, gfs3_compound_rsp_op *objp)
+{
+	register int32_t *buf;
+        buf = NULL;
+
+	 if (!xdr_int (xdrs, &objp->procnum))
+		 return FALSE;
+	 if (!xdr_bytes (xdrs, (char **)&objp->rsp.rsp_val, (u_int *) &objp->rsp.rsp_len, ~0))
+		 return FALSE;
+	 if (!xdr_u_int (xdrs, &objp->payload_size))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_gfs3_compound_rsp (XDR *xdrs, gfs3_compound_rsp *objp)
+{
+	register int32_t *buf;
+        buf = NULL;
+
+	 if (!xdr_int (xdrs, &objp->op_ret))
+		 return FALSE;
+	 if (!xdr_int (xdrs, &objp->op_errno))
+		 return FALSE;
+	 if (!xdr_array (xdrs, (char **)&objp->ops.ops_val, (u_int *) &objp->ops.ops_len, ~0,
+		sizeof (gfs3_compound_rsp_op), (xdrproc_t) xdr_gfs3_compound_rsp_op))
+		 return FALSE;
+	 if (!xdr_bytes (xdrs, (char **)&objp->xdata.xdata_val, (u_int *) &objp->xdata.xdata_len, ~0))
+		 return FALSE;
+	return TRUE;
+}
@@ -1091,6 +1091,52 @@ struct gf_event_notify_rsp {
 };
 typedef struct gf_event_notify_rsp gf_event_notify_rsp;
 
+struct gfs3_compound_req_op {
+	int procnum;
+	struct {
+		u_int args_len;
+		char *args_val;
+	} args;
+	u_int payload_size;
+};
+typedef struct gfs3_compound_req_op gfs3_compound_req_op;
+
+struct gfs3_compound_req {
+	struct {
+		u_int ops_len;
+		gfs3_compound_req_op *ops_val;
+	} ops;
+	struct {
+		u_int xdata_len;
+		char *xdata_val;
+	} xdata;
+};
+typedef struct gfs3_compound_req gfs3_compound_req;
+
+struct gfs3_compound_rsp_op {
+	int procnum;
+	struct {
+		u_int rsp_len;
+		char *rsp_val;
+	} rsp;
+	u_int payload_size;
+};
+typedef struct gfs3_compound_rsp_op gfs3_compound_rsp_op;
+
+struct gfs3_compound_rsp {
+	int op_ret;
+	int op_errno;
+	struct {
+		u_int ops_len;
+		gfs3_compound_rsp_op *ops_val;
+	} ops;
+	struct {
+		u_int xdata_len;
+		char *xdata_val;
+	} xdata;
+};
+typedef struct gfs3_compound_rsp gfs3_compound_rsp;
+
 /* the xdr functions */
 
 #if defined(__STDC__) || defined(__cplusplus)
@@ -1184,6 +1230,10 @@ extern  bool_t xdr_gf_set_lk_ver_rsp (XDR *, gf_set_lk_ver_rsp*);
 extern  bool_t xdr_gf_set_lk_ver_req (XDR *, gf_set_lk_ver_req*);
 extern  bool_t xdr_gf_event_notify_req (XDR *, gf_event_notify_req*);
 extern  bool_t xdr_gf_event_notify_rsp (XDR *, gf_event_notify_rsp*);
+extern  bool_t xdr_gfs3_compound_req_op (XDR *, gfs3_compound_req_op*);
+extern  bool_t xdr_gfs3_compound_req (XDR *, gfs3_compound_req*);
+extern  bool_t xdr_gfs3_compound_rsp_op (XDR *, gfs3_compound_rsp_op*);
+extern  bool_t xdr_gfs3_compound_rsp (XDR *, gfs3_compound_rsp*);
 
 #else /* K&R C */
 extern bool_t xdr_gf_statfs ();
@@ -1276,6 +1326,10 @@ extern bool_t xdr_gf_set_lk_ver_rsp ();
 extern bool_t xdr_gf_set_lk_ver_req ();
 extern bool_t xdr_gf_event_notify_req ();
 extern bool_t xdr_gf_event_notify_rsp ();
+extern bool_t xdr_gfs3_compound_req_op ();
+extern bool_t xdr_gfs3_compound_req ();
+extern bool_t xdr_gfs3_compound_rsp_op ();
+extern bool_t xdr_gfs3_compound_rsp ();
 
 #endif /* K&R C */
 
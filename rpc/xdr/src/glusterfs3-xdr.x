@@ -694,3 +694,29 @@ struct gf_event_notify_rsp {
 	int op_errno;
 	opaque dict<>;
 };
+
+/* a compound call carries the encoded arguments of each fop, their write
+   payloads follow the request in the order of the fops */
+struct gfs3_compound_req_op {
+        int          procnum;
+        opaque       args<>;
+        unsigned int payload_size;
+};
+
+struct gfs3_compound_req {
+        gfs3_compound_req_op ops<>;
+        opaque   xdata<>; /* Extra data */
+};
+
+struct gfs3_compound_rsp_op {
+        int          procnum;
+        opaque       rsp<>;
+        unsigned int payload_size;
+};
+
+struct gfs3_compound_rsp {
+        int    op_ret;
+        int    op_errno;
+        gfs3_compound_rsp_op ops<>;
+        opaque   xdata<>; /* Extra data */
+};
@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2013 Red Hat, Inc. <http://www.redhat.com>
+  This file is part of GlusterFS.
+
+  This file is licensed to you under your choice of the GNU Lesser
+  General Public License, version 3 or any later version (LGPLv3 or
+  later), or the GNU General Public License, version 2 (GPLv2), in all
+  cases as published by the Free Software Foundation.
+*/
+
+/* Decoders for the requests on the brick's hot path.  They match the
+   rpcgen ones in glusterfs3-xdr.c, except that the variable length
+   opaques are left in the request buffer instead of being copied out
+   (see xdr_bytes_inplace()).  The decoded arguments live exactly as long
+   as the request, and there is nothing to free afterwards. */
+
+#include "glusterfs3.h"
+
+bool_t
+xdr_gfs3_stat_req_inplace (XDR *xdrs, gfs3_stat_req *objp)
+{
+        if (!xdr_opaque (xdrs, objp->gfid, 16))
+                return FALSE;
+        if (!xdr_bytes_inplace (xdrs, &objp->xdata.xdata_val,
+                                &objp->xdata.xdata_len, ~0))
+                return FALSE;
+        return TRUE;
+}
+
+bool_t
+xdr_gfs3_read_req_inplace (XDR *xdrs, gfs3_read_req *objp)
+{
+        if (!xdr_opaque (xdrs, objp->gfid, 16))
+                return FALSE;
+        if (!xdr_quad_t (xdrs, &objp->fd))
+                return FALSE;
+        if (!xdr_u_quad_t (xdrs, &objp->offset))
+                return FALSE;
+        if (!xdr_u_int (xdrs, &objp->size))
+                return FALSE;
+        if (!xdr_u_int (xdrs, &objp->flag))
+                return FALSE;
+        if (!xdr_bytes_inplace (xdrs, &objp->xdata.xdata_val,
+                                &objp->xdata.xdata_len, ~0))
+                return FALSE;
+        return TRUE;
+}
+
+bool_t
+xdr_gfs3_write_req_inplace (XDR *xdrs, gfs3_write_req *objp)
+{
+        if (!xdr_opaque (xdrs, objp->gfid, 16))
+                return FALSE;
+        if (!xdr_quad_t (xdrs, &objp->fd))
+                return FALSE;
+        if (!xdr_u_quad_t (xdrs, &objp->offset))
+                return FALSE;
+        if (!xdr_u_int (xdrs, &objp->size))
+                return FALSE;
+        if (!xdr_u_int (xdrs, &objp->flag))
+                return FALSE;
+        if (!xdr_bytes_inplace (xdrs, &objp->xdata.xdata_val,
+                                &objp->xdata.xdata_len, ~0))
+                return FALSE;
+        return TRUE;
+}
+
+/* bname has to be NUL terminated, so it is still copied, into the buffer
+   the caller points objp->bname at */
+bool_t
+xdr_gfs3_lookup_req_inplace (XDR *xdrs, gfs3_lookup_req *objp)
+{
+        if (!xdr_opaque (xdrs, objp->gfid, 16))
+                return FALSE;
+        if (!xdr_opaque (xdrs, objp->pargfid, 16))
+                return FALSE;
+        if (!xdr_u_int (xdrs, &objp->flags))
+                return FALSE;
+        if (!xdr_string (xdrs, &objp->bname, ~0))
+                return FALSE;
+        if (!xdr_bytes_inplace (xdrs, &objp->xdata.xdata_val,
+                                &objp->xdata.xdata_len, ~0))
+                return FALSE;
+        return TRUE;
+}
+
+bool_t
+xdr_gfs3_fxattrop_req_inplace (XDR *xdrs, gfs3_fxattrop_req *objp)
+{
+        if (!xdr_opaque (xdrs, objp->gfid, 16))
+                return FALSE;
+        if (!xdr_quad_t (xdrs, &objp->fd))
+                return FALSE;
+        if (!xdr_u_int (xdrs, &objp->flags))
+                return FALSE;
+        if (!xdr_bytes_inplace (xdrs, &objp->dict.dict_val,
+                                &objp->dict.dict_len, ~0))
+                return FALSE;
+        if (!xdr_bytes_inplace (xdrs, &objp->xdata.xdata_val,
+                                &objp->xdata.xdata_len, ~0))
+                return FALSE;
+        return TRUE;
+}
@@ -267,4 +267,10 @@ gf_stat_from_iatt (struct gf_iatt *gf_stat, struct iatt *iatt)
 	gf_stat->ia_ctime_nsec = iatt->ia_ctime_nsec ;
 }
 
+bool_t xdr_gfs3_stat_req_inplace (XDR *xdrs, gfs3_stat_req *objp);
+bool_t xdr_gfs3_read_req_inplace (XDR *xdrs, gfs3_read_req *objp);
+bool_t xdr_gfs3_write_req_inplace (XDR *xdrs, gfs3_write_req *objp);
+bool_t xdr_gfs3_lookup_req_inplace (XDR *xdrs, gfs3_lookup_req *objp);
+bool_t xdr_gfs3_fxattrop_req_inplace (XDR *xdrs, gfs3_fxattrop_req *objp);
+
 #endif /* !_GLUSTERFS3_H */
@@ -88,6 +88,51 @@ ret:
         return ret;
 }
 
+/* Same as xdr_bytes(), except that decoding leaves *cpp pointing at the
+   bytes inside the buffer being decoded.  Nothing is allocated, so the
+   result is valid only as long as that buffer is, and must not be freed. */
+bool_t
+xdr_bytes_inplace (XDR *xdrs, char **cpp, u_int *sizep, u_int maxsize)
+{
+        char  *sp        = NULL;
+        u_int  size      = 0;
+        u_int  rndup     = 0;
+        long   remaining = 0;
+
+        if (xdrs->x_op == XDR_FREE)
+                return TRUE;
+
+        if (xdrs->x_op != XDR_DECODE)
+                return xdr_bytes (xdrs, cpp, sizep, maxsize);
+
+        if (!xdr_u_int (xdrs, &size) || (size > maxsize))
+                return FALSE;
+
+        if (size == 0) {
+                *sizep = 0;
+                *cpp = NULL;
+                return TRUE;
+        }
+
+        /* only memory streams are decoded in place. RNDUP () wraps for
+           sizes close to UINT_MAX, look at what is left first */
+        remaining = xdr_decoded_remaining_len (*xdrs);
+        if ((remaining < 0) || (size > remaining))
+                return FALSE;
+
+        rndup = RNDUP (size);
+        if ((rndup < size) || (rndup > remaining) || (rndup > INT_MAX))
+                return FALSE;
+
+        sp = (char *) XDR_INLINE (xdrs, (int) rndup);
+        if (!sp)
+                return FALSE;
+
+        *sizep = size;
+        *cpp = sp;
+        return TRUE;
+}
+
 ssize_t
 xdr_length_round_up (size_t len, size_t bufsize)
 {
@@ -35,6 +35,8 @@ ssize_t
 xdr_to_generic_payload (struct iovec inmsg, void *args, xdrproc_t proc,
                         struct iovec *pendingpayload);
 
+bool_t
+xdr_bytes_inplace (XDR *xdrs, char **cpp, u_int *sizep, u_int maxsize);
 
 extern int
 xdr_bytes_round_up (struct iovec *vec, size_t bufsize);
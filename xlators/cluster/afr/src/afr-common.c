@@ -597,11 +597,125 @@ afr_hash_child (int32_t *success_children, int32_t child_count,
                              sizeof(gfid_copy)) % child_count;
 }
 
+void
+afr_load_wind (xlator_t *this, afr_local_t *local, int32_t child)
+{
+        afr_private_t   *priv = NULL;
+
+        priv = this->private;
+        /* once a fop is tracked all its winds are, whatever the mode */
+        if (!timerisset (&local->load_start) &&
+            (priv->hash_mode != AFR_READ_HASH_LOAD))
+                return;
+
+        local->load_child = child;
+        gettimeofday (&local->load_start, NULL);
+
+        LOCK (&priv->read_child_lock);
+        {
+                priv->child_load[child].outstanding++;
+        }
+        UNLOCK (&priv->read_child_lock);
+}
+
+void
+afr_load_unwind (xlator_t *this, afr_local_t *local, int32_t child,
+                 int32_t op_ret)
+{
+        afr_private_t    *priv    = NULL;
+        afr_child_load_t *load    = NULL;
+        struct timeval    now     = {0,};
+        uint64_t          elapsed = 0;
+
+        /* not wound through afr_load_wind */
+        if (!timerisset (&local->load_start))
+                return;
+
+        priv = this->private;
+        gettimeofday (&now, NULL);
+        elapsed = ((now.tv_sec - local->load_start.tv_sec) * 1000000) +
+                  (now.tv_usec - local->load_start.tv_usec);
+        if ((int64_t) elapsed < 0)
+                elapsed = 0;
+
+        LOCK (&priv->read_child_lock);
+        {
+                load = &priv->child_load[child];
+                if (load->outstanding)
+                        load->outstanding--;
+                /* failures say little about how fast the child is */
+                if (op_ret >= 0) {
+                        if (!load->latency)
+                                load->latency = elapsed;
+                        else
+                                load->latency = load->latency -
+                                                (load->latency >> 3) +
+                                                (elapsed >> 3);
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
+}
+
+/* expected wait for one more fop on the child */
+static uint64_t
+__afr_load_score (afr_private_t *priv, int32_t child)
+{
+        return priv->child_load[child].latency *
+               (priv->child_load[child].outstanding + 1);
+}
+
+/* The read child of an inode is only moved off prev_read_child when another
+ * child is clearly less loaded, so that reads on a file do not flip between
+ * children as the averages move.
+ */
+static int32_t
+afr_least_loaded_child (xlator_t *this, int32_t *success_children,
+                        int32_t child_count, int32_t prev_read_child,
+                        int32_t *sources)
+{
+        afr_private_t   *priv       = NULL;
+        int32_t          read_child = -1;
+        uint64_t         score      = 0;
+        uint64_t         best       = 0;
+        int              i          = 0;
+
+        priv = this->private;
+
+        LOCK (&priv->read_child_lock);
+        {
+                for (i = 0; i < child_count; i++) {
+                        if (success_children[i] < 0)
+                                break;
+                        if (!afr_is_read_child (success_children, sources,
+                                                child_count,
+                                                success_children[i]))
+                                continue;
+                        score = __afr_load_score (priv, success_children[i]);
+                        if ((read_child < 0) || (score < best)) {
+                                read_child = success_children[i];
+                                best = score;
+                        }
+                }
+
+                if ((read_child >= 0) && (read_child != prev_read_child) &&
+                    afr_is_read_child (success_children, sources, child_count,
+                                       prev_read_child)) {
+                        score = __afr_load_score (priv, prev_read_child);
+                        if (score <= (best + (best * AFR_READ_LOAD_MARGIN / 100)
+                                      + AFR_READ_LOAD_SLACK))
+                                read_child = prev_read_child;
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
+
+        return read_child;
+}
+
 /* If sources is NULL the xattrs are assumed to be of source for all
  * success_children.
  */
 int
-afr_select_read_child_from_policy (int32_t *success_children,
+afr_select_read_child_from_policy (xlator_t *this, int32_t *success_children,
                                    int32_t child_count, int32_t prev_read_child,
                                    int32_t config_read_child, int32_t *sources,
                                    unsigned int hmode, uuid_t gfid)
@@ -616,6 +730,14 @@ afr_select_read_child_from_policy (int32_t *success_children,
                                read_child))
                 goto out;
 
+        if (hmode == AFR_READ_HASH_LOAD) {
+                read_child = afr_least_loaded_child (this, success_children,
+                                                     child_count,
+                                                     prev_read_child, sources);
+                if (read_child >= 0)
+                        goto out;
+        }
+
         read_child = prev_read_child;
         if (afr_is_read_child (success_children, sources, child_count,
                                read_child))
@@ -653,7 +775,7 @@ afr_set_read_ctx_from_policy (xlator_t *this, inode_t *inode,
         afr_private_t            *priv = NULL;
 
         priv = this->private;
-        read_child = afr_select_read_child_from_policy (fresh_children,
+        read_child = afr_select_read_child_from_policy (this, fresh_children,
                                                         priv->child_count,
                                                         prev_read_child,
                                                         config_read_child,
@@ -815,6 +937,8 @@ afr_local_sh_cleanup (afr_local_t *local, xlator_t *this)
         loc_wipe (&sh->lookup_loc);
 
         GF_FREE (sh->checksum);
+        GF_FREE (sh->checksum_fast);
+        GF_FREE (sh->dirty_regions);
 
         GF_FREE (sh->write_needed);
         if (sh->healing_fd)
@@ -2154,6 +2278,8 @@ afr_lookup_cbk (call_frame_t *frame, void *cookie,
 
          child_index = (long) cookie;
 
+        afr_load_unwind (this, frame->local, child_index, op_ret);
+
         LOCK (&frame->lock);
         {
                 local = frame->local;
@@ -2314,7 +2440,8 @@ afr_lookup (call_frame_t *frame, xlator_t *this,
         afr_lookup_save_gfid (local->cont.lookup.gfid_req, gfid_req,
                               &local->loc);
         local->fop = GF_FOP_LOOKUP;
-        if (priv->choose_local && !priv->did_discovery) {
+        if (priv->choose_local && !priv->did_discovery &&
+            (priv->hash_mode != AFR_READ_HASH_LOAD)) {
                 if (gfid_req && __is_root_gfid(gfid_req)) {
                         local->do_discovery = _gf_true;
                         priv->did_discovery = _gf_true;
@@ -2322,6 +2449,7 @@ afr_lookup (call_frame_t *frame, xlator_t *this,
         }
         for (i = 0; i < priv->child_count; i++) {
                 if (local->child_up[i]) {
+                        afr_load_wind (this, local, i);
                         STACK_WIND_COOKIE (frame, afr_lookup_cbk,
                                            (void *) (long) i,
                                            priv->children[i],
@@ -3665,6 +3793,19 @@ afr_priv_dump (xlator_t *this)
         gf_proc_dump_write("metadata_change_log", "%d", priv->metadata_change_log);
         gf_proc_dump_write("entry-change_log", "%d", priv->entry_change_log);
         gf_proc_dump_write("read_child", "%d", priv->read_child);
+        gf_proc_dump_write("read_hash_mode", "%u", priv->hash_mode);
+        LOCK (&priv->read_child_lock);
+        {
+                for (i = 0; i < priv->child_count; i++) {
+                        sprintf (key, "latency_usec[%d]", i);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           priv->child_load[i].latency);
+                        sprintf (key, "outstanding[%d]", i);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           priv->child_load[i].outstanding);
+                }
+        }
+        UNLOCK (&priv->read_child_lock);
         gf_proc_dump_write("favorite_child", "%d", priv->favorite_child);
         gf_proc_dump_write("wait_count", "%u", priv->wait_count);
 
@@ -4256,6 +4397,8 @@ afr_priv_destroy (afr_private_t *priv)
 //                if (priv->shd.timer && priv->shd.timer[i])
 //                        gf_timer_call_cancel (this->ctx, priv->shd.timer[i]);
         GF_FREE (priv->shd.timer);
+        GF_FREE (priv->shd.stats);
+        GF_FREE (priv->shd.healing);
 
         if (priv->shd.healed)
                 eh_destroy (priv->shd.healed);
@@ -4274,6 +4417,7 @@ afr_priv_destroy (afr_private_t *priv)
         GF_FREE (priv->pending_key);
         GF_FREE (priv->children);
         GF_FREE (priv->child_up);
+        GF_FREE (priv->child_load);
         LOCK_DESTROY (&priv->lock);
         LOCK_DESTROY (&priv->read_child_lock);
         pthread_mutex_destroy (&priv->mutex);
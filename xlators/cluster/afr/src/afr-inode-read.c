@@ -67,6 +67,8 @@ afr_access_cbk (call_frame_t *frame, void *cookie,
 
         read_child = (long) cookie;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.access.last_index;
                 fresh_children = local->fresh_children;
@@ -79,6 +81,8 @@ afr_access_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_access_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -145,6 +149,7 @@ afr_access (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t mask,
         loc_copy (&local->loc, loc);
         local->cont.access.mask = mask;
 
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_access_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -184,6 +189,8 @@ afr_stat_cbk (call_frame_t *frame, void *cookie,
 
         local = frame->local;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.stat.last_index;
                 fresh_children = local->fresh_children;
@@ -196,6 +203,8 @@ afr_stat_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_stat_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -257,6 +266,7 @@ afr_stat (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xdata)
         }
         loc_copy (&local->loc, loc);
 
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_stat_cbk, (void *) (long) call_child,
                            children[call_child],
                            children[call_child]->fops->stat,
@@ -296,6 +306,8 @@ afr_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         read_child = (long) cookie;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.fstat.last_index;
                 fresh_children = local->fresh_children;
@@ -308,6 +320,8 @@ afr_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
                 unwind = 0;
 
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_fstat_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -382,6 +396,7 @@ afr_fstat (call_frame_t *frame, xlator_t *this,
                 op_errno = -ret;
                 goto out;
         }
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_fstat_cbk, (void *) (long) call_child,
                            children[call_child],
                            children[call_child]->fops->fstat,
@@ -420,6 +435,8 @@ afr_readlink_cbk (call_frame_t *frame, void *cookie,
 
         read_child = (long) cookie;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.readlink.last_index;
                 fresh_children = local->fresh_children;
@@ -431,6 +448,8 @@ afr_readlink_cbk (call_frame_t *frame, void *cookie,
                         goto out;
 
                 unwind = 0;
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_readlink_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -497,6 +516,7 @@ afr_readlink (call_frame_t *frame, xlator_t *this,
 
         local->cont.readlink.size       = size;
 
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_readlink_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -588,6 +608,8 @@ afr_getxattr_cbk (call_frame_t *frame, void *cookie,
 
         read_child = (long) cookie;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.getxattr.last_index;
                 fresh_children = local->fresh_children;
@@ -599,6 +621,8 @@ afr_getxattr_cbk (call_frame_t *frame, void *cookie,
                         goto out;
 
                 unwind = 0;
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_getxattr_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1072,6 +1096,7 @@ no_name:
                 goto out;
         }
 
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_getxattr_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -1109,6 +1134,8 @@ afr_fgetxattr_cbk (call_frame_t *frame, void *cookie,
 
         read_child = (long) cookie;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.getxattr.last_index;
                 fresh_children = local->fresh_children;
@@ -1120,6 +1147,8 @@ afr_fgetxattr_cbk (call_frame_t *frame, void *cookie,
                         goto out;
 
                 unwind = 0;
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_fgetxattr_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1204,6 +1233,7 @@ afr_fgetxattr (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_fgetxattr_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -1263,6 +1293,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
         read_child = (long) cookie;
 
+        afr_load_unwind (this, local, local->load_child, op_ret);
+
         if (op_ret == -1) {
                 last_index = &local->cont.readv.last_index;
                 fresh_children = local->fresh_children;
@@ -1275,6 +1307,8 @@ afr_readv_cbk (call_frame_t *frame, void *cookie,
 
                 unwind = 0;
 
+                afr_load_wind (this, local, next_call_child);
+
                 STACK_WIND_COOKIE (frame, afr_readv_cbk,
                                    (void *) (long) read_child,
                                    children[next_call_child],
@@ -1349,6 +1383,7 @@ afr_readv (call_frame_t *frame, xlator_t *this,
                 op_errno = -ret;
                 goto out;
         }
+        afr_load_wind (this, local, call_child);
         STACK_WIND_COOKIE (frame, afr_readv_cbk,
                            (void *) (long) call_child,
                            children[call_child],
@@ -25,6 +25,7 @@
 #include "compat-errno.h"
 #include "compat.h"
 #include "byte-order.h"
+#include "dirty-regions.h"
 
 #include "afr-transaction.h"
 #include "afr-self-heal.h"
@@ -233,6 +234,11 @@ sh_loop_frame_create (call_frame_t *sh_frame, xlator_t *this,
                                            gf_afr_mt_uint8_t);
         if (!new_loop_sh->checksum)
                 goto out;
+        new_loop_sh->checksum_fast = GF_CALLOC (priv->child_count,
+                                                sizeof (*new_loop_sh->checksum_fast),
+                                                gf_afr_mt_char);
+        if (!new_loop_sh->checksum_fast)
+                goto out;
         new_loop_sh->inode      = inode_ref (sh->inode);
         new_loop_sh->sh_data_algo_start = sh->sh_data_algo_start;
         new_loop_sh->source = sh->source;
@@ -283,6 +289,21 @@ out:
         return 0;
 }
 
+/* first block at or after offset a replica recorded a write to */
+static off_t
+sh_loop_next_offset (afr_self_heal_t *sh, off_t offset)
+{
+        if (!sh->dirty_regions)
+                return offset;
+
+        while ((offset < sh->file_size) &&
+               !gf_dirty_regions_test (sh->dirty_regions, offset,
+                                       sh->block_size))
+                offset += sh->block_size;
+
+        return offset;
+}
+
 static int
 sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
                 gf_boolean_t is_first_call, call_frame_t *old_loop_frame)
@@ -312,7 +333,9 @@ sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
                        && (sh_priv->offset < sh->file_size)) {
 
                         loop++;
-                        sh_priv->offset += block_size;
+                        sh_priv->offset = sh_loop_next_offset (sh,
+                                                               sh_priv->offset
+                                                               + block_size);
                         sh_priv->loops_running++;
 
                         if (!is_first_call)
@@ -351,7 +374,7 @@ sh_loop_driver (call_frame_t *sh_frame, xlator_t *this,
 
                         sh_loop_start (sh_frame, this, offset, old_loop_frame);
                         old_loop_frame = NULL;
-                        offset += block_size;
+                        offset = sh_loop_next_offset (sh, offset + block_size);
                 }
         }
 
@@ -610,6 +633,8 @@ sh_diff_checksum_cbk (call_frame_t *loop_frame, void *cookie, xlator_t *this,
         } else {
                 memcpy (loop_sh->checksum + child_index * MD5_DIGEST_LENGTH,
                         strong_checksum, MD5_DIGEST_LENGTH);
+                loop_sh->checksum_fast[child_index] =
+                        (xdata && dict_get (xdata, GF_RCHECKSUM_TYPE_KEY));
         }
 
         call_count = afr_frame_return (loop_frame);
@@ -619,7 +644,11 @@ sh_diff_checksum_cbk (call_frame_t *loop_frame, void *cookie, xlator_t *this,
                         if (sh->sources[i] || !sh_local->child_up[i])
                                 continue;
 
-                        if (memcmp (loop_sh->checksum + (i * MD5_DIGEST_LENGTH),
+                        /* an older brick answered with MD5: the two
+                           can't be compared, so assume they differ */
+                        if ((loop_sh->checksum_fast[i] !=
+                             loop_sh->checksum_fast[sh->source]) ||
+                            memcmp (loop_sh->checksum + (i * MD5_DIGEST_LENGTH),
                                     loop_sh->checksum + (sh->source * MD5_DIGEST_LENGTH),
                                     MD5_DIGEST_LENGTH)) {
                                 /*
@@ -661,6 +690,7 @@ sh_diff_checksum (call_frame_t *loop_frame, xlator_t *this)
         afr_private_t           *priv         = NULL;
         afr_local_t             *loop_local   = NULL;
         afr_self_heal_t         *loop_sh      = NULL;
+        dict_t                  *xdata        = NULL;
         int                     call_count    = 0;
         int                     i             = 0;
 
@@ -672,12 +702,20 @@ sh_diff_checksum (call_frame_t *loop_frame, xlator_t *this)
 
         loop_local->call_count = call_count;
 
+        /* ask for the cheaper strong checksum; failing to, MD5 it is */
+        xdata = dict_new ();
+        if (xdata && dict_set_str (xdata, GF_RCHECKSUM_TYPE_KEY,
+                                   GF_RCHECKSUM_TYPE_FAST)) {
+                dict_unref (xdata);
+                xdata = NULL;
+        }
+
         STACK_WIND_COOKIE (loop_frame, sh_diff_checksum_cbk,
                            (void *) (long) loop_sh->source,
                            priv->children[loop_sh->source],
                            priv->children[loop_sh->source]->fops->rchecksum,
                            loop_sh->healing_fd,
-                           loop_sh->offset, loop_sh->block_size, NULL);
+                           loop_sh->offset, loop_sh->block_size, xdata);
 
         for (i = 0; i < priv->child_count; i++) {
                 if (loop_sh->sources[i] || !loop_local->child_up[i])
@@ -688,12 +726,16 @@ sh_diff_checksum (call_frame_t *loop_frame, xlator_t *this)
                                    priv->children[i],
                                    priv->children[i]->fops->rchecksum,
                                    loop_sh->healing_fd,
-                                   loop_sh->offset, loop_sh->block_size, NULL);
+                                   loop_sh->offset, loop_sh->block_size,
+                                   xdata);
 
                 if (!--call_count)
                         break;
         }
 
+        if (xdata)
+                dict_unref (xdata);
+
         return 0;
 }
 
@@ -778,6 +820,7 @@ afr_sh_start_loops (call_frame_t *sh_frame, xlator_t *this,
                 ret = -1;
                 goto out;
         }
+        sh->private->offset = sh_loop_next_offset (sh, 0);
         sh_loop_driver (sh_frame, this, _gf_true, first_loop_frame);
         ret = 0;
 out:
@@ -34,6 +34,7 @@
 #include "compat-errno.h"
 #include "compat.h"
 #include "byte-order.h"
+#include "dirty-regions.h"
 
 #include "afr-transaction.h"
 #include "afr-self-heal.h"
@@ -628,6 +629,95 @@ out:
         return ret;
 }
 
+int
+afr_sh_data_regions_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno, dict_t *xattr,
+                         dict_t *xdata)
+{
+        afr_local_t             *local = NULL;
+        afr_self_heal_t         *sh = NULL;
+        data_t                  *data = NULL;
+        struct gf_dirty_regions *regions = NULL;
+        int                      call_count = 0;
+
+        local = frame->local;
+        sh = &local->self_heal;
+
+        if (op_ret == 0)
+                data = dict_get (xattr, GF_XATTR_DIRTY_REGIONS);
+        if (data && gf_dirty_regions_valid ((void *)data->data, data->len))
+                regions = (void *)data->data;
+
+        LOCK (&frame->lock);
+        {
+                if (!regions)
+                        sh->regions_incomplete = _gf_true;
+                else if (!sh->dirty_regions)
+                        sh->dirty_regions = memdup (regions, data->len);
+                else if (gf_dirty_regions_merge (sh->dirty_regions, regions))
+                        sh->regions_incomplete = _gf_true;
+        }
+        UNLOCK (&frame->lock);
+
+        call_count = afr_frame_return (frame);
+        if (call_count)
+                return 0;
+
+        if (sh->regions_incomplete || !sh->dirty_regions) {
+                GF_FREE (sh->dirty_regions);
+                sh->dirty_regions = NULL;
+        } else {
+                gf_log (this->name, GF_LOG_DEBUG, "%s: healing only the "
+                        "regions recorded by the replicas", local->loc.path);
+        }
+
+        afr_sh_data_trim_sinks (frame, this);
+        return 0;
+}
+
+/* regions written on the source or on any sink while the replicas were out
+   of sync. A write may have reached only some of them, so their maps are
+   merged; the whole file is looked at when one of them has none. */
+void
+afr_sh_data_get_regions (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t     *local = NULL;
+        afr_self_heal_t *sh = NULL;
+        afr_private_t   *priv = NULL;
+        int              call_count = 0;
+        int              i = 0;
+
+        local = frame->local;
+        sh = &local->self_heal;
+        priv = this->private;
+
+        /* an emptied sink needs all of it anyway */
+        if (!sh->file_size ||
+            sh_zero_byte_files_exist (local, priv->child_count)) {
+                afr_sh_data_trim_sinks (frame, this);
+                return;
+        }
+
+        sh->regions_incomplete = _gf_false;
+        call_count = sh->active_sinks + 1;
+        local->call_count = call_count;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if ((i != sh->source) &&
+                    (sh->sources[i] || !local->child_up[i]))
+                        continue;
+
+                STACK_WIND_COOKIE (frame, afr_sh_data_regions_cbk,
+                                   (void *) (long) i,
+                                   priv->children[i],
+                                   priv->children[i]->fops->getxattr,
+                                   &local->loc, GF_XATTR_DIRTY_REGIONS, NULL);
+
+                if (!--call_count)
+                        break;
+        }
+}
+
 void
 afr_sh_data_fix (call_frame_t *frame, xlator_t *this)
 {
@@ -666,7 +756,7 @@ afr_sh_data_fix (call_frame_t *frame, xlator_t *this)
                 "self-healing file %s from subvolume %s to %d other",
                 local->loc.path, priv->children[sh->source]->name,
                 sh->active_sinks);
-        afr_sh_data_trim_sinks (frame, this);
+        afr_sh_data_get_regions (frame, this);
 }
 
 int
@@ -799,7 +889,8 @@ afr_lookup_select_read_child_by_txn_type (xlator_t *this, afr_local_t *local,
 
         prev_read_child = local->read_child_index;
         config_read_child = priv->read_child;
-        read_child = afr_select_read_child_from_policy (success_children,
+        read_child = afr_select_read_child_from_policy (this,
+                                                        success_children,
                                                         priv->child_count,
                                                         prev_read_child,
                                                         config_read_child,
@@ -257,6 +257,72 @@ afr_sh_entry_impunge_all (call_frame_t *frame, xlator_t *this);
 int
 afr_sh_entry_impunge_subvol (call_frame_t *frame, xlator_t *this);
 
+/* reads the names the source recorded as changed in the directory, in
+   place of the whole directory */
+static int
+afr_sh_entry_changes_readdir (call_frame_t *frame, xlator_t *this,
+                              fop_readdir_cbk_t readdir_cbk)
+{
+        afr_private_t   *priv = NULL;
+        afr_local_t     *local  = NULL;
+        afr_self_heal_t *sh  = NULL;
+        dict_t          *xdata = NULL;
+        int              ret = -1;
+
+        priv = this->private;
+        local = frame->local;
+        sh = &local->self_heal;
+
+        xdata = dict_new ();
+        if (!xdata)
+                goto out;
+
+        ret = dict_set_int32 (xdata, GF_XATTROP_ENTRY_CHANGES, 1);
+        if (ret)
+                goto out;
+
+        STACK_WIND (frame, readdir_cbk,
+                    priv->children[sh->source],
+                    priv->children[sh->source]->fops->readdir,
+                    sh->healing_fd, sh->block_size, sh->offset, xdata);
+out:
+        if (xdata)
+                dict_unref (xdata);
+        return ret;
+}
+
+/* a source without the list of changed names, or one that could not
+   serve it, has the whole directory read instead */
+static gf_boolean_t
+afr_sh_entry_changes_fallback (call_frame_t *frame, xlator_t *this,
+                               int32_t op_ret, int32_t op_errno,
+                               dict_t *xdata)
+{
+        afr_private_t   *priv = NULL;
+        afr_local_t     *local  = NULL;
+        afr_self_heal_t *sh  = NULL;
+
+        priv = this->private;
+        local = frame->local;
+        sh = &local->self_heal;
+
+        if (!sh->entry_changes)
+                return _gf_false;
+
+        if ((op_ret >= 0) && xdata &&
+            dict_get (xdata, GF_XATTROP_ENTRY_CHANGES))
+                return _gf_false;
+
+        gf_log (this->name, GF_LOG_DEBUG, "%s: names changed are not known "
+                "to %s (%s), healing the whole directory", local->loc.path,
+                priv->children[sh->source]->name,
+                (op_ret < 0) ? strerror (op_errno) : "not recorded");
+
+        sh->entry_changes = _gf_false;
+        sh->offset = 0;
+        return _gf_true;
+}
+
 int
 afr_sh_entry_expunge_all (call_frame_t *frame, xlator_t *this);
 
@@ -613,6 +679,57 @@ out:
 }
 
 
+/* the name came from the source's list, the sink may not have it */
+int
+afr_sh_entry_expunge_sink_lookup_cbk (call_frame_t *expunge_frame,
+                                      void *cookie, xlator_t *this,
+                                      int32_t op_ret, int32_t op_errno,
+                                      inode_t *inode, struct iatt *buf,
+                                      dict_t *x, struct iatt *postparent)
+{
+        afr_private_t   *priv = NULL;
+        afr_local_t     *expunge_local = NULL;
+        afr_self_heal_t *expunge_sh = NULL;
+        call_frame_t    *frame = NULL;
+        int              active_src = 0;
+        afr_self_heal_t *sh            = NULL;
+        afr_local_t     *local         = NULL;
+
+        priv = this->private;
+        expunge_local = expunge_frame->local;
+        expunge_sh = &expunge_local->self_heal;
+        frame = expunge_sh->sh_frame;
+        active_src = (long) cookie;
+        local         = frame->local;
+        sh            = &local->self_heal;
+
+        if (op_ret == -1) {
+                if (op_errno == ENOENT)
+                        op_ret = 0;
+                goto out;
+        }
+
+        expunge_sh->entrybuf = *buf;
+
+        gf_log (this->name, GF_LOG_TRACE,
+                "looking up %s on %s", expunge_local->loc.path,
+                priv->children[sh->source]->name);
+
+        STACK_WIND_COOKIE (expunge_frame,
+                           afr_sh_entry_expunge_entry_cbk,
+                           (void *) (long) sh->source,
+                           priv->children[sh->source],
+                           priv->children[sh->source]->fops->lookup,
+                           &expunge_local->loc, NULL);
+        return 0;
+out:
+        AFR_STACK_DESTROY (expunge_frame);
+        sh->expunge_done (frame, this, active_src, op_ret, op_errno);
+
+        return 0;
+}
+
+
 int
 afr_sh_entry_expunge_entry (call_frame_t *frame, xlator_t *this,
                             gf_dirent_t *entry)
@@ -676,6 +793,17 @@ afr_sh_entry_expunge_entry (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        if (sh->entry_changes) {
+                STACK_WIND_COOKIE (expunge_frame,
+                                   afr_sh_entry_expunge_sink_lookup_cbk,
+                                   (void *) (long) active_src,
+                                   priv->children[active_src],
+                                   priv->children[active_src]->fops->lookup,
+                                   &expunge_local->loc, NULL);
+                ret = 0;
+                goto out;
+        }
+
         gf_log (this->name, GF_LOG_TRACE,
                 "looking up %s on %s", expunge_local->loc.path,
                 priv->children[source]->name);
@@ -716,6 +844,12 @@ afr_sh_entry_expunge_readdir_cbk (call_frame_t *frame, void *cookie,
 
         active_src = sh->active_source;
 
+        if (afr_sh_entry_changes_fallback (frame, this, op_ret, op_errno,
+                                           xdata)) {
+                afr_sh_entry_expunge_subvol (frame, this, active_src);
+                return 0;
+        }
+
         if (op_ret <= 0) {
                 if (op_ret < 0) {
                         gf_log (this->name, GF_LOG_INFO,
@@ -765,6 +899,12 @@ afr_sh_entry_expunge_subvol (call_frame_t *frame, xlator_t *this,
         local = frame->local;
         sh = &local->self_heal;
 
+        if (sh->entry_changes &&
+            !afr_sh_entry_changes_readdir (frame, this,
+                                           afr_sh_entry_expunge_readdir_cbk))
+                return 0;
+        sh->entry_changes = _gf_false;
+
         STACK_WIND (frame, afr_sh_entry_expunge_readdir_cbk,
                     priv->children[active_src],
                     priv->children[active_src]->fops->readdirp,
@@ -1050,6 +1190,7 @@ afr_sh_entry_impunge_perform_xattrop (call_frame_t *impunge_frame,
 {
         int              active_src       = 0;
         dict_t          *xattr            = NULL;
+        dict_t          *xdata            = NULL;
         afr_private_t   *priv             = NULL;
         afr_local_t     *impunge_local    = NULL;
         afr_self_heal_t *impunge_sh       = NULL;
@@ -1073,16 +1214,34 @@ afr_sh_entry_impunge_perform_xattrop (call_frame_t *impunge_frame,
         afr_set_pending_dict (priv, xattr, impunge_local->pending, active_src,
                               LOCAL_LAST);
 
+        /* the new directory on the sinks is empty, names recorded by the
+           source do not cover what it misses */
+        if (IA_ISDIR (impunge_sh->entrybuf.ia_type)) {
+                xdata = dict_new ();
+                if (!xdata ||
+                    dict_set_int32 (xdata, GF_XATTROP_ENTRY_CHANGES_ALL, 1)) {
+                        op_errno = ENOMEM;
+                        goto out;
+                }
+        }
+
         STACK_WIND_COOKIE (impunge_frame, afr_sh_entry_impunge_xattrop_cbk,
                            (void *) (long) active_src,
                            priv->children[active_src],
                            priv->children[active_src]->fops->xattrop,
-                           &impunge_local->loc, GF_XATTROP_ADD_ARRAY, xattr, NULL);
+                           &impunge_local->loc, GF_XATTROP_ADD_ARRAY, xattr,
+                           xdata);
 
         if (xattr)
                 dict_unref (xattr);
+        if (xdata)
+                dict_unref (xdata);
         return 0;
 out:
+        if (xattr)
+                dict_unref (xattr);
+        if (xdata)
+                dict_unref (xdata);
         afr_sh_entry_call_impunge_done (impunge_frame, this,
                                         -1, op_errno);
         return 0;
@@ -1877,10 +2036,38 @@ done:
         return;
 }
 
+/* the name came from the source's list, it may be gone from the source
+   and then expunge has dealt with it */
+int
+afr_sh_entry_impunge_source_lookup_cbk (call_frame_t *impunge_frame,
+                                        void *cookie, xlator_t *this,
+                                        int32_t op_ret, int32_t op_errno,
+                                        inode_t *inode, struct iatt *buf,
+                                        dict_t *x, struct iatt *postparent)
+{
+        afr_local_t     *impunge_local = NULL;
+
+        impunge_local = impunge_frame->local;
+
+        if (op_ret == -1) {
+                if (op_errno == ENOENT)
+                        op_ret = 0;
+                afr_sh_entry_call_impunge_done (impunge_frame, this,
+                                                op_ret, op_errno);
+                return 0;
+        }
+
+        afr_sh_common_lookup (impunge_frame, this, &impunge_local->loc,
+                              afr_sh_entry_common_lookup_done, NULL,
+                              AFR_LOOKUP_FAIL_CONFLICTS, NULL);
+        return 0;
+}
+
 int
 afr_sh_entry_impunge_entry (call_frame_t *frame, xlator_t *this,
                             gf_dirent_t *entry)
 {
+        afr_private_t   *priv = NULL;
         afr_local_t     *local  = NULL;
         afr_self_heal_t *sh  = NULL;
         afr_self_heal_t *impunge_sh  = NULL;
@@ -1891,6 +2078,7 @@ afr_sh_entry_impunge_entry (call_frame_t *frame, xlator_t *this,
         int              op_errno = 0;
         int              op_ret = -1;
 
+        priv = this->private;
         local = frame->local;
         sh = &local->self_heal;
 
@@ -1928,6 +2116,16 @@ afr_sh_entry_impunge_entry (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        if (sh->entry_changes) {
+                STACK_WIND (impunge_frame,
+                            afr_sh_entry_impunge_source_lookup_cbk,
+                            priv->children[active_src],
+                            priv->children[active_src]->fops->lookup,
+                            &impunge_local->loc, NULL);
+                op_ret = 0;
+                goto out;
+        }
+
         afr_sh_common_lookup (impunge_frame, this, &impunge_local->loc,
                               afr_sh_entry_common_lookup_done, NULL,
                               AFR_LOOKUP_FAIL_CONFLICTS, NULL);
@@ -1964,6 +2162,12 @@ afr_sh_entry_impunge_readdir_cbk (call_frame_t *frame, void *cookie,
 
         active_src = sh->active_source;
 
+        if (afr_sh_entry_changes_fallback (frame, this, op_ret, op_errno,
+                                           xdata)) {
+                afr_sh_entry_impunge_subvol (frame, this);
+                return 0;
+        }
+
         if (op_ret <= 0) {
                 if (op_ret < 0) {
                         gf_log (this->name, GF_LOG_INFO,
@@ -2018,6 +2222,12 @@ afr_sh_entry_impunge_subvol (call_frame_t *frame, xlator_t *this)
         gf_log (this->name, GF_LOG_DEBUG, "%s: readdir from offset %zd",
                 local->loc.path, sh->offset);
 
+        if (sh->entry_changes &&
+            !afr_sh_entry_changes_readdir (frame, this,
+                                           afr_sh_entry_impunge_readdir_cbk))
+                return 0;
+        sh->entry_changes = _gf_false;
+
         STACK_WIND (frame, afr_sh_entry_impunge_readdir_cbk,
                     priv->children[active_src],
                     priv->children[active_src]->fops->readdirp,
@@ -2109,6 +2319,9 @@ afr_sh_entry_opendir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         "fd for %s opened, commencing sync",
                         local->loc.path);
 
+                /* a known source lists the names changed while the sinks
+                   were away */
+                sh->entry_changes = (sh->source != -1);
                 sh->active_source = -1;
                 afr_sh_entry_expunge_all (frame, this);
         }
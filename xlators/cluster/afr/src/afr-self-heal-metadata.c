@@ -305,6 +305,7 @@ afr_sh_metadata_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 for (i = 0; i < priv->child_count; i++) {
                         dict_del (xattr, priv->pending_key[i]);
                 }
+                dict_del (xattr, GF_XATTR_DIRTY_REGIONS);
 
                 afr_sh_metadata_sync (frame, this, xattr);
         }
@@ -20,7 +20,8 @@
 #include "event-history.h"
 
 typedef enum {
-        STOP_CRAWL_ON_SINGLE_SUBVOL = 1
+        STOP_CRAWL_ON_SINGLE_SUBVOL = 1,
+        HEAL_THROUGH_QUEUE = 2
 } afr_crawl_flags_t;
 
 typedef enum {
@@ -382,7 +383,8 @@ void
 _do_self_heal_on_subvol (xlator_t *this, int child, afr_crawl_type_t crawl)
 {
         afr_start_crawl (this, child, crawl, _self_heal_entry,
-                         NULL, _gf_true, STOP_CRAWL_ON_SINGLE_SUBVOL,
+                         NULL, _gf_true,
+                         STOP_CRAWL_ON_SINGLE_SUBVOL | HEAL_THROUGH_QUEUE,
                          afr_crawl_done);
 }
 
@@ -519,6 +521,103 @@ _add_all_subvols_eh_to_dict (xlator_t *this, eh_t *eh, dict_t *dict)
         return 0;
 }
 
+int
+_add_heal_stats_to_dict (xlator_t *this, dict_t *output, int child)
+{
+        afr_private_t    *priv = NULL;
+        afr_shd_stats_t  stats = {0};
+        char             key[256] = {0};
+        uint64_t         remaining = 0;
+        uint64_t         eta = 0;
+        double           rate = 0;
+        time_t           elapsed = 0;
+        int              xl_id = 0;
+        int              ret = -1;
+
+        priv = this->private;
+
+        ret = dict_get_int32 (output, this->name, &xl_id);
+        if (ret)
+                goto out;
+
+        LOCK (&priv->lock);
+        {
+                stats = priv->shd.stats[child];
+        }
+        UNLOCK (&priv->lock);
+
+        if (stats.start) {
+                elapsed = time (NULL) - stats.start;
+                if (elapsed > 0)
+                        rate = (double) stats.done / elapsed;
+                if (stats.pending > stats.done)
+                        remaining = stats.pending - stats.done;
+                if (rate > 0)
+                        eta = remaining / rate;
+        }
+
+        snprintf (key, sizeof (key), "%d-%d-status", xl_id, child);
+        ret = dict_set_str (output, key, stats.start ?
+                            "Index heal in progress" : "No index heal running");
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-threads", xl_id, child);
+        ret = dict_set_uint32 (output, key, stats.workers);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-queued", xl_id, child);
+        ret = dict_set_uint32 (output, key, stats.queued);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-done", xl_id, child);
+        ret = dict_set_uint64 (output, key, stats.done);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-failed", xl_id, child);
+        ret = dict_set_uint64 (output, key, stats.failed);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-skipped", xl_id, child);
+        ret = dict_set_uint64 (output, key, stats.skipped);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-remaining", xl_id, child);
+        ret = dict_set_uint64 (output, key, remaining);
+        if (ret)
+                goto out;
+        snprintf (key, sizeof (key), "%d-%d-heal-rate", xl_id, child);
+        ret = dict_set_double (output, key, rate);
+        if (ret)
+                goto out;
+        if (eta) {
+                snprintf (key, sizeof (key), "%d-%d-heal-eta", xl_id, child);
+                ret = dict_set_uint64 (output, key, eta);
+        }
+out:
+        return ret;
+}
+
+int
+_add_all_subvols_heal_stats_to_dict (xlator_t *this, dict_t *dict)
+{
+        afr_private_t           *priv = NULL;
+        afr_self_heald_t        *shd = NULL;
+        int                     i = 0;
+        int                     ret = 0;
+
+        priv = this->private;
+        shd = &priv->shd;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (shd->pos[i] != AFR_POS_LOCAL)
+                        continue;
+                ret = _add_heal_stats_to_dict (this, dict, i);
+                if (ret)
+                        break;
+        }
+        return ret;
+}
+
 int
 afr_xl_op (xlator_t *this, dict_t *input, dict_t *output)
 {
@@ -562,6 +661,9 @@ afr_xl_op (xlator_t *this, dict_t *input, dict_t *output)
                 ret = _add_all_subvols_eh_to_dict (this, shd->split_brain,
                                                    output);
                 break;
+        case GF_AFR_OP_STATISTICS:
+                ret = _add_all_subvols_heal_stats_to_dict (this, output);
+                break;
         default:
                 gf_log (this->name, GF_LOG_ERROR, "Unknown set op %d", op);
                 break;
@@ -870,6 +972,309 @@ out:
         return ret;
 }
 
+static afr_shd_heal_t *
+__afr_shd_healing_find (afr_self_heald_t *shd, uuid_t gfid)
+{
+        afr_shd_heal_t  *heal = NULL;
+        struct list_head *bucket = NULL;
+
+        bucket = &shd->healing[gfid[15] % AFR_SHD_HEALING_BUCKETS];
+        list_for_each_entry (heal, bucket, hash) {
+                if (!uuid_compare (heal->gfid, gfid))
+                        return heal;
+        }
+        return NULL;
+}
+
+/* Parks the crawl until the workers have made room in the queue, or,
+ * with drain, until they are all done. Workers wake it whenever they
+ * take an entry or leave.
+ */
+static void
+afr_shd_queue_wait (xlator_t *this, afr_shd_queue_t *queue,
+                    gf_boolean_t drain)
+{
+        afr_private_t    *priv = NULL;
+        struct synctask  *task = NULL;
+
+        priv = this->private;
+        task = synctask_get ();
+        GF_ASSERT (task);
+
+        LOCK (&priv->lock);
+        while (drain ? (queue->qlen || queue->workers) :
+               (queue->qlen >= priv->shd.wait_qlength)) {
+                queue->waiter = task;
+                UNLOCK (&priv->lock);
+
+                task->state = SYNCTASK_SUSPEND;
+                synctask_yield (task);
+
+                LOCK (&priv->lock);
+        }
+        UNLOCK (&priv->lock);
+}
+
+static int
+afr_shd_heal_entry (xlator_t *this, afr_shd_queue_t *queue,
+                    afr_shd_heal_t *heal)
+{
+        afr_private_t    *priv = NULL;
+        afr_crawl_data_t *crawl_data = NULL;
+        loc_t            entry_loc = {0};
+        struct iatt      iattr = {0};
+        int              ret = -1;
+
+        priv = this->private;
+        crawl_data = queue->crawl_data;
+
+        entry_loc.inode = inode_new (priv->root_inode->table);
+        if (!entry_loc.inode)
+                goto out;
+        uuid_copy (entry_loc.gfid, heal->gfid);
+        ret = _loc_assign_gfid_path (&entry_loc);
+        if (ret)
+                goto out;
+
+        ret = crawl_data->process_entry (this, crawl_data, NULL, &entry_loc,
+                                         queue->parent, &iattr);
+        if (ret)
+                goto out;
+
+        _link_inode_update_loc (this, &entry_loc, &iattr);
+out:
+        loc_wipe (&entry_loc);
+        return ret;
+}
+
+static int
+afr_shd_heal_worker (void *data)
+{
+        afr_shd_queue_t  *queue = data;
+        afr_private_t    *priv = NULL;
+        afr_shd_stats_t  *stats = NULL;
+        afr_shd_heal_t   *heal = NULL;
+        struct synctask  *waiter = NULL;
+        xlator_t         *this = NULL;
+        int              child = 0;
+        int              ret = 0;
+
+        this = THIS;
+        priv = this->private;
+        child = queue->crawl_data->child;
+        stats = &priv->shd.stats[child];
+
+        for (;;) {
+                heal = NULL;
+                LOCK (&priv->lock);
+                {
+                        if (!list_empty (&queue->entries)) {
+                                heal = list_entry (queue->entries.next,
+                                                   afr_shd_heal_t, list);
+                                list_del_init (&heal->list);
+                                stats->queued = --queue->qlen;
+                        } else {
+                                stats->workers = --queue->workers;
+                        }
+                        waiter = queue->waiter;
+                        queue->waiter = NULL;
+                }
+                UNLOCK (&priv->lock);
+
+                /* the queue may be gone as soon as the crawl runs again
+                   after our leaving */
+                if (waiter)
+                        synctask_wake (waiter);
+                if (!heal)
+                        break;
+
+                if (_crawl_proceed (this, child, queue->crawl_data->crawl_flags,
+                                    NULL))
+                        ret = afr_shd_heal_entry (this, queue, heal);
+                else
+                        ret = 1;
+
+                LOCK (&priv->lock);
+                {
+                        list_del_init (&heal->hash);
+                        if (ret <= 0)
+                                stats->done++;
+                        if (ret < 0)
+                                stats->failed++;
+                }
+                UNLOCK (&priv->lock);
+                GF_FREE (heal);
+        }
+
+        return 0;
+}
+
+static int
+afr_shd_heal_worker_done (int ret, call_frame_t *sync_frame, void *data)
+{
+        STACK_DESTROY (sync_frame->root);
+        return 0;
+}
+
+static void
+afr_shd_spawn_worker (xlator_t *this, afr_shd_queue_t *queue)
+{
+        afr_private_t *priv = NULL;
+        call_frame_t  *frame = NULL;
+        int           ret = -1;
+
+        priv = this->private;
+
+        /* a lock owner of its own, so that workers healing different
+           files never pass for one another */
+        frame = create_frame (this, this->ctx->pool);
+        if (frame) {
+                afr_set_lk_owner (frame, this, frame->root);
+                afr_set_low_priority (frame);
+                ret = synctask_new (this->ctx->env, afr_shd_heal_worker,
+                                    afr_shd_heal_worker_done, frame, queue);
+                if (!ret)
+                        return;
+                STACK_DESTROY (frame->root);
+        }
+
+        gf_log (this->name, GF_LOG_WARNING, "Could not start a heal thread "
+                "for %s, healing from the crawl",
+                priv->children[queue->crawl_data->child]->name);
+        afr_shd_heal_worker (queue);
+}
+
+static int
+afr_shd_queue_entry (xlator_t *this, afr_crawl_data_t *crawl_data,
+                     gf_dirent_t *entry)
+{
+        afr_private_t    *priv = NULL;
+        afr_self_heald_t *shd = NULL;
+        afr_shd_stats_t  *stats = NULL;
+        afr_shd_queue_t  *queue = NULL;
+        afr_shd_heal_t   *heal = NULL;
+        gf_boolean_t     spawn = _gf_false;
+
+        priv = this->private;
+        shd = &priv->shd;
+        stats = &shd->stats[crawl_data->child];
+        queue = crawl_data->queue;
+
+        heal = GF_CALLOC (1, sizeof (*heal), gf_afr_mt_shd_heal_t);
+        if (!heal)
+                return -1;
+        INIT_LIST_HEAD (&heal->list);
+        INIT_LIST_HEAD (&heal->hash);
+        if (uuid_parse (entry->d_name, heal->gfid)) {
+                gf_log (this->name, GF_LOG_DEBUG, "%s: not a gfid, skipping",
+                        entry->d_name);
+                GF_FREE (heal);
+                return 0;
+        }
+
+        afr_shd_queue_wait (this, queue, _gf_false);
+
+        LOCK (&priv->lock);
+        {
+                if (__afr_shd_healing_find (shd, heal->gfid)) {
+                        stats->skipped++;
+                } else {
+                        list_add_tail (&heal->hash, &shd->healing[
+                                       heal->gfid[15] %
+                                       AFR_SHD_HEALING_BUCKETS]);
+                        list_add_tail (&heal->list, &queue->entries);
+                        stats->queued = ++queue->qlen;
+                        if (queue->workers < shd->max_threads) {
+                                stats->workers = ++queue->workers;
+                                spawn = _gf_true;
+                        }
+                        heal = NULL;
+                }
+        }
+        UNLOCK (&priv->lock);
+
+        if (heal) {
+                gf_log (this->name, GF_LOG_DEBUG, "%s is already being "
+                        "healed", entry->d_name);
+                GF_FREE (heal);
+        }
+
+        if (spawn)
+                afr_shd_spawn_worker (this, queue);
+
+        return 0;
+}
+
+static uint64_t
+afr_shd_index_count (xlator_t *this, afr_crawl_data_t *crawl_data, fd_t *fd)
+{
+        gf_dirent_t      entries;
+        gf_dirent_t      *entry = NULL;
+        off_t            offset = 0;
+        uint64_t         count = 0;
+        int              ret = 0;
+
+        INIT_LIST_HEAD (&entries.list);
+
+        while (1) {
+                ret = syncop_readdir (crawl_data->readdir_xl, fd, 131072,
+                                      offset, &entries);
+                if (ret <= 0)
+                        break;
+                if (list_empty (&entries.list))
+                        break;
+
+                list_for_each_entry (entry, &entries.list, list) {
+                        offset = entry->d_off;
+                        if (IS_ENTRY_CWD (entry->d_name) ||
+                            IS_ENTRY_PARENT (entry->d_name))
+                                continue;
+                        count++;
+                }
+                gf_dirent_free (&entries);
+        }
+
+        return count;
+}
+
+static void
+afr_shd_stats_begin (xlator_t *this, afr_crawl_data_t *crawl_data, fd_t *fd)
+{
+        afr_private_t    *priv = NULL;
+        afr_shd_stats_t  *stats = NULL;
+        uint64_t         pending = 0;
+
+        priv = this->private;
+        stats = &priv->shd.stats[crawl_data->child];
+
+        /* names only, cheap next to healing them */
+        pending = afr_shd_index_count (this, crawl_data, fd);
+
+        LOCK (&priv->lock);
+        {
+                stats->start = time (NULL);
+                stats->pending = pending;
+                stats->done = 0;
+                stats->failed = 0;
+                stats->skipped = 0;
+        }
+        UNLOCK (&priv->lock);
+}
+
+static void
+afr_shd_stats_end (xlator_t *this, afr_crawl_data_t *crawl_data)
+{
+        afr_private_t    *priv = NULL;
+
+        priv = this->private;
+
+        LOCK (&priv->lock);
+        {
+                priv->shd.stats[crawl_data->child].start = 0;
+        }
+        UNLOCK (&priv->lock);
+}
+
 static int
 _process_entries (xlator_t *this, loc_t *parentloc, gf_dirent_t *entries,
                   off_t *offset, afr_crawl_data_t *crawl_data)
@@ -891,6 +1296,12 @@ _process_entries (xlator_t *this, loc_t *parentloc, gf_dirent_t *entries,
                 if (IS_ENTRY_CWD (entry->d_name) ||
                     IS_ENTRY_PARENT (entry->d_name))
                         continue;
+                if (crawl_data->queue) {
+                        ret = afr_shd_queue_entry (this, crawl_data, entry);
+                        if (ret)
+                                goto out;
+                        continue;
+                }
                 if ((crawl_data->crawl == FULL) &&
                      uuid_is_null (entry->d_stat.ia_gfid)) {
                         gf_log (this->name, GF_LOG_WARNING, "%s/%s: No "
@@ -1064,6 +1475,7 @@ afr_dir_crawl (void *data)
         fd_t                *fd = NULL;
         loc_t               dirloc = {0};
         afr_crawl_data_t    *crawl_data = data;
+        afr_shd_queue_t     *queue = NULL;
 
         this = THIS;
 
@@ -1084,7 +1496,29 @@ afr_dir_crawl (void *data)
         if (ret)
                 goto out;
 
+        if ((crawl_data->crawl == INDEX) &&
+            (crawl_data->crawl_flags & HEAL_THROUGH_QUEUE)) {
+                queue = GF_CALLOC (1, sizeof (*queue), gf_afr_mt_shd_queue_t);
+                if (!queue) {
+                        ret = -1;
+                        goto out;
+                }
+                INIT_LIST_HEAD (&queue->entries);
+                queue->parent = &dirloc;
+                queue->crawl_data = crawl_data;
+                crawl_data->queue = queue;
+                afr_shd_stats_begin (this, crawl_data, fd);
+        }
+
         ret = _crawl_directory (fd, &dirloc, crawl_data);
+
+        if (queue) {
+                afr_shd_queue_wait (this, queue, _gf_true);
+                afr_shd_stats_end (this, crawl_data);
+                crawl_data->queue = NULL;
+                GF_FREE (queue);
+        }
+
         if (ret)
                 gf_log (this->name, GF_LOG_ERROR, "Crawl failed on %s",
                         readdir_xl->name);
@@ -17,6 +17,8 @@
 #define IS_ENTRY_PARENT(entry) (!strcmp (entry, ".."))
 #define AFR_ALL_CHILDREN -1
 
+struct afr_shd_queue_;
+
 typedef struct afr_crawl_data_ {
         int                 child;
         pid_t               pid;
@@ -24,6 +26,7 @@ typedef struct afr_crawl_data_ {
         xlator_t            *readdir_xl;
         void                *op_data;
         int                 crawl_flags;
+        struct afr_shd_queue_ *queue;
         int (*process_entry) (xlator_t *this, struct afr_crawl_data_ *crawl_data,
                               gf_dirent_t *entry, loc_t *child, loc_t *parent,
                               struct iatt *iattr);
@@ -33,6 +36,25 @@ typedef int (*process_entry_cbk_t) (xlator_t *this, afr_crawl_data_t *crawl_data
                               gf_dirent_t *entry, loc_t *child, loc_t *parent,
                               struct iatt *iattr);
 
+/* an index entry waiting for, or going through, heal */
+typedef struct afr_shd_heal_ {
+        struct list_head    list;       /* in the queue */
+        struct list_head    hash;       /* in shd->healing */
+        uuid_t              gfid;
+} afr_shd_heal_t;
+
+/* index entries read by the crawl, healed by up to shd-max-threads
+   synctasks */
+typedef struct afr_shd_queue_ {
+        gf_lock_t           lock;
+        struct list_head    entries;
+        uint32_t            qlen;
+        uint32_t            workers;
+        struct synctask     *waiter;    /* crawl waiting on the workers */
+        loc_t               *parent;    /* the index directory */
+        afr_crawl_data_t    *crawl_data;
+} afr_shd_queue_t;
+
 void afr_build_root_loc (xlator_t *this, loc_t *loc);
 
 int afr_set_root_gfid (dict_t *dict);
@@ -15,6 +15,7 @@
 
 #include "afr.h"
 #include "afr-transaction.h"
+#include "compound-fop.h"
 
 #include <signal.h>
 
@@ -522,6 +523,243 @@ afr_set_postop_dict (afr_local_t *local, xlator_t *this, dict_t *xattr,
                         "failed to set pending entry");
 }
 
+/* names the entry a post-op is for, bricks keeping a list of the names
+   changed in a directory add it there */
+static dict_t *
+afr_changelog_entry_xdata (xlator_t *this, const char *name)
+{
+        dict_t  *xdata = NULL;
+        int      ret = -1;
+
+        if (!name)
+                goto out;
+
+        xdata = dict_new ();
+        if (!xdata)
+                goto out;
+
+        ret = dict_set_dynstr (xdata, GF_XATTROP_ENTRY_CHANGES_NAME,
+                               gf_strdup (name));
+out:
+        if (ret && xdata) {
+                dict_unref (xdata);
+                xdata = NULL;
+        }
+        if (ret && name)
+                gf_log (this->name, GF_LOG_DEBUG, "failed to name %s in the "
+                        "post-op", name);
+        return xdata;
+}
+
+/* a post-op sent along with the unlock which follows it */
+typedef struct {
+        int              child;
+        struct list_head stubs;
+} afr_post_op_unlock_t;
+
+
+/* the unlock can go with the post-op when afr_unlock would release the
+   lock on @child with a single plain (f)inodelk */
+static gf_boolean_t
+afr_post_op_unlock_compound_ok (call_frame_t *frame, xlator_t *this,
+                                int child)
+{
+        afr_private_t       *priv     = NULL;
+        afr_local_t         *local    = NULL;
+        afr_internal_lock_t *int_lock = NULL;
+
+        priv     = this->private;
+        local    = frame->local;
+        int_lock = &local->internal_lock;
+
+        if (!priv->use_compound_fops)
+                return _gf_false;
+
+        if (int_lock->transaction_lk_type != AFR_TRANSACTION_LK)
+                return _gf_false;
+
+        if ((local->transaction.type != AFR_DATA_TRANSACTION) &&
+            (local->transaction.type != AFR_METADATA_TRANSACTION))
+                return _gf_false;
+
+        if ((int_lock->inode_locked_nodes[child] & LOCKED_YES) != LOCKED_YES)
+                return _gf_false;
+
+        /* eager locks are handed on to the next transaction on the fd */
+        if (local->fd && local->transaction.eager_lock &&
+            local->transaction.eager_lock[child])
+                return _gf_false;
+
+        return _gf_true;
+}
+
+
+static int32_t
+afr_post_op_unlock_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno,
+                        struct list_head *replies, dict_t *xdata)
+{
+        afr_local_t          *local    = NULL;
+        afr_internal_lock_t  *int_lock = NULL;
+        afr_post_op_unlock_t *args     = NULL;
+        call_stub_t          *reply    = NULL;
+        int32_t               post_op_ret   = -1;
+        int32_t               post_op_errno = op_errno;
+        int32_t               unlock_ret    = 0;
+        int32_t               unlock_errno  = 0;
+        gf_boolean_t          unlocked      = _gf_false;
+
+        local    = frame->local;
+        int_lock = &local->internal_lock;
+        args     = cookie;
+
+        list_for_each_entry (reply, replies, list) {
+                switch (reply->fop) {
+                case GF_FOP_XATTROP:
+                        post_op_ret = reply->args.xattrop_cbk.op_ret;
+                        post_op_errno = reply->args.xattrop_cbk.op_errno;
+                        break;
+                case GF_FOP_FXATTROP:
+                        post_op_ret = reply->args.fxattrop_cbk.op_ret;
+                        post_op_errno = reply->args.fxattrop_cbk.op_errno;
+                        break;
+                case GF_FOP_INODELK:
+                        unlock_ret = reply->args.inodelk_cbk.op_ret;
+                        unlock_errno = reply->args.inodelk_cbk.op_errno;
+                        unlocked = _gf_true;
+                        break;
+                case GF_FOP_FINODELK:
+                        unlock_ret = reply->args.finodelk_cbk.op_ret;
+                        unlock_errno = reply->args.finodelk_cbk.op_errno;
+                        unlocked = _gf_true;
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        /* a failed post-op ended the compound with the lock still held;
+           afr_unlock () releases it with the others */
+        if (unlocked) {
+                if ((unlock_ret < 0) && (unlock_errno != ENOTCONN) &&
+                    (unlock_errno != EBADFD))
+                        gf_log (this->name, GF_LOG_INFO, "%s: unlock failed "
+                                "on %d unlock by %s", local->loc.path,
+                                args->child,
+                                lkowner_utoa (&frame->root->lk_owner));
+
+                int_lock->inode_locked_nodes[args->child] &= LOCKED_NO;
+        }
+
+        compound_replies_destroy (&args->stubs);
+
+        afr_changelog_post_op_cbk (frame, (void *) (long) args->child, this,
+                                   post_op_ret, post_op_errno, NULL, NULL);
+
+        GF_FREE (args);
+
+        return 0;
+}
+
+
+static int
+afr_post_op_unlock (call_frame_t *frame, xlator_t *this, int child,
+                    fd_t *fd, dict_t *xattr)
+{
+        afr_private_t        *priv     = NULL;
+        afr_local_t          *local    = NULL;
+        afr_internal_lock_t  *int_lock = NULL;
+        afr_post_op_unlock_t *args     = NULL;
+        call_stub_t          *post_op  = NULL;
+        call_stub_t          *unlock   = NULL;
+        struct gf_flock       flock    = {0,};
+
+        priv     = this->private;
+        local    = frame->local;
+        int_lock = &local->internal_lock;
+
+        args = GF_CALLOC (1, sizeof (*args), gf_afr_mt_post_op_unlock_t);
+        if (!args)
+                goto err;
+
+        args->child = child;
+        INIT_LIST_HEAD (&args->stubs);
+
+        flock.l_start = int_lock->lk_flock.l_start;
+        flock.l_len   = int_lock->lk_flock.l_len;
+        flock.l_type  = F_UNLCK;
+
+        if (fd)
+                post_op = fop_fxattrop_stub (frame, NULL, fd,
+                                             GF_XATTROP_ADD_ARRAY, xattr,
+                                             NULL);
+        else
+                post_op = fop_xattrop_stub (frame, NULL, &local->loc,
+                                            GF_XATTROP_ADD_ARRAY, xattr,
+                                            NULL);
+        if (!post_op)
+                goto err;
+        list_add_tail (&post_op->list, &args->stubs);
+
+        /* the same lock afr_unlock_inodelk () would release */
+        if (local->fd)
+                unlock = fop_finodelk_stub (frame, NULL, this->name,
+                                            local->fd, F_SETLK, &flock, NULL);
+        else
+                unlock = fop_inodelk_stub (frame, NULL, this->name,
+                                           &local->loc, F_SETLK, &flock,
+                                           NULL);
+        if (!unlock)
+                goto err;
+        list_add_tail (&unlock->list, &args->stubs);
+
+        STACK_WIND_COOKIE (frame, afr_post_op_unlock_cbk, args,
+                           priv->children[child],
+                           priv->children[child]->fops->compound,
+                           &args->stubs, NULL);
+
+        return 0;
+err:
+        if (args) {
+                compound_replies_destroy (&args->stubs);
+                GF_FREE (args);
+        }
+
+        return -1;
+}
+
+
+/* winds the post-op of @child, with the unlock along if it can be */
+static void
+afr_changelog_post_op_wind (call_frame_t *frame, xlator_t *this, int child,
+                            fd_t *fd, dict_t *xattr)
+{
+        afr_private_t *priv  = NULL;
+        afr_local_t   *local = NULL;
+
+        priv  = this->private;
+        local = frame->local;
+
+        if (afr_post_op_unlock_compound_ok (frame, this, child) &&
+            (afr_post_op_unlock (frame, this, child, fd, xattr) == 0))
+                return;
+
+        if (fd)
+                STACK_WIND_COOKIE (frame, afr_changelog_post_op_cbk,
+                                   (void *) (long) child,
+                                   priv->children[child],
+                                   priv->children[child]->fops->fxattrop,
+                                   fd, GF_XATTROP_ADD_ARRAY, xattr, NULL);
+        else
+                STACK_WIND_COOKIE (frame, afr_changelog_post_op_cbk,
+                                   (void *) (long) child,
+                                   priv->children[child],
+                                   priv->children[child]->fops->xattrop,
+                                   &local->loc, GF_XATTROP_ADD_ARRAY, xattr,
+                                   NULL);
+}
+
+
 int
 afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
 {
@@ -533,6 +771,8 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
         afr_local_t *  local = NULL;
         afr_fd_ctx_t  *fdctx = NULL;
         dict_t        **xattr = NULL;
+        dict_t         *xdata = NULL;
+        dict_t         *new_xdata = NULL;
         int            piggyback = 0;
         int            index = 0;
         int            nothing_failed = 1;
@@ -580,6 +820,17 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                 }
         }
 
+        /* entry self-heal can then look up just the names that failed */
+        if (!nothing_failed &&
+            ((local->transaction.type == AFR_ENTRY_TRANSACTION) ||
+             (local->transaction.type == AFR_ENTRY_RENAME_TRANSACTION))) {
+                xdata = afr_changelog_entry_xdata (this,
+                                                   local->transaction.basename);
+                if (local->transaction.type == AFR_ENTRY_RENAME_TRANSACTION)
+                        new_xdata = afr_changelog_entry_xdata (this,
+                                          local->transaction.new_basename);
+        }
+
         afr_compute_txn_changelog (local , priv);
 
         for (i = 0; i < priv->child_count; i++) {
@@ -595,12 +846,8 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                         if (!fdctx) {
                                 afr_set_postop_dict (local, this, xattr[i],
                                                      0, i);
-                                STACK_WIND (frame, afr_changelog_post_op_cbk,
-                                            priv->children[i],
-                                            priv->children[i]->fops->xattrop,
-                                            &local->loc,
-                                            GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
+                                afr_changelog_post_op_wind (frame, this, i,
+                                                            NULL, xattr[i]);
                                 break;
                         }
 
@@ -622,14 +869,9 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                                                            this, 1, 0, xattr[i], NULL);
                         } else {
                                 __mark_pre_op_undone_on_fd (frame, this, i);
-                                STACK_WIND_COOKIE (frame,
-                                                   afr_changelog_post_op_cbk,
-                                                   (void *) (long) i,
-                                                   priv->children[i],
-                                                   priv->children[i]->fops->fxattrop,
-                                                   local->fd,
-                                                   GF_XATTROP_ADD_ARRAY, xattr[i],
-                                                   NULL);
+                                afr_changelog_post_op_wind (frame, this, i,
+                                                            local->fd,
+                                                            xattr[i]);
                         }
                 }
                 break;
@@ -642,20 +884,8 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                                 break;
                         }
 
-                        if (local->fd)
-                                STACK_WIND (frame, afr_changelog_post_op_cbk,
-                                            priv->children[i],
-                                            priv->children[i]->fops->fxattrop,
-                                            local->fd,
-                                            GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
-                        else
-                                STACK_WIND (frame, afr_changelog_post_op_cbk,
-                                            priv->children[i],
-                                            priv->children[i]->fops->xattrop,
-                                            &local->loc,
-                                            GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
+                        afr_changelog_post_op_wind (frame, this, i,
+                                                    local->fd, xattr[i]);
                 }
                 break;
 
@@ -672,7 +902,7 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                                                    priv->children[i]->fops->xattrop,
                                                    &local->transaction.new_parent_loc,
                                                    GF_XATTROP_ADD_ARRAY, xattr[i],
-                                                   NULL);
+                                                   new_xdata);
                         }
                         call_count--;
                 }
@@ -705,14 +935,14 @@ afr_changelog_post_op_now (call_frame_t *frame, xlator_t *this)
                                             priv->children[i]->fops->fxattrop,
                                             local->fd,
                                             GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
+                                            xdata);
                         else
                                 STACK_WIND (frame, afr_changelog_post_op_cbk,
                                             priv->children[i],
                                             priv->children[i]->fops->xattrop,
                                             &local->transaction.parent_loc,
                                             GF_XATTROP_ADD_ARRAY, xattr[i],
-                                            NULL);
+                                            xdata);
                 }
                 break;
                 }
@@ -725,6 +955,10 @@ out:
         for (i = 0; i < priv->child_count; i++) {
                 dict_unref (xattr[i]);
         }
+        if (xdata)
+                dict_unref (xdata);
+        if (new_xdata)
+                dict_unref (new_xdata);
 
         return 0;
 }
@@ -175,6 +175,11 @@ reconfigure (xlator_t *this, dict_t *options)
                 priv->read_child = index;
         }
 
+        /* a local child found by choose-local would pin every read */
+        if ((priv->hash_mode == AFR_READ_HASH_LOAD) && !read_subvol &&
+            (read_subvol_index < 0))
+                priv->read_child = -1;
+
         GF_OPTION_RECONF ("eager-lock", priv->eager_lock, options, bool, out);
         GF_OPTION_RECONF ("quorum-type", qtype, options, str, out);
         GF_OPTION_RECONF ("quorum-count", priv->quorum_count, options,
@@ -183,9 +188,18 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("heal-timeout", priv->shd.timeout, options,
                           int32, out);
 
+        GF_OPTION_RECONF ("shd-max-threads", priv->shd.max_threads, options,
+                          uint32, out);
+
+        GF_OPTION_RECONF ("shd-wait-qlength", priv->shd.wait_qlength,
+                          options, uint32, out);
+
 	GF_OPTION_RECONF ("post-op-delay-secs", priv->post_op_delay_secs, options,
 			  uint32, out);
 
+        GF_OPTION_RECONF ("use-compound-fops", priv->use_compound_fops,
+                          options, bool, out);
+
         /* Reset this so we re-discover in case the topology changed.  */
         priv->did_discovery = _gf_false;
 
@@ -329,6 +343,9 @@ init (xlator_t *this)
 
 	GF_OPTION_INIT ("post-op-delay-secs", priv->post_op_delay_secs, uint32, out);
 
+        GF_OPTION_INIT ("use-compound-fops", priv->use_compound_fops, bool,
+                        out);
+
         priv->wait_count = 1;
 
         priv->child_up = GF_CALLOC (sizeof (unsigned char), child_count,
@@ -345,6 +362,13 @@ init (xlator_t *this)
                                            reliably
                                         */
 
+        priv->child_load = GF_CALLOC (child_count, sizeof (*priv->child_load),
+                                      gf_afr_mt_child_load_t);
+        if (!priv->child_load) {
+                ret = -ENOMEM;
+                goto out;
+        }
+
         priv->children = GF_CALLOC (sizeof (xlator_t *), child_count,
                                     gf_afr_mt_xlator_t);
         if (!priv->children) {
@@ -435,12 +459,28 @@ init (xlator_t *this)
         if (!priv->shd.split_brain)
                 goto out;
 
+        priv->shd.stats = GF_CALLOC (sizeof (*priv->shd.stats), child_count,
+                                     gf_afr_mt_shd_stats_t);
+        if (!priv->shd.stats)
+                goto out;
+
+        priv->shd.healing = GF_CALLOC (sizeof (*priv->shd.healing),
+                                       AFR_SHD_HEALING_BUCKETS,
+                                       gf_afr_mt_list_head);
+        if (!priv->shd.healing)
+                goto out;
+        for (i = 0; i < AFR_SHD_HEALING_BUCKETS; i++)
+                INIT_LIST_HEAD (&priv->shd.healing[i]);
+
         this->itable = inode_table_new (SHD_INODE_LRU_LIMIT, this);
         if (!this->itable)
                 goto out;
         priv->root_inode = inode_ref (this->itable->root);
         GF_OPTION_INIT ("node-uuid", priv->shd.node_uuid, str, out);
         GF_OPTION_INIT ("heal-timeout", priv->shd.timeout, int32, out);
+        GF_OPTION_INIT ("shd-max-threads", priv->shd.max_threads, uint32, out);
+        GF_OPTION_INIT ("shd-wait-qlength", priv->shd.wait_qlength, uint32,
+                        out);
 
         ret = 0;
 out:
@@ -537,11 +577,13 @@ struct volume_options options[] = {
         { .key = {"read-hash-mode" },
           .type = GF_OPTION_TYPE_INT,
           .min = 0,
-          .max = 2,
+          .max = 3,
           .default_value = "0",
           .description = "0 = first responder, "
                          "1 = hash by GFID (all clients use same subvolume), "
-                         "2 = hash by GFID and client PID",
+                         "2 = hash by GFID and client PID, "
+                         "3 = subvolume with the least latency and "
+                         "outstanding fops",
         },
         { .key  = {"choose-local" },
           .type = GF_OPTION_TYPE_BOOL,
@@ -663,6 +705,24 @@ struct volume_options options[] = {
           .default_value = "600",
           .description = "Poll timeout for checking the need to self-heal"
         },
+        { .key  = {"shd-max-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 64,
+          .default_value = "1",
+          .description = "Maximum number of files the self-heal daemon heals "
+                         "at the same time on each local brick of the "
+                         "replica, from the entries its index crawl queues."
+        },
+        { .key  = {"shd-wait-qlength"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 65536,
+          .default_value = "1024",
+          .description = "Number of index entries the self-heal daemon's "
+                         "crawl reads ahead of the heal threads before it "
+                         "waits for them."
+        },
         { .key  = {"post-op-delay-secs"},
           .type = GF_OPTION_TYPE_INT,
           .min  = 0,
@@ -672,5 +732,13 @@ struct volume_options options[] = {
 	                 "post-operation phase of the transaction to "
                          "enhance overlap of adjacent write operations.",
         },
+        { .key  = {"use-compound-fops"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Send the changelog post-op of a transaction and "
+                         "the unlock after it to each brick in one round "
+                         "trip. Bricks which do not take compound fops get "
+                         "them one by one.",
+        },
         { .key  = {NULL} },
 };
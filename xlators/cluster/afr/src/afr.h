@@ -85,6 +85,33 @@ typedef enum {
         FULL,
 } afr_crawl_type_t;
 
+/* progress of the index heal of one local child, guarded by priv->lock */
+typedef struct afr_shd_stats_ {
+        time_t           start;         /* 0 when no index heal is running */
+        uint64_t         pending;       /* index entries when it started */
+        uint64_t         done;          /* entries processed since */
+        uint64_t         failed;
+        uint64_t         skipped;       /* already being healed */
+        uint32_t         queued;
+        uint32_t         workers;
+} afr_shd_stats_t;
+
+#define AFR_SHD_HEALING_BUCKETS 256
+
+/* read-hash-mode picking the least loaded child */
+#define AFR_READ_HASH_LOAD      3
+
+/* the read child of an inode is only moved when its score exceeds that of
+   the best child by this percentage plus AFR_READ_LOAD_SLACK usecs */
+#define AFR_READ_LOAD_MARGIN    50
+#define AFR_READ_LOAD_SLACK     1000
+
+/* load seen on one child, guarded by priv->read_child_lock */
+typedef struct afr_child_load_ {
+        uint64_t         latency;       /* moving average, usecs */
+        uint64_t         outstanding;   /* fops wound and not answered */
+} afr_child_load_t;
+
 typedef struct afr_self_heald_ {
         gf_boolean_t     enabled;
         gf_boolean_t     iamshd;
@@ -97,6 +124,11 @@ typedef struct afr_self_heald_ {
         eh_t             *split_brain;
         char             *node_uuid;
         int              timeout;
+        uint32_t         max_threads;
+        uint32_t         wait_qlength;
+        afr_shd_stats_t  *stats;
+        /* gfids queued or being healed, hashed on their last byte */
+        struct list_head *healing;
 } afr_self_heald_t;
 
 typedef struct _afr_private {
@@ -131,6 +163,7 @@ typedef struct _afr_private {
 
         int read_child;               /* read-subvolume */
         unsigned int hash_mode;       /* for when read_child is not set */
+        afr_child_load_t *child_load; /* for hash_mode 3 */
         int favorite_child;  /* subvolume to be preferred in resolving
                                          split-brain cases */
 
@@ -152,6 +185,7 @@ typedef struct _afr_private {
         gf_boolean_t      optimistic_change_log;
         gf_boolean_t      eager_lock;
 	uint32_t          post_op_delay_secs;
+        gf_boolean_t      use_compound_fops;
         unsigned int      quorum_count;
 
         char                   vol_uuid[UUID_SIZE + 1];
@@ -250,6 +284,15 @@ typedef struct {
         off_t offset;
         unsigned char *write_needed;
         uint8_t *checksum;
+        unsigned char *checksum_fast;   /* child replied with the fast
+                                           strong checksum, not MD5 */
+        struct gf_dirty_regions *dirty_regions; /* recorded by the source
+                                                   and the sinks, NULL if
+                                                   all may differ */
+        gf_boolean_t regions_incomplete;        /* a child had no map */
+        gf_boolean_t entry_changes;     /* entries are read from the
+                                           names the sources recorded as
+                                           changed */
         afr_post_remove_call_t post_remove_call;
 
         loc_t parent_loc;
@@ -385,6 +428,10 @@ typedef struct _afr_local {
         unsigned char read_child_returned;
         unsigned int first_up_child;
 
+        /* child a read fop was last wound to and when, for hash_mode 3 */
+        int32_t        load_child;
+        struct timeval load_start;
+
 	gf_lkowner_t  saved_lk_owner;
 
         int32_t op_ret;
@@ -906,7 +953,8 @@ int
 afr_first_up_child (unsigned char *child_up, size_t child_count);
 
 int
-afr_select_read_child_from_policy (int32_t *fresh_children, int32_t child_count,
+afr_select_read_child_from_policy (xlator_t *this,
+                                   int32_t *fresh_children, int32_t child_count,
                                    int32_t prev_read_child,
                                    int32_t config_read_child, int32_t *sources,
                                    unsigned int hmode, uuid_t gfid);
@@ -916,6 +964,13 @@ afr_set_read_ctx_from_policy (xlator_t *this, inode_t *inode,
                               int32_t *fresh_children, int32_t prev_read_child,
                               int32_t config_read_child, uuid_t gfid);
 
+void
+afr_load_wind (xlator_t *this, afr_local_t *local, int32_t child);
+
+void
+afr_load_unwind (xlator_t *this, afr_local_t *local, int32_t child,
+                 int32_t op_ret);
+
 int32_t
 afr_get_call_child (xlator_t *this, unsigned char *child_up, int32_t read_child,
                     int32_t *fresh_children,
@@ -2461,6 +2461,15 @@ init (xlator_t *this)
 		goto out;
 	}
 
+        priv->child_load = GF_CALLOC (child_count, sizeof (*priv->child_load),
+                                      gf_afr_mt_child_load_t);
+        if (!priv->child_load) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Out of memory.");
+                op_errno = ENOMEM;
+                goto out;
+        }
+
 	priv->children = GF_CALLOC (sizeof (xlator_t *), child_count,
                                  gf_afr_mt_xlator_t);
 	if (!priv->children) {
@@ -36,6 +36,7 @@
 #include <stdarg.h>
 #include "defaults.h"
 #include "logging.h"
+#include "event.h"
 
 #define MAX_LIST_MEMBERS 100
 
@@ -2548,6 +2549,7 @@ reconfigure (xlator_t *this, dict_t *options)
         int                 sys_log_level = -1;
         char               *log_str = NULL;
         int                 log_level = -1;
+        int32_t             event_threads = 0;
 
         if (!this || !this->private)
                 goto out;
@@ -2575,6 +2577,9 @@ reconfigure (xlator_t *this, dict_t *options)
                 gf_log_set_loglevel (log_level);
         }
 
+        GF_OPTION_RECONF ("event-threads", event_threads, options, int32, out);
+        event_reconfigure_threads (this->ctx->event_pool, event_threads);
+
         ret = 0;
 out:
         gf_log (this->name, GF_LOG_DEBUG, "reconfigure returning %d", ret);
@@ -2609,6 +2614,7 @@ init (xlator_t *this)
         int                 sys_log_level = -1;
         char               *log_str = NULL;
         int                 log_level = -1;
+        int32_t             event_threads = 0;
         int                 ret = -1;
 
         if (!this)
@@ -2664,6 +2670,10 @@ init (xlator_t *this)
                 gf_log_set_loglevel (log_level);
         }
 
+        /* like the log level, this is for the whole process */
+        GF_OPTION_INIT ("event-threads", event_threads, int32, out);
+        event_reconfigure_threads (this->ctx->event_pool, event_threads);
+
         this->private = conf;
         ret = 0;
 out:
@@ -2847,6 +2857,14 @@ struct volume_options options[] = {
           .value = { "DEBUG", "WARNING", "ERROR", "INFO",
                      "CRITICAL", "NONE", "TRACE"}
         },
+        { .key  = {"event-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = EVENT_MAX_THREADS,
+          .default_value = "1",
+          .description = "Number of threads dispatching network events "
+                         "in the process."
+        },
 
         /* These are synthetic entries to assist validation of CLI's  *
          *  volume set  command                                       */
@@ -2870,6 +2888,22 @@ struct volume_options options[] = {
           .value = { "DEBUG", "WARNING", "ERROR", "INFO",
                      "CRITICAL", "NONE", "TRACE"}
         },
+        { .key  = {"client-event-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = EVENT_MAX_THREADS,
+          .default_value = "1",
+          .description = "Number of threads dispatching network events "
+                         "in the client processes."
+        },
+        { .key  = {"server-event-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = EVENT_MAX_THREADS,
+          .default_value = "1",
+          .description = "Number of threads dispatching network events "
+                         "in the brick processes."
+        },
         { .key  = {NULL} },
 
 };
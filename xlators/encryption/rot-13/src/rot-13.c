@@ -62,8 +62,16 @@ rot13_readv_cbk (call_frame_t *frame,
 {
 	rot_13_private_t *priv = (rot_13_private_t *)this->private;
   
-	if (priv->decrypt_read)
+	if (priv->decrypt_read) {
+		/* the payload may still be sitting in a pipe */
+		if (iobref && (iobref_materialize (iobref) != 0)) {
+			op_ret = -1;
+			op_errno = EIO;
+			goto out;
+		}
 		rot13_iovec (vector, count);
+	}
+out:
 
 	STACK_UNWIND_STRICT (readv, frame, op_ret, op_errno, vector, count,
                              stbuf, iobref, xdata);
@@ -15,8 +15,16 @@
 #include "index.h"
 #include "options.h"
 #include "glusterfs3-xdr.h"
+#include "syscall.h"
+
+#include <ftw.h>
 
 #define XATTROP_SUBDIR "xattrop"
+#define ENTRY_CHANGES_SUBDIR "entry-changes"
+#define ENTRY_CHANGES_STALE_SUBDIR "entry-changes-stale"
+#define ENTRY_CHANGES_TMP_SUBDIR "entry-changes-tmp"
+/* set on a list once it holds every name, removed before it is discarded */
+#define ENTRY_CHANGES_COMPLETE_XATTR "trusted.glusterfs.index.complete"
 
 call_stub_t *
 __index_dequeue (struct list_head *callstubs)
@@ -255,7 +263,8 @@ check_delete_stale_index_file (xlator_t *this, char *filename)
 
 static int
 index_fill_readdir (fd_t *fd, DIR *dir, off_t off,
-                    size_t size, gf_dirent_t *entries)
+                    size_t size, gf_dirent_t *entries,
+                    gf_boolean_t skip_index_files)
 {
         off_t     in_case = -1;
         size_t    filled = 0;
@@ -297,7 +306,8 @@ index_fill_readdir (fd_t *fd, DIR *dir, off_t off,
                         break;
                 }
 
-                if (!strncmp (entry->d_name, XATTROP_SUBDIR"-",
+                if (skip_index_files &&
+                    !strncmp (entry->d_name, XATTROP_SUBDIR"-",
                               strlen (XATTROP_SUBDIR"-"))) {
                         check_delete_stale_index_file (this, entry->d_name);
                         continue;
@@ -408,27 +418,863 @@ out:
 int
 index_del (xlator_t *this, uuid_t gfid, const char *subdir)
 {
-        int32_t      op_errno __attribute__((unused)) = 0;
-        index_priv_t *priv = NULL;
-        int          ret = 0;
-        char         gfid_path[PATH_MAX] = {0};
+        int32_t      op_errno __attribute__((unused)) = 0;
+        index_priv_t *priv = NULL;
+        int          ret = 0;
+        char         gfid_path[PATH_MAX] = {0};
+
+        priv = this->private;
+        GF_ASSERT_AND_GOTO_WITH_ERROR (this->name, !uuid_is_null (gfid),
+                                       out, op_errno, EINVAL);
+        make_gfid_path (priv->index_basepath, subdir, gfid,
+                        gfid_path, sizeof (gfid_path));
+        ret = unlink (gfid_path);
+        if (ret && (errno != ENOENT)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "%s: failed to delete from index (%s)",
+                        gfid_path, strerror (errno));
+                ret = -errno;
+                goto out;
+        }
+        ret = 0;
+out:
+        return ret;
+}
+
+static uint64_t
+index_regions_epoch (index_priv_t *priv)
+{
+        uint64_t epoch = 0;
+
+        LOCK (&priv->lock);
+        {
+                epoch = priv->regions_epoch;
+        }
+        UNLOCK (&priv->lock);
+
+        return epoch;
+}
+
+/* makes every region map recorded so far, in memory or on disk, stale */
+static void
+index_regions_new_epoch (index_priv_t *priv)
+{
+        uuid_t   uuid = {0};
+        uint64_t epoch = 0;
+
+        uuid_generate (uuid);
+        memcpy (&epoch, uuid, sizeof (epoch));
+
+        LOCK (&priv->lock);
+        {
+                priv->regions_epoch = epoch;
+        }
+        UNLOCK (&priv->lock);
+}
+
+static struct gf_dirty_regions *
+__index_regions_get (index_inode_ctx_t *ctx, uint64_t epoch)
+{
+        if (ctx->regions && (ntoh64 (ctx->regions->epoch) != epoch)) {
+                GF_FREE (ctx->regions);
+                ctx->regions = NULL;
+                ctx->regions_persisted = ctx->regions_version;
+        }
+
+        return ctx->regions;
+}
+
+static struct gf_dirty_regions *
+__index_regions_dup (index_inode_ctx_t *ctx)
+{
+        struct gf_dirty_regions *copy = NULL;
+
+        copy = GF_MALLOC (sizeof (*copy), gf_index_mt_dirty_regions_t);
+        if (copy)
+                memcpy (copy, ctx->regions, sizeof (*copy));
+
+        return copy;
+}
+
+static void
+index_regions_persist (xlator_t *this, inode_t *inode,
+                       struct gf_dirty_regions *regions);
+
+int32_t
+index_regions_persist_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno, dict_t *xdata)
+{
+        index_priv_t            *priv = NULL;
+        index_inode_ctx_t       *ctx = NULL;
+        inode_t                 *inode = NULL;
+        struct gf_dirty_regions *regions = NULL;
+        uint64_t                 epoch = 0;
+        int                      ret = 0;
+
+        priv = this->private;
+        inode = frame->local;
+        frame->local = NULL;
+
+        /* the file is gone along with its regions */
+        if ((op_ret < 0) && (op_errno != ENOENT) && (op_errno != ESTALE)) {
+                gf_log (this->name, GF_LOG_WARNING, "%s: failed to store "
+                        "dirty regions (%s), forgetting the regions of all "
+                        "files", uuid_utoa (inode->gfid), strerror (op_errno));
+                index_regions_new_epoch (priv);
+        }
+
+        epoch = index_regions_epoch (priv);
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (ret)
+                        goto unlock;
+
+                if (ctx->regions_inflight > ctx->regions_persisted)
+                        ctx->regions_persisted = ctx->regions_inflight;
+                ctx->regions_inflight = 0;
+
+                if ((ctx->state != IN) || !__index_regions_get (ctx, epoch) ||
+                    (ctx->regions_version == ctx->regions_persisted))
+                        goto unlock;
+
+                regions = __index_regions_dup (ctx);
+                if (regions)
+                        ctx->regions_inflight = ctx->regions_version;
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        STACK_DESTROY (frame->root);
+
+        if (regions)
+                index_regions_persist (this, inode, regions);
+        inode_unref (inode);
+
+        return 0;
+}
+
+/* writes the map next to the file, so that it outlives the inode ctx. The
+   inode stays referenced until then. */
+static void
+index_regions_persist (xlator_t *this, inode_t *inode,
+                       struct gf_dirty_regions *regions)
+{
+        call_frame_t    *frame = NULL;
+        dict_t          *dict = NULL;
+        loc_t            loc = {0, };
+        int              ret = -1;
+
+        frame = create_frame (this, this->ctx->pool);
+        if (!frame)
+                goto out;
+
+        dict = dict_new ();
+        if (!dict)
+                goto out;
+
+        ret = dict_set_bin (dict, GF_XATTR_DIRTY_REGIONS, regions,
+                            sizeof (*regions));
+        if (ret)
+                goto out;
+        regions = NULL;
+
+        loc.inode = inode;
+        uuid_copy (loc.gfid, inode->gfid);
+        frame->local = inode_ref (inode);
+
+        STACK_WIND (frame, index_regions_persist_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->setxattr, &loc, dict, 0, NULL);
+        frame = NULL;
+        ret = 0;
+out:
+        if (ret) {
+                gf_log (this->name, GF_LOG_WARNING, "%s: failed to store "
+                        "dirty regions, forgetting the regions of all files",
+                        uuid_utoa (inode->gfid));
+                index_regions_new_epoch (this->private);
+        }
+        if (dict)
+                dict_unref (dict);
+        if (frame)
+                STACK_DESTROY (frame->root);
+        GF_FREE (regions);
+}
+
+/* regions are kept only while the file has pending changelog counts, a
+   write on a clean file reaches every replica */
+static int
+index_regions_record (xlator_t *this, inode_t *inode, off_t offset,
+                      size_t len, gf_boolean_t full)
+{
+        index_priv_t            *priv = NULL;
+        index_inode_ctx_t       *ctx = NULL;
+        struct gf_dirty_regions *regions = NULL;
+        uint64_t                 epoch = 0;
+        int                      changed = 0;
+        int                      ret = 0;
+
+        priv = this->private;
+        if (!priv->dirty_regions)
+                goto out;
+
+        epoch = index_regions_epoch (priv);
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (ret)
+                        goto unlock;
+
+                if (ctx->state == NOTIN)
+                        goto unlock;
+
+                regions = __index_regions_get (ctx, epoch);
+                if (!regions) {
+                        regions = GF_MALLOC (sizeof (*regions),
+                                             gf_index_mt_dirty_regions_t);
+                        if (!regions) {
+                                ret = -1;
+                                goto unlock;
+                        }
+                        /* the writes that came before are not known */
+                        gf_dirty_regions_init (regions,
+                                               priv->dirty_region_size, epoch,
+                                               GF_DIRTY_REGIONS_FULL);
+                        ctx->regions = regions;
+                        ctx->regions_version++;
+                }
+
+                if (full)
+                        changed = gf_dirty_regions_mark_full (regions);
+                else
+                        changed = gf_dirty_regions_mark (regions, offset, len);
+                if (changed)
+                        ctx->regions_version++;
+        }
+unlock:
+        UNLOCK (&inode->lock);
+out:
+        return ret;
+}
+
+/* called on the changelog counts changing from 'prev' to ctx->state */
+static void
+index_regions_update (xlator_t *this, inode_t *inode, index_state_t prev)
+{
+        index_priv_t            *priv = NULL;
+        index_inode_ctx_t       *ctx = NULL;
+        struct gf_dirty_regions *regions = NULL;
+        uint64_t                 epoch = 0;
+        int                      ret = 0;
+
+        priv = this->private;
+        epoch = index_regions_epoch (priv);
+
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (ret)
+                        goto unlock;
+
+                if (ctx->state == NOTIN) {
+                        /* every replica has every write */
+                        GF_FREE (ctx->regions);
+                        ctx->regions = NULL;
+                        ctx->regions_persisted = ctx->regions_version;
+                        goto unlock;
+                }
+
+                if (!priv->dirty_regions || (ctx->state != IN))
+                        goto unlock;
+
+                if (prev == NOTIN) {
+                        /* the replicas were in sync till now, start over.
+                           Whatever is on disk is a superset. */
+                        if (!ctx->regions)
+                                ctx->regions =
+                                        GF_MALLOC (sizeof (*ctx->regions),
+                                                   gf_index_mt_dirty_regions_t);
+                        if (ctx->regions)
+                                gf_dirty_regions_init (ctx->regions,
+                                                       priv->dirty_region_size,
+                                                       epoch, 0);
+                        ctx->regions_version++;
+                        ctx->regions_persisted = ctx->regions_version;
+                        goto unlock;
+                }
+
+                /* still out of sync, regions recorded so far must survive
+                   the inode */
+                if (ctx->regions_inflight || !__index_regions_get (ctx, epoch) ||
+                    (ctx->regions_version == ctx->regions_persisted))
+                        goto unlock;
+
+                regions = __index_regions_dup (ctx);
+                if (regions)
+                        ctx->regions_inflight = ctx->regions_version;
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        if (regions)
+                index_regions_persist (this, inode, regions);
+}
+
+/* map stored by an earlier inode of the file, fetched along with lookup */
+static void
+index_regions_load (xlator_t *this, inode_t *inode, dict_t *xattr)
+{
+        index_priv_t            *priv = NULL;
+        index_inode_ctx_t       *ctx = NULL;
+        struct gf_dirty_regions *regions = NULL;
+        data_t                  *data = NULL;
+        int                      ret = 0;
+
+        priv = this->private;
+
+        data = dict_get (xattr, GF_XATTR_DIRTY_REGIONS);
+        if (!data)
+                goto out;
+
+        regions = (struct gf_dirty_regions *)data->data;
+        if (!gf_dirty_regions_valid (regions, data->len) ||
+            (ntoh64 (regions->epoch) != index_regions_epoch (priv))) {
+                regions = NULL;
+                goto out;
+        }
+
+        regions = GF_MALLOC (sizeof (*regions), gf_index_mt_dirty_regions_t);
+        if (!regions)
+                goto out;
+        memcpy (regions, data->data, sizeof (*regions));
+
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (ret || (ctx->state == NOTIN) || ctx->regions)
+                        goto unlock;
+
+                ctx->regions = regions;
+                regions = NULL;
+                ctx->regions_version++;
+                ctx->regions_persisted = ctx->regions_version;
+        }
+unlock:
+        UNLOCK (&inode->lock);
+out:
+        GF_FREE (regions);
+        if (data)
+                dict_del (xattr, GF_XATTR_DIRTY_REGIONS);
+}
+
+static void
+make_entry_changes_path (char *base, uuid_t gfid, char *path, size_t len)
+{
+        make_gfid_path (base, ENTRY_CHANGES_SUBDIR, gfid, path, len);
+}
+
+/* renames 'path' under the stale directory, the sweeper removes it from
+   there. Lists can be too big to be removed in the fop path. */
+static int
+index_entry_changes_move_aside (xlator_t *this, const char *path)
+{
+        index_priv_t    *priv = NULL;
+        char            stale_path[PATH_MAX] = {0};
+        struct stat     st = {0};
+        uuid_t          uuid = {0};
+        int             ret = 0;
+
+        priv = this->private;
+
+        ret = lstat (path, &st);
+        if (ret) {
+                if (errno == ENOENT)
+                        ret = 0;
+                goto out;
+        }
+
+        uuid_generate (uuid);
+        make_gfid_path (priv->index_basepath, ENTRY_CHANGES_STALE_SUBDIR,
+                        uuid, stale_path, sizeof (stale_path));
+        ret = rename (path, stale_path);
+        if (ret && (errno == ENOENT)) {
+                ret = index_dir_create (this, ENTRY_CHANGES_STALE_SUBDIR);
+                if (!ret)
+                        ret = rename (path, stale_path);
+        }
+        if (ret) {
+                if (errno == ENOENT) {
+                        ret = 0;
+                        goto out;
+                }
+                gf_log (this->name, GF_LOG_ERROR, "%s: failed to discard "
+                        "entry changes (%s)", path, strerror (errno));
+                goto out;
+        }
+
+        pthread_mutex_lock (&priv->mutex);
+        {
+                priv->sweep_pending = _gf_true;
+                pthread_cond_signal (&priv->sweep_cond);
+        }
+        pthread_mutex_unlock (&priv->mutex);
+out:
+        return ret;
+}
+
+static gf_boolean_t
+index_entry_changes_is_complete (const char *list_path)
+{
+        char    marker = 0;
+
+        return (sys_lgetxattr (list_path, ENTRY_CHANGES_COMPLETE_XATTR,
+                               &marker, sizeof (marker)) >= 0);
+}
+
+/* a list not looked at since the inode came in is trusted only if it
+   carries the marker */
+static index_list_state_t
+index_entry_changes_state (xlator_t *this, inode_t *inode,
+                           index_inode_ctx_t *ctx, const char *list_path)
+{
+        index_list_state_t list_state = LIST_NONE;
+
+        if (index_entry_changes_is_complete (list_path))
+                list_state = LIST_VALID;
+
+        LOCK (&inode->lock);
+        {
+                if (ctx->list_state == LIST_UNKNOWN)
+                        ctx->list_state = list_state;
+                list_state = ctx->list_state;
+        }
+        UNLOCK (&inode->lock);
+
+        return list_state;
+}
+
+/* drops the list of the directory. The state and the marker go before the
+   list does, a list that could not be moved aside is not trusted after a
+   forget or a restart either */
+static void
+index_entry_changes_discard (xlator_t *this, inode_t *inode)
+{
+        index_priv_t      *priv = NULL;
+        index_inode_ctx_t *ctx = NULL;
+        char              path[PATH_MAX] = {0};
+        int               ret = 0;
+
+        priv = this->private;
+
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (!ret)
+                        ctx->list_state = LIST_NONE;
+        }
+        UNLOCK (&inode->lock);
+
+        make_entry_changes_path (priv->index_basepath, inode->gfid, path,
+                                 sizeof (path));
+        ret = sys_lremovexattr (path, ENTRY_CHANGES_COMPLETE_XATTR);
+        if (ret && (errno != ENOENT) && (errno != ENODATA))
+                gf_log (this->name, GF_LOG_ERROR, "%s: failed to mark the "
+                        "entry changes incomplete (%s)", path,
+                        strerror (errno));
+
+        index_entry_changes_move_aside (this, path);
+}
+
+/* lists of every directory are stale once names went unrecorded */
+static void
+index_entry_changes_wipe (xlator_t *this)
+{
+        index_priv_t    *priv = NULL;
+        char            path[PATH_MAX] = {0};
+
+        priv = this->private;
+        make_index_dir_path (priv->index_basepath, ENTRY_CHANGES_SUBDIR,
+                             path, sizeof (path));
+        index_entry_changes_move_aside (this, path);
+}
+
+/* names are hard links to a single index file, like the xattrop index */
+static int
+index_entry_changes_link (xlator_t *this, const char *list_path,
+                          const char *name)
+{
+        index_priv_t    *priv = NULL;
+        char            path[PATH_MAX] = {0};
+        char            index_path[PATH_MAX] = {0};
+        struct stat     st = {0};
+        uuid_t          index = {0};
+        int             fd = -1;
+        int             ret = 0;
+
+        priv = this->private;
+        snprintf (path, sizeof (path), "%s/%s", list_path, name);
+
+        ret = lstat (path, &st);
+        if (!ret)
+                goto out;
+
+        index_get_index (priv, index);
+        make_index_path (priv->index_basepath, ENTRY_CHANGES_SUBDIR, index,
+                         index_path, sizeof (index_path));
+        ret = link (index_path, path);
+        if (!ret || (errno == EEXIST)) {
+                ret = 0;
+                goto out;
+        }
+
+        if (errno == EMLINK) {
+                index_generate_index (priv, index);
+                make_index_path (priv->index_basepath, ENTRY_CHANGES_SUBDIR,
+                                 index, index_path, sizeof (index_path));
+        } else if (errno == ENOENT) {
+                /* either the list or the index file is missing */
+                ret = lstat (list_path, &st);
+                if (ret) {
+                        ret = -errno;
+                        goto out;
+                }
+        } else {
+                ret = -errno;
+                goto out;
+        }
+
+        fd = creat (index_path, 0);
+        if ((fd < 0) && (errno != EEXIST)) {
+                ret = -errno;
+                goto out;
+        }
+        if (fd >= 0)
+                close (fd);
+
+        ret = link (index_path, path);
+        if (ret && (errno != EEXIST)) {
+                ret = -errno;
+                goto out;
+        }
+        ret = 0;
+out:
+        return ret;
+}
+
+/* records 'name' as changed in the directory 'inode', if the directory has
+   a list. Names of directories that are clean are not needed, entry
+   operations that fail on a replica are named again in the post-op. */
+static void
+index_entry_changes_add (xlator_t *this, inode_t *inode, const char *name)
+{
+        index_priv_t       *priv = NULL;
+        index_inode_ctx_t  *ctx = NULL;
+        index_list_state_t list_state = LIST_NONE;
+        char               list_path[PATH_MAX] = {0};
+        int                ret = 0;
+
+        priv = this->private;
+        if (!priv->entry_changes || !inode || !name)
+                goto out;
+
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (!ret && (ctx->state != NOTIN))
+                        list_state = ctx->list_state;
+        }
+        UNLOCK (&inode->lock);
+
+        if (ret || (list_state == LIST_NONE))
+                goto out;
+
+        make_entry_changes_path (priv->index_basepath, inode->gfid,
+                                 list_path, sizeof (list_path));
+
+        if (list_state == LIST_UNKNOWN) {
+                list_state = index_entry_changes_state (this, inode, ctx,
+                                                        list_path);
+                if (list_state == LIST_NONE)
+                        goto out;
+        }
+
+        ret = index_entry_changes_link (this, list_path, name);
+        if (!ret || (ret == -ENOENT)) {
+                /* a list that went away was discarded along with its
+                   state */
+                if (ret)
+                        index_entry_changes_discard (this, inode);
+                goto out;
+        }
+
+        gf_log (this->name, GF_LOG_WARNING, "%s: failed to record %s as "
+                "changed (%s), the directory will be healed in full",
+                uuid_utoa (inode->gfid), name, strerror (-ret));
+        index_entry_changes_discard (this, inode);
+out:
+        return;
+}
+
+/* starts the list of a directory that just went dirty, with the name the
+   xattrop was for in it. It is put together in the tmp directory, which
+   the sweeper stays out of, marked complete and renamed into place: a list
+   is never seen without that name. */
+static int
+index_entry_changes_start (xlator_t *this, inode_t *inode, const char *name)
+{
+        index_priv_t    *priv = NULL;
+        char            tmp_path[PATH_MAX] = {0};
+        char            list_path[PATH_MAX] = {0};
+        uuid_t          uuid = {0};
+        gf_boolean_t    tmp_left = _gf_false;
+        int             ret = 0;
+
+        priv = this->private;
+
+        ret = index_dir_create (this, ENTRY_CHANGES_SUBDIR);
+        if (ret)
+                goto out;
+
+        uuid_generate (uuid);
+        make_gfid_path (priv->index_basepath, ENTRY_CHANGES_TMP_SUBDIR,
+                        uuid, tmp_path, sizeof (tmp_path));
+        ret = mkdir (tmp_path, 0600);
+        if (ret && (errno == ENOENT)) {
+                ret = index_dir_create (this, ENTRY_CHANGES_TMP_SUBDIR);
+                if (!ret)
+                        ret = mkdir (tmp_path, 0600);
+        }
+        if (ret) {
+                gf_log (this->name, GF_LOG_ERROR, "%s: failed to create "
+                        "(%s)", tmp_path, strerror (errno));
+                goto out;
+        }
+        tmp_left = _gf_true;
+
+        if (name) {
+                ret = index_entry_changes_link (this, tmp_path, name);
+                if (ret)
+                        goto out;
+        }
+
+        ret = sys_lsetxattr (tmp_path, ENTRY_CHANGES_COMPLETE_XATTR, "1", 1,
+                             0);
+        if (ret) {
+                ret = -errno;
+                goto out;
+        }
+
+        make_entry_changes_path (priv->index_basepath, inode->gfid,
+                                 list_path, sizeof (list_path));
+        ret = rename (tmp_path, list_path);
+        if (ret && ((errno == EEXIST) || (errno == ENOTEMPTY))) {
+                /* left over from before. A complete one has every name
+                   needed, anything else makes room for ours. */
+                if (index_entry_changes_is_complete (list_path)) {
+                        ret = 0;
+                        if (name)
+                                ret = index_entry_changes_link (this,
+                                                                list_path,
+                                                                name);
+                        goto out;
+                }
+                ret = index_entry_changes_move_aside (this, list_path);
+                if (!ret)
+                        ret = rename (tmp_path, list_path);
+        }
+        if (ret) {
+                ret = -errno;
+                goto out;
+        }
+        tmp_left = _gf_false;
+out:
+        if (ret)
+                gf_log (this->name, GF_LOG_WARNING, "%s: failed to start "
+                        "the list of changed names, the directory will be "
+                        "healed in full", uuid_utoa (inode->gfid));
+        if (tmp_left)
+                index_entry_changes_move_aside (this, tmp_path);
+        return ret;
+}
+
+/* the xattrop changed the counts from all zero, 'rsp' holds what the
+   counts were raised to and 'req' what they were raised by */
+static gf_boolean_t
+index_xattrop_was_clean (dict_t *req, dict_t *rsp)
+{
+        gf_boolean_t    was_clean = _gf_true;
+
+        int _check_key_is_delta (dict_t *d, char *k, data_t *v, void *tmp)
+        {
+                data_t  *result = NULL;
+
+                result = dict_get (rsp, k);
+                if (!result || (result->len != v->len) ||
+                    memcmp (result->data, v->data, v->len)) {
+                        was_clean = _gf_false;
+                        return -1;
+                }
+                return 0;
+        }
+        dict_foreach (req, _check_key_is_delta, NULL);
+
+        return was_clean;
+}
+
+/* posix answers an xattrop in the dict it was asked with, so the request
+   is kept aside for the cbk. Xattrops of an inode are serialized. */
+static void
+index_entry_changes_stash (xlator_t *this, inode_t *inode, dict_t *xattr,
+                           dict_t *xdata)
+{
+        index_priv_t      *priv = NULL;
+        index_inode_ctx_t *ctx = NULL;
+        dict_t            *req = NULL;
+        int               ret = 0;
+
+        priv = this->private;
+        if (!priv->entry_changes || !IA_ISDIR (inode->ia_type) || !xattr)
+                goto out;
+
+        req = dict_copy_with_ref (xattr, NULL);
+        if (!req)
+                goto out;
+
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (!ret) {
+                        ctx->xattrop_req = req;
+                        req = NULL;
+                        if (xdata)
+                                ctx->xattrop_xdata = dict_ref (xdata);
+                }
+        }
+        UNLOCK (&inode->lock);
+out:
+        if (req)
+                dict_unref (req);
+}
+
+/* called once the xattrop reached the disk, 'xattr' is NULL if it failed.
+   A list is started only when the directory was clean before the xattrop,
+   nothing can have been missed then. */
+static void
+index_entry_changes_update (xlator_t *this, inode_t *inode, dict_t *xattr)
+{
+        index_priv_t       *priv = NULL;
+        index_inode_ctx_t  *ctx = NULL;
+        dict_t             *req = NULL;
+        dict_t             *xdata = NULL;
+        index_state_t      state = UNKNOWN;
+        index_list_state_t list_state = LIST_UNKNOWN;
+        char               *name = NULL;
+        int                ret = 0;
+
+        priv = this->private;
+
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (!ret) {
+                        req = ctx->xattrop_req;
+                        xdata = ctx->xattrop_xdata;
+                        ctx->xattrop_req = NULL;
+                        ctx->xattrop_xdata = NULL;
+                        state = ctx->state;
+                        list_state = ctx->list_state;
+                }
+        }
+        UNLOCK (&inode->lock);
+
+        if (!req || !xattr || !priv->entry_changes)
+                goto out;
+
+        if (state == NOTIN) {
+                /* every replica has every name */
+                if (list_state != LIST_NONE)
+                        index_entry_changes_discard (this, inode);
+                goto out;
+        }
+
+        if (state != IN)
+                goto out;
+
+        if (xdata && dict_get (xdata, GF_XATTROP_ENTRY_CHANGES_ALL)) {
+                index_entry_changes_discard (this, inode);
+                goto out;
+        }
+
+        if (xdata &&
+            dict_get_str (xdata, GF_XATTROP_ENTRY_CHANGES_NAME, &name))
+                name = NULL;
+
+        if (index_xattrop_was_clean (req, xattr)) {
+                ret = index_entry_changes_start (this, inode, name);
+                if (!ret) {
+                        LOCK (&inode->lock);
+                        {
+                                ctx->list_state = LIST_VALID;
+                        }
+                        UNLOCK (&inode->lock);
+                } else {
+                        index_entry_changes_discard (this, inode);
+                }
+        } else if (name) {
+                index_entry_changes_add (this, inode, name);
+        }
+out:
+        if (req)
+                dict_unref (req);
+        if (xdata)
+                dict_unref (xdata);
+}
+
+static int
+index_sweep_walker (const char *fpath, const struct stat *sb,
+                    int typeflag, struct FTW *ftwbuf)
+{
+        if (!ftwbuf->level) /* don't remove top level dir */
+                return 0;
+
+        if (S_ISDIR (sb->st_mode))
+                rmdir (fpath);
+        else
+                unlink (fpath);
+
+        return 0;   /* 0 = FTW_CONTINUE */
+}
+
+/* removes the lists moved aside */
+void *
+index_sweeper (void *data)
+{
+        index_priv_t    *priv = NULL;
+        xlator_t        *this = NULL;
+        char            stale_dir[PATH_MAX] = {0};
 
+        THIS = data;
+        this = data;
         priv = this->private;
-        GF_ASSERT_AND_GOTO_WITH_ERROR (this->name, !uuid_is_null (gfid),
-                                       out, op_errno, EINVAL);
-        make_gfid_path (priv->index_basepath, subdir, gfid,
-                        gfid_path, sizeof (gfid_path));
-        ret = unlink (gfid_path);
-        if (ret && (errno != ENOENT)) {
-                gf_log (this->name, GF_LOG_ERROR,
-                        "%s: failed to delete from index (%s)",
-                        gfid_path, strerror (errno));
-                ret = -errno;
-                goto out;
+
+        make_index_dir_path (priv->index_basepath, ENTRY_CHANGES_STALE_SUBDIR,
+                             stale_dir, sizeof (stale_dir));
+
+        for (;;) {
+                pthread_mutex_lock (&priv->mutex);
+                {
+                        while (!priv->sweep_pending)
+                                pthread_cond_wait (&priv->sweep_cond,
+                                                   &priv->mutex);
+                        priv->sweep_pending = _gf_false;
+                }
+                pthread_mutex_unlock (&priv->mutex);
+
+                nftw (stale_dir, index_sweep_walker, 32,
+                      FTW_DEPTH | FTW_PHYS);
         }
-        ret = 0;
-out:
-        return ret;
+
+        return NULL;
 }
 
 void
@@ -436,6 +1282,7 @@ _xattrop_index_action (xlator_t *this, inode_t *inode,  dict_t *xattr)
 {
         gf_boolean_t      zero_xattr = _gf_true;
         index_inode_ctx_t *ctx = NULL;
+        index_state_t     prev = UNKNOWN;
         int               ret = 0;
 
         int _check_key_is_zero_filled (dict_t *d, char *k, data_t *v,
@@ -456,6 +1303,7 @@ _xattrop_index_action (xlator_t *this, inode_t *inode,  dict_t *xattr)
                         zero_xattr?"add":"del", uuid_utoa (inode->gfid));
                 goto out;
         }
+        prev = ctx->state;
         if (zero_xattr) {
                 if (ctx->state == NOTIN)
                         goto out;
@@ -470,6 +1318,8 @@ _xattrop_index_action (xlator_t *this, inode_t *inode,  dict_t *xattr)
                         ctx->state = IN;
         }
 out:
+        if (ctx)
+                index_regions_update (this, inode, prev);
         return;
 }
 
@@ -507,10 +1357,6 @@ __index_fd_ctx_get (fd_t *fd, xlator_t *this, index_fd_ctx_t **ctx)
         index_priv_t      *priv = NULL;
 
         priv = this->private;
-        if (uuid_compare (fd->inode->gfid, priv->xattrop_vgfid)) {
-                ret = -EINVAL;
-                goto out;
-        }
 
         ret = __fd_ctx_get (fd, this, &tmpctx);
         if (!ret) {
@@ -524,8 +1370,14 @@ __index_fd_ctx_get (fd_t *fd, xlator_t *this, index_fd_ctx_t **ctx)
                 goto out;
         }
 
-        make_index_dir_path (priv->index_basepath, XATTROP_SUBDIR,
-                             index_dir, sizeof (index_dir));
+        /* any other directory is read for its list of changed names */
+        if (!uuid_compare (fd->inode->gfid, priv->xattrop_vgfid))
+                make_index_dir_path (priv->index_basepath, XATTROP_SUBDIR,
+                                     index_dir, sizeof (index_dir));
+        else
+                make_entry_changes_path (priv->index_basepath,
+                                         fd->inode->gfid, index_dir,
+                                         sizeof (index_dir));
         fctx->dir = opendir (index_dir);
         if (!fctx->dir) {
                 ret = -errno;
@@ -620,6 +1472,9 @@ index_xattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 goto out;
         fop_xattrop_index_action (this, frame->local, xattr);
 out:
+        /* before the unwind, the entry operation that follows a pre-op
+           has to find the list */
+        index_entry_changes_update (this, inode, (op_ret < 0) ? NULL : xattr);
         INDEX_STACK_UNWIND (xattrop, frame, op_ret, op_errno, xattr, xdata);
         index_queue_process (this, inode, NULL);
         inode_unref (inode);
@@ -640,6 +1495,7 @@ index_fxattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         fop_fxattrop_index_action (this, frame->local, xattr);
 out:
+        index_entry_changes_update (this, inode, (op_ret < 0) ? NULL : xattr);
         INDEX_STACK_UNWIND (fxattrop, frame, op_ret, op_errno, xattr, xdata);
         index_queue_process (this, inode, NULL);
         inode_unref (inode);
@@ -651,6 +1507,7 @@ int
 index_xattrop_wrapper (call_frame_t *frame, xlator_t *this, loc_t *loc,
                        gf_xattrop_flags_t optype, dict_t *xattr, dict_t *xdata)
 {
+        index_entry_changes_stash (this, loc->inode, xattr, xdata);
         STACK_WIND (frame, index_xattrop_cbk, FIRST_CHILD (this),
                     FIRST_CHILD (this)->fops->xattrop, loc, optype, xattr,
                     xdata);
@@ -661,6 +1518,7 @@ int
 index_fxattrop_wrapper (call_frame_t *frame, xlator_t *this, fd_t *fd,
                         gf_xattrop_flags_t optype, dict_t *xattr, dict_t *xdata)
 {
+        index_entry_changes_stash (this, fd->inode, xattr, xdata);
         STACK_WIND (frame, index_fxattrop_cbk, FIRST_CHILD (this),
                     FIRST_CHILD (this)->fops->fxattrop, fd, optype, xattr,
                     xdata);
@@ -844,7 +1702,7 @@ index_readdir_wrapper (call_frame_t *frame, xlator_t *this,
                 goto done;
         }
 
-        count = index_fill_readdir (fd, dir, off, size, &entries);
+        count = index_fill_readdir (fd, dir, off, size, &entries, _gf_true);
 
         /* pick ENOENT to indicate EOF */
         op_errno = errno;
@@ -855,6 +1713,93 @@ done:
         return 0;
 }
 
+/* served only while the directory has a list, the reply carries
+   GF_XATTROP_ENTRY_CHANGES so that callers can tell it from a plain readdir
+   of a brick without the list */
+int32_t
+index_entry_changes_readdir_wrapper (call_frame_t *frame, xlator_t *this,
+                                     fd_t *fd, size_t size, off_t off,
+                                     dict_t *xdata)
+{
+        index_priv_t          *priv          = NULL;
+        index_inode_ctx_t     *ctx           = NULL;
+        index_fd_ctx_t        *fctx          = NULL;
+        dict_t                *rsp_xdata     = NULL;
+        index_list_state_t     list_state    = LIST_UNKNOWN;
+        char                   list_path[PATH_MAX] = {0};
+        int                    ret           = -1;
+        int32_t                op_ret        = -1;
+        int32_t                op_errno      = 0;
+        int                    count         = 0;
+        gf_dirent_t            entries;
+
+        priv = this->private;
+        INIT_LIST_HEAD (&entries.list);
+
+        if (!priv->entry_changes) {
+                op_errno = ENOTSUP;
+                goto done;
+        }
+
+        LOCK (&fd->inode->lock);
+        {
+                ret = __index_inode_ctx_get (fd->inode, this, &ctx);
+                if (!ret)
+                        list_state = ctx->list_state;
+        }
+        UNLOCK (&fd->inode->lock);
+
+        if (ret) {
+                op_errno = ENOMEM;
+                goto done;
+        }
+
+        if (list_state == LIST_UNKNOWN) {
+                make_entry_changes_path (priv->index_basepath,
+                                         fd->inode->gfid, list_path,
+                                         sizeof (list_path));
+                list_state = index_entry_changes_state (this, fd->inode, ctx,
+                                                        list_path);
+        }
+
+        if (list_state == LIST_NONE) {
+                op_errno = ENOENT;
+                goto done;
+        }
+
+        ret = index_fd_ctx_get (fd, this, &fctx);
+        if (ret < 0) {
+                op_errno = -ret;
+                goto done;
+        }
+
+        rsp_xdata = dict_new ();
+        if (!rsp_xdata) {
+                op_errno = ENOMEM;
+                goto done;
+        }
+
+        ret = dict_set_int32 (rsp_xdata, GF_XATTROP_ENTRY_CHANGES, 1);
+        if (ret) {
+                op_errno = ENOMEM;
+                goto done;
+        }
+
+        count = index_fill_readdir (fd, fctx->dir, off, size, &entries,
+                                    _gf_false);
+
+        /* pick ENOENT to indicate EOF */
+        op_errno = errno;
+        op_ret = count;
+done:
+        STACK_UNWIND_STRICT (readdir, frame, op_ret, op_errno, &entries,
+                             rsp_xdata);
+        gf_dirent_free (&entries);
+        if (rsp_xdata)
+                dict_unref (rsp_xdata);
+        return 0;
+}
+
 int
 index_unlink_wrapper (call_frame_t *frame, xlator_t *this, loc_t *loc, int flag,
                       dict_t *xdata)
@@ -905,12 +1850,71 @@ done:
         return 0;
 }
 
+static int32_t
+index_regions_getxattr (call_frame_t *frame, xlator_t *this, inode_t *inode)
+{
+        index_priv_t            *priv = NULL;
+        index_inode_ctx_t       *ctx = NULL;
+        struct gf_dirty_regions *regions = NULL;
+        dict_t                  *xattr = NULL;
+        uint64_t                 epoch = 0;
+        int32_t                  op_errno = ENODATA;
+        int                      ret = 0;
+
+        priv = this->private;
+        if (!priv->dirty_regions || !inode)
+                goto out;
+
+        epoch = index_regions_epoch (priv);
+        LOCK (&inode->lock);
+        {
+                ret = __index_inode_ctx_get (inode, this, &ctx);
+                if (ret || (ctx->state == NOTIN) ||
+                    !__index_regions_get (ctx, epoch) ||
+                    gf_dirty_regions_full (ctx->regions))
+                        goto unlock;
+
+                regions = __index_regions_dup (ctx);
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        if (!regions)
+                goto out;
+
+        xattr = dict_new ();
+        if (!xattr)
+                goto out;
+
+        ret = dict_set_bin (xattr, GF_XATTR_DIRTY_REGIONS, regions,
+                            sizeof (*regions));
+        if (ret)
+                goto out;
+        regions = NULL;
+        op_errno = 0;
+out:
+        if (op_errno)
+                STACK_UNWIND_STRICT (getxattr, frame, -1, op_errno, NULL,
+                                     NULL);
+        else
+                STACK_UNWIND_STRICT (getxattr, frame, 0, 0, xattr, NULL);
+
+        GF_FREE (regions);
+        if (xattr)
+                dict_unref (xattr);
+        return 0;
+}
+
 int32_t
 index_getxattr (call_frame_t *frame, xlator_t *this,
                 loc_t *loc, const char *name, dict_t *xdata)
 {
         call_stub_t     *stub = NULL;
 
+        /* answered from memory only, the copy on disk may be stale */
+        if (name && !strcmp (GF_XATTR_DIRTY_REGIONS, name))
+                return index_regions_getxattr (frame, this, loc->inode);
+
         if (!name || strcmp (GF_XATTROP_INDEX_GFID, name))
                 goto out;
 
@@ -928,12 +1932,26 @@ out:
         return 0;
 }
 
+int32_t
+index_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, inode_t *inode,
+                  struct iatt *buf, dict_t *xattr, struct iatt *postparent)
+{
+        if ((op_ret == 0) && xattr)
+                index_regions_load (this, inode, xattr);
+
+        STACK_UNWIND_STRICT (lookup, frame, op_ret, op_errno, inode, buf,
+                             xattr, postparent);
+        return 0;
+}
+
 int32_t
 index_lookup (call_frame_t *frame, xlator_t *this,
               loc_t *loc, dict_t *xattr_req)
 {
         call_stub_t     *stub = NULL;
         index_priv_t    *priv = NULL;
+        int             ret = 0;
 
         priv = this->private;
 
@@ -950,6 +1968,30 @@ index_lookup (call_frame_t *frame, xlator_t *this,
         worker_enqueue (this, stub);
         return 0;
 normal:
+        if (!priv->dirty_regions)
+                goto wind;
+
+        if (xattr_req)
+                xattr_req = dict_ref (xattr_req);
+        else
+                xattr_req = dict_new ();
+        if (!xattr_req) {
+                STACK_UNWIND_STRICT (lookup, frame, -1, ENOMEM, loc->inode,
+                                     NULL, NULL, NULL);
+                return 0;
+        }
+
+        ret = dict_set_int32 (xattr_req, GF_XATTR_DIRTY_REGIONS, 0);
+        if (ret)
+                gf_log (this->name, GF_LOG_DEBUG, "%s: failed to request "
+                        "dirty regions", loc->path);
+
+        STACK_WIND (frame, index_lookup_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->lookup, loc, xattr_req);
+        dict_unref (xattr_req);
+
+        return 0;
+wind:
         STACK_WIND (frame, default_lookup_cbk, FIRST_CHILD(this),
                     FIRST_CHILD(this)->fops->lookup, loc, xattr_req);
 
@@ -964,10 +2006,18 @@ index_readdir (call_frame_t *frame, xlator_t *this,
         index_priv_t    *priv = NULL;
 
         priv = this->private;
+        if (xdata && dict_get (xdata, GF_XATTROP_ENTRY_CHANGES)) {
+                stub = fop_readdir_stub (frame,
+                                         index_entry_changes_readdir_wrapper,
+                                         fd, size, off, xdata);
+                goto enqueue;
+        }
+
         if (uuid_compare (fd->inode->gfid, priv->xattrop_vgfid))
                 goto out;
         stub = fop_readdir_stub (frame, index_readdir_wrapper, fd, size, off,
                                  xdata);
+enqueue:
         if (!stub) {
                 STACK_UNWIND_STRICT (readdir, frame, -1, ENOMEM, NULL, NULL);
                 return 0;
@@ -1000,11 +2050,163 @@ index_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc, int xflag,
         worker_enqueue (this, stub);
         return 0;
 out:
+        index_entry_changes_add (this, loc->parent, loc->name);
         STACK_WIND (frame, default_unlink_cbk, FIRST_CHILD(this),
                     FIRST_CHILD(this)->fops->unlink, loc, xflag, xdata);
         return 0;
 }
 
+int32_t
+index_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
+              mode_t mode, mode_t umask, fd_t *fd, dict_t *xdata)
+{
+        index_entry_changes_add (this, loc->parent, loc->name);
+        STACK_WIND (frame, default_create_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->create, loc, flags, mode, umask,
+                    fd, xdata);
+        return 0;
+}
+
+int32_t
+index_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+             dev_t rdev, mode_t umask, dict_t *xdata)
+{
+        index_entry_changes_add (this, loc->parent, loc->name);
+        STACK_WIND (frame, default_mknod_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->mknod, loc, mode, rdev, umask,
+                    xdata);
+        return 0;
+}
+
+int32_t
+index_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+             mode_t umask, dict_t *xdata)
+{
+        index_entry_changes_add (this, loc->parent, loc->name);
+        STACK_WIND (frame, default_mkdir_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->mkdir, loc, mode, umask, xdata);
+        return 0;
+}
+
+int32_t
+index_symlink (call_frame_t *frame, xlator_t *this, const char *linkpath,
+               loc_t *loc, mode_t umask, dict_t *xdata)
+{
+        index_entry_changes_add (this, loc->parent, loc->name);
+        STACK_WIND (frame, default_symlink_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->symlink, linkpath, loc, umask,
+                    xdata);
+        return 0;
+}
+
+int32_t
+index_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+            loc_t *newloc, dict_t *xdata)
+{
+        index_entry_changes_add (this, newloc->parent, newloc->name);
+        STACK_WIND (frame, default_link_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->link, oldloc, newloc, xdata);
+        return 0;
+}
+
+int32_t
+index_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+              loc_t *newloc, dict_t *xdata)
+{
+        index_entry_changes_add (this, oldloc->parent, oldloc->name);
+        index_entry_changes_add (this, newloc->parent, newloc->name);
+        STACK_WIND (frame, default_rename_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->rename, oldloc, newloc, xdata);
+        return 0;
+}
+
+int32_t
+index_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags,
+             dict_t *xdata)
+{
+        index_entry_changes_add (this, loc->parent, loc->name);
+        STACK_WIND (frame, default_rmdir_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->rmdir, loc, flags, xdata);
+        return 0;
+}
+
+int32_t
+index_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+              struct iovec *vector, int32_t count, off_t off, uint32_t flags,
+              struct iobref *iobref, dict_t *xdata)
+{
+        int     ret = 0;
+
+        ret = index_regions_record (this, fd->inode, off,
+                                    iov_length (vector, count), _gf_false);
+        if (ret) {
+                STACK_UNWIND_STRICT (writev, frame, -1, ENOMEM, NULL, NULL,
+                                     NULL);
+                return 0;
+        }
+
+        STACK_WIND (frame, default_writev_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->writev, fd, vector, count, off,
+                    flags, iobref, xdata);
+        return 0;
+}
+
+int32_t
+index_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                off_t offset, dict_t *xdata)
+{
+        int     ret = 0;
+
+        ret = index_regions_record (this, loc->inode, 0, 0, _gf_true);
+        if (ret) {
+                STACK_UNWIND_STRICT (truncate, frame, -1, ENOMEM, NULL, NULL,
+                                     NULL);
+                return 0;
+        }
+
+        STACK_WIND (frame, default_truncate_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->truncate, loc, offset, xdata);
+        return 0;
+}
+
+int32_t
+index_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                 off_t offset, dict_t *xdata)
+{
+        int     ret = 0;
+
+        ret = index_regions_record (this, fd->inode, 0, 0, _gf_true);
+        if (ret) {
+                STACK_UNWIND_STRICT (ftruncate, frame, -1, ENOMEM, NULL, NULL,
+                                     NULL);
+                return 0;
+        }
+
+        STACK_WIND (frame, default_ftruncate_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->ftruncate, fd, offset, xdata);
+        return 0;
+}
+
+int32_t
+index_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
+            fd_t *fd, dict_t *xdata)
+{
+        int     ret = 0;
+
+        if (!(flags & O_TRUNC))
+                goto wind;
+
+        ret = index_regions_record (this, loc->inode, 0, 0, _gf_true);
+        if (ret) {
+                STACK_UNWIND_STRICT (open, frame, -1, ENOMEM, NULL, NULL);
+                return 0;
+        }
+wind:
+        STACK_WIND (frame, default_open_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->open, loc, flags, fd, xdata);
+        return 0;
+}
+
 int32_t
 mem_acct_init (xlator_t *this)
 {
@@ -1024,7 +2226,9 @@ init (xlator_t *this)
         pthread_attr_t  w_attr;
         gf_boolean_t    mutex_inited = _gf_false;
         gf_boolean_t    cond_inited  = _gf_false;
+        gf_boolean_t    sweep_cond_inited = _gf_false;
         gf_boolean_t    attr_inited  = _gf_false;
+        char            tmp_dir[PATH_MAX] = {0};
 
 	if (!this->children || this->children->next) {
 		gf_log (this->name, GF_LOG_ERROR,
@@ -1049,6 +2253,13 @@ init (xlator_t *this)
         }
         cond_inited = _gf_true;
 
+        if ((ret = pthread_cond_init(&priv->sweep_cond, NULL)) != 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "pthread_cond_init failed (%d)", ret);
+                goto out;
+        }
+        sweep_cond_inited = _gf_true;
+
         if ((ret = pthread_mutex_init(&priv->mutex, NULL)) != 0) {
                 gf_log (this->name, GF_LOG_ERROR,
                         "pthread_mutex_init failed (%d)", ret);
@@ -1069,22 +2280,45 @@ init (xlator_t *this)
                         "Using default thread stack size");
         }
         GF_OPTION_INIT ("index-base", priv->index_basepath, path, out);
+        GF_OPTION_INIT ("dirty-regions", priv->dirty_regions, bool, out);
+        GF_OPTION_INIT ("dirty-region-size", priv->dirty_region_size,
+                        size, out);
+        GF_OPTION_INIT ("entry-changes", priv->entry_changes, bool, out);
+        index_regions_new_epoch (priv);
         uuid_generate (priv->index);
         uuid_generate (priv->xattrop_vgfid);
         INIT_LIST_HEAD (&priv->callstubs);
 
         this->private = priv;
+        /* lists left behind were not kept up to date if it was off */
+        if (!priv->entry_changes)
+                index_entry_changes_wipe (this);
+        /* and lists being put together were cut short */
+        make_index_dir_path (priv->index_basepath, ENTRY_CHANGES_TMP_SUBDIR,
+                             tmp_dir, sizeof (tmp_dir));
+        index_entry_changes_move_aside (this, tmp_dir);
+        priv->sweep_pending = _gf_true;
+
         ret = pthread_create (&thread, &w_attr, index_worker, this);
         if (ret) {
                 gf_log (this->name, GF_LOG_WARNING, "Failed to create "
                         "worker thread, aborting");
                 goto out;
         }
+
+        ret = pthread_create (&thread, &w_attr, index_sweeper, this);
+        if (ret) {
+                gf_log (this->name, GF_LOG_WARNING, "Failed to create "
+                        "sweeper thread, aborting");
+                goto out;
+        }
         ret = 0;
 out:
         if (ret) {
                 if (cond_inited)
                         pthread_cond_destroy (&priv->cond);
+                if (sweep_cond_inited)
+                        pthread_cond_destroy (&priv->sweep_cond);
                 if (mutex_inited)
                         pthread_mutex_destroy (&priv->mutex);
                 if (priv)
@@ -1096,6 +2330,37 @@ out:
         return ret;
 }
 
+int
+reconfigure (xlator_t *this, dict_t *options)
+{
+        index_priv_t    *priv = NULL;
+        gf_boolean_t    dirty_regions = _gf_false;
+        gf_boolean_t    entry_changes = _gf_false;
+        int             ret = -1;
+
+        priv = this->private;
+
+        GF_OPTION_RECONF ("dirty-regions", dirty_regions, options, bool, out);
+        /* writes went unrecorded while it was off */
+        if (dirty_regions && !priv->dirty_regions)
+                index_regions_new_epoch (priv);
+        priv->dirty_regions = dirty_regions;
+
+        GF_OPTION_RECONF ("dirty-region-size", priv->dirty_region_size,
+                          options, size, out);
+
+        GF_OPTION_RECONF ("entry-changes", entry_changes, options, bool, out);
+        /* names go unrecorded while it is off */
+        if (entry_changes != priv->entry_changes) {
+                priv->entry_changes = _gf_false;
+                index_entry_changes_wipe (this);
+                priv->entry_changes = entry_changes;
+        }
+        ret = 0;
+out:
+        return ret;
+}
+
 void
 fini (xlator_t *this)
 {
@@ -1107,6 +2372,7 @@ fini (xlator_t *this)
         this->private = NULL;
         LOCK_DESTROY (&priv->lock);
         pthread_cond_destroy (&priv->cond);
+        pthread_cond_destroy (&priv->sweep_cond);
         pthread_mutex_destroy (&priv->mutex);
         GF_FREE (priv);
 out:
@@ -1116,10 +2382,30 @@ out:
 int
 index_forget (xlator_t *this, inode_t *inode)
 {
-        uint64_t tmp_cache = 0;
-        if (!inode_ctx_del (inode, this, &tmp_cache))
-                GF_FREE ((index_inode_ctx_t*) (long)tmp_cache);
+        index_priv_t      *priv = NULL;
+        index_inode_ctx_t *ctx = NULL;
+        uint64_t          tmp_cache = 0;
 
+        priv = this->private;
+        if (inode_ctx_del (inode, this, &tmp_cache))
+                goto out;
+
+        ctx = (index_inode_ctx_t*) (long)tmp_cache;
+        if (priv->dirty_regions &&
+            __index_regions_get (ctx, index_regions_epoch (priv)) &&
+            (ctx->regions_version != ctx->regions_persisted)) {
+                gf_log (this->name, GF_LOG_INFO, "%s: dirty regions were "
+                        "not stored, forgetting the regions of all files",
+                        uuid_utoa (inode->gfid));
+                index_regions_new_epoch (priv);
+        }
+        GF_FREE (ctx->regions);
+        if (ctx->xattrop_req)
+                dict_unref (ctx->xattrop_req);
+        if (ctx->xattrop_xdata)
+                dict_unref (ctx->xattrop_xdata);
+        GF_FREE (ctx);
+out:
         return 0;
 }
 
@@ -1176,7 +2462,20 @@ struct xlator_fops fops = {
         .getxattr    = index_getxattr,
         .lookup      = index_lookup,
         .readdir     = index_readdir,
-        .unlink      = index_unlink
+        .unlink      = index_unlink,
+
+        .create      = index_create,
+        .mknod       = index_mknod,
+        .mkdir       = index_mkdir,
+        .symlink     = index_symlink,
+        .link        = index_link,
+        .rename      = index_rename,
+        .rmdir       = index_rmdir,
+
+        .writev      = index_writev,
+        .truncate    = index_truncate,
+        .ftruncate   = index_ftruncate,
+        .open        = index_open,
 };
 
 struct xlator_dumpops dumpops = {
@@ -1193,5 +2492,30 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_PATH,
           .description = "path where the index files need to be stored",
         },
+        { .key  = {"dirty-regions"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Record which regions of a file are written to "
+                         "while its replicas are out of sync, so that data "
+                         "self-heal only has to look at those regions. "
+                         "Maps are forgotten when the brick restarts."
+        },
+        { .key  = {"dirty-region-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 4 * GF_UNIT_KB,
+          .max  = 1 * GF_UNIT_GB,
+          .default_value = "1MB",
+          .description = "Size of the region a bit of the dirty region map "
+                         "stands for. The map has 8192 bits, regions past "
+                         "that share bits with the ones before."
+        },
+        { .key  = {"entry-changes"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Record the names created, deleted or renamed in "
+                         "a directory while its replicas are out of sync, "
+                         "so that entry self-heal only has to look up those "
+                         "names instead of reading the whole directory."
+        },
         { .key  = {NULL} },
 };
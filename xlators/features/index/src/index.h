@@ -16,6 +16,7 @@
 #include "defaults.h"
 #include "byte-order.h"
 #include "common-utils.h"
+#include "dirty-regions.h"
 #include "index-mem-types.h"
 
 #define INDEX_THREAD_STACK_SIZE   ((size_t)(1024*1024))
@@ -26,10 +27,25 @@ typedef enum {
         NOTIN
 } index_state_t;
 
+/* entry-changes list of a directory: it exists only while every name
+   changed in the directory since it was last clean is in it */
+typedef enum {
+        LIST_UNKNOWN,
+        LIST_VALID,
+        LIST_NONE
+} index_list_state_t;
+
 typedef struct index_inode_ctx {
         gf_boolean_t processing;
         struct list_head callstubs;
         index_state_t state;
+        struct gf_dirty_regions *regions; //written to while IN
+        uint64_t regions_version;   //bumped on every change of regions
+        uint64_t regions_persisted; //version known to be on disk
+        uint64_t regions_inflight;  //version being written, 0 if none
+        index_list_state_t list_state;
+        dict_t *xattrop_req;   //request of the xattrop in flight
+        dict_t *xattrop_xdata;
 } index_inode_ctx_t;
 
 typedef struct index_fd_ctx {
@@ -44,6 +60,12 @@ typedef struct index_priv {
         struct list_head callstubs;
         pthread_mutex_t mutex;
         pthread_cond_t  cond;
+        gf_boolean_t dirty_regions;
+        uint64_t dirty_region_size;
+        uint64_t regions_epoch;//regions on disk from other epochs are stale
+        gf_boolean_t entry_changes;
+        pthread_cond_t sweep_cond; //signalled when lists were moved aside
+        gf_boolean_t sweep_pending;
 } index_priv_t;
 
 #define INDEX_STACK_UNWIND(fop, frame, params ...)      \
@@ -799,6 +799,16 @@ path_create (call_frame_t *frame,
 	return 0;
 }
 
+/* the most recently set key, which is what setxattr of a file's content
+   puts in the dict */
+static int
+path_first_key (dict_t *dict, char *key, data_t *value, void *data)
+{
+	*(char **)data = key;
+
+	return -1;
+}
+
 int32_t 
 path_setxattr (call_frame_t *frame,
 	       xlator_t *this,
@@ -807,7 +817,8 @@ path_setxattr (call_frame_t *frame,
 	       int32_t flags)
 {
 	char *tmp_name = NULL;
-	data_pair_t *trav = dict->members_list;
+	char *key = NULL;
+	data_t *value = NULL;
 	char *loc_path = (char *)loc->path;
 	char *tmp_path = NULL;
 	
@@ -817,10 +828,17 @@ path_setxattr (call_frame_t *frame,
 	}
 	loc->path = tmp_path;
 
-	if (ZR_FILE_CONTENT_REQUEST(trav->key)) {
-		tmp_name = name_this_to_that (this, loc->path, trav->key);
-		if (tmp_name != trav->key) {
-			trav->key = tmp_name;
+	dict_foreach (dict, path_first_key, &key);
+
+	if (key && ZR_FILE_CONTENT_REQUEST(key)) {
+		tmp_name = name_this_to_that (this, loc->path, key);
+		if (tmp_name != key) {
+			/* keys live in the dict's own storage, rename the
+			   pair by setting the value again under the new one */
+			value = data_ref (dict_get (dict, key));
+			dict_del (dict, key);
+			dict_set (dict, tmp_name, value);
+			data_unref (value);
 		} else {
 			tmp_name = NULL;
 		}
@@ -123,6 +123,8 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.entry-self-heal",              "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.self-heal-daemon",             "cluster/replicate",  "!self-heal-daemon" , NULL, NO_DOC, 0     },
         {"cluster.heal-timeout",                 "cluster/replicate",  "!heal-timeout" , NULL, NO_DOC, 0     },
+        {"cluster.shd-max-threads",              "cluster/replicate",  "!shd-max-threads", NULL, DOC, 0 },
+        {"cluster.shd-wait-qlength",             "cluster/replicate",  "!shd-wait-qlength", NULL, DOC, 0 },
         {"cluster.strict-readdir",               "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
         {"cluster.self-heal-window-size",        "cluster/replicate",         "data-self-heal-window-size", NULL, DOC, 0},
         {"cluster.data-change-log",              "cluster/replicate",  NULL, NULL, NO_DOC, 0     },
@@ -132,6 +134,7 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.quorum-type",                  "cluster/replicate",  "quorum-type", NULL, NO_DOC, 0},
         {"cluster.quorum-count",                 "cluster/replicate",  "quorum-count", NULL, NO_DOC, 0},
         {"cluster.choose-local",                 "cluster/replicate",  NULL, NULL, DOC, 0},
+        {"cluster.use-compound-fops",            "cluster/replicate",  NULL, NULL, NO_DOC, 0},
 
         {"cluster.stripe-block-size",            "cluster/stripe",     "block-size", NULL, DOC, 0},
 	{"cluster.stripe-coalesce",		 "cluster/stripe",     "coalesce", NULL, DOC, 0},
@@ -144,6 +147,8 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"diagnostics.client-log-level",         "debug/io-stats",     "!client-log-level", NULL, DOC, 0},
         {"diagnostics.brick-sys-log-level",      "debug/io-stats",     "!sys-log-level", NULL, DOC, 0},
         {"diagnostics.client-sys-log-level",     "debug/io-stats",     "!sys-log-level", NULL, DOC, 0},
+        {"client.event-threads",                 "debug/io-stats",     "!client-event-threads", NULL, DOC, 0},
+        {"server.event-threads",                 "debug/io-stats",     "!server-event-threads", NULL, DOC, 0},
 
         {"performance.cache-max-file-size",      "performance/io-cache",      "max-file-size", NULL, DOC, 0},
         {"performance.cache-min-file-size",      "performance/io-cache",      "min-file-size", NULL, DOC, 0},
@@ -169,6 +174,14 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"network.ping-timeout",                 "protocol/client",           NULL, NULL, NO_DOC, 0},
         {"network.tcp-window-size",              "protocol/client",           NULL, NULL, NO_DOC, 0},
         { "client.ssl",                          "protocol/client",           "transport.socket.ssl-enabled", NULL, NO_DOC, 0},
+        { "client.ssl-ktls",                     "protocol/client",           "transport.socket.ssl-ktls", NULL, NO_DOC, 0},
+        {"client.channels",                      "protocol/client",           "channels", NULL, DOC, 0},
+        {"client.flow-control",                  "protocol/client",           "flow-control", NULL, DOC, 0},
+        {VKEY_TRANSPORT_SHM,                     "protocol/client",           "!shm-local", "on", DOC, 0},
+        {"client.coalesce-usec",                 "protocol/client",           "transport.socket.coalesce-usec", NULL, NO_DOC, 0},
+        {"client.busy-poll-usec",                "protocol/client",           "transport.socket.busy-poll-usec", NULL, NO_DOC, 0},
+        {"network.iobuf-page-sizes",             "protocol/client",           "iobuf-page-sizes", NULL, NO_DOC, 0},
+        {"network.iobuf-hugepages",              "protocol/client",           "iobuf-hugepages", NULL, NO_DOC, 0},
 
         {"network.tcp-window-size",              "protocol/server",           NULL, NULL, NO_DOC, 0},
         {"network.inode-lru-limit",              "protocol/server",           NULL, NULL, NO_DOC, 0},
@@ -177,6 +190,14 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"transport.keepalive",                  "protocol/server",           "transport.socket.keepalive", NULL, NO_DOC, 0},
         {"server.allow-insecure",                "protocol/server",           "rpc-auth-allow-insecure", NULL, NO_DOC, 0},
         { "server.ssl",                          "protocol/server",           "transport.socket.ssl-enabled", NULL, NO_DOC, 0},
+        { "server.ssl-ktls",                     "protocol/server",           "transport.socket.ssl-ktls", NULL, NO_DOC, 0},
+        { "server.ssl-ticket-key",               "protocol/server",           "transport.socket.ssl-ticket-key", NULL, NO_DOC, 0},
+        {"server.coalesce-usec",                 "protocol/server",           "transport.socket.coalesce-usec", NULL, NO_DOC, 0},
+        {"server.busy-poll-usec",                "protocol/server",           "transport.socket.busy-poll-usec", NULL, NO_DOC, 0},
+        {"server.outstanding-rpc-limit",         "protocol/server",           "rpc.outstanding-rpc-limit", NULL, DOC, 0},
+        {"server.dispatch-limit",                "protocol/server",           "rpc.dispatch-limit", NULL, DOC, 0},
+        {"network.iobuf-page-sizes",             "protocol/server",           "iobuf-page-sizes", NULL, NO_DOC, 0},
+        {"network.iobuf-hugepages",              "protocol/server",           "iobuf-hugepages", NULL, NO_DOC, 0},
 
         {"performance.write-behind",             "performance/write-behind",  "!perf", "on", NO_DOC, 0},
         {"performance.read-ahead",               "performance/read-ahead",    "!perf", "on", NO_DOC, 0},
@@ -235,6 +256,12 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"storage.linux-aio",                    "storage/posix",             NULL, NULL, DOC, 0},
         {"storage.owner-uid",                    "storage/posix",             "brick-uid", NULL, DOC, 0},
         {"storage.owner-gid",                    "storage/posix",             "brick-gid", NULL, DOC, 0},
+        {"storage.io-uring",                     "storage/posix",             NULL, NULL, DOC, 0},
+        {"storage.zero-copy-read",               "storage/posix",             NULL, NULL, DOC, 0},
+        {"storage.rchecksum-cache",              "storage/posix",             NULL, NULL, DOC, 0},
+        {"features.dirty-regions",               "features/index",            NULL, NULL, DOC, 0},
+        {"features.dirty-region-size",           "features/index",            NULL, NULL, DOC, 0},
+        {"features.entry-changes",               "features/index",            NULL, NULL, DOC, 0},
         {NULL,                                                                }
 };
 
@@ -1257,6 +1284,29 @@ build_graph_generic (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
         return ret;
 }
 
+#ifdef HAVE_SHM_TRANSPORT
+/* auth.allow and auth.reject name addresses, which shared-memory peers do
+   not have. such volumes keep their local clients on tcp. */
+static gf_boolean_t
+volgen_shm_enabled (glusterd_volinfo_t *volinfo)
+{
+        char *val = NULL;
+
+        if (glusterd_volinfo_get_boolean (volinfo, VKEY_TRANSPORT_SHM) <= 0)
+                return _gf_false;
+
+        if (!glusterd_volinfo_get (volinfo, AUTH_REJECT_MAP_KEY, &val) && val)
+                return _gf_false;
+
+        val = NULL;
+        if (!glusterd_volinfo_get (volinfo, AUTH_ALLOW_MAP_KEY, &val) && val &&
+            strcmp (val, "*"))
+                return _gf_false;
+
+        return _gf_true;
+}
+#endif
+
 static gf_transport_type
 transport_str_to_type (char *tt)
 {
@@ -1458,6 +1508,27 @@ sys_loglevel_option_handler (volgen_graph_t *graph,
         return basic_option_handler (graph, &vme2, NULL);
 }
 
+/* event-threads is for the whole process, io-stats (one per graph) has it */
+static int
+event_threads_option_handler (volgen_graph_t *graph,
+                              struct volopt_map_entry *vme, void *param)
+{
+        char  *role = NULL;
+        char   option[64] = {0,};
+        struct volopt_map_entry vme2 = {0,};
+
+        role = (char *) param;
+
+        snprintf (option, sizeof (option), "!%s-event-threads", role);
+        if (strcmp (vme->option, option) != 0)
+                return 0;
+
+        memcpy (&vme2, vme, sizeof (vme2));
+        vme2.option = "event-threads";
+
+        return basic_option_handler (graph, &vme2, NULL);
+}
+
 static int
 volgen_graph_set_xl_options (volgen_graph_t *graph, dict_t *dict)
 {
@@ -1510,6 +1581,9 @@ server_spec_option_handler (volgen_graph_t *graph,
         if (!ret)
                 ret = sys_loglevel_option_handler (graph, vme, "brick");
 
+        if (!ret)
+                ret = event_threads_option_handler (graph, vme, "server");
+
         return ret;
 }
 
@@ -1557,6 +1631,11 @@ server_graph_builder (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
         path = param;
         volname = volinfo->volname;
         get_vol_transport_type (volinfo, transt);
+#ifdef HAVE_SHM_TRANSPORT
+        /* for the daemons glusterd runs next to the brick */
+        if (volgen_shm_enabled (volinfo))
+                strcat (transt, ",shm");
+#endif
 
         ret = dict_get_str (set_dict, "xlator", &xlator);
 
@@ -2107,6 +2186,7 @@ volgen_graph_build_clients (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
         xlator_t                *xl                 = NULL;
         char                    *ssl_str            = NULL;
         gf_boolean_t             ssl_bool;
+        gf_boolean_t             shm_local          = _gf_false;
 
         volname = volinfo->volname;
 
@@ -2132,6 +2212,14 @@ volgen_graph_build_clients (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
         if (!strcmp (transt, "tcp,rdma"))
                 strcpy (transt, "tcp");
 
+#ifdef HAVE_SHM_TRANSPORT
+        /* volfiles of daemons on this host only, never ones served to
+           other hosts */
+        shm_local = dict_get_str_boolean (set_dict, "shm-local-client",
+                                          _gf_false) &&
+                    !strcmp (transt, "tcp") && volgen_shm_enabled (volinfo);
+#endif
+
         i = 0;
         ret = -1;
         list_for_each_entry (brick, &volinfo->bricks, brick_list) {
@@ -2146,7 +2234,11 @@ volgen_graph_build_clients (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
                 ret = xlator_set_option (xl, "remote-subvolume", brick->path);
                 if (ret)
                         goto out;
-                ret = xlator_set_option (xl, "transport-type", transt);
+                if (shm_local && glusterd_is_local_brick (THIS, volinfo,
+                                                          brick))
+                        ret = xlator_set_option (xl, "transport-type", "shm");
+                else
+                        ret = xlator_set_option (xl, "transport-type", transt);
                 if (ret)
                         goto out;
 
@@ -2522,6 +2614,12 @@ client_graph_builder (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
         if (ret)
                 gf_log (THIS->name, GF_LOG_WARNING, "changing client syslog "
                         "level failed");
+
+        ret = volgen_graph_set_options_generic (graph, set_dict, "client",
+                                                &event_threads_option_handler);
+        if (ret)
+                gf_log (THIS->name, GF_LOG_WARNING, "changing client event "
+                        "threads failed");
 out:
         return ret;
 }
@@ -2539,6 +2637,8 @@ build_client_graph (volgen_graph_t *graph, glusterd_volinfo_t *volinfo,
 char *gd_shd_options[] = {
         "!self-heal-daemon",
         "!heal-timeout",
+        "!shd-max-threads",
+        "!shd-wait-qlength",
         NULL
 };
 
@@ -2820,6 +2920,10 @@ build_shd_graph (volgen_graph_t *graph, dict_t *mod_dict)
                 if (ret)
                         goto out;
 
+                ret = dict_set_str (set_dict, "shm-local-client", "yes");
+                if (ret)
+                        goto out;
+
                 dict_copy (voliter->dict, set_dict);
                 if (mod_dict)
                         dict_copy (mod_dict, set_dict);
@@ -2978,6 +3082,10 @@ build_nfs_graph (volgen_graph_t *graph, dict_t *mod_dict)
                 if (ret)
                         goto out;
 
+                ret = dict_set_str (set_dict, "shm-local-client", "yes");
+                if (ret)
+                        goto out;
+
                 ret = build_client_graph (&cgraph, voliter, set_dict);
                 if (ret)
                         goto out;
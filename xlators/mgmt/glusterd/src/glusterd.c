@@ -732,6 +732,33 @@ _install_mount_spec (dict_t *opts, char *key, data_t *value, void *data)
         return -1;
 }
 
+#ifdef HAVE_SHM_TRANSPORT
+/* clients on shared memory ask for the brick ports over it too. they
+ * are local daemons, glusterd does fine without them.
+ */
+static void
+glusterd_shm_listener_init (xlator_t *this, rpcsvc_t *rpc)
+{
+        dict_t *options = NULL;
+
+        options = dict_copy_with_ref (this->options, NULL);
+        if (!options)
+                goto out;
+
+        if (dict_set_str (options, "transport-type", "shm")) {
+                dict_unref (options);
+                goto out;
+        }
+
+        /* the listener transport keeps the reference */
+        if (rpcsvc_create_listeners (rpc, options, this->name) > 0)
+                return;
+out:
+        gf_log (this->name, GF_LOG_WARNING, "could not listen on the shm "
+                "transport, local clients have to use tcp");
+}
+#endif
+
 /*
  * init - called during glusterd initialization
  *
@@ -894,6 +921,10 @@ init (xlator_t *this)
                 goto out;
         }
 
+#ifdef HAVE_SHM_TRANSPORT
+        glusterd_shm_listener_init (this, rpc);
+#endif
+
         ret = glusterd_program_register (this, rpc, &gd_svc_peer_prog);
         if (ret) {
                 goto out;
@@ -29,136 +29,361 @@ int iot_workers_scale (iot_conf_t *conf);
 int __iot_workers_scale (iot_conf_t *conf);
 struct volume_options options[];
 
+
+static uint64_t
+iot_now_nsec (void)
+{
+        struct timespec  ts = {0, };
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+
+/* Take a slot in the concurrency limit of a priority class */
+static gf_boolean_t
+iot_class_get (iot_conf_t *conf, int pri)
+{
+        int32_t  count = 0;
+
+        count = __atomic_load_n (&conf->ac_iot_count[pri], __ATOMIC_RELAXED);
+        do {
+                if (count >= conf->ac_iot_limit[pri])
+                        return _gf_false;
+        } while (!__atomic_compare_exchange_n (&conf->ac_iot_count[pri],
+                                               &count, count + 1, _gf_true,
+                                               __ATOMIC_ACQUIRE,
+                                               __ATOMIC_RELAXED));
+
+        return _gf_true;
+}
+
+
+static void
+iot_class_put (iot_conf_t *conf, int pri)
+{
+        __atomic_sub_fetch (&conf->ac_iot_count[pri], 1, __ATOMIC_RELEASE);
+}
+
+
+/* Is there a queued request some worker is allowed to pick up? */
+static gf_boolean_t
+iot_work_available (iot_conf_t *conf)
+{
+        int  i = 0;
+
+        for (i = 0; i < IOT_PRI_MAX; i++) {
+                if (__atomic_load_n (&conf->queue_sizes[i], __ATOMIC_SEQ_CST) &&
+                    (__atomic_load_n (&conf->ac_iot_count[i], __ATOMIC_RELAXED)
+                     < conf->ac_iot_limit[i]))
+                        return _gf_true;
+        }
+
+        return _gf_false;
+}
+
+
+static call_stub_t *
+iot_worker_pop (iot_worker_t *worker, int pri, gf_boolean_t steal)
+{
+        call_stub_t  *stub = NULL;
+
+        pthread_mutex_lock (&worker->lock);
+        {
+                if (list_empty (&worker->reqs[pri]))
+                        goto unlock;
+
+                if (steal)
+                        stub = list_entry (worker->reqs[pri].prev,
+                                           call_stub_t, list);
+                else
+                        stub = list_entry (worker->reqs[pri].next,
+                                           call_stub_t, list);
+
+                list_del_init (&stub->list);
+                worker->queue_sizes[pri]--;
+        }
+unlock:
+        pthread_mutex_unlock (&worker->lock);
+
+        return stub;
+}
+
+
+static call_stub_t *
+iot_worker_steal (iot_conf_t *conf, iot_worker_t *worker, int pri)
+{
+        iot_worker_t  *victim = NULL;
+        call_stub_t   *stub = NULL;
+        int            slots = 0;
+        int            i = 0;
+
+        slots = __atomic_load_n (&conf->worker_slots, __ATOMIC_ACQUIRE);
+
+        for (i = 1; i <= slots; i++) {
+                victim = &conf->workers[(worker->index + i) % slots];
+                if (victim == worker ||
+                    !__atomic_load_n (&victim->queue_sizes[pri],
+                                      __ATOMIC_RELAXED))
+                        continue;
+
+                stub = iot_worker_pop (victim, pri, _gf_true);
+                if (stub) {
+                        __atomic_add_fetch (&conf->steals, 1,
+                                            __ATOMIC_RELAXED);
+                        break;
+                }
+        }
+
+        return stub;
+}
+
+
 call_stub_t *
-__iot_dequeue (iot_conf_t *conf, int *pri)
+iot_dequeue (iot_worker_t *worker, int *pri)
 {
+        iot_conf_t   *conf = worker->conf;
         call_stub_t  *stub = NULL;
         int           i = 0;
 
         *pri = -1;
         for (i = 0; i < IOT_PRI_MAX; i++) {
-                if (list_empty (&conf->reqs[i]) ||
-                   (conf->ac_iot_count[i] >= conf->ac_iot_limit[i]))
+                if (!__atomic_load_n (&conf->queue_sizes[i], __ATOMIC_ACQUIRE))
                         continue;
-                stub = list_entry (conf->reqs[i].next, call_stub_t, list);
-                conf->ac_iot_count[i]++;
-                *pri = i;
-                break;
+
+                if (!iot_class_get (conf, i))
+                        continue;
+
+                if (__atomic_load_n (&worker->queue_sizes[i], __ATOMIC_RELAXED))
+                        stub = iot_worker_pop (worker, i, _gf_false);
+                if (!stub)
+                        stub = iot_worker_steal (conf, worker, i);
+
+                if (stub) {
+                        *pri = i;
+                        break;
+                }
+
+                iot_class_put (conf, i);
         }
 
         if (!stub)
                 return NULL;
 
-        conf->queue_size--;
-        conf->queue_sizes[*pri]--;
-        list_del_init (&stub->list);
+        __atomic_sub_fetch (&conf->queue_sizes[*pri], 1, __ATOMIC_SEQ_CST);
+        __atomic_sub_fetch (&conf->queue_size, 1, __ATOMIC_SEQ_CST);
 
         return stub;
 }
 
 
 void
-__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
+iot_enqueue (iot_conf_t *conf, iot_worker_t *worker, call_stub_t *stub,
+             int pri)
 {
         if (pri < 0 || pri >= IOT_PRI_MAX)
                 pri = IOT_PRI_MAX-1;
 
-        list_add_tail (&stub->list, &conf->reqs[pri]);
+        pthread_mutex_lock (&worker->lock);
+        {
+                list_add_tail (&stub->list, &worker->reqs[pri]);
+                worker->queue_sizes[pri]++;
+        }
+        pthread_mutex_unlock (&worker->lock);
 
-        conf->queue_size++;
-        conf->queue_sizes[pri]++;
+        /* pairs with the sleep_count/iot_work_available() check of a
+           worker going to sleep */
+        __atomic_add_fetch (&conf->queue_sizes[pri], 1, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch (&conf->queue_size, 1, __ATOMIC_SEQ_CST);
 
         return;
 }
 
 
+static iot_worker_t *
+iot_worker_pick (iot_conf_t *conf)
+{
+        iot_worker_t  *worker = NULL;
+        uint32_t       next = 0;
+        int            slots = 0;
+        int            i = 0;
+
+        slots = __atomic_load_n (&conf->worker_slots, __ATOMIC_ACQUIRE);
+        next = __atomic_fetch_add (&conf->next_worker, 1, __ATOMIC_RELAXED);
+
+        for (i = 0; i < slots; i++) {
+                worker = &conf->workers[(next + i) % slots];
+                if (worker->running)
+                        return worker;
+        }
+
+        /* whoever runs next steals it from here */
+        return &conf->workers[0];
+}
+
+
+static void
+iot_worker_wake (iot_conf_t *conf)
+{
+        iot_worker_t  *worker = NULL;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                if (list_empty (&conf->idle))
+                        goto unlock;
+
+                worker = list_entry (conf->idle.next, iot_worker_t, idle);
+                list_del_init (&worker->idle);
+                worker->wakeup = _gf_true;
+                pthread_cond_signal (&worker->cond);
+        }
+unlock:
+        pthread_mutex_unlock (&conf->mutex);
+}
+
+
+static void
+iot_worker_account (iot_conf_t *conf, uint64_t start)
+{
+        uint64_t  took = 0;
+        uint64_t  avg = 0;
+
+        took = iot_now_nsec () - start;
+        avg = conf->fop_nsec;
+
+        /* races between workers only lose a sample */
+        conf->fop_nsec = avg ? (avg - (avg >> 3) + (took >> 3)) : (took + 1);
+}
+
+
 void *
 iot_worker (void *data)
 {
+        iot_worker_t     *worker = NULL;
         iot_conf_t       *conf = NULL;
         xlator_t         *this = NULL;
         call_stub_t      *stub = NULL;
         struct timespec   sleep_till = {0, };
+        uint64_t          start = 0;
         int               ret = 0;
         int               pri = -1;
         char              timeout = 0;
         char              bye = 0;
 
-        conf = data;
+        worker = data;
+        conf = worker->conf;
         this = conf->this;
         THIS = this;
 
+        pthread_setspecific (conf->worker_key, worker);
+
         for (;;) {
+                stub = iot_dequeue (worker, &pri);
+                if (stub) {
+                        start = iot_now_nsec ();
+                        call_resume (stub);
+                        iot_worker_account (conf, start);
+
+                        iot_class_put (conf, pri);
+                        continue;
+                }
+
                 sleep_till.tv_sec = time (NULL) + conf->idle_time;
 
                 pthread_mutex_lock (&conf->mutex);
                 {
-                        if (pri != -1) {
-                                conf->ac_iot_count[pri]--;
-                                pri = -1;
-                        }
-                        while (conf->queue_size == 0) {
-                                conf->sleep_count++;
-
-                                ret = pthread_cond_timedwait (&conf->cond,
+                        list_add (&worker->idle, &conf->idle);
+                        worker->wakeup = _gf_false;
+                        __atomic_add_fetch (&conf->sleep_count, 1,
+                                            __ATOMIC_SEQ_CST);
+
+                        while (!worker->wakeup && !conf->down &&
+                               !iot_work_available (conf)) {
+                                ret = pthread_cond_timedwait (&worker->cond,
                                                               &conf->mutex,
                                                               &sleep_till);
-                                conf->sleep_count--;
-
                                 if (ret == ETIMEDOUT) {
                                         timeout = 1;
                                         break;
                                 }
                         }
 
-                        if (timeout) {
-                                if (conf->curr_count > IOT_MIN_THREADS) {
-                                        conf->curr_count--;
-                                        bye = 1;
-                                        gf_log (conf->this->name, GF_LOG_DEBUG,
-                                                "timeout, terminated. conf->curr_count=%d",
-                                                conf->curr_count);
-                                } else {
-                                        timeout = 0;
-                                }
+                        list_del_init (&worker->idle);
+                        __atomic_sub_fetch (&conf->sleep_count, 1,
+                                            __ATOMIC_SEQ_CST);
+
+                        if (timeout && !iot_work_available (conf) &&
+                            conf->curr_count > IOT_MIN_THREADS) {
+                                conf->curr_count--;
+                                worker->running = _gf_false;
+                                bye = 1;
+                                gf_log (conf->this->name, GF_LOG_DEBUG,
+                                        "timeout, terminated. conf->curr_count=%d",
+                                        conf->curr_count);
+                        }
+                        timeout = 0;
+
+                        if (!bye && conf->down && !iot_work_available (conf)) {
+                                conf->curr_count--;
+                                worker->running = _gf_false;
+                                bye = 1;
+                                if (!conf->curr_count)
+                                        pthread_cond_broadcast
+                                                (&conf->down_cond);
                         }
-
-                        stub = __iot_dequeue (conf, &pri);
                 }
                 pthread_mutex_unlock (&conf->mutex);
 
-                if (stub) /* guard against spurious wakeups */
-                        call_resume (stub);
-
                 if (bye)
                         break;
         }
 
-        if (pri != -1) {
-                pthread_mutex_lock (&conf->mutex);
-                {
-                        conf->ac_iot_count[pri]--;
-                }
-                pthread_mutex_unlock (&conf->mutex);
-        }
         return NULL;
 }
 
 
+/* Start more workers only when the ones running cannot keep up: the queue
+   is deep compared to how long a request takes to serve */
+static int
+iot_workers_grow (iot_conf_t *conf)
+{
+        uint64_t  fop_nsec = 0;
+        int       queued = 0;
+        int       running = 0;
+
+        running = conf->curr_count;
+        if (running >= conf->max_count)
+                return 0;
+
+        queued = __atomic_load_n (&conf->queue_size, __ATOMIC_RELAXED);
+        fop_nsec = conf->fop_nsec;
+
+        if (fop_nsec &&
+            (queued * fop_nsec < (uint64_t) running * IOT_SCALE_WAIT_NSEC))
+                return 0;
+
+        return iot_workers_scale (conf);
+}
+
+
 int
 do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri)
 {
-        int   ret = 0;
+        iot_worker_t  *worker = NULL;
+        int            ret = 0;
 
-        pthread_mutex_lock (&conf->mutex);
-        {
-                __iot_enqueue (conf, stub, pri);
+        /* a worker queueing more work keeps it for itself */
+        worker = pthread_getspecific (conf->worker_key);
+        if (!worker)
+                worker = iot_worker_pick (conf);
 
-                pthread_cond_signal (&conf->cond);
+        iot_enqueue (conf, worker, stub, pri);
 
-                ret = __iot_workers_scale (conf);
-        }
-        pthread_mutex_unlock (&conf->mutex);
+        if (__atomic_load_n (&conf->sleep_count, __ATOMIC_SEQ_CST))
+                iot_worker_wake (conf);
+        else
+                ret = iot_workers_grow (conf);
 
         return ret;
 }
@@ -255,6 +480,7 @@ iot_schedule (call_frame_t *frame, xlator_t *this, call_stub_t *stub)
         case GF_FOP_RELEASE:
         case GF_FOP_RELEASEDIR:
         case GF_FOP_GETSPEC:
+        case GF_FOP_COMPOUND:
         case GF_FOP_MAXVALUE:
                 //fail compilation on missing fop
                 //new fop must choose priority.
@@ -2350,14 +2576,18 @@ out:
 int
 __iot_workers_scale (iot_conf_t *conf)
 {
+        iot_worker_t *worker = NULL;
         int       scale = 0;
         int       diff = 0;
-        pthread_t thread;
         int       ret = 0;
         int       i = 0;
+        int       slot = 0;
+        pthread_t thread;
 
+        /* what the priority classes would let run at once */
         for (i = 0; i < IOT_PRI_MAX; i++)
-                scale += min (conf->queue_sizes[i], conf->ac_iot_limit[i]);
+                scale += min (conf->queue_sizes[i] + conf->ac_iot_count[i],
+                              conf->ac_iot_limit[i]);
 
         if (scale < IOT_MIN_THREADS)
                 scale = IOT_MIN_THREADS;
@@ -2365,20 +2595,38 @@ __iot_workers_scale (iot_conf_t *conf)
         if (scale > conf->max_count)
                 scale = conf->max_count;
 
+        if (conf->down)
+                return 0;
+
         if (conf->curr_count < scale) {
                 diff = scale - conf->curr_count;
         }
 
         while (diff) {
+                for (; slot < IOT_MAX_THREADS; slot++) {
+                        if (!conf->workers[slot].running)
+                                break;
+                }
+                if (slot == IOT_MAX_THREADS)
+                        break;
+
                 diff --;
 
-                ret = pthread_create (&thread, &conf->w_attr, iot_worker, conf);
+                worker = &conf->workers[slot];
+                worker->running = _gf_true;
+                if (slot >= conf->worker_slots)
+                        __atomic_store_n (&conf->worker_slots, slot + 1,
+                                          __ATOMIC_RELEASE);
+
+                ret = pthread_create (&thread, &conf->w_attr, iot_worker,
+                                      worker);
                 if (ret == 0) {
                         conf->curr_count++;
                         gf_log (conf->this->name, GF_LOG_DEBUG,
                                 "scaled threads to %d (queue_size=%d/%d)",
                                 conf->curr_count, conf->queue_size, scale);
                 } else {
+                        worker->running = _gf_false;
                         break;
                 }
         }
@@ -2408,6 +2656,23 @@ out:
 }
 
 
+void
+iot_worker_init (iot_conf_t *conf, iot_worker_t *worker, int index)
+{
+        int  i = 0;
+
+        pthread_mutex_init (&worker->lock, NULL);
+        pthread_cond_init (&worker->cond, NULL);
+
+        for (i = 0; i < IOT_PRI_MAX; i++)
+                INIT_LIST_HEAD (&worker->reqs[i]);
+
+        INIT_LIST_HEAD (&worker->idle);
+        worker->index = index;
+        worker->conf = conf;
+}
+
+
 void
 set_stack_size (iot_conf_t *conf)
 {
@@ -2484,6 +2749,18 @@ iot_priv_dump (xlator_t *this)
                            conf->ac_iot_limit[IOT_PRI_LO]);
         gf_proc_dump_write("least_priority_threads", "%d",
                            conf->ac_iot_limit[IOT_PRI_LEAST]);
+        gf_proc_dump_write("queue_size", "%d", conf->queue_size);
+        gf_proc_dump_write("high_priority_queued", "%d",
+                           conf->queue_sizes[IOT_PRI_HI]);
+        gf_proc_dump_write("normal_priority_queued", "%d",
+                           conf->queue_sizes[IOT_PRI_NORMAL]);
+        gf_proc_dump_write("low_priority_queued", "%d",
+                           conf->queue_sizes[IOT_PRI_LO]);
+        gf_proc_dump_write("least_priority_queued", "%d",
+                           conf->queue_sizes[IOT_PRI_LEAST]);
+        gf_proc_dump_write("steals", "%"PRIu64, conf->steals);
+        gf_proc_dump_write("average_fop_usec", "%"PRIu64,
+                           conf->fop_nsec / 1000);
 
         return 0;
 }
@@ -2548,9 +2825,9 @@ init (xlator_t *this)
                 goto out;
         }
 
-        if ((ret = pthread_cond_init(&conf->cond, NULL)) != 0) {
+        if ((ret = pthread_key_create (&conf->worker_key, NULL)) != 0) {
                 gf_log (this->name, GF_LOG_ERROR,
-                        "pthread_cond_init failed (%d)", ret);
+                        "pthread_key_create failed (%d)", ret);
                 goto out;
         }
 
@@ -2560,6 +2837,8 @@ init (xlator_t *this)
                 goto out;
         }
 
+        pthread_cond_init (&conf->down_cond, NULL);
+
         set_stack_size (conf);
 
         GF_OPTION_INIT ("thread-count", conf->max_count, int32, out);
@@ -2582,8 +2861,9 @@ init (xlator_t *this)
 
         conf->this = this;
 
-        for (i = 0; i < IOT_PRI_MAX; i++) {
-                INIT_LIST_HEAD (&conf->reqs[i]);
+        INIT_LIST_HEAD (&conf->idle);
+        for (i = 0; i < IOT_MAX_THREADS; i++) {
+                iot_worker_init (conf, &conf->workers[i], i);
         }
 
 	ret = iot_workers_scale (conf);
@@ -2608,7 +2888,36 @@ void
 fini (xlator_t *this)
 {
 	iot_conf_t *conf = this->private;
+        int         i = 0;
+
+        if (!conf)
+                return;
+
+        /* let the workers run what is queued, then wait for them to exit */
+        pthread_mutex_lock (&conf->mutex);
+        {
+                conf->down = _gf_true;
+
+                for (i = 0; i < IOT_MAX_THREADS; i++)
+                        pthread_cond_signal (&conf->workers[i].cond);
+
+                while (conf->curr_count)
+                        pthread_cond_wait (&conf->down_cond, &conf->mutex);
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        pthread_key_delete (conf->worker_key);
+
+        for (i = 0; i < IOT_MAX_THREADS; i++) {
+                pthread_mutex_destroy (&conf->workers[i].lock);
+                pthread_cond_destroy (&conf->workers[i].cond);
+        }
+
+        pthread_cond_destroy (&conf->down_cond);
+        pthread_mutex_destroy (&conf->mutex);
+        pthread_attr_destroy (&conf->w_attr);
 
+        /* the worker array is part of conf */
 	GF_FREE (conf);
 
 	this->private = NULL;
@@ -44,6 +44,10 @@ struct iot_conf;
 
 #define IOT_THREAD_STACK_SIZE   ((size_t)(1024*1024))
 
+/* Another worker is started only when the queued requests would take
+   longer than this to drain with the workers already running */
+#define IOT_SCALE_WAIT_NSEC     (1000 * 1000)
+
 
 typedef enum {
         IOT_PRI_HI = 0, /* low latency */
@@ -54,9 +58,29 @@ typedef enum {
 } iot_pri_t;
 
 
+/* One per worker thread. Requests are queued on a worker, which takes them
+   from the head; idle workers steal from the tail of the others. */
+struct iot_worker {
+        pthread_mutex_t      lock;        /* protects reqs, queue_sizes */
+        pthread_cond_t       cond;        /* waited on under conf->mutex */
+
+        struct list_head     reqs[IOT_PRI_MAX];
+        int32_t              queue_sizes[IOT_PRI_MAX];
+
+        struct list_head     idle;        /* on conf->idle while asleep */
+        gf_boolean_t         wakeup;
+        gf_boolean_t         running;     /* a thread owns this slot */
+        int                  index;
+        struct iot_conf     *conf;
+};
+
+typedef struct iot_worker iot_worker_t;
+
+
 struct iot_conf {
-        pthread_mutex_t      mutex;
-        pthread_cond_t       cond;
+        pthread_mutex_t      mutex;       /* idle list, thread start/exit */
+        pthread_cond_t       down_cond;   /* fini waits for the workers */
+        gf_boolean_t         down;        /* workers are to exit */
 
         int32_t              max_count;   /* configured maximum */
         int32_t              curr_count;  /* actual number of threads running */
@@ -64,7 +88,11 @@ struct iot_conf {
 
         int32_t              idle_time;   /* in seconds */
 
-        struct list_head     reqs[IOT_PRI_MAX];
+        iot_worker_t         workers[IOT_MAX_THREADS];
+        int32_t              worker_slots; /* slots ever used */
+        uint32_t             next_worker;  /* round robin for other threads */
+        struct list_head     idle;
+        pthread_key_t        worker_key;
 
         int32_t              ac_iot_limit[IOT_PRI_MAX];
         int32_t              ac_iot_count[IOT_PRI_MAX];
@@ -73,6 +101,9 @@ struct iot_conf {
         pthread_attr_t       w_attr;
         gf_boolean_t         least_priority; /*Enable/Disable least-priority */
 
+        uint64_t             fop_nsec;    /* moving average service time */
+        uint64_t             steals;
+
         xlator_t            *this;
         size_t              stack_size;
 };
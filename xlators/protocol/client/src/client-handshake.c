@@ -627,6 +627,7 @@ clnt_release_reopen_fd (xlator_t *this, clnt_fd_ctx_t *fdctx)
 
         frame->local = (void *) fdctx;
         req.fd       = fdctx->remote_fd;
+        memcpy (req.gfid, fdctx->gfid, 16);
 
         ret    = client_submit_request (this, &req, frame, conf->fops,
                                         GFS3_OP_RELEASE,
@@ -1278,6 +1279,76 @@ out:
         return 0;
 }
 
+/* SETVOLUME reply on one of the extra channels. The brick has bound it to
+   the connection of channel 0, so there is nothing to reopen or heal, the
+   channel only starts taking fops. */
+int
+client_channel_setvolume_cbk (struct rpc_req *req, struct iovec *iov,
+                              int count, void *myframe)
+{
+        call_frame_t         *frame   = NULL;
+        clnt_conf_t          *conf    = NULL;
+        clnt_channel_t       *channel = NULL;
+        struct rpc_clnt      *rpc     = NULL;
+        xlator_t             *this    = NULL;
+        gf_setvolume_rsp      rsp     = {0,};
+        int                   ret     = -1;
+
+        frame = myframe;
+        this  = frame->this;
+        conf  = this->private;
+        rpc   = frame->cookie;
+
+        if (-1 == req->rpc_status)
+                goto out;
+
+        ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gf_setvolume_rsp);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
+                goto out;
+        }
+
+        ret = rsp.op_ret;
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "SETVOLUME on extra channel failed: %s",
+                        strerror (gf_error_to_errno (rsp.op_errno)));
+                goto out;
+        }
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                channel = client_channel_get (conf, rpc);
+                /* channel 0 went down meanwhile, this one is being shut */
+                if (channel && !conf->channels[0].connected)
+                        channel = NULL;
+                if (channel)
+                        channel->connected = 1;
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        if (!channel) {
+                ret = -1;
+                goto out;
+        }
+
+        rpc_clnt_set_connected (&rpc->conn);
+
+        gf_log (this->name, GF_LOG_INFO, "channel %d connected to %s",
+                channel->index, rpc->conn.trans->peerinfo.identifier);
+
+out:
+        free (rsp.dict.dict_val);
+
+        STACK_DESTROY (frame->root);
+
+        if (ret < 0)
+                rpc_transport_disconnect (rpc->conn.trans);
+
+        return 0;
+}
+
+
 int
 client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *myframe)
 {
@@ -1416,6 +1487,11 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         conf->connecting = 0;
         conf->connected = 1;
 
+        if (conf->channels) {
+                conf->channels[0].connected = 1;
+                client_channels_start (this);
+        }
+
         conf->need_different_port = 0;
 
         if (lk_ver != client_get_lk_ver (conf)) {
@@ -1478,6 +1554,7 @@ client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
         char             *process_uuid_xl = NULL;
         clnt_conf_t      *conf            = NULL;
         dict_t           *options         = NULL;
+        fop_cbk_fn_t      cbkfn           = client_setvolume_cbk;
 
         options = this->options;
         conf    = this->private;
@@ -1575,10 +1652,14 @@ client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
         if (!fr)
                 goto fail;
 
-        ret = client_submit_request (this, &req, fr, conf->handshake,
-                                     GF_HNDSK_SETVOLUME, client_setvolume_cbk,
-                                     NULL, NULL, 0, NULL, 0, NULL,
-                                     (xdrproc_t)xdr_gf_setvolume_req);
+        /* the handshake frames remember which channel they belong to */
+        fr->cookie = rpc;
+        if (rpc != conf->rpc)
+                cbkfn = client_channel_setvolume_cbk;
+
+        ret = client_submit_on (this, rpc, &req, fr, conf->handshake,
+                                GF_HNDSK_SETVOLUME, cbkfn,
+                                (xdrproc_t)xdr_gf_setvolume_req);
 
 fail:
         GF_FREE (req.dict.dict_val);
@@ -1602,7 +1683,16 @@ select_server_supported_programs (xlator_t *this, gf_prog_detail *prog)
         conf = this->private;
         trav = prog;
 
+        conf->compound = _gf_false;
+
         while (trav) {
+                if ((trav->prognum == GLUSTER_FOP_PROGRAM) &&
+                    (trav->progver == GLUSTER_FOP_COMPOUND_VERSION)) {
+                        conf->compound = _gf_true;
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "server takes compound fops");
+                }
+
                 /* Select 'programs' */
                 if ((clnt3_3_fop_prog.prognum == trav->prognum) &&
                     (clnt3_3_fop_prog.progver == trav->progver)) {
@@ -1665,6 +1755,7 @@ client_query_portmap_cbk (struct rpc_req *req, struct iovec *iov, int count, voi
         int                               ret   = -1;
         struct rpc_clnt_config            config = {0, };
         xlator_t                         *this   = NULL;
+        struct rpc_clnt                  *rpc    = NULL;
 
         frame = myframe;
         if (!frame || !frame->this || !frame->this->private) {
@@ -1674,6 +1765,7 @@ client_query_portmap_cbk (struct rpc_req *req, struct iovec *iov, int count, voi
         }
         this  = frame->this;
         conf  = frame->this->private;
+        rpc   = frame->cookie;
 
         if (-1 == req->rpc_status) {
                 gf_log (this->name, GF_LOG_WARNING,
@@ -1699,18 +1791,19 @@ client_query_portmap_cbk (struct rpc_req *req, struct iovec *iov, int count, voi
         conf->portmap_err_logged = 0;
 
         config.remote_port = rsp.port;
-        rpc_clnt_reconfig (conf->rpc, &config);
-        conf->skip_notify = 1;
+        rpc_clnt_reconfig (rpc, &config);
+        if (rpc == conf->rpc)
+                conf->skip_notify = 1;
 
 out:
         if (frame)
                 STACK_DESTROY (frame->root);
 
-        if (conf) {
+        if (rpc) {
                 /* Need this to connect the same transport on different port */
                 /* ie, glusterd to glusterfsd */
-                rpc_transport_disconnect (conf->rpc->conn.trans);
-                rpc_clnt_reconnect (conf->rpc->conn.trans);
+                rpc_transport_disconnect (rpc->conn.trans);
+                rpc_clnt_reconnect (rpc->conn.trans);
         }
 
         return ret;
@@ -1766,11 +1859,10 @@ client_query_portmap (xlator_t *this, struct rpc_clnt *rpc)
                 goto fail;
         }
 
-        ret = client_submit_request (this, &req, fr, &clnt_pmap_prog,
-                                     GF_PMAP_PORTBYBRICK,
-                                     client_query_portmap_cbk,
-                                     NULL, NULL, 0, NULL, 0, NULL,
-                                     (xdrproc_t)xdr_pmap_port_by_brick_req);
+        fr->cookie = rpc;
+        ret = client_submit_on (this, rpc, &req, fr, &clnt_pmap_prog,
+                                GF_PMAP_PORTBYBRICK, client_query_portmap_cbk,
+                                (xdrproc_t)xdr_pmap_port_by_brick_req);
 
 fail:
         return ret;
@@ -1786,10 +1878,12 @@ client_dump_version_cbk (struct rpc_req *req, struct iovec *iov, int count,
         gf_prog_detail *next  = NULL;
         call_frame_t   *frame = NULL;
         clnt_conf_t    *conf  = NULL;
+        struct rpc_clnt *rpc  = NULL;
         int             ret   = 0;
 
         frame = myframe;
         conf  = frame->this->private;
+        rpc   = frame->cookie;
 
         if (-1 == req->rpc_status) {
                 gf_log (frame->this->name, GF_LOG_WARNING,
@@ -1809,7 +1903,7 @@ client_dump_version_cbk (struct rpc_req *req, struct iovec *iov, int count,
         }
 
         if (server_has_portmap (frame->this, rsp.prog) == 0) {
-                ret = client_query_portmap (frame->this, conf->rpc);
+                ret = client_query_portmap (frame->this, rpc);
                 goto out;
         }
 
@@ -1822,7 +1916,7 @@ client_dump_version_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
         }
 
-        client_setvolume (frame->this, conf->rpc);
+        client_setvolume (frame->this, rpc);
 
 out:
         /* don't use GF_FREE, buffer was allocated by libc */
@@ -1839,7 +1933,7 @@ out:
         STACK_DESTROY (frame->root);
 
         if (ret != 0)
-                rpc_transport_disconnect (conf->rpc->conn.trans);
+                rpc_transport_disconnect (rpc->conn.trans);
 
         return ret;
 }
@@ -1862,11 +1956,12 @@ client_handshake (xlator_t *this, struct rpc_clnt *rpc)
         if (!frame)
                 goto out;
 
+        frame->cookie = rpc;
+
         req.gfs_id = 0xbabe;
-        ret = client_submit_request (this, &req, frame, conf->dump,
-                                     GF_DUMP_DUMP, client_dump_version_cbk,
-                                     NULL, NULL, 0, NULL, 0,
-                                     NULL, (xdrproc_t)xdr_gf_dump_req);
+        ret = client_submit_on (this, rpc, &req, frame, conf->dump,
+                                GF_DUMP_DUMP, client_dump_version_cbk,
+                                (xdrproc_t)xdr_gf_dump_req);
 
 out:
         return ret;
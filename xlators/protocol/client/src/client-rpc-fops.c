@@ -32,6 +32,7 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
 {
         int             ret        = 0;
         clnt_conf_t    *conf       = NULL;
+        struct rpc_clnt *rpc       = NULL;
         struct iovec    iov        = {0, };
         struct iobuf   *iobuf      = NULL;
         int             count      = 0;
@@ -87,15 +88,28 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
                 count = 1;
         }
 
+        /* fops wound from a compound are only serialized here, they go
+           out together with the compound */
+        ret = client_compound_capture (this, frame, procnum, cbkfn, &iov,
+                                       payload, payloadcnt, new_iobref);
+        if (ret < 0)
+                goto unwind;
+        if (ret > 0) {
+                ret = 0;
+                goto captured;
+        }
+
+        rpc = client_channel_pick (this, prog, procnum, &iov);
+
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbkfn, &iov, count,
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbkfn, &iov, count,
                                payload, payloadcnt, new_iobref, frame, NULL, 0,
                                NULL, 0, NULL);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_DEBUG, "rpc_clnt_submit failed");
         }
 
-        if (ret == 0) {
+        if ((ret == 0) && (rpc == conf->rpc)) {
                 pthread_mutex_lock (&conf->rpc->conn.lock);
                 {
                         if (!conf->rpc->conn.ping_started) {
@@ -108,6 +122,7 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
         if (start_ping)
                 client_start_ping ((void *) this);
 
+captured:
         if (new_iobref)
                 iobref_unref (new_iobref);
 
@@ -2754,6 +2769,7 @@ client_fdctx_destroy (xlator_t *this, clnt_fd_ctx_t *fdctx)
         if (fdctx->is_dir) {
                 gfs3_releasedir_req  req = {{0,},};
                 req.fd = fdctx->remote_fd;
+                memcpy (req.gfid, fdctx->gfid, 16);
                 gf_log (this->name, GF_LOG_DEBUG, "sending releasedir on fd");
                 client_submit_request (this, &req, fr, &clnt3_3_fop_prog,
                                        GFS3_OP_RELEASEDIR,
@@ -2763,6 +2779,7 @@ client_fdctx_destroy (xlator_t *this, clnt_fd_ctx_t *fdctx)
         } else {
                 gfs3_release_req  req = {{0,},};
                 req.fd = fdctx->remote_fd;
+                memcpy (req.gfid, fdctx->gfid, 16);
                 gf_log (this->name, GF_LOG_DEBUG, "sending release on fd");
                 client_submit_request (this, &req, fr, &clnt3_3_fop_prog,
                                        GFS3_OP_RELEASE,
@@ -5758,6 +5775,307 @@ unwind:
 
 
 
+/* Compound */
+
+static void
+client3_3_compound_free (clnt_compound_t *compound)
+{
+        clnt_compound_op_t *op = NULL;
+        int                 i  = 0;
+
+        for (i = 0; i < compound->count; i++) {
+                op = &compound->ops[i];
+
+                GF_FREE (op->payload);
+                if (op->iobref)
+                        iobref_unref (op->iobref);
+                if (op->reply)
+                        call_stub_destroy (op->reply);
+        }
+
+        GF_FREE (compound);
+}
+
+/* answers the compound with the replies of the fops which ran, up to and
+   including the first one which failed */
+static void
+client3_3_compound_unwind (call_frame_t *frame, int32_t op_ret,
+                           int32_t op_errno)
+{
+        clnt_compound_t    *compound = NULL;
+        clnt_compound_op_t *op       = NULL;
+        struct list_head    replies;
+        int                 i        = 0;
+
+        compound = frame->local;
+        frame->local = NULL;
+
+        INIT_LIST_HEAD (&replies);
+
+        for (i = 0; i < compound->count; i++) {
+                op = &compound->ops[i];
+                if (!op->reply)
+                        break;
+
+                list_add_tail (&op->reply->list, &replies);
+                op->reply = NULL;
+
+                if (op->op_ret < 0) {
+                        op_ret = op->op_ret;
+                        op_errno = op->op_errno;
+                        break;
+                }
+        }
+
+        if (list_empty (&replies) && (op_ret == 0)) {
+                op_ret = -1;
+                op_errno = EIO;
+        }
+
+        STACK_UNWIND_STRICT (compound, frame, op_ret, op_errno, &replies,
+                             NULL);
+
+        compound_replies_destroy (&replies);
+        client3_3_compound_free (compound);
+}
+
+static int
+client3_3_compound_collect (call_frame_t *frame, compound_op_t *cop,
+                            call_stub_t *reply, int32_t op_ret,
+                            int32_t op_errno)
+{
+        clnt_compound_t    *compound = NULL;
+        clnt_compound_op_t *op       = NULL;
+
+        compound = cop->data;
+        op = &compound->ops[cop->index];
+
+        /* sent, but the server never got to it */
+        if (op->captured && !op->executed) {
+                if (reply)
+                        call_stub_destroy (reply);
+                return 0;
+        }
+
+        op->reply = reply;
+        op->op_ret = reply ? op_ret : -1;
+        op->op_errno = reply ? op_errno : ENOMEM;
+
+        return 0;
+}
+
+int
+client3_3_compound_cbk (struct rpc_req *req, struct iovec *iov, int count,
+                        void *myframe)
+{
+        call_frame_t       *frame    = NULL;
+        clnt_compound_t    *compound = NULL;
+        clnt_compound_op_t *op       = NULL;
+        gfs3_compound_rsp   rsp      = {0,};
+        struct rpc_req      subreq   = {0,};
+        struct iovec        subiov   = {0,};
+        xlator_t           *this     = NULL;
+        int                 executed = 0;
+        int                 ret      = 0;
+        int                 i        = 0;
+
+        this = THIS;
+
+        frame = myframe;
+        compound = frame->local;
+
+        if (-1 == req->rpc_status) {
+                rsp.op_ret   = -1;
+                rsp.op_errno = ENOTCONN;
+                goto out;
+        }
+
+        ret = xdr_to_generic (*iov, &rsp, (xdrproc_t)xdr_gfs3_compound_rsp);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR, "XDR decoding failed");
+                rsp.op_ret   = -1;
+                rsp.op_errno = EINVAL;
+                goto out;
+        }
+
+        rsp.op_errno = gf_error_to_errno (rsp.op_errno);
+
+        for (executed = 0; executed < rsp.ops.ops_len; executed++) {
+                if ((executed == compound->captured) ||
+                    (rsp.ops.ops_val[executed].procnum !=
+                     compound->ops[executed].procnum)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "compound reply does not match the call");
+                        rsp.op_ret   = -1;
+                        rsp.op_errno = EINVAL;
+                        break;
+                }
+        }
+
+out:
+        /* hand every fop its own reply, as if it had been sent alone */
+        for (i = 0; i < compound->captured; i++) {
+                op = &compound->ops[i];
+
+                memset (&subreq, 0, sizeof (subreq));
+                subreq.prog = req->prog;
+                subreq.procnum = op->procnum;
+                subreq.rsp_iobref = req->rsp_iobref;
+
+                if (i < executed) {
+                        op->executed = _gf_true;
+
+                        subiov.iov_base = rsp.ops.ops_val[i].rsp.rsp_val;
+                        subiov.iov_len  = rsp.ops.ops_val[i].rsp.rsp_len;
+                        subreq.rsp[0] = subiov;
+                        subreq.rspcnt = 1;
+
+                        op->cbkfn (&subreq, &subiov, 1, op->frame);
+                } else {
+                        subreq.rpc_status = -1;
+                        op->cbkfn (&subreq, NULL, 0, op->frame);
+                }
+        }
+
+        client3_3_compound_unwind (frame, rsp.op_ret, rsp.op_errno);
+
+        for (i = 0; i < rsp.ops.ops_len; i++)
+                free (rsp.ops.ops_val[i].rsp.rsp_val);
+        free (rsp.ops.ops_val);
+        free (rsp.xdata.xdata_val);
+
+        return 0;
+}
+
+static void
+client3_3_compound_send (call_frame_t *frame, xlator_t *this)
+{
+        clnt_conf_t          *conf       = NULL;
+        clnt_compound_t      *compound   = NULL;
+        clnt_compound_op_t   *op         = NULL;
+        gfs3_compound_req     req        = {{0,},};
+        gfs3_compound_req_op  reqops[GF_COMPOUND_MAX_OPS];
+        struct iovec         *payload    = NULL;
+        struct iobref        *iobref     = NULL;
+        struct rpc_req        rpcreq     = {0,};
+        int                   payloadcnt = 0;
+        int                   op_errno   = ENOMEM;
+        int                   i          = 0;
+        int                   j          = 0;
+
+        conf = this->private;
+        compound = frame->local;
+
+        for (i = 0; i < compound->captured; i++)
+                payloadcnt += compound->ops[i].payloadcnt;
+
+        if (payloadcnt) {
+                payload = GF_CALLOC (payloadcnt, sizeof (*payload),
+                                     gf_common_mt_iovec);
+                if (!payload)
+                        goto unwind;
+        }
+
+        iobref = iobref_new ();
+        if (!iobref)
+                goto unwind;
+
+        payloadcnt = 0;
+        for (i = 0; i < compound->captured; i++) {
+                op = &compound->ops[i];
+
+                reqops[i].procnum = op->procnum;
+                reqops[i].args.args_val = op->hdr.iov_base;
+                reqops[i].args.args_len = op->hdr.iov_len;
+                reqops[i].payload_size = op->payload_size;
+
+                for (j = 0; j < op->payloadcnt; j++)
+                        payload[payloadcnt++] = op->payload[j];
+
+                iobref_merge (iobref, op->iobref);
+        }
+
+        /* the xdata of the compound went out with every fop in it */
+        req.ops.ops_val = reqops;
+        req.ops.ops_len = compound->captured;
+
+        /* failures past this point are answered through the cbk */
+        client_submit_vec_request (this, &req, frame, conf->fops,
+                                   GFS3_OP_COMPOUND, client3_3_compound_cbk,
+                                   payload, payloadcnt, iobref,
+                                   (xdrproc_t)xdr_gfs3_compound_req);
+        goto out;
+
+unwind:
+        gf_log (this->name, GF_LOG_WARNING, "failed to send the compound: %s",
+                strerror (op_errno));
+        rpcreq.rpc_status = -1;
+        client3_3_compound_cbk (&rpcreq, NULL, 0, frame);
+out:
+        GF_FREE (payload);
+        if (iobref)
+                iobref_unref (iobref);
+}
+
+int32_t
+client3_3_compound (call_frame_t *frame, xlator_t *this, void *data)
+{
+        clnt_args_t        *args     = NULL;
+        clnt_compound_t    *compound = NULL;
+        clnt_compound_op_t *op       = NULL;
+        call_stub_t        *stub     = NULL;
+        int                 op_errno = EINVAL;
+        struct list_head    replies;
+
+        if (!frame || !this || !data)
+                goto unwind;
+
+        args = data;
+
+        if (compound_stubs_validate (args->stubs) < 0)
+                goto unwind;
+
+        compound = GF_CALLOC (1, sizeof (*compound), gf_client_mt_compound_t);
+        if (!compound) {
+                op_errno = ENOMEM;
+                goto unwind;
+        }
+
+        frame->local = compound;
+        frame->op = GF_FOP_COMPOUND;
+
+        /* Every fop is wound to ourselves; client_compound_capture() keeps
+           the serialized call instead of sending it.  A fop which fails
+           before reaching the wire ends the compound there. */
+        compound->building = _gf_true;
+        list_for_each_entry (stub, args->stubs, list) {
+                op = &compound->ops[compound->count];
+                op->op.collect = client3_3_compound_collect;
+                op->op.data = compound;
+                op->op.index = compound->count++;
+
+                compound_stub_wind (frame, this, stub, args->xdata, &op->op);
+                if (!op->captured)
+                        break;
+        }
+        compound->building = _gf_false;
+
+        if (!compound->captured) {
+                client3_3_compound_unwind (frame, 0, 0);
+                return 0;
+        }
+
+        client3_3_compound_send (frame, this);
+
+        return 0;
+unwind:
+        INIT_LIST_HEAD (&replies);
+        STACK_UNWIND_STRICT (compound, frame, -1, op_errno, &replies, NULL);
+
+        return 0;
+}
+
+
 /* Table Specific to FOPS */
 
 
@@ -5807,6 +6125,7 @@ rpc_clnt_procedure_t clnt3_3_fop_actors[GF_FOP_MAXVALUE] = {
         [GF_FOP_RELEASEDIR]  = { "RELEASEDIR",  client3_3_releasedir },
         [GF_FOP_GETSPEC]     = { "GETSPEC",     client3_getspec },
         [GF_FOP_FREMOVEXATTR] = { "FREMOVEXATTR", client3_3_fremovexattr },
+        [GF_FOP_COMPOUND]    = { "COMPOUND",    client3_3_compound },
 };
 
 /* Used From RPC-CLNT library to log proper name of procedure based on number */
@@ -5855,6 +6174,7 @@ char *clnt3_3_fop_names[GFS3_OP_MAXVALUE] = {
         [GFS3_OP_RELEASE]     = "RELEASE",
         [GFS3_OP_RELEASEDIR]  = "RELEASEDIR",
         [GFS3_OP_FREMOVEXATTR] = "FREMOVEXATTR",
+        [GFS3_OP_COMPOUND]    = "COMPOUND",
 };
 
 rpc_clnt_prog_t clnt3_3_fop_prog = {
@@ -5864,4 +6184,5 @@ rpc_clnt_prog_t clnt3_3_fop_prog = {
         .numproc   = GLUSTER_FOP_PROCCNT,
         .proctable = clnt3_3_fop_actors,
         .procnames = clnt3_3_fop_names,
+        .flow_controlled = _gf_true,
 };
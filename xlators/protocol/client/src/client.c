@@ -20,6 +20,8 @@
 #include "glusterfs.h"
 #include "statedump.h"
 #include "compat-errno.h"
+#include "byte-order.h"
+#include "hashfn.h"
 
 #include "glusterfs3.h"
 
@@ -142,13 +144,172 @@ out:
         return ret;
 }
 
-int
-client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
-                       rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbkfn,
-                       struct iobref *iobref,  struct iovec *rsphdr,
-                       int rsphdr_count, struct iovec *rsp_payload,
-                       int rsp_payload_count, struct iobref *rsp_iobref,
-                       xdrproc_t xdrproc)
+/* Finds the gfid a fop works on in its serialized request. Every fop
+   request starts with that gfid, except for the ones handled here. */
+static int
+client_channel_key (clnt_conf_t *conf, int procnum, char *buf, size_t len,
+                    uuid_t gfid)
+{
+        clnt_fd_ctx_t *fdctx     = NULL;
+        int64_t        remote_fd = 0;
+        uint32_t       inner     = 0;
+
+        switch (procnum) {
+        case GFS3_OP_COMPOUND:
+                /* ops count, then procnum and args length of the first op;
+                   the whole compound goes where its first fop would */
+                if (len < 12)
+                        return -1;
+                memcpy (&inner, buf + 4, sizeof (inner));
+                return client_channel_key (conf, ntoh32 (inner), buf + 12,
+                                           len - 12, gfid);
+
+        case GFS3_OP_FSETATTR:
+        case GFS3_OP_RCHECKSUM:
+                /* these only carry the remote fd */
+                if (len < sizeof (remote_fd))
+                        return -1;
+                memcpy (&remote_fd, buf, sizeof (remote_fd));
+                remote_fd = ntoh64 (remote_fd);
+
+                pthread_mutex_lock (&conf->lock);
+                {
+                        list_for_each_entry (fdctx, &conf->saved_fds,
+                                             sfd_pos) {
+                                if (fdctx->remote_fd != remote_fd)
+                                        continue;
+                                uuid_copy (gfid, fdctx->gfid);
+                                break;
+                        }
+                }
+                pthread_mutex_unlock (&conf->lock);
+                return 0;
+
+        case GFS3_OP_LOOKUP:
+                /* named lookups go by the parent */
+                if ((len >= 32) && uuid_is_null ((unsigned char *)buf)) {
+                        memcpy (gfid, buf + 16, 16);
+                        return 0;
+                }
+                break;
+        }
+
+        if (len < 16)
+                return -1;
+
+        memcpy (gfid, buf, 16);
+        return 0;
+}
+
+
+static int
+client_is_lock_proc (int procnum)
+{
+        return ((procnum == GFS3_OP_LK) ||
+                (procnum == GFS3_OP_INODELK) ||
+                (procnum == GFS3_OP_FINODELK) ||
+                (procnum == GFS3_OP_ENTRYLK) ||
+                (procnum == GFS3_OP_FENTRYLK));
+}
+
+/* Lock fops (and so their unlocks) stay on channel 0: the brick only drops
+   a client's locks when all of its channels are gone, so a lock granted on
+   an extra channel that then disconnects would be orphaned. A compound
+   goes there as soon as one of its fops is a lock. */
+static int
+client_channel_pinned (int procnum, char *buf, size_t len)
+{
+        uint32_t count  = 0;
+        uint32_t inner  = 0;
+        uint32_t arglen = 0;
+        size_t   off    = 0;
+
+        if (procnum != GFS3_OP_COMPOUND)
+                return client_is_lock_proc (procnum);
+
+        if (len < 4)
+                return 1;
+        memcpy (&count, buf, sizeof (count));
+        count = ntoh32 (count);
+        off = 4;
+
+        while (count--) {
+                if (len - off < 8)
+                        return 1;
+                memcpy (&inner, buf + off, sizeof (inner));
+                memcpy (&arglen, buf + off + 4, sizeof (arglen));
+                if (client_is_lock_proc (ntoh32 (inner)))
+                        return 1;
+                /* args, padded, then payload_size */
+                arglen = ((ntoh32 (arglen) + 3) & ~3) + 4;
+                off += 8;
+                if (len - off < arglen)
+                        return 1;
+                off += arglen;
+        }
+
+        return 0;
+}
+
+
+clnt_channel_t *
+client_channel_get (clnt_conf_t *conf, struct rpc_clnt *rpc)
+{
+        int i = 0;
+
+        for (i = 0; i < conf->channel_count; i++) {
+                if (conf->channels[i].rpc == rpc)
+                        return &conf->channels[i];
+        }
+
+        return NULL;
+}
+
+
+/* Picks the connection a request goes out on. Fops are spread over the
+   channels by the gfid they work on, so that all fops on one file take the
+   same socket and reach the brick in the order they were wound. Lock fops,
+   anything else, and fops whose channel is down, use channel 0. */
+struct rpc_clnt *
+client_channel_pick (xlator_t *this, rpc_clnt_prog_t *prog, int procnum,
+                     struct iovec *hdr)
+{
+        clnt_conf_t    *conf    = NULL;
+        clnt_channel_t *channel = NULL;
+        uuid_t          gfid    = {0, };
+        uint32_t        hash    = 0;
+
+        conf = this->private;
+
+        if ((conf->channel_count < 2) || (prog != conf->fops) ||
+            !hdr->iov_base)
+                return conf->rpc;
+
+        if (client_channel_pinned (procnum, hdr->iov_base, hdr->iov_len)) {
+                channel = &conf->channels[0];
+        } else {
+                if (client_channel_key (conf, procnum, hdr->iov_base,
+                                        hdr->iov_len, gfid) == 0)
+                        hash = SuperFastHash ((char *)gfid, sizeof (gfid));
+
+                channel = &conf->channels[hash % conf->channel_count];
+                if (!channel->connected)
+                        channel = &conf->channels[0];
+        }
+
+        __atomic_add_fetch (&channel->submitted, 1, __ATOMIC_RELAXED);
+
+        return channel->rpc;
+}
+
+
+static int
+client_submit_rpc (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                   call_frame_t *frame, rpc_clnt_prog_t *prog, int procnum,
+                   fop_cbk_fn_t cbkfn, struct iobref *iobref,
+                   struct iovec *rsphdr, int rsphdr_count,
+                   struct iovec *rsp_payload, int rsp_payload_count,
+                   struct iobref *rsp_iobref, xdrproc_t xdrproc)
 {
         int             ret        = -1;
         clnt_conf_t    *conf       = NULL;
@@ -225,8 +386,20 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                 count = 1;
         }
 
+        /* fops wound from a compound are only serialized here, they go
+           out together with the compound */
+        ret = client_compound_capture (this, frame, procnum, cbkfn, &iov,
+                                       NULL, 0, new_iobref);
+        if (ret < 0)
+                goto out;
+        if (ret > 0)
+                goto captured;
+
+        if (!rpc)
+                rpc = client_channel_pick (this, prog, procnum, &iov);
+
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbkfn, &iov, count,
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbkfn, &iov, count,
                                NULL, 0, new_iobref, frame, rsphdr, rsphdr_count,
                                rsp_payload, rsp_payload_count, rsp_iobref);
 
@@ -234,7 +407,7 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                 gf_log (this->name, GF_LOG_DEBUG, "rpc_clnt_submit failed");
         }
 
-        if (ret == 0) {
+        if ((ret == 0) && (rpc == conf->rpc)) {
                 pthread_mutex_lock (&conf->rpc->conn.lock);
                 {
                         if (!conf->rpc->conn.ping_started) {
@@ -247,6 +420,7 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
         if (start_ping)
                 client_start_ping ((void *) this);
 
+captured:
         ret = 0;
 
         if (new_iobref)
@@ -272,6 +446,80 @@ out:
 }
 
 
+int
+client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
+                       rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbkfn,
+                       struct iobref *iobref,  struct iovec *rsphdr,
+                       int rsphdr_count, struct iovec *rsp_payload,
+                       int rsp_payload_count, struct iobref *rsp_iobref,
+                       xdrproc_t xdrproc)
+{
+        return client_submit_rpc (this, NULL, req, frame, prog, procnum, cbkfn,
+                                  iobref, rsphdr, rsphdr_count, rsp_payload,
+                                  rsp_payload_count, rsp_iobref, xdrproc);
+}
+
+
+/* Sends a handshake request on the given channel */
+int
+client_submit_on (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                  call_frame_t *frame, rpc_clnt_prog_t *prog, int procnum,
+                  fop_cbk_fn_t cbkfn, xdrproc_t xdrproc)
+{
+        return client_submit_rpc (this, rpc, req, frame, prog, procnum, cbkfn,
+                                  NULL, NULL, 0, NULL, 0, NULL, xdrproc);
+}
+
+
+/* Returns 1 when @frame is a fop wound by client3_3_compound (), after
+   keeping the serialized call in the compound, 0 when the call is to be
+   sent as usual and -1 on failure. */
+int
+client_compound_capture (xlator_t *this, call_frame_t *frame, int procnum,
+                         fop_cbk_fn_t cbkfn, struct iovec *hdr,
+                         struct iovec *payload, int payloadcnt,
+                         struct iobref *iobref)
+{
+        clnt_compound_t    *compound = NULL;
+        clnt_compound_op_t *op       = NULL;
+        int                 i        = 0;
+
+        if (!frame->parent || (frame->parent->this != this) ||
+            (frame->parent->op != GF_FOP_COMPOUND))
+                return 0;
+
+        compound = frame->parent->local;
+        if (!compound || !compound->building)
+                return 0;
+
+        op = &compound->ops[compound->count - 1];
+
+        if (payloadcnt) {
+                op->payload = GF_CALLOC (payloadcnt, sizeof (*payload),
+                                         gf_common_mt_iovec);
+                if (!op->payload)
+                        return -1;
+
+                for (i = 0; i < payloadcnt; i++) {
+                        op->payload[i] = payload[i];
+                        op->payload_size += payload[i].iov_len;
+                }
+                op->payloadcnt = payloadcnt;
+        }
+
+        op->procnum = procnum;
+        op->cbkfn   = cbkfn;
+        op->frame   = frame;
+        op->hdr     = *hdr;
+        op->iobref  = iobref_ref (iobref);
+        op->captured = _gf_true;
+
+        compound->captured++;
+
+        return 1;
+}
+
+
 int32_t
 client_forget (xlator_t *this, inode_t *inode)
 {
@@ -1990,6 +2238,50 @@ out:
 }
 
 
+int32_t
+client_compound (call_frame_t *frame, xlator_t *this,
+                 struct list_head *stubs, dict_t *xdata)
+{
+        int          ret  = -1;
+        clnt_conf_t *conf = NULL;
+        rpc_clnt_procedure_t *proc = NULL;
+        clnt_args_t  args = {0,};
+        struct list_head replies;
+
+        conf = this->private;
+        if (!conf || !conf->fops)
+                goto out;
+
+        /* an older brick would fail the whole compound, send the fops
+           one by one instead */
+        if (!conf->compound) {
+                compound_fop_serial (frame, this, stubs, xdata);
+                return 0;
+        }
+
+        args.stubs = stubs;
+        args.xdata = xdata;
+
+        proc = &conf->fops->proctable[GF_FOP_COMPOUND];
+        if (!proc) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "rpc procedure not found for %s",
+                        gf_fop_list[GF_FOP_COMPOUND]);
+                goto out;
+        }
+        if (proc->fn)
+                ret = proc->fn (frame, this, &args);
+out:
+        if (ret) {
+                INIT_LIST_HEAD (&replies);
+                STACK_UNWIND_STRICT (compound, frame, -1, ENOTCONN, &replies,
+                                     NULL);
+        }
+
+	return 0;
+}
+
+
 int
 client_mark_fd_bad (xlator_t *this)
 {
@@ -2078,6 +2370,8 @@ client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
                 break;
         }
         case RPC_CLNT_DISCONNECT:
+                client_channels_stop (this);
+
                 if (!conf->lk_heal)
                         client_mark_fd_bad (this);
                 else
@@ -2124,6 +2418,98 @@ out:
 }
 
 
+/* Event handler of the extra channels; they go through the same DUMP,
+   portmap and SETVOLUME handshake as channel 0 but never notify the
+   parents. */
+int
+client_channel_notify (struct rpc_clnt *rpc, void *mydata,
+                       rpc_clnt_event_t event, void *data)
+{
+        clnt_channel_t *channel   = NULL;
+        xlator_t       *this      = NULL;
+        char           *handshake = NULL;
+        int             ret       = 0;
+
+        channel = mydata;
+        this    = channel->this;
+
+        switch (event) {
+        case RPC_CLNT_CONNECT:
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "got RPC_CLNT_CONNECT on channel %d", channel->index);
+
+                ret = dict_get_str (this->options, "disable-handshake",
+                                    &handshake);
+                if ((ret < 0) || (strcasecmp (handshake, "on"))) {
+                        ret = client_handshake (this, rpc);
+                        if (ret)
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "handshake msg on channel %d "
+                                        "returned %d", channel->index, ret);
+                } else {
+                        channel->connected = 1;
+                }
+                break;
+
+        case RPC_CLNT_DISCONNECT:
+                if (channel->connected)
+                        gf_log (this->name, GF_LOG_INFO,
+                                "channel %d disconnected", channel->index);
+                channel->connected = 0;
+                break;
+
+        default:
+                gf_log (this->name, GF_LOG_TRACE,
+                        "got some other RPC event %d", event);
+                break;
+        }
+
+        return 0;
+}
+
+
+/* Called once channel 0 is attached to the brick, the other channels
+   follow it. */
+void
+client_channels_start (xlator_t *this)
+{
+        clnt_conf_t *conf = NULL;
+        int          i    = 0;
+
+        conf = this->private;
+
+        for (i = 1; i < conf->channel_count; i++) {
+                rpc_clnt_enable (conf->channels[i].rpc);
+                rpc_clnt_start (conf->channels[i].rpc);
+        }
+}
+
+
+/* Takes the extra channels down with channel 0, so that the brick drops
+   the connection state together with the last of them and a reconnect
+   starts from a clean slate. */
+void
+client_channels_stop (xlator_t *this)
+{
+        clnt_conf_t *conf = NULL;
+        int          i    = 0;
+
+        conf = this->private;
+        if (!conf->channels)
+                return;
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                for (i = 0; i < conf->channel_count; i++)
+                        conf->channels[i].connected = 0;
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        for (i = 1; i < conf->channel_count; i++)
+                rpc_clnt_disable (conf->channels[i].rpc);
+}
+
+
 int
 notify (xlator_t *this, int32_t event, void *data, ...)
 {
@@ -2156,6 +2542,7 @@ notify (xlator_t *this, int32_t event, void *data, ...)
                 pthread_mutex_unlock (&conf->lock);
 
                 rpc_clnt_disable (conf->rpc);
+                client_channels_stop (this);
                 break;
 
         default:
@@ -2187,6 +2574,13 @@ build_client_config (xlator_t *this, clnt_conf_t *conf)
         GF_OPTION_INIT ("ping-timeout", conf->opt.ping_timeout,
                         int32, out);
 
+        GF_OPTION_INIT ("channels", conf->opt.channels, int32, out);
+
+        GF_OPTION_INIT ("flow-control", conf->opt.flow_control, bool, out);
+
+        iobuf_pool_reconfigure (this->ctx->iobuf_pool, this->options,
+                                this->name);
+
         GF_OPTION_INIT ("remote-subvolume", conf->opt.remote_subvolume,
                         path, out);
         if (!conf->opt.remote_subvolume)
@@ -2218,6 +2612,94 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+static void
+client_destroy_channels (clnt_conf_t *conf)
+{
+        int i = 0;
+
+        if (!conf->channels)
+                return;
+
+        for (i = 1; i < conf->channel_count; i++) {
+                if (!conf->channels[i].rpc)
+                        continue;
+                rpc_clnt_disable (conf->channels[i].rpc);
+                rpc_clnt_connection_cleanup (&conf->channels[i].rpc->conn);
+                rpc_clnt_unref (conf->channels[i].rpc);
+        }
+
+        conf->channel_count = 0;
+        GF_FREE (conf->channels);
+        conf->channels = NULL;
+}
+
+
+static int
+client_init_channels (xlator_t *this)
+{
+        clnt_conf_t    *conf    = NULL;
+        clnt_channel_t *channel = NULL;
+        char           *xprt    = NULL;
+        int             count   = 0;
+        int             ret     = -1;
+        int             i       = 0;
+
+        conf  = this->private;
+        count = (conf->opt.channels > 1) ? conf->opt.channels : 1;
+
+        if ((count > 1) &&
+            !dict_get_str (this->options, "transport-type", &xprt) &&
+            !strcmp (xprt, "rdma")) {
+                gf_log (this->name, GF_LOG_WARNING, "channels are not "
+                        "supported over rdma, using a single connection");
+                count = 1;
+        }
+
+        /* with lk-heal the brick drops the locks of the client as soon as
+           any of its connections goes away */
+        if ((count > 1) && conf->lk_heal) {
+                gf_log (this->name, GF_LOG_WARNING, "channels can not be "
+                        "used with lk-heal, using a single connection");
+                count = 1;
+        }
+
+        conf->channels = GF_CALLOC (count, sizeof (*conf->channels),
+                                    gf_client_mt_clnt_channel_t);
+        if (!conf->channels)
+                goto out;
+
+        for (i = 0; i < count; i++) {
+                channel = &conf->channels[i];
+                channel->this  = this;
+                channel->index = i;
+                if (i == 0) {
+                        channel->rpc = conf->rpc;
+                        continue;
+                }
+
+                channel->rpc = rpc_clnt_new (this->options, this->ctx,
+                                             this->name, 0);
+                if (!channel->rpc) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "failed to initialize RPC of channel %d", i);
+                        goto out;
+                }
+                conf->channel_count = i + 1;
+
+                rpc_clnt_register_notify (channel->rpc, client_channel_notify,
+                                          channel);
+        }
+
+        conf->channel_count = count;
+        ret = 0;
+out:
+        if (ret)
+                client_destroy_channels (conf);
+
+        return ret;
+}
+
+
 int
 client_destroy_rpc (xlator_t *this)
 {
@@ -2229,6 +2711,8 @@ client_destroy_rpc (xlator_t *this)
                 goto out;
 
         if (conf->rpc) {
+                client_destroy_channels (conf);
+
                 /* cleanup the saved-frames before last unref */
                 rpc_clnt_connection_cleanup (&conf->rpc->conn);
 
@@ -2247,6 +2731,19 @@ out:
         return ret;
 }
 
+static void
+client_set_flow_control (clnt_conf_t *conf)
+{
+        int i = 0;
+
+        rpc_clnt_set_flow_control (conf->rpc, conf->opt.flow_control);
+
+        for (i = 1; i < conf->channel_count; i++)
+                rpc_clnt_set_flow_control (conf->channels[i].rpc,
+                                           conf->opt.flow_control);
+}
+
+
 int
 client_init_rpc (xlator_t *this)
 {
@@ -2285,7 +2782,14 @@ client_init_rpc (xlator_t *this)
                 goto out;
         }
 
-        ret = 0;
+        ret = client_init_channels (this);
+        if (ret) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to initialize channels");
+                goto out;
+        }
+
+        client_set_flow_control (conf);
 
         gf_log (this->name, GF_LOG_DEBUG, "client init successful");
 out:
@@ -2330,6 +2834,27 @@ out:
         return ret;
 }
 
+/* transport options such as coalesce-usec apply to the connections up */
+static void
+client_reconfigure_transports (xlator_t *this, dict_t *options)
+{
+        clnt_conf_t     *conf  = NULL;
+        rpc_transport_t *trans = NULL;
+        int              i     = 0;
+
+        conf = this->private;
+
+        for (i = 0; i < conf->channel_count; i++) {
+                if (!conf->channels[i].rpc)
+                        continue;
+
+                trans = conf->channels[i].rpc->conn.trans;
+                if (trans && trans->reconfigure)
+                        trans->reconfigure (trans, options);
+        }
+}
+
+
 int
 reconfigure (xlator_t *this, dict_t *options)
 {
@@ -2349,6 +2874,13 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_OPTION_RECONF ("ping-timeout", conf->opt.ping_timeout,
                           options, int32, out);
 
+        iobuf_pool_reconfigure (this->ctx->iobuf_pool, options,
+                                this->name);
+
+        GF_OPTION_RECONF ("flow-control", conf->opt.flow_control,
+                          options, bool, out);
+        client_set_flow_control (conf);
+
         subvol_ret = dict_get_str (this->options, "remote-host",
                                    &old_remote_host);
 
@@ -2377,6 +2909,8 @@ reconfigure (xlator_t *this, dict_t *options)
                 }
         }
 
+        client_reconfigure_transports (this, options);
+
         ret = client_init_grace_timer (this, options, conf);
         if (ret)
                 goto out;
@@ -2468,6 +3002,8 @@ fini (xlator_t *this)
         this->private = NULL;
 
         if (conf) {
+                client_destroy_channels (conf);
+
                 if (conf->rpc) {
                         /* cleanup the saved-frames before last unref */
                         rpc_clnt_connection_cleanup (&conf->rpc->conn);
@@ -2574,6 +3110,51 @@ client_priv_dump (xlator_t *this)
 
                 gf_proc_dump_write("total_bytes_written", "%"PRIu64,
                                    conf->rpc->conn.trans->total_bytes_write);
+
+                gf_proc_dump_write("total_msgs_written", "%"PRIu64,
+                                   conf->rpc->conn.trans->total_msgs_write);
+
+                gf_proc_dump_write("total_writev_calls", "%"PRIu64,
+                                   conf->rpc->conn.trans->total_writev_calls);
+
+                gf_proc_dump_write("flow_credits", "%u",
+                                   conf->rpc->conn.credits);
+
+                gf_proc_dump_write("flow_held", "%u",
+                                   conf->rpc->conn.held_count);
+
+                gf_proc_dump_write("total_spin_hits", "%"PRIu64,
+                                   conf->rpc->conn.trans->total_spin_hits);
+
+                gf_proc_dump_write("total_spin_misses", "%"PRIu64,
+                                   conf->rpc->conn.trans->total_spin_misses);
+        }
+
+        for (i = 0; (conf->channel_count > 1) && (i < conf->channel_count);
+             i++) {
+                rpc_transport_t *trans = conf->channels[i].rpc->conn.trans;
+
+                sprintf (key, "channel.%d.connected", i);
+                gf_proc_dump_write (key, "%d", conf->channels[i].connected);
+                sprintf (key, "channel.%d.fops_sent", i);
+                gf_proc_dump_write (key, "%"PRIu64,
+                                    conf->channels[i].submitted);
+                sprintf (key, "channel.%d.bytes_read", i);
+                gf_proc_dump_write (key, "%"PRIu64, trans->total_bytes_read);
+                sprintf (key, "channel.%d.bytes_written", i);
+                gf_proc_dump_write (key, "%"PRIu64, trans->total_bytes_write);
+                sprintf (key, "channel.%d.msgs_written", i);
+                gf_proc_dump_write (key, "%"PRIu64, trans->total_msgs_write);
+                sprintf (key, "channel.%d.flow_credits", i);
+                gf_proc_dump_write (key, "%u",
+                                    conf->channels[i].rpc->conn.credits);
+                sprintf (key, "channel.%d.flow_held", i);
+                gf_proc_dump_write (key, "%u",
+                                    conf->channels[i].rpc->conn.held_count);
+                sprintf (key, "channel.%d.spin_hits", i);
+                gf_proc_dump_write (key, "%"PRIu64, trans->total_spin_hits);
+                sprintf (key, "channel.%d.spin_misses", i);
+                gf_proc_dump_write (key, "%"PRIu64, trans->total_spin_misses);
         }
         pthread_mutex_unlock(&conf->lock);
 
@@ -2647,6 +3228,7 @@ struct xlator_fops fops = {
         .setattr     = client_setattr,
         .fsetattr    = client_fsetattr,
         .getspec     = client_getspec,
+        .compound    = client_compound,
 };
 
 
@@ -2665,7 +3247,7 @@ struct volume_options options[] = {
         },
         { .key   = {"transport-type"},
           .value = {"tcp", "socket", "ib-verbs", "unix", "ib-sdp",
-                    "tcp/client", "ib-verbs/client", "rdma"},
+                    "tcp/client", "ib-verbs/client", "rdma", "shm"},
           .type  = GF_OPTION_TYPE_STR
         },
         { .key   = {"remote-host"},
@@ -2712,5 +3294,43 @@ struct volume_options options[] = {
          .min  = GF_MIN_SOCKET_WINDOW_SIZE,
          .max  = GF_MAX_SOCKET_WINDOW_SIZE
         },
+        { .key   = {"channels"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 1,
+          .max   = CLIENT_MAX_CHANNELS,
+          .default_value = "1",
+          .description = "Number of TCP connections opened to the brick. "
+                         "Fops are spread over them by the file they work "
+                         "on, so that fops on one file stay in order."
+        },
+        { .key   = {"flow-control"},
+          .type  = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Ask the brick for a window of fops it is ready to "
+                         "take, and hold fops back locally while it is full "
+                         "instead of queueing them on the brick."
+        },
+        { .key   = {"shm-local"},
+          .type  = GF_OPTION_TYPE_BOOL,
+          .default_value = "on",
+          .description = "Connect the self-heal daemon and NFS server to the "
+                         "bricks on their own host over shared memory "
+                         "instead of loopback TCP. Read by glusterd when it "
+                         "generates the volfiles; bricks need a restart to "
+                         "start listening for it. Not used while auth.allow "
+                         "or auth.reject is set."
+        },
+        { .key   = {"iobuf-page-sizes"},
+          .type  = GF_OPTION_TYPE_STR,
+          .description = "Comma separated list of <page-size>[:<pages>] "
+                         "entries setting the iobuf size classes of the "
+                         "process, e.g. \"4KB:256,128KB:32,1MB:8\"."
+        },
+        { .key   = {"iobuf-hugepages"},
+          .type  = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Back the iobuf arenas of 2MB and more by huge "
+                         "pages."
+        },
         { .key   = {NULL} },
 };
@@ -21,6 +21,7 @@
 #include "protocol-common.h"
 #include "glusterfs3.h"
 #include "fd-lk.h"
+#include "compound-fop.h"
 
 /* FIXME: Needs to be defined in a common file */
 #define CLIENT_CMD_CONNECT    "trusted.glusterfs.client-connect"
@@ -64,9 +65,26 @@ typedef enum {
         } while (0)
 
 
+#define CLIENT_MAX_CHANNELS 16
+
+/* One TCP connection to the brick. With "channels" above 1 the client keeps
+   several of them; channel 0 is conf->rpc and carries the handshake, ping,
+   fd reopen and lock heal, the others only carry fops. All of them present
+   the same process-uuid, so the brick binds them to one server connection
+   and fds and locks are shared. */
+typedef struct clnt_channel {
+        xlator_t              *this;
+        struct rpc_clnt       *rpc;
+        int                    index;
+        int                    connected; /* SETVOLUME done on this channel */
+        uint64_t               submitted; /* fops sent on this channel */
+} clnt_channel_t;
+
 struct clnt_options {
         char *remote_subvolume;
         int   ping_timeout;
+        int   channels;
+        gf_boolean_t flow_control;
 };
 
 typedef struct clnt_conf {
@@ -82,6 +100,8 @@ typedef struct clnt_conf {
         rpc_clnt_prog_t       *mgmt;
         rpc_clnt_prog_t       *handshake;
         rpc_clnt_prog_t       *dump;
+        gf_boolean_t           compound; /* the brick takes compound fops,
+                                            set from its DUMP reply */
 
         uint64_t               reopen_fd_count; /* Count of fds reopened after a
                                                    connection is established */
@@ -109,6 +129,8 @@ typedef struct clnt_conf {
                                                       means dont register, true
                                                       means register */
         char                   parent_down;
+        int32_t                channel_count;
+        clnt_channel_t        *channels;
 } clnt_conf_t;
 
 typedef struct _client_fd_ctx {
@@ -185,8 +207,35 @@ typedef struct client_args {
 
         mode_t              umask;
         dict_t             *xdata;
+        struct list_head   *stubs;
 } clnt_args_t;
 
+/* one fop of a compound, serialized but not sent on its own */
+typedef struct client_compound_op {
+        compound_op_t        op;
+        gf_boolean_t         captured;
+        gf_boolean_t         executed;
+        int                  procnum;
+        fop_cbk_fn_t         cbkfn;
+        call_frame_t        *frame;
+        struct iovec         hdr;
+        struct iovec        *payload;
+        int                  payloadcnt;
+        size_t               payload_size;
+        struct iobref       *iobref;
+
+        call_stub_t         *reply;
+        int32_t              op_ret;
+        int32_t              op_errno;
+} clnt_compound_op_t;
+
+typedef struct client_compound {
+        gf_boolean_t         building;
+        int                  count;
+        int                  captured;
+        clnt_compound_op_t   ops[GF_COMPOUND_MAX_OPS];
+} clnt_compound_t;
+
 typedef ssize_t (*gfs_serialize_t) (struct iovec outmsg, void *args);
 
 clnt_fd_ctx_t *this_fd_get_ctx (fd_t *file, xlator_t *this);
@@ -203,6 +252,20 @@ int client_submit_request (xlator_t *this, void *req,
                            struct iovec *rsp_payload, int rsp_count,
                            struct iobref *rsp_iobref, xdrproc_t xdrproc);
 
+int client_submit_on (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                      call_frame_t *frame, rpc_clnt_prog_t *prog,
+                      int procnum, fop_cbk_fn_t cbk, xdrproc_t xdrproc);
+struct rpc_clnt *client_channel_pick (xlator_t *this, rpc_clnt_prog_t *prog,
+                                      int procnum, struct iovec *hdr);
+clnt_channel_t *client_channel_get (clnt_conf_t *conf, struct rpc_clnt *rpc);
+void client_channels_start (xlator_t *this);
+void client_channels_stop (xlator_t *this);
+
+int client_compound_capture (xlator_t *this, call_frame_t *frame,
+                             int procnum, fop_cbk_fn_t cbkfn,
+                             struct iovec *hdr, struct iovec *payload,
+                             int payloadcnt, struct iobref *iobref);
+
 int protocol_client_reopendir (xlator_t *this, clnt_fd_ctx_t *fdctx);
 int protocol_client_reopen (xlator_t *this, clnt_fd_ctx_t *fdctx);
 
@@ -2915,7 +2915,8 @@ server3_3_stat (rpcsvc_request_t *req)
 
         /* Initialize args first, then decode */
 
-        if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_stat_req)) {
+        if (!xdr_to_generic (req->msg[0], &args,
+                             (xdrproc_t)xdr_gfs3_stat_req_inplace)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
                 goto out;
@@ -2949,8 +2950,6 @@ server3_3_stat (rpcsvc_request_t *req)
         resolve_and_resume (frame, server_stat_resume);
 
 out:
-        free (args.xdata.xdata_val);
-
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
@@ -3263,7 +3262,8 @@ server3_3_readv (rpcsvc_request_t *req)
         if (!req)
                 goto out;
 
-        if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_read_req)) {
+        if (!xdr_to_generic (req->msg[0], &args,
+                             (xdrproc_t)xdr_gfs3_read_req_inplace)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
                 goto out;
@@ -3277,6 +3277,11 @@ server3_3_readv (rpcsvc_request_t *req)
         }
         frame->root->op = GF_FOP_READ;
 
+        /* let the storage hand back pipe-backed iobufs when this
+           connection can send them as they are */
+        if (req->trans->pipe_payload)
+                frame->root->flags |= GF_STACK_PIPE_PAYLOAD;
+
         state = CALL_STATE (frame);
         if (!state->conn->bound_xl) {
                 /* auth failure, request on subvolume without setvolume */
@@ -3300,9 +3305,6 @@ server3_3_readv (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_readv_resume);
 out:
-        /* memory allocated by libc, don't use GF_FREE */
-        free (args.xdata.xdata_val);
-
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
@@ -3324,7 +3326,8 @@ server3_3_writev (rpcsvc_request_t *req)
         if (!req)
                 return ret;
 
-        len = xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_write_req);
+        len = xdr_to_generic (req->msg[0], &args,
+                              (xdrproc_t)xdr_gfs3_write_req_inplace);
         if (len == 0) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -3382,8 +3385,6 @@ server3_3_writev (rpcsvc_request_t *req)
         ret = 0;
         resolve_and_resume (frame, server_writev_resume);
 out:
-        free (args.xdata.xdata_val);
-
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
@@ -3998,8 +3999,8 @@ server3_3_fxattrop (rpcsvc_request_t *req)
         if (!req)
                 return ret;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
-        if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_fxattrop_req)) {
+        if (!xdr_to_generic (req->msg[0], &args,
+                             (xdrproc_t)xdr_gfs3_fxattrop_req_inplace)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
                 goto out;
@@ -4043,8 +4044,6 @@ server3_3_fxattrop (rpcsvc_request_t *req)
         return ret;
 
 out:
-        free (args.xdata.xdata_val);
-
         if (op_errno)
                 req->rpc_err = GARBAGE_ARGS;
 
@@ -5503,10 +5502,10 @@ server3_3_lookup (rpcsvc_request_t *req)
 
         GF_VALIDATE_OR_GOTO ("server", req, err);
 
-        args.bname           = alloca (req->msg[0].iov_len);
-        args.xdata.xdata_val = alloca (req->msg[0].iov_len);
+        args.bname = alloca (req->msg[0].iov_len);
 
-        if (!xdr_to_generic (req->msg[0], &args, (xdrproc_t)xdr_gfs3_lookup_req)) {
+        if (!xdr_to_generic (req->msg[0], &args,
+                             (xdrproc_t)xdr_gfs3_lookup_req_inplace)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
                 goto err;
@@ -5609,6 +5608,286 @@ out:
 }
 
 
+/* Compound */
+
+static gf_boolean_t
+server_compound_proc_ok (int procnum)
+{
+        switch (procnum) {
+        case GFS3_OP_STAT:
+        case GFS3_OP_FSTAT:
+        case GFS3_OP_INODELK:
+        case GFS3_OP_FINODELK:
+        case GFS3_OP_XATTROP:
+        case GFS3_OP_FXATTROP:
+        case GFS3_OP_WRITE:
+        case GFS3_OP_SETXATTR:
+        case GFS3_OP_FSETXATTR:
+        case GFS3_OP_FLUSH:
+        case GFS3_OP_FSYNC:
+        case GFS3_OP_CREATE:
+        case GFS3_OP_FTRUNCATE:
+        case GFS3_OP_FSETATTR:
+                return _gf_true;
+        default:
+                return _gf_false;
+        }
+}
+
+static void
+server_compound_req_free (rpcsvc_request_t *req)
+{
+        if (req->iobref)
+                iobref_unref (req->iobref);
+
+        rpc_transport_unref (req->trans);
+        GF_FREE (req);
+}
+
+static void
+server_compound_free (server_compound_t *compound)
+{
+        int i = 0;
+
+        for (i = 0; i < compound->done; i++)
+                iobuf_unref (compound->rsp_iobufs[i]);
+
+        for (i = 0; i < compound->args.ops.ops_len; i++)
+                free (compound->args.ops.ops_val[i].args.args_val);
+
+        free (compound->args.ops.ops_val);
+        free (compound->args.xdata.xdata_val);
+
+        LOCK_DESTROY (&compound->lock);
+        GF_FREE (compound);
+}
+
+/* a copy of the compound request which looks to the actor like a plain
+   call of the given fop */
+static rpcsvc_request_t *
+server_compound_req_new (server_compound_t *compound,
+                         gfs3_compound_req_op *op)
+{
+        rpcsvc_request_t *req = NULL;
+
+        req = GF_CALLOC (1, sizeof (*req), gf_server_mt_compound_req_t);
+        if (!req)
+                return NULL;
+
+        *req = *compound->req;
+
+        req->procnum = op->procnum;
+        req->msg[0].iov_base = op->args.args_val;
+        req->msg[0].iov_len  = op->args.args_len;
+        req->count = 1;
+
+        if (op->payload_size) {
+                req->msg[1].iov_base = compound->payload;
+                req->msg[1].iov_len  = op->payload_size;
+                req->count = 2;
+
+                compound->payload      += op->payload_size;
+                compound->payload_left -= op->payload_size;
+        }
+
+        req->trans = rpc_transport_ref (compound->req->trans);
+        if (req->iobref)
+                req->iobref = iobref_ref (req->iobref);
+
+        INIT_LIST_HEAD (&req->txlist);
+        INIT_LIST_HEAD (&req->queue);
+        req->outstanding = _gf_false;
+        req->dispatched  = _gf_false;
+        req->private     = compound;
+
+        return req;
+}
+
+static void
+server_compound_done (server_compound_t *compound)
+{
+        gfs3_compound_rsp rsp = {0,};
+
+        rsp.op_ret   = compound->op_ret;
+        rsp.op_errno = gf_errno_to_error (compound->op_errno);
+        rsp.ops.ops_len = compound->done;
+        rsp.ops.ops_val = compound->rsp_ops;
+
+        server_submit_reply (NULL, compound->req, &rsp, NULL, 0, NULL,
+                             (xdrproc_t) xdr_gfs3_compound_rsp);
+
+        server_compound_free (compound);
+}
+
+static void
+server_compound_run (server_compound_t *compound)
+{
+        gfs3_compound_req_op *op       = NULL;
+        rpcsvc_request_t     *req      = NULL;
+        rpcsvc_actor_t       *actor    = NULL;
+        xlator_t             *old_THIS = NULL;
+        gf_boolean_t          replied  = _gf_false;
+        int                   ret      = 0;
+
+        while ((compound->op_ret == 0) &&
+               (compound->next < compound->args.ops.ops_len)) {
+                op = &compound->args.ops.ops_val[compound->next++];
+                actor = &compound->req->prog->actors[op->procnum];
+
+                req = server_compound_req_new (compound, op);
+                if (!req) {
+                        compound->op_ret = -1;
+                        compound->op_errno = ENOMEM;
+                        break;
+                }
+
+                LOCK (&compound->lock);
+                {
+                        compound->in_actor = _gf_true;
+                        compound->replied = _gf_false;
+                }
+                UNLOCK (&compound->lock);
+
+                old_THIS = THIS;
+                THIS = compound->req->svc->mydata;
+                ret = actor->actor (req);
+                THIS = old_THIS;
+
+                LOCK (&compound->lock);
+                {
+                        compound->in_actor = _gf_false;
+                        replied = compound->replied;
+                }
+                UNLOCK (&compound->lock);
+
+                /* answered already, go on with the next fop */
+                if (replied)
+                        continue;
+
+                /* the reply will come later and carry on from there */
+                if (ret == 0)
+                        return;
+
+                server_compound_req_free (req);
+                compound->op_ret = -1;
+                compound->op_errno = EINVAL;
+        }
+
+        server_compound_done (compound);
+}
+
+void
+server_compound_reply (server_compound_t *compound, void *arg,
+                       struct iovec *rsp, struct iobuf *iob)
+{
+        gfs3_compound_rsp_op *op     = NULL;
+        gf_common_rsp        *common = arg;
+
+        op = &compound->rsp_ops[compound->done];
+        op->procnum = compound->args.ops.ops_val[compound->done].procnum;
+        op->rsp.rsp_val = rsp->iov_base;
+        op->rsp.rsp_len = rsp->iov_len;
+        op->payload_size = 0;
+
+        compound->rsp_iobufs[compound->done++] = iobuf_ref (iob);
+
+        /* every fop reply begins with op_ret and op_errno */
+        if (common->op_ret < 0) {
+                compound->op_ret = -1;
+                compound->op_errno = gf_error_to_errno (common->op_errno);
+        }
+}
+
+void
+server_compound_next (server_compound_t *compound, rpcsvc_request_t *req,
+                      int ret)
+{
+        gf_boolean_t in_actor = _gf_false;
+
+        server_compound_req_free (req);
+
+        if (ret < 0) {
+                compound->op_ret = -1;
+                compound->op_errno = ENOMEM;
+        }
+
+        LOCK (&compound->lock);
+        {
+                in_actor = compound->in_actor;
+                compound->replied = _gf_true;
+        }
+        UNLOCK (&compound->lock);
+
+        if (!in_actor)
+                server_compound_run (compound);
+}
+
+int
+server3_3_compound (rpcsvc_request_t *req)
+{
+        server_compound_t    *compound = NULL;
+        gfs3_compound_req_op *op       = NULL;
+        ssize_t               len      = 0;
+        size_t                payload  = 0;
+        int                   ret      = -1;
+        int                   i        = 0;
+
+        if (!req)
+                return ret;
+
+        compound = GF_CALLOC (1, sizeof (*compound), gf_server_mt_compound_t);
+        if (!compound) {
+                req->rpc_err = SYSTEM_ERR;
+                goto out;
+        }
+        LOCK_INIT (&compound->lock);
+
+        len = xdr_to_generic (req->msg[0], &compound->args,
+                              (xdrproc_t)xdr_gfs3_compound_req);
+        if (len == 0) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        if ((compound->args.ops.ops_len == 0) ||
+            (compound->args.ops.ops_len > GF_COMPOUND_MAX_OPS)) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        for (i = 0; i < compound->args.ops.ops_len; i++) {
+                op = &compound->args.ops.ops_val[i];
+                if (!server_compound_proc_ok (op->procnum)) {
+                        gf_log (THIS->name, GF_LOG_ERROR,
+                                "procedure %d cannot be part of a compound",
+                                op->procnum);
+                        req->rpc_err = GARBAGE_ARGS;
+                        goto out;
+                }
+                payload += op->payload_size;
+        }
+
+        /* write payloads follow the call, in the order of the fops */
+        if (payload != (req->msg[0].iov_len - len)) {
+                req->rpc_err = GARBAGE_ARGS;
+                goto out;
+        }
+
+        compound->req = req;
+        compound->payload = req->msg[0].iov_base + len;
+        compound->payload_left = payload;
+
+        server_compound_run (compound);
+
+        return 0;
+out:
+        if (compound)
+                server_compound_free (compound);
+
+        return ret;
+}
+
+
 rpcsvc_actor_t glusterfs3_3_fop_actors[] = {
         [GFS3_OP_NULL]        = { "NULL",       GFS3_OP_NULL, server_null, NULL, 0},
         [GFS3_OP_STAT]        = { "STAT",       GFS3_OP_STAT, server3_3_stat, NULL, 0},
@@ -5654,6 +5933,7 @@ rpcsvc_actor_t glusterfs3_3_fop_actors[] = {
         [GFS3_OP_RELEASE]     = { "RELEASE",    GFS3_OP_RELEASE, server3_3_release, NULL, 0},
         [GFS3_OP_RELEASEDIR]  = { "RELEASEDIR", GFS3_OP_RELEASEDIR, server3_3_releasedir, NULL, 0},
         [GFS3_OP_FREMOVEXATTR] = { "FREMOVEXATTR", GFS3_OP_FREMOVEXATTR, server3_3_fremovexattr, NULL, 0},
+        [GFS3_OP_COMPOUND]    = { "COMPOUND",   GFS3_OP_COMPOUND, server3_3_compound, NULL, 0},
 };
 
 
@@ -5664,3 +5944,17 @@ struct rpcsvc_program glusterfs3_3_fop_prog = {
         .numactors = GLUSTER_FOP_PROCCNT,
         .actors    = glusterfs3_3_fop_actors,
 };
+
+
+/* only there to be seen in the DUMP reply, see protocol-common.h */
+rpcsvc_actor_t glusterfs3_3_compound_actors[] = {
+        [GFS3_OP_NULL]        = { "NULL",       GFS3_OP_NULL, server_null, NULL, 0},
+};
+
+struct rpcsvc_program glusterfs3_3_compound_prog = {
+        .progname  = "GlusterFS 3.3 Compound",
+        .prognum   = GLUSTER_FOP_PROGRAM,
+        .progver   = GLUSTER_FOP_COMPOUND_VERSION,
+        .numactors = 1,
+        .actors    = glusterfs3_3_compound_actors,
+};
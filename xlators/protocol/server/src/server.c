@@ -130,9 +130,13 @@ server_submit_reply (call_frame_t *frame, rpcsvc_request_t *req, void *arg,
         char                    new_iobref = 0;
         server_connection_t    *conn       = NULL;
         gf_boolean_t            lk_heal    = _gf_false;
+        server_compound_t      *compound   = NULL;
 
         GF_VALIDATE_OR_GOTO ("server", req, ret);
 
+        /* set on the requests a compound feeds to the actors */
+        compound = req->private;
+
         if (frame) {
                 state = CALL_STATE (frame);
                 frame->local = NULL;
@@ -159,6 +163,14 @@ server_submit_reply (call_frame_t *frame, rpcsvc_request_t *req, void *arg,
 
         iobref_add (iobref, iob);
 
+        if (compound) {
+                /* the reply travels back inside the compound's */
+                server_compound_reply (compound, arg, &rsp, iob);
+                iobuf_unref (iob);
+                ret = 0;
+                goto ret;
+        }
+
         /* Then, submit the message for transmission. */
         ret = rpcsvc_submit_generic (req, &rsp, 1, payload, payloadcount,
                                      iobref);
@@ -201,6 +213,9 @@ ret:
                 iobref_unref (iobref);
         }
 
+        if (compound)
+                server_compound_next (compound, req, ret);
+
         return ret;
 }
 
@@ -439,6 +454,11 @@ server_priv (xlator_t *this)
         char              key[GF_DUMP_MAX_BUF_LEN] = {0,};
         uint64_t          total_read = 0;
         uint64_t          total_write = 0;
+        uint64_t          total_msgs = 0;
+        uint64_t          total_writevs = 0;
+        uint64_t          total_spin_hits = 0;
+        uint64_t          total_spin_misses = 0;
+        int               count = 0;
         int32_t           ret  = -1;
 
         GF_VALIDATE_OR_GOTO ("server", this, out);
@@ -457,6 +477,10 @@ server_priv (xlator_t *this)
                 list_for_each_entry (xprt, &conf->xprt_list, list) {
                         total_read  += xprt->total_bytes_read;
                         total_write += xprt->total_bytes_write;
+                        total_msgs  += xprt->total_msgs_write;
+                        total_writevs += xprt->total_writev_calls;
+                        total_spin_hits += xprt->total_spin_hits;
+                        total_spin_misses += xprt->total_spin_misses;
                 }
         }
         pthread_mutex_unlock (&conf->mutex);
@@ -467,6 +491,64 @@ server_priv (xlator_t *this)
         gf_proc_dump_build_key(key, "server", "total-bytes-write");
         gf_proc_dump_write(key, "%"PRIu64, total_write);
 
+        gf_proc_dump_build_key(key, "server", "total-msgs-write");
+        gf_proc_dump_write(key, "%"PRIu64, total_msgs);
+
+        gf_proc_dump_build_key(key, "server", "total-writev-calls");
+        gf_proc_dump_write(key, "%"PRIu64, total_writevs);
+
+        gf_proc_dump_build_key(key, "server", "total-spin-hits");
+        gf_proc_dump_write(key, "%"PRIu64, total_spin_hits);
+
+        gf_proc_dump_build_key(key, "server", "total-spin-misses");
+        gf_proc_dump_write(key, "%"PRIu64, total_spin_misses);
+
+        if (conf->rpc) {
+                gf_proc_dump_build_key(key, "server", "dispatched-requests");
+                gf_proc_dump_write(key, "%u", conf->rpc->dispatched);
+
+                gf_proc_dump_build_key(key, "server", "queued-requests");
+                gf_proc_dump_write(key, "%u", conf->rpc->queued);
+        }
+
+        ret = pthread_mutex_trylock (&conf->mutex);
+        if (ret != 0)
+                goto out;
+        {
+                list_for_each_entry (xprt, &conf->xprt_list, list) {
+                        gf_proc_dump_build_key(key, "server",
+                                               "client%d.identifier", count);
+                        gf_proc_dump_write(key, "%s",
+                                           xprt->peerinfo.identifier);
+
+                        gf_proc_dump_build_key(key, "server",
+                                               "client%d.outstanding-rpcs", count);
+                        gf_proc_dump_write(key, "%u",
+                                           xprt->outstanding_rpc_count);
+
+                        gf_proc_dump_build_key(key, "server",
+                                               "client%d.queued-rpcs", count);
+                        gf_proc_dump_write(key, "%u", xprt->rpcsvc_queued);
+
+                        gf_proc_dump_build_key(key, "server",
+                                               "client%d.throttled", count);
+                        gf_proc_dump_write(key, "%d", xprt->rpc_throttled);
+
+                        gf_proc_dump_build_key(key, "server",
+                                               "client%d.spin-hits", count);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           xprt->total_spin_hits);
+
+                        gf_proc_dump_build_key(key, "server",
+                                               "client%d.spin-misses", count);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           xprt->total_spin_misses);
+
+                        count++;
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
         ret = 0;
 out:
         if (ret)
@@ -474,7 +556,7 @@ out:
                                     "(Lock acquisition failed) %s",
                                     this?this->name:"server");
 
-        return ret;
+        return 0;
 }
 
 int
@@ -910,6 +992,7 @@ reconfigure (xlator_t *this, dict_t *options)
         server_conf_t            *conf =NULL;
         rpcsvc_t                 *rpc_conf;
         rpcsvc_listener_t        *listeners;
+        rpc_transport_t          *xprt = NULL;
         int                       inode_lru_limit;
         gf_boolean_t              trace;
         data_t                   *data;
@@ -961,6 +1044,9 @@ reconfigure (xlator_t *this, dict_t *options)
         GF_FREE (this->ctx->statedump_path);
         this->ctx->statedump_path = gf_strdup (statedump_path);
 
+        iobuf_pool_reconfigure (this->ctx->iobuf_pool, options,
+                                this->name);
+
         if (!conf->auth_modules)
                 conf->auth_modules = dict_new ();
 
@@ -986,6 +1072,9 @@ reconfigure (xlator_t *this, dict_t *options)
         }
 
         (void) rpcsvc_set_allow_insecure (rpc_conf, options);
+        (void) rpcsvc_set_outstanding_rpc_limit (rpc_conf, options,
+                                         RPCSVC_DEFAULT_OUTSTANDING_RPC_LIMIT);
+        (void) rpcsvc_set_dispatch_limit (rpc_conf, options);
         list_for_each_entry (listeners, &(rpc_conf->listeners), list) {
                 if (listeners->trans != NULL) {
                         if (listeners->trans->reconfigure )
@@ -995,6 +1084,17 @@ reconfigure (xlator_t *this, dict_t *options)
                                         "Reconfigure not found for transport" );
                 }
         }
+
+        /* and the connections accepted already (eg. coalesce-usec) */
+        pthread_mutex_lock (&conf->mutex);
+        {
+                list_for_each_entry (xprt, &conf->xprt_list, list) {
+                        if (xprt->reconfigure)
+                                xprt->reconfigure (xprt, options);
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
         ret = server_init_grace_timer (this, options, conf);
 
 out:
@@ -1060,6 +1160,9 @@ init (xlator_t *this)
                 goto out;
         }
 
+        iobuf_pool_reconfigure (this->ctx->iobuf_pool, this->options,
+                                this->name);
+
         /* Authentication modules */
         conf->auth_modules = dict_new ();
         GF_VALIDATE_OR_GOTO(this->name, conf->auth_modules, out);
@@ -1086,6 +1189,13 @@ init (xlator_t *this)
                 goto out;
         }
 
+        ret = rpcsvc_set_outstanding_rpc_limit (conf->rpc, this->options,
+                                         RPCSVC_DEFAULT_OUTSTANDING_RPC_LIMIT);
+        if (ret) {
+                ret = -1;
+                goto out;
+        }
+
         ret = rpcsvc_create_listeners (conf->rpc, this->options,
                                        this->name);
         if (ret < 1) {
@@ -1113,6 +1223,19 @@ init (xlator_t *this)
                 goto out;
         }
 
+        glusterfs3_3_compound_prog.options = this->options;
+        ret = rpcsvc_program_register (conf->rpc, &glusterfs3_3_compound_prog);
+        if (ret) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "registration of program (name:%s, prognum:%d, "
+                        "progver:%d) failed",
+                        glusterfs3_3_compound_prog.progname,
+                        glusterfs3_3_compound_prog.prognum,
+                        glusterfs3_3_compound_prog.progver);
+                rpcsvc_program_unregister (conf->rpc, &glusterfs3_3_fop_prog);
+                goto out;
+        }
+
         gluster_handshake_prog.options = this->options;
         ret = rpcsvc_program_register (conf->rpc, &gluster_handshake_prog);
         if (ret) {
@@ -1122,6 +1245,8 @@ init (xlator_t *this)
                         gluster_handshake_prog.prognum,
                         gluster_handshake_prog.progver);
                 rpcsvc_program_unregister (conf->rpc, &glusterfs3_3_fop_prog);
+                rpcsvc_program_unregister (conf->rpc,
+                                           &glusterfs3_3_compound_prog);
                 goto out;
         }
 
@@ -1236,7 +1361,11 @@ struct volume_options options[] = {
                     "rdma*([ \t]),*([ \t])socket",
                     "rdma*([ \t]),*([ \t])tcp",
                     "tcp*([ \t]),*([ \t])rdma",
-                    "socket*([ \t]),*([ \t])rdma"},
+                    "socket*([ \t]),*([ \t])rdma",
+                    "shm", "tcp*([ \t]),*([ \t])shm",
+                    "socket*([ \t]),*([ \t])shm",
+                    "rdma*([ \t]),*([ \t])shm",
+                    "tcp*([ \t]),*([ \t])rdma*([ \t]),*([ \t])shm"},
           .type  = GF_OPTION_TYPE_STR
         },
         { .key   = {"volume-filename.*"},
@@ -1267,6 +1396,25 @@ struct volume_options options[] = {
         { .key   = {"rpc-auth-allow-insecure"},
           .type  = GF_OPTION_TYPE_BOOL,
         },
+        { .key   = {"rpc.outstanding-rpc-limit"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 0,
+          .max   = RPCSVC_MAX_OUTSTANDING_RPC_LIMIT,
+          .default_value = "64",
+          .description = "Stop reading requests from a client while it has "
+                         "this many in progress on the brick. 0 means no "
+                         "limit."
+        },
+        { .key   = {"rpc.dispatch-limit"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 0,
+          .max   = RPCSVC_MAX_DISPATCH_LIMIT,
+          .default_value = "0",
+          .description = "Hand at most this many requests to the brick "
+                         "at once, queueing the rest per client and "
+                         "serving the clients in turn. 0 dispatches every "
+                         "request as soon as it is read."
+        },
         { .key           = {"statedump-path"},
           .type          = GF_OPTION_TYPE_PATH,
           .default_value = "/tmp",
@@ -1287,6 +1435,18 @@ struct volume_options options[] = {
          .min  = GF_MIN_SOCKET_WINDOW_SIZE,
          .max  = GF_MAX_SOCKET_WINDOW_SIZE
         },
+        { .key   = {"iobuf-page-sizes"},
+          .type  = GF_OPTION_TYPE_STR,
+          .description = "Comma separated list of <page-size>[:<pages>] "
+                         "entries setting the iobuf size classes of the "
+                         "process, e.g. \"4KB:256,128KB:32,1MB:8\"."
+        },
+        { .key   = {"iobuf-hugepages"},
+          .type  = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Back the iobuf arenas of 2MB and more by huge "
+                         "pages."
+        },
 
         /*  The following two options are defined in addr.c, redifined here *
          * for the sake of validation during volume set from cli            */
@@ -29,6 +29,7 @@
 #include "server-mem-types.h"
 #include "glusterfs3.h"
 #include "timer.h"
+#include "compound-fop.h"
 
 #define DEFAULT_BLOCK_SIZE         4194304   /* 4MB */
 #define DEFAULT_VOLUME_FILE_PATH   CONFDIR "/glusterfs.vol"
@@ -201,8 +202,28 @@ struct _server_state {
         mode_t            umask;
 };
 
+/* a GFS3_OP_COMPOUND call in progress: its fops are fed one at a time to
+   the regular actors through copies of the request, and the replies are
+   kept here until the last one is in */
+typedef struct {
+        rpcsvc_request_t     *req;
+        gfs3_compound_req     args;
+        char                 *payload;
+        size_t                payload_left;
+        int                   next;
+        int                   done;
+        int32_t               op_ret;
+        int32_t               op_errno;
+        gf_lock_t             lock;
+        gf_boolean_t          in_actor;
+        gf_boolean_t          replied;
+        gfs3_compound_rsp_op  rsp_ops[GF_COMPOUND_MAX_OPS];
+        struct iobuf         *rsp_iobufs[GF_COMPOUND_MAX_OPS];
+} server_compound_t;
+
 extern struct rpcsvc_program gluster_handshake_prog;
 extern struct rpcsvc_program glusterfs3_3_fop_prog;
+extern struct rpcsvc_program glusterfs3_3_compound_prog;
 extern struct rpcsvc_program gluster_ping_prog;
 
 int
@@ -210,6 +231,14 @@ server_submit_reply (call_frame_t *frame, rpcsvc_request_t *req, void *arg,
                      struct iovec *payload, int payloadcount,
                      struct iobref *iobref, xdrproc_t xdrproc);
 
+void
+server_compound_reply (server_compound_t *compound, void *arg,
+                       struct iovec *rsp, struct iobuf *iob);
+
+void
+server_compound_next (server_compound_t *compound, rpcsvc_request_t *req,
+                      int ret);
+
 int gf_server_check_setxattr_cmd (call_frame_t *frame, dict_t *dict);
 int gf_server_check_getxattr_cmd (call_frame_t *frame, const char *name);
 
@@ -15,6 +15,7 @@
 #include "xlator.h"
 #include "glusterfs.h"
 #include "posix.h"
+#include "posix-rchecksum.h"
 #include <sys/uio.h>
 
 #ifdef HAVE_LIBAIO
@@ -27,6 +28,7 @@ struct posix_aio_cb {
         struct iobuf   *iobuf;
         struct iobref  *iobref;
         struct iatt     prebuf;
+        inode_t        *inode;  /* rchecksum write to end, if any */
         int             fd;
         int             op;
         off_t           offset;
@@ -151,6 +153,11 @@ posix_aio_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
         _fd = pfd->fd;
 
+        /* spliced reads are done synchronously */
+        if (posix_zero_copy_wanted (frame, this, pfd, size))
+                return posix_readv (frame, this, fd, size, offset, flags,
+                                    xdata);
+
         if (!size) {
                 op_errno = EINVAL;
                 gf_log (this->name, GF_LOG_WARNING, "size=%"GF_PRI_SIZET, size);
@@ -259,6 +266,11 @@ posix_aio_writev_complete (struct posix_aio_cb *paiocb, int res, int res2)
         UNLOCK (&priv->lock);
 
 out:
+        if (paiocb->inode) {
+                posix_rchecksum_write_end (this, paiocb->inode);
+                inode_unref (paiocb->inode);
+        }
+
         STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, &prebuf, &postbuf,
 			     NULL);
 
@@ -334,6 +346,14 @@ posix_aio_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	}
 
 
+        ret = posix_rchecksum_write_begin (this, fd->inode, offset,
+                                           iov_length (iov, count));
+        if (ret < 0) {
+                op_errno = -ret;
+                goto err;
+        }
+        paiocb->inode = inode_ref (fd->inode);
+
         ret = io_submit (priv->ctxp, 1, &iocb);
         if (ret != 1) {
                 gf_log (this->name, GF_LOG_ERROR,
@@ -344,6 +364,11 @@ posix_aio_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
 
         return 0;
 err:
+        if (paiocb && paiocb->inode) {
+                posix_rchecksum_write_end (this, paiocb->inode);
+                inode_unref (paiocb->inode);
+        }
+
         STACK_UNWIND_STRICT (writev, frame, -1, op_errno, 0, 0, 0);
 
         if (paiocb) {
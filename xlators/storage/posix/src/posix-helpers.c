@@ -44,6 +44,7 @@
 #include "timer.h"
 #include "glusterfs3-xdr.h"
 #include "hashfn.h"
+#include "posix-rchecksum.h"
 #include <fnmatch.h>
 
 typedef struct {
@@ -763,8 +764,10 @@ janitor_walker (const char *fpath, const struct stat *sb,
                 gf_log (THIS->name, GF_LOG_TRACE,
                         "unlinking %s", fpath);
                 unlink (fpath);
-                if (stbuf.ia_nlink == 1)
+                if (stbuf.ia_nlink == 1) {
                         posix_handle_unset (this, stbuf.ia_gfid, NULL);
+                        posix_rchecksum_unlink (this, NULL, stbuf.ia_gfid);
+                }
                 break;
 
         case S_IFDIR:
@@ -0,0 +1,1142 @@
+/*
+   Copyright (c) 2006-2012 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "glusterfs.h"
+#include "posix.h"
+#include "posix-aio.h"
+#include "posix-io-uring.h"
+#include "posix-rchecksum.h"
+#include <sys/uio.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+
+
+struct posix_uring {
+        int                  fd;
+
+        pthread_mutex_t      lock;       /* for the SQ tail and below */
+        pthread_cond_t       cond;       /* signalled when submitting ends
+                                            and when completions are reaped */
+        unsigned int         pending;    /* queued, not yet submitted */
+        gf_boolean_t         submitting; /* someone is in io_uring_enter */
+        unsigned int         inflight;
+        gf_boolean_t         stopping;   /* no more submissions, the
+                                            thread exits once drained */
+
+        unsigned int         sq_entries;
+        unsigned int        *sq_head;
+        unsigned int        *sq_tail;
+        unsigned int        *sq_mask;
+        unsigned int        *sq_array;
+        struct io_uring_sqe *sqes;
+
+        unsigned int         cq_entries;
+        unsigned int        *cq_head;
+        unsigned int        *cq_tail;
+        unsigned int        *cq_mask;
+        struct io_uring_cqe *cqes;
+
+        void                *sq_ring;
+        size_t               sq_ring_size;
+        void                *cq_ring;
+        size_t               cq_ring_size;
+        size_t               sqes_size;
+
+        pthread_t            thread;
+};
+
+
+struct posix_uring_cb {
+        call_frame_t   *frame;
+        struct iobuf   *iobuf;
+        struct iobref  *iobref;
+        struct iovec   *iov;
+        struct iovec    one_iov;
+        struct iatt     prebuf;
+        inode_t        *inode;  /* rchecksum write to end, if any */
+        int             fd;
+        int             op;
+        off_t           offset;
+        struct posix_uring_cb *next;  /* cancelled, never submitted */
+};
+
+
+static void posix_uring_complete (struct posix_uring_cb *cb, int res);
+
+
+static int
+sys_io_uring_setup (unsigned int entries, struct io_uring_params *params)
+{
+        return syscall (__NR_io_uring_setup, entries, params);
+}
+
+
+static int
+sys_io_uring_enter (int fd, unsigned int to_submit, unsigned int min_complete,
+                    unsigned int flags)
+{
+        return syscall (__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+
+static void
+posix_uring_unmap (struct posix_uring *ring)
+{
+        if (ring->sqes)
+                munmap (ring->sqes, ring->sqes_size);
+        if (ring->cq_ring && (ring->cq_ring != ring->sq_ring))
+                munmap (ring->cq_ring, ring->cq_ring_size);
+        if (ring->sq_ring)
+                munmap (ring->sq_ring, ring->sq_ring_size);
+        if (ring->fd != -1)
+                close (ring->fd);
+
+        ring->sqes = NULL;
+        ring->cq_ring = NULL;
+        ring->sq_ring = NULL;
+        ring->fd = -1;
+}
+
+
+static void
+posix_uring_destroy (struct posix_uring *ring)
+{
+        if (!ring)
+                return;
+
+        posix_uring_unmap (ring);
+
+        pthread_cond_destroy (&ring->cond);
+        pthread_mutex_destroy (&ring->lock);
+        GF_FREE (ring);
+}
+
+
+static int
+posix_uring_map (xlator_t *this, struct posix_uring *ring)
+{
+        struct io_uring_params  params = {0,};
+        int                     ret = -1;
+
+        ring->fd = sys_io_uring_setup (POSIX_IO_URING_ENTRIES, &params);
+        if (ring->fd == -1)
+                goto out;
+
+        ring->sq_ring_size = params.sq_off.array +
+                             params.sq_entries * sizeof (unsigned int);
+        ring->cq_ring_size = params.cq_off.cqes +
+                             params.cq_entries * sizeof (struct io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                if (ring->cq_ring_size > ring->sq_ring_size)
+                        ring->sq_ring_size = ring->cq_ring_size;
+                ring->cq_ring_size = ring->sq_ring_size;
+        }
+
+        ring->sq_ring = mmap (NULL, ring->sq_ring_size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring->fd,
+                              IORING_OFF_SQ_RING);
+        if (ring->sq_ring == MAP_FAILED) {
+                ring->sq_ring = NULL;
+                goto out;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                ring->cq_ring = ring->sq_ring;
+        } else {
+                ring->cq_ring = mmap (NULL, ring->cq_ring_size,
+                                      PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, ring->fd,
+                                      IORING_OFF_CQ_RING);
+                if (ring->cq_ring == MAP_FAILED) {
+                        ring->cq_ring = NULL;
+                        goto out;
+                }
+        }
+
+        ring->sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+        ring->sqes = mmap (NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring->fd,
+                           IORING_OFF_SQES);
+        if (ring->sqes == MAP_FAILED) {
+                ring->sqes = NULL;
+                goto out;
+        }
+
+        ring->sq_entries = params.sq_entries;
+        ring->sq_head  = ring->sq_ring + params.sq_off.head;
+        ring->sq_tail  = ring->sq_ring + params.sq_off.tail;
+        ring->sq_mask  = ring->sq_ring + params.sq_off.ring_mask;
+        ring->sq_array = ring->sq_ring + params.sq_off.array;
+
+        ring->cq_entries = params.cq_entries;
+        ring->cq_head  = ring->cq_ring + params.cq_off.head;
+        ring->cq_tail  = ring->cq_ring + params.cq_off.tail;
+        ring->cq_mask  = ring->cq_ring + params.cq_off.ring_mask;
+        ring->cqes     = ring->cq_ring + params.cq_off.cqes;
+
+        ret = 0;
+out:
+        if (ret) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "io_uring setup failed (%s). Continuing with "
+                        "synchronous IO", strerror (errno));
+                posix_uring_unmap (ring);
+        }
+
+        return ret;
+}
+
+
+static struct posix_uring *
+posix_uring_new (xlator_t *this)
+{
+        struct posix_uring *ring = NULL;
+
+        ring = GF_CALLOC (1, sizeof (*ring), gf_posix_mt_uring_t);
+        if (!ring)
+                return NULL;
+
+        pthread_mutex_init (&ring->lock, NULL);
+        pthread_cond_init (&ring->cond, NULL);
+        ring->fd = -1;
+        ring->stopping = _gf_true;
+
+        return ring;
+}
+
+
+/*
+ * take back whatever the kernel has not consumed from the SQ. only safe
+ * with nobody inside io_uring_enter () for submission.
+ */
+static struct posix_uring_cb *
+__posix_uring_unqueue (struct posix_uring *ring)
+{
+        struct posix_uring_cb *cancelled = NULL;
+        struct posix_uring_cb *cb = NULL;
+        unsigned int           head = 0;
+        unsigned int           tail = 0;
+        unsigned int           index = 0;
+
+        head = __atomic_load_n (ring->sq_head, __ATOMIC_ACQUIRE);
+        tail = *ring->sq_tail;
+        for (; tail != head; tail--) {
+                index = ring->sq_array[(tail - 1) & *ring->sq_mask];
+                cb = (void *)(unsigned long) ring->sqes[index].user_data;
+                cb->next = cancelled;
+                cancelled = cb;
+                ring->inflight--;
+        }
+        __atomic_store_n (ring->sq_tail, head, __ATOMIC_RELEASE);
+        ring->pending = 0;
+
+        return cancelled;
+}
+
+
+/* fail the fops taken back by __posix_uring_unqueue (), except @skip */
+static void
+posix_uring_cancel (struct posix_uring_cb *cancelled,
+                    struct posix_uring_cb *skip, int res)
+{
+        struct posix_uring_cb *cb = NULL;
+
+        while (cancelled) {
+                cb = cancelled;
+                cancelled = cb->next;
+
+                if (cb != skip)
+                        posix_uring_complete (cb, res);
+        }
+}
+
+
+/*
+ * queue @sqe and get it to the kernel. submissions racing with one
+ * already inside io_uring_enter () are picked up by that caller, so a
+ * busy brick pays one syscall per batch rather than one per fop.
+ *
+ * when the kernel is short of resources the submitter waits for
+ * completions to be reaped before it tries again. if io_uring_enter ()
+ * fails for good, the fops still queued are failed with its error.
+ *
+ * returns -EAGAIN when the ring is full; the caller does the fop inline.
+ * returns -errno when @sqe itself was failed; the caller unwinds it.
+ */
+static int
+posix_uring_submit (xlator_t *this, struct posix_uring *ring,
+                    struct io_uring_sqe *sqe)
+{
+        struct posix_uring_cb *cancelled = NULL;
+        struct posix_uring_cb *cb = NULL;
+        struct posix_uring_cb *mine = NULL;
+        struct timespec        ts = {0,};
+        unsigned int           head = 0;
+        unsigned int           tail = 0;
+        unsigned int           index = 0;
+        unsigned int           to_submit = 0;
+        int                    retries = 0;
+        int                    op_errno = 0;
+        int                    ret = 0;
+
+        pthread_mutex_lock (&ring->lock);
+        {
+                /* the ring is going away, or gone */
+                if (ring->stopping) {
+                        ret = -EAGAIN;
+                        goto unlock;
+                }
+
+                head = __atomic_load_n (ring->sq_head, __ATOMIC_ACQUIRE);
+                tail = *ring->sq_tail;
+
+                if (((tail - head) >= ring->sq_entries) ||
+                    (ring->inflight >= ring->cq_entries)) {
+                        ret = -EAGAIN;
+                        goto unlock;
+                }
+
+                index = tail & *ring->sq_mask;
+                ring->sqes[index] = *sqe;
+                ring->sq_array[index] = index;
+                __atomic_store_n (ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+                ring->pending++;
+                ring->inflight++;
+
+                if (ring->submitting)
+                        goto unlock;
+
+                ring->submitting = _gf_true;
+                while (ring->pending && !ring->stopping) {
+                        to_submit = ring->pending;
+
+                        pthread_mutex_unlock (&ring->lock);
+                        ret = sys_io_uring_enter (ring->fd, to_submit, 0, 0);
+                        op_errno = errno;
+                        pthread_mutex_lock (&ring->lock);
+
+                        if (ret >= 0) {
+                                ring->pending -= ret;
+                                retries = 0;
+                                continue;
+                        }
+
+                        if (op_errno == EINTR)
+                                continue;
+
+                        if (((op_errno == EAGAIN) || (op_errno == EBUSY)) &&
+                            (retries++ < POSIX_IO_URING_MAX_RETRIES)) {
+                                /* out of kernel resources, or the CQ is
+                                   backed up: let the thread reap */
+                                clock_gettime (CLOCK_REALTIME, &ts);
+                                ts.tv_nsec += POSIX_IO_URING_BACKOFF_USEC *
+                                              1000;
+                                if (ts.tv_nsec >= 1000000000) {
+                                        ts.tv_sec++;
+                                        ts.tv_nsec -= 1000000000;
+                                }
+                                pthread_cond_timedwait (&ring->cond,
+                                                        &ring->lock, &ts);
+                                continue;
+                        }
+
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "io_uring_enter() failed, failing %u "
+                                "queued fops: %s", ring->pending,
+                                strerror (op_errno));
+                        cancelled = __posix_uring_unqueue (ring);
+                        break;
+                }
+                ring->submitting = _gf_false;
+                pthread_cond_broadcast (&ring->cond);
+
+                ret = 0;
+        }
+unlock:
+        pthread_mutex_unlock (&ring->lock);
+
+        if (!cancelled)
+                return ret;
+
+        for (cb = cancelled; cb; cb = cb->next) {
+                if (cb == (void *)(unsigned long) sqe->user_data)
+                        mine = cb;
+        }
+
+        posix_uring_cancel (cancelled, mine, -op_errno);
+
+        return mine ? -op_errno : 0;
+}
+
+
+static void
+posix_uring_cb_destroy (struct posix_uring_cb *cb)
+{
+        if (cb->iobuf)
+                iobuf_unref (cb->iobuf);
+        if (cb->iobref)
+                iobref_unref (cb->iobref);
+        if (cb->iov && (cb->iov != &cb->one_iov))
+                GF_FREE (cb->iov);
+
+        GF_FREE (cb);
+}
+
+
+int
+posix_uring_readv_complete (struct posix_uring_cb *cb, int res)
+{
+        call_frame_t   *frame = NULL;
+        xlator_t       *this = NULL;
+        struct iatt     postbuf = {0,};
+        int             op_ret = -1;
+        int             op_errno = 0;
+        struct iovec    iov = {0,};
+        struct iobref  *iobref = NULL;
+        int             ret = 0;
+        struct posix_private *priv = NULL;
+
+        frame = cb->frame;
+        this = frame->this;
+        priv = this->private;
+
+        if (res < 0) {
+                op_errno = -res;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "readv(io_uring) failed fd=%d,size=%zu,offset=%llu "
+                        "(%s)", cb->fd, cb->one_iov.iov_len,
+                        (unsigned long long) cb->offset, strerror (op_errno));
+                goto out;
+        }
+
+        ret = posix_fdstat (this, cb->fd, &postbuf);
+        if (ret != 0) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "fstat failed on fd=%d: %s", cb->fd,
+                        strerror (op_errno));
+                goto out;
+        }
+
+        iobref = iobref_new ();
+        if (!iobref) {
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        iobref_add (iobref, cb->iobuf);
+
+        op_ret = res;
+
+        iov.iov_base = iobuf_ptr (cb->iobuf);
+        iov.iov_len = op_ret;
+
+        /* Hack to notify higher layers of EOF. */
+        if (postbuf.ia_size == 0)
+                op_errno = ENOENT;
+        else if ((cb->offset + iov.iov_len) == postbuf.ia_size)
+                op_errno = ENOENT;
+        else if (cb->offset > postbuf.ia_size)
+                op_errno = ENOENT;
+
+        LOCK (&priv->lock);
+        {
+                priv->read_value += op_ret;
+        }
+        UNLOCK (&priv->lock);
+
+out:
+        STACK_UNWIND_STRICT (readv, frame, op_ret, op_errno, &iov, 1,
+                             &postbuf, iobref, NULL);
+        if (iobref)
+                iobref_unref (iobref);
+
+        posix_uring_cb_destroy (cb);
+
+        return 0;
+}
+
+
+int
+posix_uring_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                   size_t size, off_t offset, uint32_t flags, dict_t *xdata)
+{
+        int32_t                op_errno   = EINVAL;
+        struct posix_fd       *pfd        = NULL;
+        struct posix_private  *priv       = NULL;
+        struct posix_uring_cb *cb         = NULL;
+        struct io_uring_sqe    sqe        = {0,};
+        int                    ret        = -1;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (fd, err);
+
+        priv = this->private;
+
+        ret = posix_fd_ctx_get (fd, this, &pfd);
+        if (ret < 0) {
+                op_errno = -ret;
+                gf_log (this->name, GF_LOG_WARNING,
+                        "pfd is NULL from fd=%p", fd);
+                goto err;
+        }
+
+        /* no alignment guarantees on size/offset */
+        if (pfd->flags & O_DIRECT)
+                goto inline_fop;
+
+        /* spliced reads are done synchronously */
+        if (posix_zero_copy_wanted (frame, this, pfd, size))
+                goto inline_fop;
+
+        if (!size) {
+                op_errno = EINVAL;
+                gf_log (this->name, GF_LOG_WARNING, "size=%"GF_PRI_SIZET, size);
+                goto err;
+        }
+
+        cb = GF_CALLOC (1, sizeof (*cb), gf_posix_mt_uring_cb);
+        if (!cb) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        cb->iobuf = iobuf_get2 (this->ctx->iobuf_pool, size);
+        if (!cb->iobuf) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        cb->frame = frame;
+        cb->fd = pfd->fd;
+        cb->op = GF_FOP_READ;
+        cb->offset = offset;
+        cb->one_iov.iov_base = iobuf_ptr (cb->iobuf);
+        cb->one_iov.iov_len = size;
+        cb->iov = &cb->one_iov;
+
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = cb->fd;
+        sqe.addr = (unsigned long) cb->iov;
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = (unsigned long) cb;
+
+        ret = posix_uring_submit (this, priv->uring, &sqe);
+        if (ret == -EAGAIN) {
+                posix_uring_cb_destroy (cb);
+                goto inline_fop;
+        }
+        if (ret < 0) {
+                op_errno = -ret;
+                goto err;
+        }
+
+        return 0;
+
+inline_fop:
+        return posix_readv (frame, this, fd, size, offset, flags, xdata);
+err:
+        STACK_UNWIND_STRICT (readv, frame, -1, op_errno, 0, 0, 0, 0, 0);
+        if (cb)
+                posix_uring_cb_destroy (cb);
+
+        return 0;
+}
+
+
+int
+posix_uring_writev_complete (struct posix_uring_cb *cb, int res)
+{
+        call_frame_t   *frame = NULL;
+        xlator_t       *this = NULL;
+        struct iatt     postbuf = {0,};
+        int             op_ret = -1;
+        int             op_errno = 0;
+        int             ret = 0;
+        struct posix_private *priv = NULL;
+
+        frame = cb->frame;
+        this = frame->this;
+        priv = this->private;
+
+        if (res < 0) {
+                op_errno = -res;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "writev(io_uring) failed fd=%d,offset=%llu (%s)",
+                        cb->fd, (unsigned long long) cb->offset,
+                        strerror (op_errno));
+                goto out;
+        }
+
+        ret = posix_fdstat (this, cb->fd, &postbuf);
+        if (ret != 0) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "fstat failed on fd=%d: %s", cb->fd,
+                        strerror (op_errno));
+                goto out;
+        }
+
+        op_ret = res;
+
+        LOCK (&priv->lock);
+        {
+                priv->write_value += op_ret;
+        }
+        UNLOCK (&priv->lock);
+
+out:
+        if (cb->inode) {
+                posix_rchecksum_write_end (this, cb->inode);
+                inode_unref (cb->inode);
+                cb->inode = NULL;
+        }
+
+        STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, &cb->prebuf,
+                             &postbuf, NULL);
+
+        posix_uring_cb_destroy (cb);
+
+        return 0;
+}
+
+
+int
+posix_uring_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                    struct iovec *iov, int count, off_t offset,
+                    uint32_t flags, struct iobref *iobref, dict_t *xdata)
+{
+        int32_t                op_errno   = EINVAL;
+        struct posix_fd       *pfd        = NULL;
+        struct posix_private  *priv       = NULL;
+        struct posix_uring_cb *cb         = NULL;
+        struct io_uring_sqe    sqe        = {0,};
+        int                    ret        = -1;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (fd, err);
+        VALIDATE_OR_GOTO (iov, err);
+
+        priv = this->private;
+
+        ret = posix_fd_ctx_get (fd, this, &pfd);
+        if (ret < 0) {
+                op_errno = -ret;
+                gf_log (this->name, GF_LOG_WARNING,
+                        "pfd is NULL from fd=%p", fd);
+                goto err;
+        }
+
+        /* O_DIRECT needs the realigning copy of __posix_writev (), and
+           flushwrites an fsync () behind every write */
+        if ((pfd->flags & O_DIRECT) || pfd->flushwrites)
+                goto inline_fop;
+
+        cb = GF_CALLOC (1, sizeof (*cb), gf_posix_mt_uring_cb);
+        if (!cb) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        /* the vector has to outlive this call */
+        cb->iov = iov_dup (iov, count);
+        if (!cb->iov) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        cb->frame = frame;
+        cb->fd = pfd->fd;
+        cb->op = GF_FOP_WRITE;
+        cb->offset = offset;
+        if (iobref)
+                cb->iobref = iobref_ref (iobref);
+
+        ret = posix_fdstat (this, cb->fd, &cb->prebuf);
+        if (ret != 0) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "fstat failed on fd=%p: %s", fd,
+                        strerror (op_errno));
+                goto err;
+        }
+
+        ret = posix_rchecksum_write_begin (this, fd->inode, offset,
+                                           iov_length (iov, count));
+        if (ret < 0) {
+                op_errno = -ret;
+                goto err;
+        }
+        cb->inode = inode_ref (fd->inode);
+
+        sqe.opcode = IORING_OP_WRITEV;
+        sqe.fd = cb->fd;
+        sqe.addr = (unsigned long) cb->iov;
+        sqe.len = count;
+        sqe.off = offset;
+        sqe.user_data = (unsigned long) cb;
+
+        ret = posix_uring_submit (this, priv->uring, &sqe);
+        if (ret < 0) {
+                posix_rchecksum_write_end (this, cb->inode);
+                inode_unref (cb->inode);
+                cb->inode = NULL;
+        }
+        if (ret == -EAGAIN) {
+                posix_uring_cb_destroy (cb);
+                goto inline_fop;
+        }
+        if (ret < 0) {
+                op_errno = -ret;
+                goto err;
+        }
+
+        return 0;
+
+inline_fop:
+        return posix_writev (frame, this, fd, iov, count, offset, flags,
+                             iobref, xdata);
+err:
+        STACK_UNWIND_STRICT (writev, frame, -1, op_errno, 0, 0, 0);
+        if (cb)
+                posix_uring_cb_destroy (cb);
+
+        return 0;
+}
+
+
+int
+posix_uring_fsync_complete (struct posix_uring_cb *cb, int res)
+{
+        call_frame_t   *frame = NULL;
+        xlator_t       *this = NULL;
+        struct iatt     postbuf = {0,};
+        int             op_ret = -1;
+        int             op_errno = 0;
+        int             ret = 0;
+
+        frame = cb->frame;
+        this = frame->this;
+
+        if (res < 0) {
+                op_errno = -res;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "fsync(io_uring) on fd=%d failed: %s", cb->fd,
+                        strerror (op_errno));
+                goto out;
+        }
+
+        ret = posix_fdstat (this, cb->fd, &postbuf);
+        if (ret != 0) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_WARNING,
+                        "post-operation fstat failed on fd=%d: %s", cb->fd,
+                        strerror (op_errno));
+                goto out;
+        }
+
+        op_ret = 0;
+out:
+        STACK_UNWIND_STRICT (fsync, frame, op_ret, op_errno, &cb->prebuf,
+                             &postbuf, NULL);
+
+        posix_uring_cb_destroy (cb);
+
+        return 0;
+}
+
+
+int
+posix_uring_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                   int32_t datasync, dict_t *xdata)
+{
+        int32_t                op_errno   = EINVAL;
+        struct posix_fd       *pfd        = NULL;
+        struct posix_private  *priv       = NULL;
+        struct posix_uring_cb *cb         = NULL;
+        struct io_uring_sqe    sqe        = {0,};
+        int                    ret        = -1;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (fd, err);
+
+        priv = this->private;
+
+        ret = posix_fd_ctx_get (fd, this, &pfd);
+        if (ret < 0) {
+                op_errno = -ret;
+                gf_log (this->name, GF_LOG_WARNING,
+                        "pfd not found in fd's ctx");
+                goto err;
+        }
+
+        cb = GF_CALLOC (1, sizeof (*cb), gf_posix_mt_uring_cb);
+        if (!cb) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        cb->frame = frame;
+        cb->fd = pfd->fd;
+        cb->op = GF_FOP_FSYNC;
+
+        ret = posix_fdstat (this, cb->fd, &cb->prebuf);
+        if (ret != 0) {
+                op_errno = errno;
+                gf_log (this->name, GF_LOG_WARNING,
+                        "pre-operation fstat failed on fd=%p: %s", fd,
+                        strerror (op_errno));
+                goto err;
+        }
+
+        sqe.opcode = IORING_OP_FSYNC;
+        sqe.fd = cb->fd;
+        if (datasync)
+                sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe.user_data = (unsigned long) cb;
+
+        ret = posix_uring_submit (this, priv->uring, &sqe);
+        if (ret == -EAGAIN) {
+                posix_uring_cb_destroy (cb);
+                return posix_fsync (frame, this, fd, datasync, xdata);
+        }
+        if (ret < 0) {
+                op_errno = -ret;
+                goto err;
+        }
+
+        return 0;
+err:
+        STACK_UNWIND_STRICT (fsync, frame, -1, op_errno, 0, 0, 0);
+        if (cb)
+                posix_uring_cb_destroy (cb);
+
+        return 0;
+}
+
+
+static void
+posix_uring_complete (struct posix_uring_cb *cb, int res)
+{
+        switch (cb->op) {
+        case GF_FOP_READ:
+                posix_uring_readv_complete (cb, res);
+                break;
+        case GF_FOP_WRITE:
+                posix_uring_writev_complete (cb, res);
+                break;
+        case GF_FOP_FSYNC:
+                posix_uring_fsync_complete (cb, res);
+                break;
+        default:
+                gf_log (THIS->name, GF_LOG_ERROR,
+                        "unknown op %d found in uring cb", cb->op);
+                break;
+        }
+}
+
+
+void *
+posix_uring_thread (void *data)
+{
+        xlator_t              *this = NULL;
+        struct posix_private  *priv = NULL;
+        struct posix_uring    *ring = NULL;
+        struct io_uring_cqe   *cqe = NULL;
+        struct posix_uring_cb *cb = NULL;
+        unsigned int           head = 0;
+        unsigned int           tail = 0;
+        int                    reaped = 0;
+        int                    res = 0;
+        int                    ret = 0;
+        gf_boolean_t           done = _gf_false;
+
+        this = data;
+        THIS = this;
+        priv = this->private;
+        ring = priv->uring;
+
+        for (;;) {
+                ret = sys_io_uring_enter (ring->fd, 0, 1,
+                                          IORING_ENTER_GETEVENTS);
+                if (ret == -1) {
+                        if (errno == EINTR)
+                                continue;
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "io_uring_enter() failed: %s",
+                                strerror (errno));
+                        break;
+                }
+
+                head = *ring->cq_head;
+                tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+
+                for (reaped = 0; (head != tail) &&
+                             (reaped < POSIX_IO_URING_MAX_REAP); reaped++) {
+                        cqe = &ring->cqes[head & *ring->cq_mask];
+                        cb = (void *)(unsigned long) cqe->user_data;
+                        res = cqe->res;
+
+                        /* hand the slot back before the completion runs
+                           up the graph */
+                        head++;
+                        __atomic_store_n (ring->cq_head, head,
+                                          __ATOMIC_RELEASE);
+
+                        /* the wakeup posted by posix_uring_stop() */
+                        if (!cb) {
+                                reaped--;
+                                continue;
+                        }
+
+                        posix_uring_complete (cb, res);
+                }
+
+                pthread_mutex_lock (&ring->lock);
+                {
+                        ring->inflight -= reaped;
+                        done = (ring->stopping && !ring->inflight);
+                        if (reaped)
+                                pthread_cond_broadcast (&ring->cond);
+                }
+                pthread_mutex_unlock (&ring->lock);
+
+                if (done)
+                        break;
+        }
+
+        return NULL;
+}
+
+
+/*
+ * stop taking submissions, fail whatever is still queued in the SQ with
+ * ECANCELED, and wait for the thread to reap everything the kernel
+ * already has before unmapping the ring.
+ *
+ * the ring itself stays allocated: a fop that picked up the io_uring
+ * fops before they were swapped out sees ->stopping and goes inline.
+ *
+ * returns -1 if the thread could not be woken up, in which case the
+ * ring is left mapped for it.
+ */
+static int
+posix_uring_stop (xlator_t *this, struct posix_uring *ring)
+{
+        struct posix_uring_cb *cancelled = NULL;
+        struct io_uring_sqe   *sqe = NULL;
+        unsigned int           tail = 0;
+        unsigned int           index = 0;
+        int                    ret = -1;
+
+        pthread_mutex_lock (&ring->lock);
+        {
+                ring->stopping = _gf_true;
+                while (ring->submitting)
+                        pthread_cond_wait (&ring->cond, &ring->lock);
+
+                /* whatever the kernel has not consumed is ours to fail */
+                cancelled = __posix_uring_unqueue (ring);
+                tail = *ring->sq_tail;
+
+                /* wake the thread up so it sees ->stopping */
+                index = tail & *ring->sq_mask;
+                sqe = &ring->sqes[index];
+                memset (sqe, 0, sizeof (*sqe));
+                sqe->opcode = IORING_OP_NOP;
+                sqe->user_data = 0;
+                ring->sq_array[index] = index;
+                __atomic_store_n (ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+                do {
+                        ret = sys_io_uring_enter (ring->fd, 1, 0, 0);
+                } while ((ret == -1) && (errno == EINTR));
+        }
+        pthread_mutex_unlock (&ring->lock);
+
+        if (ret != 1)
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not wake up the io_uring thread (%s), "
+                        "leaving the ring mapped", strerror (errno));
+
+        posix_uring_cancel (cancelled, NULL, -ECANCELED);
+
+        if (ret != 1) {
+                pthread_detach (ring->thread);
+                return -1;
+        }
+
+        pthread_join (ring->thread, NULL);
+
+        posix_uring_unmap (ring);
+
+        return 0;
+}
+
+
+int
+posix_io_uring_init (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+        int                   ret = -1;
+
+        priv = this->private;
+
+        /* turned back on after posix_io_uring_off(): reuse the ring */
+        if (!priv->uring) {
+                priv->uring = posix_uring_new (this);
+                if (!priv->uring)
+                        goto out;
+        }
+
+        ret = posix_uring_map (this, priv->uring);
+        if (ret)
+                goto out;
+
+        priv->uring->pending = 0;
+        priv->uring->inflight = 0;
+        priv->uring->stopping = _gf_false;
+
+        ret = pthread_create (&priv->uring->thread, NULL,
+                              posix_uring_thread, this);
+        if (ret != 0) {
+                priv->uring->stopping = _gf_true;
+                posix_uring_unmap (priv->uring);
+                ret = -1;
+                goto out;
+        }
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+int
+posix_io_uring_on (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+        int                   ret = 0;
+
+        priv = this->private;
+
+        if (!priv->io_uring_init_done) {
+                ret = posix_io_uring_init (this);
+                if (ret == 0)
+                        priv->io_uring_capable = _gf_true;
+                else
+                        priv->io_uring_capable = _gf_false;
+                priv->io_uring_init_done = _gf_true;
+        }
+
+        if (priv->io_uring_capable) {
+                this->fops->readv  = posix_uring_readv;
+                this->fops->writev = posix_uring_writev;
+                this->fops->fsync  = posix_uring_fsync;
+        }
+
+        /* not being able to set up a ring is no reason to fail the brick */
+        return 0;
+}
+
+int
+posix_io_uring_off (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+
+        priv = this->private;
+
+        this->fops->readv  = posix_readv;
+        this->fops->writev = posix_writev;
+        this->fops->fsync  = posix_fsync;
+
+        /* give readv/writev back to Linux AIO if that is configured */
+        if (priv->aio_configured)
+                posix_aio_on (this);
+
+        if (priv->io_uring_capable) {
+                /* if the thread is stuck the ring stays as it is, and
+                   is not set up again */
+                if (posix_uring_stop (this, priv->uring) == 0)
+                        priv->io_uring_init_done = _gf_false;
+                priv->io_uring_capable = _gf_false;
+        } else {
+                priv->io_uring_init_done = _gf_false;
+        }
+
+        return 0;
+}
+
+
+void
+posix_io_uring_fini (xlator_t *this)
+{
+        struct posix_private *priv = NULL;
+
+        priv = this->private;
+
+        if (!priv->uring)
+                return;
+
+        if (priv->io_uring_capable) {
+                if (posix_uring_stop (this, priv->uring) != 0)
+                        return;
+        } else if (priv->uring->fd != -1) {
+                /* still mapped for a thread posix_io_uring_off() could
+                   not stop */
+                return;
+        }
+
+        posix_uring_destroy (priv->uring);
+        priv->uring = NULL;
+        priv->io_uring_capable = _gf_false;
+}
+
+
+#else
+
+
+int
+posix_io_uring_on (xlator_t *this)
+{
+        gf_log (this->name, GF_LOG_INFO,
+                "io_uring not available at build-time."
+                " Continuing with synchronous IO");
+        return 0;
+}
+
+int
+posix_io_uring_off (xlator_t *this)
+{
+        return 0;
+}
+
+void
+posix_io_uring_fini (xlator_t *this)
+{
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+   Copyright (c) 2006-2012 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+#ifndef _POSIX_IO_URING_H
+#define _POSIX_IO_URING_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "glusterfs.h"
+
+// Submission queue depth. The completion queue is twice as deep, and no
+// more than that many operations are let in flight at once
+#define POSIX_IO_URING_ENTRIES 256
+
+// Maximum number of completions reaped before handing the CQ back
+#define POSIX_IO_URING_MAX_REAP 64
+
+// How long a submitter backs off when io_uring_enter() is short of
+// resources, and how often it tries before failing the queued fops
+#define POSIX_IO_URING_BACKOFF_USEC 1000
+#define POSIX_IO_URING_MAX_RETRIES 64
+
+
+int posix_io_uring_on (xlator_t *this);
+int posix_io_uring_off (xlator_t *this);
+void posix_io_uring_fini (xlator_t *this);
+
+int32_t posix_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                     int32_t datasync, dict_t *xdata);
+
+#endif /* !_POSIX_IO_URING_H */
@@ -0,0 +1,679 @@
+/*
+   Copyright (c) 2006-2012 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "glusterfs.h"
+#include "posix.h"
+#include "posix-rchecksum.h"
+
+/*
+ * Persistent cache of the (weak, fast strong) checksum pairs handed out
+ * by rchecksum, so that a diff self-heal of a mostly unchanged file does
+ * not have to read and hash all of it on the source again.
+ *
+ * Every regular file that has been checksummed gets a sidecar file named
+ * after its gfid, holding a header and one entry per block. An entry is
+ * valid only while its tag matches the salt in the header, and the header
+ * only while its epoch matches the one the brick was started with.
+ *
+ * Correctness rests on invalidating before modifying: writev, truncate,
+ * ftruncate and open (O_TRUNC) first clear the entries of the blocks they
+ * are about to change and fdatasync the sidecar if anything was cleared,
+ * and only then touch the data. A checksum computed while a modification
+ * was in flight (or raced with one) is never stored, and one is only
+ * stored after the data it was computed from has been made durable.
+ *
+ * The cache only knows of writes that come through this brick. When the
+ * brick is started with the cache turned off, the epoch is thrown away so
+ * that all sidecars written before are ignored once it is turned on again.
+ */
+
+struct posix_rchecksum_ctx {
+        pthread_mutex_t                 lock;
+        int                             fd;       /* sidecar, or -1 */
+        gf_boolean_t                    absent;   /* no sidecar on disk */
+        struct posix_rchecksum_hdr      hdr;      /* block_size == 0:
+                                                     nothing in it is valid */
+        uint64_t                        gen;      /* bumped around every
+                                                     modification */
+        uint32_t                        inflight; /* modifications going on */
+        gf_boolean_t                    unsynced; /* data written since the
+                                                     last fdatasync */
+};
+
+#define POSIX_RCHECKSUM_ENTRY_OFF(idx)                                  \
+        ((off_t) sizeof (struct posix_rchecksum_hdr) +                  \
+         (off_t) (idx) * (off_t) sizeof (struct posix_rchecksum_entry))
+
+
+static int
+posix_rchecksum_path (xlator_t *this, uuid_t gfid, char *path, size_t size)
+{
+        struct posix_private *priv = this->private;
+
+        return snprintf (path, size, "%s/%s/%02x/%02x/%s", priv->base_path,
+                         POSIX_RCHECKSUM_DIR, gfid[0], gfid[1],
+                         uuid_utoa (gfid));
+}
+
+
+static int
+posix_rchecksum_mkdirs (xlator_t *this, uuid_t gfid)
+{
+        struct posix_private *priv = this->private;
+        char                  path[PATH_MAX] = {0,};
+        int                   ret = 0;
+
+        snprintf (path, sizeof (path), "%s/%s/%02x", priv->base_path,
+                  POSIX_RCHECKSUM_DIR, gfid[0]);
+        ret = mkdir (path, 0700);
+        if (ret == -1 && errno != EEXIST)
+                return -errno;
+
+        snprintf (path, sizeof (path), "%s/%s/%02x/%02x", priv->base_path,
+                  POSIX_RCHECKSUM_DIR, gfid[0], gfid[1]);
+        ret = mkdir (path, 0700);
+        if (ret == -1 && errno != EEXIST)
+                return -errno;
+
+        return 0;
+}
+
+
+static int
+posix_rchecksum_sync_dir (const char *path)
+{
+        int fd  = -1;
+        int ret = 0;
+
+        fd = open (path, O_RDONLY|O_DIRECTORY);
+        if (fd == -1)
+                return -errno;
+
+        ret = fsync (fd);
+        if (ret == -1)
+                ret = -errno;
+
+        close (fd);
+        return ret;
+}
+
+
+int
+posix_rchecksum_cache_init (xlator_t *this)
+{
+        struct posix_private *priv  = NULL;
+        char                  dir[PATH_MAX]   = {0,};
+        char                  path[PATH_MAX]  = {0,};
+        uint64_t              epoch = 0;
+        uuid_t                seed  = {0,};
+        int                   fd    = -1;
+        int                   ret   = -1;
+
+        priv = this->private;
+
+        snprintf (dir, sizeof (dir), "%s/%s", priv->base_path,
+                  POSIX_RCHECKSUM_DIR);
+        snprintf (path, sizeof (path), "%s/%s", priv->base_path,
+                  POSIX_RCHECKSUM_EPOCH);
+
+        if (!priv->rchecksum_cache) {
+                /* whatever gets written from now on is not tracked */
+                ret = unlink (path);
+                if (ret == 0) {
+                        posix_rchecksum_sync_dir (dir);
+                        gf_log (this->name, GF_LOG_INFO,
+                                "rchecksum cache disabled, checksums stored "
+                                "so far are dropped");
+                } else if (errno != ENOENT) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not remove %s (%s)", path,
+                                strerror (errno));
+                        goto out;
+                }
+                ret = 0;
+                goto out;
+        }
+
+        ret = mkdir (dir, 0700);
+        if (ret == -1 && errno != EEXIST) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not create %s (%s)", dir, strerror (errno));
+                goto out;
+        }
+
+        fd = open (path, O_RDONLY);
+        if (fd != -1) {
+                ret = read (fd, &epoch, sizeof (epoch));
+                if (ret != sizeof (epoch))
+                        epoch = 0;
+                close (fd);
+                fd = -1;
+        }
+
+        if (!epoch) {
+                while (!epoch) {
+                        uuid_generate (seed);
+                        memcpy (&epoch, seed, sizeof (epoch));
+                }
+
+                ret = -1;
+                fd = open (path, O_CREAT|O_TRUNC|O_WRONLY, 0600);
+                if (fd == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not create %s (%s)", path,
+                                strerror (errno));
+                        goto out;
+                }
+                if (write (fd, &epoch, sizeof (epoch)) != sizeof (epoch) ||
+                    fsync (fd) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "could not write %s (%s)", path,
+                                strerror (errno));
+                        goto out;
+                }
+                posix_rchecksum_sync_dir (dir);
+        }
+
+        priv->rchecksum_epoch = epoch;
+        ret = 0;
+out:
+        if (fd != -1)
+                close (fd);
+
+        return ret;
+}
+
+
+static struct posix_rchecksum_ctx *
+posix_rchecksum_ctx_get (xlator_t *this, inode_t *inode, gf_boolean_t create)
+{
+        struct posix_rchecksum_ctx *ctx = NULL;
+        uint64_t                    tmp = 0;
+        int                         ret = 0;
+
+        LOCK (&inode->lock);
+        {
+                ret = __inode_ctx_get (inode, this, &tmp);
+                if (ret == 0) {
+                        ctx = (struct posix_rchecksum_ctx *)(long) tmp;
+                        goto unlock;
+                }
+
+                if (!create)
+                        goto unlock;
+
+                ctx = GF_CALLOC (1, sizeof (*ctx), gf_posix_mt_rchecksum_ctx);
+                if (!ctx)
+                        goto unlock;
+
+                pthread_mutex_init (&ctx->lock, NULL);
+                ctx->fd = -1;
+                ctx->gen = 1;
+                /* writes from an earlier life of the inode may still be
+                   in the page cache only */
+                ctx->unsynced = _gf_true;
+
+                ret = __inode_ctx_put (inode, this, (uint64_t)(long) ctx);
+                if (ret) {
+                        pthread_mutex_destroy (&ctx->lock);
+                        GF_FREE (ctx);
+                        ctx = NULL;
+                }
+        }
+unlock:
+        UNLOCK (&inode->lock);
+
+        return ctx;
+}
+
+
+/* open the sidecar and check its header, called with ctx->lock held */
+static int
+__posix_rchecksum_load (xlator_t *this, struct posix_rchecksum_ctx *ctx,
+                        uuid_t gfid)
+{
+        struct posix_private *priv = this->private;
+        char                  path[PATH_MAX] = {0,};
+        int                   ret = 0;
+
+        if (ctx->fd != -1 || ctx->absent)
+                return 0;
+
+        posix_rchecksum_path (this, gfid, path, sizeof (path));
+
+        ctx->fd = open (path, O_RDWR);
+        if (ctx->fd == -1) {
+                if (errno == ENOENT) {
+                        ctx->absent = _gf_true;
+                        return 0;
+                }
+                return -errno;
+        }
+
+        ret = pread (ctx->fd, &ctx->hdr, sizeof (ctx->hdr), 0);
+        if (ret != sizeof (ctx->hdr) ||
+            ctx->hdr.magic != POSIX_RCHECKSUM_MAGIC ||
+            ctx->hdr.version != POSIX_RCHECKSUM_VERSION ||
+            ctx->hdr.epoch != priv->rchecksum_epoch) {
+                /* left over from before the cache was last turned off, or
+                   never completely written: nothing in it can be trusted */
+                ctx->hdr.block_size = 0;
+        }
+
+        return 0;
+}
+
+
+/* throw the sidecar away, called with ctx->lock held */
+static int
+__posix_rchecksum_drop (xlator_t *this, struct posix_rchecksum_ctx *ctx,
+                        uuid_t gfid)
+{
+        char path[PATH_MAX] = {0,};
+        int  ret = 0;
+
+        posix_rchecksum_path (this, gfid, path, sizeof (path));
+
+        ret = unlink (path);
+        if (ret == -1 && errno != ENOENT) {
+                ret = -errno;
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not remove stale checksums %s (%s)", path,
+                        strerror (errno));
+                return ret;
+        }
+
+        if (ctx->fd != -1)
+                close (ctx->fd);
+        ctx->fd = -1;
+        ctx->absent = _gf_true;
+        memset (&ctx->hdr, 0, sizeof (ctx->hdr));
+
+        return 0;
+}
+
+
+/* start the sidecar over for blocks of @block_size, called with ctx->lock
+   held */
+static int
+__posix_rchecksum_reset (xlator_t *this, struct posix_rchecksum_ctx *ctx,
+                         uuid_t gfid, uint32_t block_size)
+{
+        struct posix_private       *priv = this->private;
+        struct posix_rchecksum_hdr  hdr  = {0,};
+        char                        path[PATH_MAX] = {0,};
+        int                         ret  = 0;
+
+        if (ctx->fd == -1) {
+                ret = posix_rchecksum_mkdirs (this, gfid);
+                if (ret)
+                        return ret;
+
+                posix_rchecksum_path (this, gfid, path, sizeof (path));
+                ctx->fd = open (path, O_CREAT|O_RDWR, 0600);
+                if (ctx->fd == -1)
+                        return -errno;
+                ctx->absent = _gf_false;
+        }
+
+        hdr.magic      = POSIX_RCHECKSUM_MAGIC;
+        hdr.version    = POSIX_RCHECKSUM_VERSION;
+        hdr.block_size = block_size;
+        hdr.salt       = ctx->hdr.salt + 1;
+        if (!hdr.salt)
+                hdr.salt = 1;
+        hdr.epoch      = priv->rchecksum_epoch;
+
+        /* the new header has to be on disk before anything is invalidated
+           by its block size */
+        if (ftruncate (ctx->fd, 0) == -1 ||
+            pwrite (ctx->fd, &hdr, sizeof (hdr), 0) != sizeof (hdr) ||
+            fdatasync (ctx->fd) == -1) {
+                ret = -errno;
+                memset (&ctx->hdr, 0, sizeof (ctx->hdr));
+                return ret;
+        }
+
+        ctx->hdr = hdr;
+
+        return 0;
+}
+
+
+/* clear the entries of blocks [@first, @last], called with ctx->lock held */
+static int
+__posix_rchecksum_invalidate (xlator_t *this, struct posix_rchecksum_ctx *ctx,
+                              uint64_t first, uint64_t last)
+{
+        struct posix_rchecksum_entry entry = {0,};
+        struct posix_rchecksum_entry clear = {0,};
+        gf_boolean_t                 dirty = _gf_false;
+        uint64_t                     idx   = 0;
+        int                          ret   = 0;
+
+        for (idx = first; idx <= last; idx++) {
+                ret = pread (ctx->fd, &entry, sizeof (entry),
+                             POSIX_RCHECKSUM_ENTRY_OFF (idx));
+                if (ret == -1)
+                        return -errno;
+                if (ret < sizeof (entry))
+                        break;  /* nothing stored beyond this one */
+                if (entry.tag != ctx->hdr.salt)
+                        continue;
+
+                ret = pwrite (ctx->fd, &clear, sizeof (clear),
+                              POSIX_RCHECKSUM_ENTRY_OFF (idx));
+                if (ret != sizeof (clear))
+                        return (ret == -1) ? -errno : -EIO;
+                dirty = _gf_true;
+        }
+
+        if (dirty && fdatasync (ctx->fd) == -1)
+                return -errno;
+
+        return 0;
+}
+
+
+static int
+posix_rchecksum_modify_begin (xlator_t *this, inode_t *inode, off_t offset,
+                              size_t len, gf_boolean_t truncate)
+{
+        struct posix_private       *priv = NULL;
+        struct posix_rchecksum_ctx *ctx  = NULL;
+        struct stat                 stbuf = {0,};
+        off_t                       keep = 0;
+        uint64_t                    bs   = 0;
+        int                         ret  = 0;
+
+        priv = this->private;
+        if (!priv->rchecksum_cache)
+                return 0;
+
+        ctx = posix_rchecksum_ctx_get (this, inode, _gf_true);
+        if (!ctx)
+                return -ENOMEM;
+
+        pthread_mutex_lock (&ctx->lock);
+        {
+                ctx->inflight++;
+                ctx->gen++;
+                ctx->unsynced = _gf_true;
+
+                if (uuid_is_null (inode->gfid))
+                        goto unlock;
+
+                ret = __posix_rchecksum_load (this, ctx, inode->gfid);
+                if (ret || ctx->fd == -1)
+                        goto unlock;
+
+                bs = ctx->hdr.block_size;
+                if (!bs)
+                        goto unlock;
+
+                if (!truncate) {
+                        if (len)
+                                ret = __posix_rchecksum_invalidate
+                                        (this, ctx, offset / bs,
+                                         (offset + len - 1) / bs);
+                        goto unlock;
+                }
+
+                /* the block the new end of file falls in changes too */
+                keep = POSIX_RCHECKSUM_ENTRY_OFF (offset / bs);
+                ret = fstat (ctx->fd, &stbuf);
+                if (ret == -1) {
+                        ret = -errno;
+                        goto unlock;
+                }
+                if (stbuf.st_size > keep) {
+                        if (ftruncate (ctx->fd, keep) == -1 ||
+                            fdatasync (ctx->fd) == -1)
+                                ret = -errno;
+                }
+        }
+unlock:
+        if (ret) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "invalidating checksums of %s failed (%s), "
+                        "dropping them", uuid_utoa (inode->gfid),
+                        strerror (-ret));
+                ret = __posix_rchecksum_drop (this, ctx, inode->gfid);
+                if (ret)
+                        ctx->inflight--;
+        }
+        pthread_mutex_unlock (&ctx->lock);
+
+        return ret;
+}
+
+
+/* to be called before @len bytes at @offset of @inode are written; if it
+   fails the write must not be done. Every successful call is paired with
+   posix_rchecksum_write_end () once the write is over */
+int
+posix_rchecksum_write_begin (xlator_t *this, inode_t *inode, off_t offset,
+                             size_t len)
+{
+        return posix_rchecksum_modify_begin (this, inode, offset, len,
+                                             _gf_false);
+}
+
+
+int
+posix_rchecksum_truncate_begin (xlator_t *this, inode_t *inode, off_t size)
+{
+        return posix_rchecksum_modify_begin (this, inode, size, 0, _gf_true);
+}
+
+
+void
+posix_rchecksum_write_end (xlator_t *this, inode_t *inode)
+{
+        struct posix_private       *priv = NULL;
+        struct posix_rchecksum_ctx *ctx  = NULL;
+
+        priv = this->private;
+        if (!priv->rchecksum_cache)
+                return;
+
+        ctx = posix_rchecksum_ctx_get (this, inode, _gf_false);
+        if (!ctx)
+                return;
+
+        pthread_mutex_lock (&ctx->lock);
+        {
+                ctx->inflight--;
+                ctx->gen++;
+        }
+        pthread_mutex_unlock (&ctx->lock);
+}
+
+
+/* 0 with the checksums of the @len bytes block at @offset filled in if
+   they are stored. Otherwise -1, with @gen set to what has to be handed
+   to posix_rchecksum_cache_put () along with the computed ones */
+int
+posix_rchecksum_cache_get (xlator_t *this, inode_t *inode, off_t offset,
+                           int32_t len, uint32_t *weak, unsigned char *strong,
+                           uint64_t *gen)
+{
+        struct posix_private         *priv  = NULL;
+        struct posix_rchecksum_ctx   *ctx   = NULL;
+        struct posix_rchecksum_entry  entry = {0,};
+        int                           ret   = -1;
+
+        *gen = 0;
+
+        priv = this->private;
+        if (!priv->rchecksum_cache || len <= 0 || (offset % len) ||
+            uuid_is_null (inode->gfid))
+                return -1;
+
+        ctx = posix_rchecksum_ctx_get (this, inode, _gf_true);
+        if (!ctx)
+                return -1;
+
+        pthread_mutex_lock (&ctx->lock);
+        {
+                if (!ctx->inflight)
+                        *gen = ctx->gen;
+
+                if (__posix_rchecksum_load (this, ctx, inode->gfid) ||
+                    ctx->fd == -1 || ctx->hdr.block_size != len)
+                        goto unlock;
+
+                if (pread (ctx->fd, &entry, sizeof (entry),
+                           POSIX_RCHECKSUM_ENTRY_OFF (offset / len))
+                    != sizeof (entry))
+                        goto unlock;
+
+                if (entry.tag != ctx->hdr.salt)
+                        goto unlock;
+
+                *weak = entry.weak;
+                memcpy (strong, entry.strong, sizeof (entry.strong));
+                ret = 0;
+        }
+unlock:
+        pthread_mutex_unlock (&ctx->lock);
+
+        return ret;
+}
+
+
+void
+posix_rchecksum_cache_put (xlator_t *this, inode_t *inode, int data_fd,
+                           off_t offset, int32_t len, uint32_t weak,
+                           unsigned char *strong, uint64_t gen)
+{
+        struct posix_private         *priv  = NULL;
+        struct posix_rchecksum_ctx   *ctx   = NULL;
+        struct posix_rchecksum_entry  entry = {0,};
+        gf_boolean_t                  sync  = _gf_false;
+        int                           ret   = 0;
+
+        priv = this->private;
+        if (!priv->rchecksum_cache || !gen)
+                return;
+
+        ctx = posix_rchecksum_ctx_get (this, inode, _gf_false);
+        if (!ctx)
+                return;
+
+        pthread_mutex_lock (&ctx->lock);
+        {
+                if (ctx->inflight || ctx->gen != gen) {
+                        pthread_mutex_unlock (&ctx->lock);
+                        return;
+                }
+                sync = ctx->unsynced;
+        }
+        pthread_mutex_unlock (&ctx->lock);
+
+        /* a checksum must never outlive, across a crash, the data it was
+           computed from */
+        if (sync && fdatasync (data_fd) == -1)
+                return;
+
+        pthread_mutex_lock (&ctx->lock);
+        {
+                if (ctx->inflight || ctx->gen != gen)
+                        goto unlock;
+                if (sync)
+                        ctx->unsynced = _gf_false;
+
+                ret = __posix_rchecksum_load (this, ctx, inode->gfid);
+                if (ret)
+                        goto unlock;
+
+                if (ctx->fd == -1 || ctx->hdr.block_size != len) {
+                        ret = __posix_rchecksum_reset (this, ctx, inode->gfid,
+                                                       len);
+                        if (ret) {
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "could not set up checksums of %s "
+                                        "(%s)", uuid_utoa (inode->gfid),
+                                        strerror (-ret));
+                                goto unlock;
+                        }
+                }
+
+                entry.tag  = ctx->hdr.salt;
+                entry.weak = weak;
+                memcpy (entry.strong, strong, sizeof (entry.strong));
+
+                /* not synced: losing it only costs a recomputation */
+                pwrite (ctx->fd, &entry, sizeof (entry),
+                        POSIX_RCHECKSUM_ENTRY_OFF (offset / len));
+        }
+unlock:
+        pthread_mutex_unlock (&ctx->lock);
+}
+
+
+/* the last link of @gfid is gone */
+void
+posix_rchecksum_unlink (xlator_t *this, inode_t *inode, uuid_t gfid)
+{
+        struct posix_private       *priv = NULL;
+        struct posix_rchecksum_ctx *ctx  = NULL;
+        char                        path[PATH_MAX] = {0,};
+
+        priv = this->private;
+        if (!priv->rchecksum_cache || uuid_is_null (gfid))
+                return;
+
+        if (inode && !uuid_compare (inode->gfid, gfid))
+                ctx = posix_rchecksum_ctx_get (this, inode, _gf_false);
+
+        if (!ctx) {
+                posix_rchecksum_path (this, gfid, path, sizeof (path));
+                if (unlink (path) == -1 && errno != ENOENT)
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "unlink %s failed (%s)", path,
+                                strerror (errno));
+                return;
+        }
+
+        /* the same gfid can come back (self-heal recreates files with
+           it), so the inode must not keep the old sidecar around */
+        pthread_mutex_lock (&ctx->lock);
+        {
+                ctx->gen++;
+                __posix_rchecksum_drop (this, ctx, gfid);
+        }
+        pthread_mutex_unlock (&ctx->lock);
+}
+
+
+void
+posix_rchecksum_forget (xlator_t *this, inode_t *inode)
+{
+        struct posix_rchecksum_ctx *ctx = NULL;
+        uint64_t                    tmp = 0;
+
+        if (inode_ctx_del (inode, this, &tmp))
+                return;
+
+        ctx = (struct posix_rchecksum_ctx *)(long) tmp;
+        if (!ctx)
+                return;
+
+        if (ctx->fd != -1)
+                close (ctx->fd);
+        pthread_mutex_destroy (&ctx->lock);
+        GF_FREE (ctx);
+}
@@ -0,0 +1,63 @@
+/*
+   Copyright (c) 2006-2012 Red Hat, Inc. <http://www.redhat.com>
+   This file is part of GlusterFS.
+
+   This file is licensed to you under your choice of the GNU Lesser
+   General Public License, version 3 or any later version (LGPLv3 or
+   later), or the GNU General Public License, version 2 (GPLv2), in all
+   cases as published by the Free Software Foundation.
+*/
+#ifndef _POSIX_RCHECKSUM_H
+#define _POSIX_RCHECKSUM_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "glusterfs.h"
+
+/* per-file block checksums live in
+   <brick>/.glusterfs/rchecksum/<gfid[0]>/<gfid[1]>/<gfid> */
+#define POSIX_RCHECKSUM_DIR     GF_HIDDEN_PATH"/rchecksum"
+#define POSIX_RCHECKSUM_EPOCH   POSIX_RCHECKSUM_DIR"/epoch"
+
+#define POSIX_RCHECKSUM_MAGIC   0x47465243 /* "GFRC" */
+#define POSIX_RCHECKSUM_VERSION 1
+
+struct posix_rchecksum_hdr {
+        uint32_t        magic;
+        uint32_t        version;
+        uint32_t        block_size;
+        uint32_t        salt;      /* tag of the entries written under
+                                      this header */
+        uint64_t        epoch;     /* brick epoch the file belongs to */
+        uint64_t        reserved;
+};
+
+struct posix_rchecksum_entry {
+        uint32_t        tag;       /* == hdr.salt when valid */
+        uint32_t        weak;
+        unsigned char   strong[16];
+};
+
+int posix_rchecksum_cache_init (xlator_t *this);
+
+int posix_rchecksum_write_begin (xlator_t *this, inode_t *inode,
+                                 off_t offset, size_t len);
+int posix_rchecksum_truncate_begin (xlator_t *this, inode_t *inode,
+                                    off_t size);
+void posix_rchecksum_write_end (xlator_t *this, inode_t *inode);
+
+int posix_rchecksum_cache_get (xlator_t *this, inode_t *inode, off_t offset,
+                               int32_t len, uint32_t *weak,
+                               unsigned char *strong, uint64_t *gen);
+void posix_rchecksum_cache_put (xlator_t *this, inode_t *inode, int data_fd,
+                                off_t offset, int32_t len, uint32_t weak,
+                                unsigned char *strong, uint64_t gen);
+
+void posix_rchecksum_unlink (xlator_t *this, inode_t *inode, uuid_t gfid);
+void posix_rchecksum_forget (xlator_t *this, inode_t *inode);
+
+#endif /* !_POSIX_RCHECKSUM_H */
@@ -50,6 +50,8 @@
 #include "glusterfs3-xdr.h"
 #include "hashfn.h"
 #include "posix-aio.h"
+#include "posix-io-uring.h"
+#include "posix-rchecksum.h"
 
 extern char *marker_xattrs[];
 
@@ -79,9 +81,7 @@ extern char *marker_xattrs[];
 int
 posix_forget (xlator_t *this, inode_t *inode)
 {
-        uint64_t tmp_cache = 0;
-        if (!inode_ctx_del (inode, this, &tmp_cache))
-                dict_destroy ((dict_t *)(long)tmp_cache);
+        posix_rchecksum_forget (this, inode);
 
         return 0;
 }
@@ -1052,8 +1052,10 @@ posix_unlink (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
-        if (stbuf.ia_nlink == 1)
+        if (stbuf.ia_nlink == 1) {
                 posix_handle_unset (this, stbuf.ia_gfid, NULL);
+                posix_rchecksum_unlink (this, loc->inode, stbuf.ia_gfid);
+        }
 
         priv = this->private;
         if (priv->background_unlink) {
@@ -1434,8 +1436,10 @@ posix_rename (call_frame_t *frame, xlator_t *this,
         if (was_dir)
                 posix_handle_unset (this, victim, NULL);
 
-        if (was_present && !was_dir && nlink == 1)
+        if (was_present && !was_dir && nlink == 1) {
                 posix_handle_unset (this, victim, NULL);
+                posix_rchecksum_unlink (this, newloc->inode, victim);
+        }
 
         if (IA_ISDIR (oldloc->inode->ia_type)) {
                 posix_handle_soft (this, real_newpath, newloc,
@@ -1592,6 +1596,8 @@ posix_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset,
         struct posix_private *priv      = NULL;
         struct iatt           prebuf    = {0,};
         struct iatt           postbuf   = {0,};
+        gf_boolean_t          rcsum_begun = _gf_false;
+        int                   ret       = 0;
 
         DECLARE_OLD_FS_ID_VAR;
 
@@ -1613,6 +1619,17 @@ posix_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset,
                 goto out;
         }
 
+        if (loc->inode) {
+                ret = posix_rchecksum_truncate_begin (this, loc->inode,
+                                                      offset);
+                if (ret < 0) {
+                        op_ret = -1;
+                        op_errno = -ret;
+                        goto out;
+                }
+                rcsum_begun = _gf_true;
+        }
+
         op_ret = truncate (real_path, offset);
         if (op_ret == -1) {
                 op_errno = errno;
@@ -1633,6 +1650,9 @@ posix_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset,
         op_ret = 0;
 
 out:
+        if (rcsum_begun)
+                posix_rchecksum_write_end (this, loc->inode);
+
         SET_TO_OLD_FS_ID ();
 
         STACK_UNWIND_STRICT (truncate, frame, op_ret, op_errno,
@@ -1818,6 +1838,8 @@ posix_open (call_frame_t *frame, xlator_t *this,
         struct posix_fd      *pfd          = NULL;
         struct posix_private *priv         = NULL;
         struct iatt           stbuf        = {0, };
+        gf_boolean_t          rcsum_begun  = _gf_false;
+        int                   ret          = 0;
 
         DECLARE_OLD_FS_ID_VAR;
 
@@ -1838,6 +1860,15 @@ posix_open (call_frame_t *frame, xlator_t *this,
         if (priv->o_direct)
                 flags |= O_DIRECT;
 
+        if ((flags & O_TRUNC) && fd->inode) {
+                ret = posix_rchecksum_truncate_begin (this, fd->inode, 0);
+                if (ret < 0) {
+                        op_errno = -ret;
+                        goto out;
+                }
+                rcsum_begun = _gf_true;
+        }
+
         _fd = open (real_path, flags, 0);
         if (_fd == -1) {
                 op_ret   = -1;
@@ -1871,6 +1902,9 @@ posix_open (call_frame_t *frame, xlator_t *this,
         op_ret = 0;
 
 out:
+        if (rcsum_begun)
+                posix_rchecksum_write_end (this, fd->inode);
+
         if (op_ret == -1) {
                 if (_fd != -1) {
                         close (_fd);
@@ -1884,6 +1918,105 @@ out:
         return 0;
 }
 
+gf_boolean_t
+posix_zero_copy_wanted (call_frame_t *frame, xlator_t *this,
+                        struct posix_fd *pfd, size_t size)
+{
+        struct posix_private *priv = NULL;
+
+        priv = this->private;
+
+        if (!priv->zero_copy_read)
+                return _gf_false;
+
+        if (!(frame->root->flags & GF_STACK_PIPE_PAYLOAD))
+                return _gf_false;
+
+        if (size < POSIX_ZERO_COPY_MIN_SIZE)
+                return _gf_false;
+
+        if (pfd->odirect || (pfd->flags & O_DIRECT))
+                return _gf_false;
+
+        return _gf_true;
+}
+
+
+/*
+ * read by splicing the file range into a pipe and handing the pipe to
+ * @iobuf. the disk is read right here, the pipe then only holds page cache
+ * pages, which the transport splices on to the socket without copying
+ * them through ->ptr.
+ *
+ * returns the count read, or -1 with errno set. when splicing is not
+ * possible the data is read into ->ptr as usual.
+ */
+static int32_t
+posix_splice_read (xlator_t *this, int _fd, struct iobuf *iobuf,
+                   size_t size, off_t offset)
+{
+        size_t   done = 0;
+        ssize_t  ret = -1;
+#ifdef GF_LINUX_HOST_OS
+        int      pipefd[2] = {-1, -1};
+        loff_t   off = offset;
+        int      pipe_size = 0;
+
+        if (pipe2 (pipefd, O_CLOEXEC | O_NONBLOCK) == -1)
+                goto read_in;
+
+        /* a range which is not page aligned spans one more page */
+        pipe_size = size + getpagesize ();
+        if (fcntl (pipefd[1], F_SETPIPE_SZ, pipe_size) < pipe_size)
+                goto read_in;
+
+        while (done < size) {
+                ret = splice (_fd, &off, pipefd[1], NULL, size - done,
+                              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (ret == -1 && errno == EINTR)
+                        continue;
+                if (ret <= 0)
+                        break;
+                done += ret;
+        }
+
+        if (ret == -1)
+                goto read_in;
+
+        close (pipefd[1]);
+        pipefd[1] = -1;
+
+        if (!done) {
+                close (pipefd[0]);
+                return 0;
+        }
+
+        /* the iobuf owns the read end from here on */
+        if (iobuf_set_pipe_backing (iobuf, pipefd[0], done) == 0)
+                return done;
+
+read_in:
+        gf_log (this->name, GF_LOG_DEBUG,
+                "zero-copy read not possible (%s), reading in",
+                strerror (errno));
+
+        /* whatever made it into the pipe comes first */
+        if (done && (read (pipefd[0], iobuf->ptr, done) != done))
+                done = 0;
+
+        if (pipefd[0] != -1)
+                close (pipefd[0]);
+        if (pipefd[1] != -1)
+                close (pipefd[1]);
+#endif
+        ret = pread (_fd, iobuf->ptr + done, size - done, offset + done);
+        if (ret == -1)
+                return -1;
+
+        return done + ret;
+}
+
+
 int
 posix_readv (call_frame_t *frame, xlator_t *this,
              fd_t *fd, size_t size, off_t offset, uint32_t flags, dict_t *xdata)
@@ -1928,7 +2061,10 @@ posix_readv (call_frame_t *frame, xlator_t *this,
         }
 
         _fd = pfd->fd;
-        op_ret = pread (_fd, iobuf->ptr, size, offset);
+        if (posix_zero_copy_wanted (frame, this, pfd, size))
+                op_ret = posix_splice_read (this, _fd, iobuf, size, offset);
+        else
+                op_ret = pread (_fd, iobuf->ptr, size, offset);
         if (op_ret == -1) {
                 op_errno = errno;
                 gf_log (this->name, GF_LOG_ERROR,
@@ -2081,6 +2217,7 @@ posix_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
         struct iatt            preop    = {0,};
         struct iatt            postop    = {0,};
         int                      ret      = -1;
+        gf_boolean_t           rcsum_begun = _gf_false;
 
         VALIDATE_OR_GOTO (frame, out);
         VALIDATE_OR_GOTO (this, out);
@@ -2111,6 +2248,15 @@ posix_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
         }
 
+        ret = posix_rchecksum_write_begin (this, fd->inode, offset,
+                                           iov_length (vector, count));
+        if (ret < 0) {
+                op_ret = -1;
+                op_errno = -ret;
+                goto out;
+        }
+        rcsum_begun = _gf_true;
+
         op_ret = __posix_writev (_fd, vector, count, offset,
                                  (pfd->flags & O_DIRECT));
         if (op_ret < 0) {
@@ -2150,6 +2296,8 @@ posix_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
 
 out:
+        if (rcsum_begun)
+                posix_rchecksum_write_end (this, fd->inode);
 
         STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, &preop, &postop,
                              NULL);
@@ -3378,6 +3526,7 @@ posix_ftruncate (call_frame_t *frame, xlator_t *this,
         struct posix_fd      *pfd      = NULL;
         int                   ret      = -1;
         struct posix_private *priv     = NULL;
+        gf_boolean_t          rcsum_begun = _gf_false;
 
         DECLARE_OLD_FS_ID_VAR;
         SET_FS_ID (frame->root->uid, frame->root->gid);
@@ -3408,6 +3557,14 @@ posix_ftruncate (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        ret = posix_rchecksum_truncate_begin (this, fd->inode, offset);
+        if (ret < 0) {
+                op_ret = -1;
+                op_errno = -ret;
+                goto out;
+        }
+        rcsum_begun = _gf_true;
+
         op_ret = ftruncate (_fd, offset);
 
         if (op_ret == -1) {
@@ -3430,6 +3587,9 @@ posix_ftruncate (call_frame_t *frame, xlator_t *this,
         op_ret = 0;
 
 out:
+        if (rcsum_begun)
+                posix_rchecksum_write_end (this, fd->inode);
+
         SET_TO_OLD_FS_ID ();
 
         STACK_UNWIND_STRICT (ftruncate, frame, op_ret, op_errno, &preop,
@@ -3884,6 +4044,10 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
         int              ret           = 0;
         int32_t          weak_checksum = 0;
         unsigned char    strong_checksum[MD5_DIGEST_LENGTH];
+        char            *type          = NULL;
+        gf_boolean_t     fast          = _gf_false;
+        uint64_t         gen           = 0;
+        dict_t          *rsp_xdata     = NULL;
 
         VALIDATE_OR_GOTO (frame, out);
         VALIDATE_OR_GOTO (this, out);
@@ -3891,10 +4055,22 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
 
         memset (strong_checksum, 0, MD5_DIGEST_LENGTH);
 
-        buf = GF_CALLOC (1, len, gf_posix_mt_char);
-        if (!buf) {
-                op_errno = ENOMEM;
-                goto out;
+        /* the caller may ask for the cheaper strong checksum; peers which
+           don't know of it just get MD5 and no type in the reply */
+        if (xdata && !dict_get_str (xdata, GF_RCHECKSUM_TYPE_KEY, &type) &&
+            !strcmp (type, GF_RCHECKSUM_TYPE_FAST)) {
+                fast = _gf_true;
+                rsp_xdata = dict_new ();
+                if (!rsp_xdata) {
+                        op_errno = ENOMEM;
+                        goto out;
+                }
+                ret = dict_set_str (rsp_xdata, GF_RCHECKSUM_TYPE_KEY,
+                                    GF_RCHECKSUM_TYPE_FAST);
+                if (ret) {
+                        op_errno = ENOMEM;
+                        goto out;
+                }
         }
 
         ret = posix_fd_ctx_get (fd, this, &pfd);
@@ -3907,6 +4083,20 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
 
         _fd = pfd->fd;
 
+        if (fast &&
+            !posix_rchecksum_cache_get (this, fd->inode, offset, len,
+                                        (uint32_t *) &weak_checksum,
+                                        strong_checksum, &gen)) {
+                op_ret = 0;
+                goto out;
+        }
+
+        buf = GF_CALLOC (1, len, gf_posix_mt_char);
+        if (!buf) {
+                op_errno = ENOMEM;
+                goto out;
+        }
+
         ret = pread (_fd, buf, len, offset);
         if (ret < 0) {
                 gf_log (this->name, GF_LOG_WARNING,
@@ -3918,14 +4108,25 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
         }
 
         weak_checksum = gf_rsync_weak_checksum ((unsigned char *) buf, (size_t) len);
-        gf_rsync_strong_checksum ((unsigned char *) buf, (size_t) len, (unsigned char *) strong_checksum);
+        if (fast) {
+                gf_rsync_fast_checksum ((unsigned char *) buf, (size_t) len,
+                                        strong_checksum);
+                posix_rchecksum_cache_put (this, fd->inode, _fd, offset, len,
+                                           weak_checksum, strong_checksum,
+                                           gen);
+        } else {
+                gf_rsync_strong_checksum ((unsigned char *) buf, (size_t) len,
+                                          (unsigned char *) strong_checksum);
+        }
 
         op_ret = 0;
 out:
         STACK_UNWIND_STRICT (rchecksum, frame, op_ret, op_errno,
-                             weak_checksum, strong_checksum, NULL);
+                             weak_checksum, strong_checksum, rsp_xdata);
 
         GF_FREE (buf);
+        if (rsp_xdata)
+                dict_unref (rsp_xdata);
 
         return 0;
 }
@@ -4008,11 +4209,22 @@ reconfigure (xlator_t *this, dict_t *options)
 	GF_OPTION_RECONF ("linux-aio", priv->aio_configured,
 			  options, bool, out);
 
+        GF_OPTION_RECONF ("zero-copy-read", priv->zero_copy_read,
+                          options, bool, out);
+
 	if (priv->aio_configured)
 		posix_aio_on (this);
 	else
 		posix_aio_off (this);
 
+        GF_OPTION_RECONF ("io-uring", priv->io_uring_configured,
+                          options, bool, out);
+
+        if (priv->io_uring_configured)
+                posix_io_uring_on (this);
+        else if (priv->io_uring_init_done)
+                posix_io_uring_off (this);
+
 	ret = 0;
 out:
 	return ret;
@@ -4364,6 +4576,8 @@ init (xlator_t *this)
         GF_OPTION_INIT ("brick-gid", gid, uint32, out);
         posix_set_owner (this, uid, gid);
 
+        GF_OPTION_INIT ("zero-copy-read", _private->zero_copy_read, bool, out);
+
 	GF_OPTION_INIT ("linux-aio", _private->aio_configured, bool, out);
 
 	if (_private->aio_configured) {
@@ -4377,6 +4591,22 @@ init (xlator_t *this)
 		}
 	}
 
+        GF_OPTION_INIT ("io-uring", _private->io_uring_configured, bool, out);
+
+        if (_private->io_uring_configured)
+                posix_io_uring_on (this);
+
+        GF_OPTION_INIT ("rchecksum-cache", _private->rchecksum_cache, bool,
+                        out);
+
+        op_ret = posix_rchecksum_cache_init (this);
+        if (op_ret == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "rchecksum cache setup failed");
+                ret = -1;
+                goto out;
+        }
+
         pthread_mutex_init (&_private->janitor_lock, NULL);
         pthread_cond_init (&_private->janitor_cond, NULL);
         INIT_LIST_HEAD (&_private->janitor_fds);
@@ -4392,6 +4622,7 @@ fini (xlator_t *this)
         struct posix_private *priv = this->private;
         if (!priv)
                 return;
+        posix_io_uring_fini (this);
         this->private = NULL;
         /*unlock brick dir*/
         if (priv->mount_lock)
@@ -4480,6 +4711,30 @@ struct volume_options options[] = {
 	  .default_value = "off",
           .description = "Support for native Linux AIO"
 	},
+        {
+          .key  = {"zero-copy-read"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Splice large reads from the page cache to the "
+                         "network through a pipe instead of copying them "
+                         "through an iobuf"
+        },
+        {
+          .key  = {"io-uring"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Submit readv, writev and fsync through io_uring "
+                         "instead of blocking an io-threads worker"
+        },
+        {
+          .key  = {"rchecksum-cache"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .default_value = "off",
+          .description = "Keep the block checksums computed for diff "
+                         "self-heal on the brick, so that unchanged blocks "
+                         "are not read and hashed again by the next heal. "
+                         "Takes effect when the brick is restarted"
+        },
         {
           .key = {"brick-uid"},
           .type = GF_OPTION_TYPE_INT,
@@ -121,12 +121,27 @@ struct posix_private {
 	gf_boolean_t    aio_configured;
 	gf_boolean_t    aio_init_done;
 	gf_boolean_t    aio_capable;
+
+	gf_boolean_t    io_uring_configured;
+	gf_boolean_t    io_uring_init_done;
+	gf_boolean_t    io_uring_capable;
+        struct posix_uring *uring;
+
+/* keep the checksums handed out by rchecksum (see posix-rchecksum.c) */
+        gf_boolean_t    rchecksum_cache;
+        uint64_t        rchecksum_epoch;
+
+/* splice large reads into pipe-backed iobufs when the caller can take them */
+        gf_boolean_t    zero_copy_read;
 #ifdef HAVE_LIBAIO
         io_context_t    ctxp;
         pthread_t       aiothread;
 #endif
 };
 
+/* below this, setting up a pipe costs more than the copy it saves */
+#define POSIX_ZERO_COPY_MIN_SIZE (64 * GF_UNIT_KB)
+
 #define POSIX_BASE_PATH(this) (((struct posix_private *)this->private)->base_path)
 
 #define POSIX_BASE_PATH_LEN(this) (((struct posix_private *)this->private)->base_path_length)
@@ -159,6 +174,8 @@ int posix_fd_ctx_get (fd_t *fd, xlator_t *this, struct posix_fd **pfd);
 int posix_fd_ctx_get_off (fd_t *fd, xlator_t *this, struct posix_fd **pfd,
                           off_t off);
 void posix_fill_ino_from_gfid (xlator_t *this, struct iatt *buf);
+gf_boolean_t posix_zero_copy_wanted (call_frame_t *frame, xlator_t *this,
+                                     struct posix_fd *pfd, size_t size);
 
 gf_boolean_t posix_special_xattr (char **pattern, char *key);
 #endif /* _POSIX_H */